@@ -0,0 +1,49 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include "pico/stdlib.h"
+
+#define ALERTS_MAX_RULES 8
+
+// Longest label of a rule, e.g. "SOIL LOW"
+#define ALERTS_LABEL_LEN 9
+
+typedef enum {ALERT_TEMPERATURE, ALERT_LUX, ALERT_MOISTURE, ALERT_METRIC_COUNT} alert_metric_t;
+
+typedef enum {ALERT_BELOW, ALERT_ABOVE, ALERT_OUTSIDE} alert_kind_t;
+
+// Fires once the value has been below 'low', above 'high' or outside
+// [low, high] for 'duration_s'. Clears once it has been back inside
+// by at least 'hysteresis' for ALERTS_CLEAR_HOLD_S.
+typedef struct {
+    bool enabled;
+    alert_metric_t metric;
+    alert_kind_t kind;
+    int32_t low;
+    int32_t high;
+    int32_t hysteresis;
+    uint32_t duration_s;
+} alert_rule_t;
+
+#define ALERTS_CLEAR_HOLD_S 60
+
+// Samples wanted within a rule's duration, so it fires on time
+#define ALERTS_SAMPLES_PER_DURATION 10
+
+void alerts_init(void);
+
+bool alerts_set_rule(uint slot, const alert_rule_t* rule);
+
+void alerts_add_sample(alert_metric_t metric, int32_t value, uint32_t timestamp_s);
+
+uint32_t alerts_firing_mask(void);
+
+uint32_t alerts_interval_ms(alert_metric_t metric);
+
+void alerts_label(uint slot, char label[ALERTS_LABEL_LEN + 1]);
+
+void alerts_report(void);
+
+bool alerts_configure(const char* args);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include "pico/stdlib.h"
+
+// Moisture level below which the soil counts as dry, matching the
+// "DRY" band of the soil view
+#define ANALYTICS_DRY_MOISTURE 400
+
+typedef struct {
+    uint32_t dli_today_x100;        // Daily light integral so far today, mol/m2 x 100
+    uint32_t dli_yesterday_x100;    // Daily light integral of the previous day
+    bool yesterday_valid;
+    uint8_t dry_points;             // Points in the dry-down fit
+    bool drying;                    // True if the fitted moisture is falling
+    uint32_t dry_rate_x10;          // Fall of moisture in %/day x 10
+    uint32_t hours_to_dry;          // 0 if already dry
+} analytics_t;
+
+void analytics_init(void);
+
+void analytics_add_light(uint16_t lux, uint32_t timestamp_s);
+
+void analytics_add_moisture(uint16_t moisture, uint32_t timestamp_s);
+
+void analytics_get(analytics_t* result);
+
+void analytics_report(void);
+
+#endif
@@ -4,11 +4,34 @@
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
+#include "i2c_sched.h"
+#include "sensor.h"
 
-void _i2c_write_byte(i2c_inst_t* i2c, uint8_t byte); 
+// State of a BH1750 registered as a sensor
+typedef struct {
+    i2c_inst_t* i2c;
+    bool powered_down;
+    bool burst;     // Low-res conversions, for oversampling
+} bh1750_sensor_t;
 
-void bh1750_power_on(i2c_inst_t* i2c);
+extern const sensor_driver_t bh1750_sensor_driver;
 
-uint16_t bh1750_read_measurement(i2c_inst_t* i2c);
+bool _i2c_write_byte(i2c_inst_t* i2c, uint8_t byte); 
+
+bool bh1750_power_on(i2c_inst_t* i2c);
+
+void bh1750_power_down(i2c_inst_t* i2c);
+
+void bh1750_power_on_job(i2c_job_t* job, i2c_inst_t* i2c);
+
+void bh1750_start_job(i2c_job_t* job, i2c_inst_t* i2c);
+
+void bh1750_start_lres_job(i2c_job_t* job, i2c_inst_t* i2c);
+
+void bh1750_read_job(i2c_job_t* job, i2c_inst_t* i2c, uint8_t buff[2]);
+
+uint16_t bh1750_decode(const uint8_t buff[2]);
+
+bool bh1750_read_measurement(i2c_inst_t* i2c, uint16_t* lux);
 
 #endif
\ No newline at end of file
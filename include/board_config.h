@@ -0,0 +1,38 @@
+#ifndef BOARD_CONFIG_H
+#define BOARD_CONFIG_H
+
+#include "hardware/i2c.h"
+
+// I2C controller pins. A controller is only brought up if a sensor
+// below is mapped to it, so a sensor can be moved to the other bus by
+// changing its mapping.
+#define BOARD_I2C0_SDA_PIN 4
+#define BOARD_I2C0_SCL_PIN 5
+#define BOARD_I2C1_SDA_PIN 6
+#define BOARD_I2C1_SCL_PIN 7
+
+#define BOARD_I2C_BAUDRATE 100000
+
+// Controller each I2C sensor is wired to.
+// The current PCB has every sensor on i2c1.
+#define BOARD_BH1750_I2C i2c1
+#define BOARD_SEESAW_I2C i2c1
+
+// TCA9548A mux for more soil probes than the seesaw has addresses.
+// Bit n is set for a seesaw on mux channel n. Each probe is a sensor
+// of its own, so no more than SENSOR_MAX less the three on-board
+// sensors can be added. The mux is not on the on-board seesaw's bus,
+// as that seesaw would answer along with every probe. The current
+// PCB has no mux.
+#define BOARD_MUX_I2C i2c0
+#define BOARD_MUX_ADDR 0x70
+#define BOARD_MUX_PROBE_CHANNELS 0x00
+
+// Reads decimated into each sample (1, 4, 16 or 64). More reads use
+// shorter conversions and must fit within SENSOR_BURST_BUDGET_MS.
+// The BH1750 takes one H-res read: L-res reads are 4 lx steps, and the
+// 16 needed to get back to 1 lx would take 384 ms.
+#define BOARD_BH1750_OVERSAMPLE 1
+#define BOARD_SEESAW_OVERSAMPLE 16
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CLOCK_PROFILE_H
+#define CLOCK_PROFILE_H
+
+#include "pico/stdlib.h"
+
+typedef enum {CLOCK_PROFILE_LOW_POWER, CLOCK_PROFILE_DEFAULT, CLOCK_PROFILE_FAST, CLOCK_PROFILE_COUNT} clock_profile_t;
+
+// Called after the system clock has changed so a peripheral can
+// recompute its dividers from the new frequency.
+typedef void (*clock_listener_t)(uint32_t sys_hz);
+
+bool clock_profile_add_listener(clock_listener_t listener);
+
+uint32_t clock_profile_sys_khz(clock_profile_t profile);
+
+bool clock_profile_validate(clock_profile_t profile);
+
+bool clock_profile_apply(clock_profile_t profile);
+
+clock_profile_t clock_profile_get(void);
+
+void clock_profile_print_validation(void);
+
+void clock_profile_core1_checkpoint(void);
+
+#endif
@@ -2,13 +2,64 @@
 #define DS18B20_H
 
  #include "hardware/pio.h"
+#include "sensor.h"
 
-void _writeBytes(PIO pio, uint sm, uint8_t bytes[], int len);
+// Longest transaction, in SM words, that can be built
+#define DS18B20_TXN_MAX_WORDS 64
 
-void _readBytes(PIO pio, uint sm, uint8_t bytes[], int len);
+// Reset, ROM command, function command and read sequences encoded
+// as words for the 1-wire SM
+typedef struct {
+    uint32_t words[DS18B20_TXN_MAX_WORDS];
+    uint8_t word_count;
+    uint8_t read_count;
+    bool overflow;
+} ds18b20_txn_t;
+
+// State of a DS18B20 registered as a sensor
+typedef struct {
+    PIO pio;
+    int gpio;
+    int sm;         // Set by init, -1 until then
+    bool in_fahrenheit;
+} ds18b20_sensor_t;
+
+extern const sensor_driver_t ds18b20_sensor_driver;
+
+// 1-wire bus timing produced by the PIO program, in nanoseconds
+typedef struct {
+    uint16_t div_int;
+    uint8_t div_frac;
+    uint32_t tick_ns;
+    uint32_t reset_low_ns;
+    uint32_t write_0_low_ns;
+    uint32_t write_1_low_ns;
+    uint32_t slot_ns;
+    uint32_t read_low_ns;
+    uint32_t read_sample_ns;    // Falling edge to the SM sampling the bit
+    uint32_t read_slot_ns;
+} ds18b20_timing_t;
+
+void ds18b20_txn_begin(ds18b20_txn_t* txn);
+
+void ds18b20_txn_command(ds18b20_txn_t* txn, const uint8_t rom[8], const uint8_t* bytes, int len);
+
+void ds18b20_txn_read(ds18b20_txn_t* txn, int len);
+
+bool ds18b20_txn_start(PIO pio, uint sm, const ds18b20_txn_t* txn, uint8_t* rx);
+
+bool ds18b20_txn_wait(void);
+
+bool ds18b20_txn_run(PIO pio, uint sm, const ds18b20_txn_t* txn, uint8_t* rx);
 
 int8_t ds18b20_get_temperature(PIO pio, uint sm, bool in_fahrenheit);
 
 int ds18b20_init(PIO pio, int gpio);
 
+void ds18b20_clkdiv_for(uint32_t sys_hz, uint16_t* div_int, uint8_t* div_frac);
+
+bool ds18b20_timing_for_clock(uint32_t sys_hz, ds18b20_timing_t* timing);
+
+void ds18b20_set_clock(PIO pio, uint sm, uint32_t sys_hz);
+
 #endif
\ No newline at end of file
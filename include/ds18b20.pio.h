@@ -13,46 +13,49 @@
 // ------- //
 
 #define ds18b20_wrap_target 0
-#define ds18b20_wrap 28
+#define ds18b20_wrap 29
 
 static const uint16_t ds18b20_program_instructions[] = {
             //     .wrap_target
     0x80a0, //  0: pull   block                      
     0xa027, //  1: mov    x, osr                     
-    0x0034, //  2: jmp    !x, 20                     
+    0x0035, //  2: jmp    !x, 21                     
     0xe081, //  3: set    pindirs, 1                 
     0xe000, //  4: set    pins, 0                    
     0x0045, //  5: jmp    x--, 5                     
     0xff80, //  6: set    pindirs, 0             [31]
-    0x3fa0, //  7: wait   1 pin, 0               [31]
-    0x80a0, //  8: pull   block                      
-    0xa027, //  9: mov    x, osr                     
-    0x80a0, // 10: pull   block                      
-    0xe047, // 11: set    y, 7                       
-    0xe081, // 12: set    pindirs, 1                 
-    0xe100, // 13: set    pins, 0                [1] 
-    0x7f01, // 14: out    pins, 1                [31]
-    0xf401, // 15: set    pins, 1                [20]
-    0x008d, // 16: jmp    y--, 13                    
-    0x004a, // 17: jmp    x--, 10                    
-    0xff80, // 18: set    pindirs, 0             [31]
-    0x0000, // 19: jmp    0                          
-    0x80a0, // 20: pull   block                      
-    0xa027, // 21: mov    x, osr                     
-    0xe047, // 22: set    y, 7                       
-    0xe081, // 23: set    pindirs, 1                 
-    0xe100, // 24: set    pins, 0                [1] 
-    0xe580, // 25: set    pindirs, 0             [5] 
-    0x4a01, // 26: in     pins, 1                [10]
-    0x0097, // 27: jmp    y--, 23                    
-    0x0056, // 28: jmp    x--, 22                    
+    0x00de, //  7: jmp    pin, 30                    
+    0x3fa0, //  8: wait   1 pin, 0               [31]
+    0x80a0, //  9: pull   block                      
+    0xa027, // 10: mov    x, osr                     
+    0x80a0, // 11: pull   block                      
+    0xe047, // 12: set    y, 7                       
+    0xe081, // 13: set    pindirs, 1                 
+    0xe100, // 14: set    pins, 0                [1] 
+    0x7f01, // 15: out    pins, 1                [31]
+    0xf401, // 16: set    pins, 1                [20]
+    0x008e, // 17: jmp    y--, 14                    
+    0x004b, // 18: jmp    x--, 11                    
+    0xff80, // 19: set    pindirs, 0             [31]
+    0x0000, // 20: jmp    0                          
+    0x80a0, // 21: pull   block                      
+    0xa027, // 22: mov    x, osr                     
+    0xe047, // 23: set    y, 7                       
+    0xe081, // 24: set    pindirs, 1                 
+    0xe100, // 25: set    pins, 0                [1] 
+    0xe280, // 26: set    pindirs, 0             [2] 
+    0x5601, // 27: in     pins, 1                [22]
+    0x0098, // 28: jmp    y--, 24                    
+    0x0057, // 29: jmp    x--, 23                    
             //     .wrap
+    0xc010, // 30: irq    nowait 0 rel               
+    0x0009, // 31: jmp    9                          
 };
 
 #if !PICO_NO_HARDWARE
 static const struct pio_program ds18b20_program = {
     .instructions = ds18b20_program_instructions,
-    .length = 29,
+    .length = 32,
     .origin = -1,
 };
 
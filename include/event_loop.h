@@ -0,0 +1,31 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "pico/stdlib.h"
+
+typedef enum {EVENT_BUTTON, EVENT_SAMPLE, EVENT_TIMER} event_type_t;
+
+typedef struct {
+    event_type_t type;
+    uint32_t data;
+} event_t;
+
+void event_loop_init(void);
+
+bool event_post(event_type_t type, uint32_t data);
+
+bool event_poll(event_t* event);
+
+void event_wait(event_t* event);
+
+void event_set_idle_handler(void (*handler)(void));
+
+int event_timer_start(uint32_t delay_ms, bool repeating, uint32_t data);
+
+void event_timer_cancel(int timer);
+
+int64_t event_timer_next_deadline_us(void);
+
+void event_notify_sample(uint32_t sequence);
+
+#endif
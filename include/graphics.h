@@ -2,9 +2,27 @@
 #define GRAPHICS_H
 
 #include "pico/stdlib.h"
+#include "history.h"
+#include "analytics.h"
+
+// Passed instead of a reading from a faulted sensor, which is shown as "--"
+#define GRAPHICS_NO_TEMPERATURE INT8_MIN
+#define GRAPHICS_NO_READING UINT16_MAX
 
 void graphics_init(void);
 
+void graphics_set_power(bool on);
+
+void graphics_prerender_begin(void);
+
+void graphics_prerender_end(void);
+
+void graphics_show_prerendered(void);
+
+void graphics_wait_for_flush(void);
+
+void graphics_set_alert(const char* text);
+
 void clear_current_view(void);
 
 void show_loading_view(void);
@@ -17,4 +35,10 @@ void show_soil_view(uint16_t moisture, int8_t temperature);
 
 void show_light_view(uint16_t lux, int8_t temperature);
 
+void show_trend_view(history_sensor_t sensor, history_resolution_t resolution, int8_t temperature);
+
+void show_dli_view(const analytics_t* analytics, int8_t temperature);
+
+void show_dry_down_view(const analytics_t* analytics, int8_t temperature);
+
 #endif
\ No newline at end of file
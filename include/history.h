@@ -0,0 +1,40 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "pico/stdlib.h"
+
+// Number of buckets kept per resolution. Matches the LCD width
+// so a trend graph is exactly one bucket per pixel column.
+#define HISTORY_BUCKETS 84
+
+typedef enum {HISTORY_MOISTURE, HISTORY_LUX, HISTORY_TEMPERATURE, HISTORY_SENSOR_COUNT} history_sensor_t;
+
+// Moisture is kept in 1/HISTORY_MOISTURE_SCALE counts, so the extra
+// bits of an oversampled soil sensor are averaged, not rounded away
+#define HISTORY_MOISTURE_SCALE 8
+
+typedef enum {HISTORY_RES_1MIN, HISTORY_RES_15MIN, HISTORY_RES_1H, HISTORY_RES_COUNT} history_resolution_t;
+
+// Aggregate of all samples which fell into one bucket
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int16_t avg;
+    bool valid;
+} history_point_t;
+
+void history_init(void);
+
+void history_add_sample(history_sensor_t sensor, int16_t value, uint32_t timestamp_s);
+
+void history_get_trend(history_sensor_t sensor, history_resolution_t resolution, history_point_t points[HISTORY_BUCKETS]);
+
+uint32_t history_period_s(history_resolution_t resolution);
+
+uint32_t history_newest_epoch(history_resolution_t resolution);
+
+bool history_get_bucket(history_sensor_t sensor, history_resolution_t resolution, uint32_t epoch, history_point_t* point);
+
+const char* history_resolution_label(history_resolution_t resolution);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef I2C_SCHED_H
+#define I2C_SCHED_H
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "latency_hist.h"
+
+#define I2C_SCHED_BUSES 2
+
+// Longest a job may take. The longest job, a few bytes at 100 kHz,
+// is done in well under a millisecond.
+#define I2C_SCHED_JOB_TIMEOUT_US 2000
+
+// Most TCA9548A muxes the scheduler routes jobs through
+#define I2C_SCHED_MUXES 8
+
+struct tca9548a;
+
+// One I2C transaction: an optional write followed by an optional read,
+// ending with a stop condition. A job for a device behind a mux has
+// the mux channel selected first.
+typedef struct {
+    i2c_inst_t* i2c;
+    uint8_t addr;
+    struct tca9548a* mux;   // Mux the device is behind, or NULL
+    uint8_t mux_channel;
+    const uint8_t* tx;
+    uint8_t tx_len;
+    uint8_t* rx;
+    uint8_t rx_len;
+    int result;     // Bytes transferred, PICO_ERROR_GENERIC on a NACK,
+                    // PICO_ERROR_TIMEOUT or PICO_ERROR_IO if the bus was stuck
+    latency_hist_t* latency;    // Records the job's bus time, if set
+} i2c_job_t;
+
+void i2c_sched_add_bus(i2c_inst_t* i2c, uint sda_pin, uint scl_pin, uint baudrate);
+
+void i2c_sched_add_mux(struct tca9548a* mux);
+
+void i2c_sched_clock_changed(void);
+
+void i2c_job_write(i2c_job_t* job, i2c_inst_t* i2c, uint8_t addr, const uint8_t* tx, uint8_t tx_len);
+
+void i2c_job_read(i2c_job_t* job, i2c_inst_t* i2c, uint8_t addr, uint8_t* rx, uint8_t rx_len);
+
+void i2c_sched_run(i2c_job_t jobs[], int count);
+
+uint32_t i2c_sched_utilization_permille(uint bus);
+
+void i2c_sched_report(void);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "pico/stdlib.h"
+
+typedef enum {INPUT_PRESS, INPUT_LONG_PRESS, INPUT_DOUBLE_PRESS} input_kind_t;
+
+typedef struct {
+    input_kind_t kind;
+    uint64_t time_us;   // Time of the edge which completed the gesture
+} input_event_t;
+
+void input_init(uint gpio);
+
+bool input_poll(input_event_t* event);
+
+uint32_t input_dropped(void);
+
+#endif
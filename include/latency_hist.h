@@ -0,0 +1,42 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include "pico/stdlib.h"
+
+// Each power of two is split into 2^LATENCY_HIST_SUB_BITS buckets, so
+// a bucket is at most 1/8 as wide as the values in it. Values below
+// 2^LATENCY_HIST_SUB_BITS us are exact.
+#define LATENCY_HIST_SUB_BITS 3
+
+// Largest power of two tracked (2^23 us, about 8 s). Longer values
+// all fall into the last bucket.
+#define LATENCY_HIST_MAX_EXP 23
+
+#define LATENCY_HIST_BUCKETS \
+    ((LATENCY_HIST_MAX_EXP - LATENCY_HIST_SUB_BITS + 2) * (1 << LATENCY_HIST_SUB_BITS) + 1)
+
+// Latencies of one stage, in microseconds. Define with a name only:
+//   static latency_hist_t hist = {.name = "stage"};
+typedef struct {
+    const char* name;
+    uint32_t counts[LATENCY_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    bool registered;
+} latency_hist_t;
+
+void latency_hist_init(void);
+
+void latency_hist_record(latency_hist_t* hist, uint32_t us);
+
+uint32_t latency_hist_bucket(uint32_t us);
+
+uint32_t latency_hist_bucket_low(uint32_t bucket);
+
+uint32_t latency_hist_bucket_high(uint32_t bucket);
+
+uint32_t latency_hist_percentile(const latency_hist_t* hist, uint32_t permille);
+
+void latency_hist_dump_all(bool reset);
+
+#endif
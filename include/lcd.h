@@ -2,17 +2,42 @@
 #define LCD_H
 
 #include "pico/stdlib.h"
+#include "pcd8544_emu.h"
+
+#define LCD_BUF_SIZE ((48 * 84) / 8)
+#define LCD_BANKS 6
+#define LCD_WIDTH 84
 
 void lcd_init(void);
 
+void lcd_set_power(bool on);
+
 void flush_lcd_buffer(void);
 
+uint32_t lcd_panel_checksum(void);
+
+void lcd_attach_emulator(pcd8544_emu_t* emu);
+
+bool lcd_emulator_matches_buffer(const pcd8544_emu_t* emu);
+
 void clear_lcd(void);
 
+void lcd_clear_buffer(void);
+
+void lcd_load_frame(const uint8_t* frame);
+
+void lcd_begin_offscreen(uint8_t* frame);
+
+void lcd_end_offscreen(void);
+
+void lcd_wait_for_flush(void);
+
 void show_splashscreen(void);
 
 uint8_t lcd_draw_rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, bool fill);
 
+uint8_t lcd_draw_vline(uint8_t x, uint8_t y1, uint8_t y2);
+
 uint8_t lcd_draw_bitmap_8x8(const uint8_t bitmap[8], uint8_t x, uint8_t y);
 
 void lcd_newline(void);
@@ -0,0 +1,79 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ---------- //
+// lcd_stream //
+// ---------- //
+
+#define lcd_stream_wrap_target 0
+#define lcd_stream_wrap 7
+
+static const uint16_t lcd_stream_program_instructions[] = {
+            //     .wrap_target
+    0x6021, //  0: out    x, 1            side 0     
+    0x0024, //  1: jmp    !x, 4           side 0     
+    0xe001, //  2: set    pins, 1         side 0     
+    0x0005, //  3: jmp    5               side 0     
+    0xe000, //  4: set    pins, 0         side 0     
+    0xe047, //  5: set    y, 7            side 0     
+    0x6101, //  6: out    pins, 1         side 0 [1] 
+    0x1186, //  7: jmp    y--, 6          side 1 [1] 
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program lcd_stream_program = {
+    .instructions = lcd_stream_program_instructions,
+    .length = 8,
+    .origin = -1,
+};
+
+static inline pio_sm_config lcd_stream_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + lcd_stream_wrap_target, offset + lcd_stream_wrap);
+    sm_config_set_sideset(&c, 1, false, false);
+    return c;
+}
+
+// Builds the FIFO word which sends one byte to the LCD
+static inline uint32_t lcd_stream_word(bool is_data, uint8_t byte) {
+    return ((uint32_t)is_data << 31) | ((uint32_t)byte << 23);
+}
+
+// Gets the byte and D/C flag back out of a FIFO word
+static inline uint8_t lcd_stream_decode(uint32_t word, bool* is_data) {
+    *is_data = word >> 31;
+    return (word >> 23) & 0xFF;
+}
+
+static inline void lcd_stream_program_init(PIO pio, uint sm, uint offset, uint pin_sck, uint pin_mosi, uint pin_dc, uint16_t div_int, uint8_t div_frac) {
+    pio_sm_config c = lcd_stream_program_get_default_config(offset);
+
+    sm_config_set_out_pins(&c, pin_mosi, 1);
+    sm_config_set_set_pins(&c, pin_dc, 1);
+    sm_config_set_sideset_pins(&c, pin_sck);
+    sm_config_set_out_shift(&c, false, true, 9);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv_int_frac(&c, div_int, div_frac);
+
+    uint32_t pin_mask = (1u << pin_sck) | (1u << pin_mosi) | (1u << pin_dc);
+    pio_sm_set_pins_with_mask(pio, sm, 0, pin_mask);
+    pio_sm_set_pindirs_with_mask(pio, sm, pin_mask, pin_mask);
+
+    pio_gpio_init(pio, pin_sck);
+    pio_gpio_init(pio, pin_mosi);
+    pio_gpio_init(pio, pin_dc);
+
+    pio_sm_init(pio, sm, offset, &c);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+#endif
+
@@ -0,0 +1,14 @@
+#ifndef LOG_EXPORT_H
+#define LOG_EXPORT_H
+
+#include "pico/stdlib.h"
+
+#define LOG_EXPORT_BLOCK_SIZE 512
+
+uint32_t log_export_block_count(void);
+
+void log_export_snapshot(void);
+
+void log_export_read_block(uint32_t lba, uint8_t block[LOG_EXPORT_BLOCK_SIZE]);
+
+#endif
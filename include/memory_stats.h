@@ -0,0 +1,27 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include "pico/stdlib.h"
+
+// Size of the RP2040's SRAM, including both scratch banks
+#define MEMORY_SRAM_BYTES (264 * 1024)
+
+typedef struct {
+    uint32_t stack_size[2];
+    uint32_t stack_used[2];     // High-water mark of each core's stack
+    uint32_t data_bytes;        // Initialized data and code copied to SRAM
+    uint32_t bss_bytes;
+    uint32_t heap_bytes;        // Heap taken from the system so far
+} memory_stats_t;
+
+void memory_paint_core0_stack(void);
+
+void memory_paint_stack(uint core, uint32_t* bottom, uint32_t size_bytes);
+
+uint32_t memory_stack_high_water(uint core);
+
+void memory_get_stats(memory_stats_t* stats);
+
+void memory_report(void);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef PCD8544_EMU_H
+#define PCD8544_EMU_H
+
+#include "pico/stdlib.h"
+
+#define PCD8544_WIDTH 84
+#define PCD8544_HEIGHT 48
+#define PCD8544_BANKS 6
+
+// Display control modes set with the D and E bits
+typedef enum {PCD8544_BLANK, PCD8544_ALL_ON, PCD8544_NORMAL, PCD8544_INVERSE} pcd8544_display_t;
+
+// State of an emulated PCD8544 controller
+typedef struct {
+    uint8_t ram[PCD8544_BANKS][PCD8544_WIDTH];
+    uint8_t x;
+    uint8_t y;
+    bool extended;          // H bit: extended instruction set
+    bool vertical;          // V bit: vertical addressing
+    bool powered_down;      // PD bit
+    pcd8544_display_t display;
+    uint8_t vop;
+    uint32_t commands;      // Commands since the last frame reset
+    uint32_t data_bytes;    // Data bytes since the last frame reset
+} pcd8544_emu_t;
+
+void pcd8544_emu_reset(pcd8544_emu_t* emu);
+
+void pcd8544_emu_command(pcd8544_emu_t* emu, uint8_t cmd);
+
+void pcd8544_emu_data(pcd8544_emu_t* emu, const uint8_t* data, size_t len);
+
+void pcd8544_emu_frame_reset(pcd8544_emu_t* emu);
+
+bool pcd8544_emu_pixel(const pcd8544_emu_t* emu, uint8_t x, uint8_t y);
+
+uint32_t pcd8544_emu_checksum(const pcd8544_emu_t* emu);
+
+void pcd8544_emu_print_pbm(const pcd8544_emu_t* emu, const char* name);
+
+#endif
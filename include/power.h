@@ -0,0 +1,36 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include "pico/stdlib.h"
+
+// Estimated supply current of the probe while awake and while
+// asleep, in microamps. Used to project battery life.
+#define POWER_ACTIVE_UA 25000
+#define POWER_SLEEP_UA 1300
+
+// Capacity of the 2x AA battery pack
+#define POWER_BATTERY_MAH 2000
+
+typedef struct {
+    uint64_t elapsed_us;
+    uint64_t asleep_us;
+    uint32_t awake_permille;
+    uint32_t estimated_ua;
+    uint32_t battery_hours;
+} power_stats_t;
+
+void power_init(void);
+
+void power_set_low_power(bool enabled);
+
+bool power_low_power_enabled(void);
+
+void power_start_epoch(void);
+
+void power_core1_wait_for_epoch(void);
+
+void power_get_stats(power_stats_t* stats);
+
+void power_report(void);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef RAM_PLACEMENT_H
+#define RAM_PLACEMENT_H
+
+#include "pico/platform.h"
+
+// Run interrupt handlers, the render path and driver decoding from
+// SRAM instead of through the XIP cache. Set to 0 to build with
+// everything in flash, e.g. to compare XIP cache reports.
+#ifndef HOT_PATHS_IN_RAM
+#define HOT_PATHS_IN_RAM 1
+#endif
+
+// Marks a function on a hot path:  void HOT_FUNC(name)(args) { ... }
+// Marks a lookup table on a hot path:  const T HOT_DATA(group) name[] = ...
+// Tables must use different groups from each other.
+#if HOT_PATHS_IN_RAM
+#define HOT_FUNC(name) __not_in_flash_func(name)
+#define HOT_DATA(group) __not_in_flash(group)
+#else
+#define HOT_FUNC(name) name
+#define HOT_DATA(group)
+#endif
+
+#endif
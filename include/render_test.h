@@ -0,0 +1,20 @@
+#ifndef RENDER_TEST_H
+#define RENDER_TEST_H
+
+#include "pico/stdlib.h"
+
+// A view drawn with fixed readings. Its expected image is
+// test/golden/<name>.pbm.
+typedef struct {
+    const char* name;
+    void (*draw)(void);
+} render_case_t;
+
+// Cases run in order, so each frame's cost is the change from
+// the one before
+extern const render_case_t render_cases[];
+extern const int render_case_count;
+
+bool render_test_run(void);
+
+#endif
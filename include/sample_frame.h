@@ -0,0 +1,23 @@
+#ifndef SAMPLE_FRAME_H
+#define SAMPLE_FRAME_H
+
+#include "pico/stdlib.h"
+#include "sensor.h"
+
+// One sample as a single line of text:
+//   (REC) <sequence>,<time ms>,<valid mask>,<raw>,...,<raw>*<crc>
+// Sequence and time are decimal. The mask and the SENSOR_RAW_MAX raw
+// bytes of each registered sensor are hex. crc is 4 hex digits of the
+// CRC-16/CCITT-FALSE of the text between "(REC) " and '*'.
+#define SAMPLE_FRAME_TAG "(REC) "
+
+// Longest frame, with its line end and terminating zero
+#define SAMPLE_FRAME_MAX_LEN (6 + 11 + 11 + 2 + SENSOR_MAX * (2 * SENSOR_RAW_MAX + 1) + 6 + 1)
+
+uint16_t sample_frame_crc(const char* text, size_t len);
+
+size_t sample_frame_format(const sensor_record_t* record, char out[SAMPLE_FRAME_MAX_LEN]);
+
+void sample_frame_print(const sensor_record_t* record);
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef SENSOR_H
+#define SENSOR_H
+
+#include "pico/stdlib.h"
+#include "i2c_sched.h"
+
+#define SENSOR_MAX 8        // Most sensors that can be registered
+#define SENSOR_RAW_MAX 8    // Most raw bytes a sensor collects per sample
+
+// Most reads a sensor can be oversampled with, and the time a burst
+// may take. The budget is the longest single conversion, so a burst
+// does not make a sample take longer.
+#define SENSOR_OVERSAMPLE_MAX 64
+#define SENSOR_BURST_BUDGET_MS 200
+
+// Fraction bits of the fine values in a sensor_record_t: enough for
+// the extra bits of the most reads a sensor can be oversampled with
+#define SENSOR_FRACTION_BITS 3
+
+// Hooks implemented by every sensor driver. ctx is the driver's own
+// state, given when the sensor is registered.
+//
+// I2C drivers describe their transfer as a job instead of using the
+// bus, so the sampler can run the jobs of all sensors together. Other
+// drivers leave the job untouched and use their bus directly.
+typedef struct {
+    const char* name;
+    bool (*init)(void* ctx);
+    bool (*start_conversion)(void* ctx, i2c_job_t* job);
+    uint32_t (*conversion_time_ms)(void* ctx);
+    bool (*collect)(void* ctx, i2c_job_t* job, uint8_t raw[SENSOR_RAW_MAX]);
+    int32_t (*decode)(void* ctx, const uint8_t raw[SENSOR_RAW_MAX]);
+    void (*power_down)(void* ctx);  // Optional, may be NULL
+
+    // Optional, may be NULL if the sensor cannot be oversampled.
+    // Switches to short conversions for bursts of reads. The driver's
+    // raw bytes must fit in SENSOR_OVERSAMPLE_RAW_BYTES.
+    bool (*set_burst_mode)(void* ctx, bool burst);
+} sensor_driver_t;
+
+// Consumers which ask for samples of a sensor. Each sensor is sampled
+// as often as its most demanding consumer needs.
+typedef enum {
+    SENSOR_CONSUMER_VIEW,
+    SENSOR_CONSUMER_LOGGER,
+    SENSOR_CONSUMER_ALERTS,
+    SENSOR_CONSUMER_TELEMETRY,
+    SENSOR_CONSUMER_COUNT
+} sensor_consumer_t;
+
+#define SENSOR_DEMAND_NONE 0            // Consumer does not need the sensor
+#define SENSOR_DEMAND_CONTINUOUS 1      // Every sample, as fast as possible
+
+// Interval of a sensor which no consumer needs
+#define SENSOR_KEEPALIVE_MS 300000
+
+// A sensor which fails this many samples in a row is faulted, and one
+// whose last sample failed is retried at least this often
+#define SENSOR_FAULT_AFTER 2
+#define SENSOR_FAULT_RETRY_MS 1000
+
+typedef enum {SENSOR_HEALTH_OK, SENSOR_HEALTH_FAULT} sensor_health_t;
+
+// Raw bytes an oversampled sensor may use. The rest of its raw bytes
+// hold the sum of the burst so that replaying it decodes the same.
+#define SENSOR_OVERSAMPLE_RAW_BYTES 2
+
+// One sample of every registered sensor, indexed by sensor id
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t sequence;
+    uint8_t count;
+    uint8_t valid_mask;             // Bit n set if sensor n was read
+    int32_t values[SENSOR_MAX];             // In the drivers' units
+    int32_t fine_values[SENSOR_MAX];        // With SENSOR_FRACTION_BITS more bits
+    uint16_t conversion_ms[SENSOR_MAX];
+    uint8_t raw[SENSOR_MAX][SENSOR_RAW_MAX];    // Bytes values were decoded from
+} sensor_record_t;
+
+int sensor_register(const sensor_driver_t* driver, void* ctx);
+
+uint8_t sensor_count(void);
+
+const char* sensor_name(int id);
+
+void sensor_init_all(void);
+
+int32_t sensor_decode(int id, const uint8_t raw[SENSOR_RAW_MAX]);
+
+int32_t sensor_decode_fine(int id, const uint8_t raw[SENSOR_RAW_MAX]);
+
+bool sensor_set_oversampling(int id, uint8_t reads);
+
+void sensor_set_demand(int id, sensor_consumer_t consumer, uint32_t interval_ms);
+
+uint32_t sensor_interval_ms(int id);
+
+bool sensor_wait_until_due(uint32_t timeout_ms);
+
+bool sensor_sample_all(sensor_record_t* record, bool power_down);
+
+void sensor_demand_report(void);
+
+void sensor_noise_report(void);
+
+bool sensor_record_valid(const sensor_record_t* record, int id);
+
+sensor_health_t sensor_health(int id);
+
+uint8_t sensor_fault_mask(void);
+
+void sensor_health_report(void);
+
+#endif
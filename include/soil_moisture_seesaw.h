@@ -2,9 +2,31 @@
 #define SOIL_MOISTURE_SEESAW_H
 
 #include "hardware/i2c.h"
+#include "i2c_sched.h"
+#include "tca9548a.h"
+#include "sensor.h"
+
+#define SEESAW_I2C_ADDR 0x36    // With no address jumpers bridged
+
+// State of a seesaw registered as a sensor
+typedef struct {
+    i2c_inst_t* i2c;
+    bool burst;     // Short reads, for oversampling
+    const mux_device_t* mux;    // Route through a mux, or NULL if on the bus directly
+} seesaw_sensor_t;
+
+extern const sensor_driver_t seesaw_sensor_driver;
 
 void seesaw_sw_reset(i2c_inst_t* i2c);
 
-uint16_t seesaw_read_moisture(i2c_inst_t* i2c);
+void seesaw_reset_job(i2c_job_t* job, i2c_inst_t* i2c);
+
+void seesaw_start_job(i2c_job_t* job, i2c_inst_t* i2c);
+
+void seesaw_read_job(i2c_job_t* job, i2c_inst_t* i2c, uint8_t buff[2]);
+
+uint16_t seesaw_decode(const uint8_t buff[2]);
+
+bool seesaw_read_moisture(i2c_inst_t* i2c, uint16_t* moisture);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef TCA9548A_H
+#define TCA9548A_H
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "i2c_sched.h"
+
+#define TCA9548A_CHANNELS 8
+#define TCA9548A_NO_CHANNEL 0xFF    // Every channel closed
+#define TCA9548A_UNKNOWN 0xFE       // Not known, e.g. after a failed select
+
+// One TCA9548A multiplexer and the channel it currently has open.
+// The I2C scheduler writes the channel select before each job routed
+// through the mux, and only when the cached selection differs.
+typedef struct tca9548a {
+    i2c_inst_t* i2c;
+    uint8_t addr;
+    uint8_t selected;           // Open channel, TCA9548A_NO_CHANNEL or TCA9548A_UNKNOWN
+    uint32_t select_writes;     // Channel select writes sent
+    uint32_t transactions;      // All bus transactions through the mux
+} tca9548a_t;
+
+// A device behind a mux, addressed by (mux, channel, address)
+typedef struct {
+    tca9548a_t* mux;
+    uint8_t channel;
+    uint8_t addr;
+} mux_device_t;
+
+void tca9548a_init(tca9548a_t* mux, i2c_inst_t* i2c, uint8_t addr);
+
+void tca9548a_route_job(i2c_job_t* job, const mux_device_t* dev);
+
+void tca9548a_reset_stats(tca9548a_t* mux);
+
+#endif
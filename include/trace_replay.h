@@ -0,0 +1,33 @@
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include "pico/stdlib.h"
+#include "sensor.h"
+
+// One recorded sample: the raw bytes of each sensor, indexed by
+// sensor id in registration order.
+typedef struct {
+    uint32_t time_ms;
+    uint8_t valid_mask;
+    uint8_t raw[SENSOR_MAX][SENSOR_RAW_MAX];
+} trace_sample_t;
+
+// Stores a decoded sample like a live sample would be stored
+typedef void (*trace_publish_fn)(const sensor_record_t* record);
+
+// Draws the display if needed. Returns true if a frame was drawn.
+typedef bool (*trace_render_fn)(void);
+
+// Reads the clock the stages are timed with, in microseconds
+typedef uint64_t (*trace_clock_fn)(void);
+
+extern const trace_sample_t trace_builtin[];
+extern const int trace_builtin_count;
+
+void trace_print_sample(const sensor_record_t* record);
+
+void trace_replay_run(const trace_sample_t trace[], int count,
+                      trace_publish_fn publish, trace_render_fn render,
+                      trace_clock_fn clock);
+
+#endif
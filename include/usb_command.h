@@ -0,0 +1,13 @@
+#ifndef USB_COMMAND_H
+#define USB_COMMAND_H
+
+#include "pico/stdlib.h"
+
+// Called with the rest of the line after the command name
+typedef void (*usb_command_handler_t)(const char* args);
+
+bool usb_command_register(const char* name, usb_command_handler_t handler);
+
+void usb_command_poll(void);
+
+#endif
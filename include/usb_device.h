@@ -0,0 +1,10 @@
+#ifndef USB_DEVICE_H
+#define USB_DEVICE_H
+
+#include "pico/stdlib.h"
+
+void usb_device_init(bool log_export);
+
+bool usb_device_log_export_enabled(void);
+
+#endif
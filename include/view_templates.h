@@ -0,0 +1,22 @@
+#ifndef VIEW_TEMPLATES_H
+#define VIEW_TEMPLATES_H
+
+#include "pico/stdlib.h"
+#include "lcd.h"
+
+// Static layer of each view, generated by tools/gen_view_templates.py
+typedef enum {
+    VIEW_TEMPLATE_LOADING,
+    VIEW_TEMPLATE_ERROR,
+    VIEW_TEMPLATE_DUAL,
+    VIEW_TEMPLATE_SOIL,
+    VIEW_TEMPLATE_LIGHT,
+    VIEW_TEMPLATE_TREND,
+    VIEW_TEMPLATE_DLI,
+    VIEW_TEMPLATE_DRY_DOWN,
+    VIEW_TEMPLATE_COUNT
+} view_template_t;
+
+extern const uint8_t view_templates[VIEW_TEMPLATE_COUNT][LCD_BUF_SIZE];
+
+#endif
@@ -2,11 +2,18 @@
 #define VIEWMODE_SELECT_H
 
 #include "pico/stdlib.h"
+#include "input.h"
 
-typedef enum {DUAL, SOIL, LIGHT} view_mode_t;
+typedef enum {DUAL, SOIL, DRY_DOWN, LIGHT, DLI, SOIL_TREND, LIGHT_TREND, TEMP_TREND} view_mode_t;
 
-void setup_viewmodeselect_irq(uint gpio);
+view_mode_t viewmode_next(void);
+
+view_mode_t viewmode_input(input_kind_t kind);
+
+void viewmode_set(view_mode_t mode);
 
 view_mode_t get_viewmode(void);
 
-#endif
\ No newline at end of file
+view_mode_t get_next_viewmode(void);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef XIP_STATS_H
+#define XIP_STATS_H
+
+#include "pico/stdlib.h"
+
+typedef struct {
+    uint32_t accesses;
+    uint32_t hits;
+    uint32_t hit_permille;
+} xip_stats_t;
+
+void xip_stats_reset(void);
+
+void xip_stats_get(xip_stats_t* stats);
+
+void xip_stats_report(const char* label);
+
+#endif
@@ -0,0 +1,332 @@
+/*
+
+Threshold alerts, evaluated incrementally as samples arrive.
+
+Each rule watches one metric and keeps only a little state: whether it
+is firing, and since when its condition has differed from that. A new
+sample therefore costs the same to evaluate however long the probe
+has been running.
+
+A rule fires once its condition has held for the rule's duration. It
+clears once the value has been back inside the threshold, by at least
+the hysteresis band, for ALERTS_CLEAR_HOLD_S. Noise around a threshold
+can therefore neither fire a rule early nor make it flap.
+
+Every change is printed over USB as an "(ALERT)" event. Samples are
+added from Core1 (or a trace replay) and rules are changed from
+Core0, so both are guarded by a critical section. Changes are only
+recorded inside it and printed once it is left, so USB output never
+holds the other core off.
+
+*/
+
+#include "alerts.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/sync.h"
+
+typedef struct {
+    bool firing;
+    bool pending;           // Condition differs from 'firing'
+    uint32_t since_s;       // Time it started to differ
+} _rule_state_t;
+
+// A rule that fired or cleared, to be printed after the lock is left
+typedef struct {
+    uint slot;
+    bool fired;
+    char label[ALERTS_LABEL_LEN + 1];
+} _transition_t;
+
+static const char* _METRIC_NAMES[ALERT_METRIC_COUNT] = {"temp", "lux", "moisture"};
+static const char* _METRIC_LABELS[ALERT_METRIC_COUNT] = {"TEMP", "LUX", "SOIL"};
+static const char* _KIND_NAMES[] = {"below", "above", "outside"};
+static const char* _KIND_LABELS[] = {"LOW", "HIGH", "OUT"};
+
+// Hysteresis used for rules set over USB
+static const int32_t _DEFAULT_HYSTERESIS[ALERT_METRIC_COUNT] = {2, 500, 20};
+
+// Rules in place at boot. Moisture and temperature (F) match the
+// bands the views show.
+static const alert_rule_t _DEFAULT_RULES[] = {
+    {true, ALERT_MOISTURE, ALERT_BELOW, 400, 0, 20, 30 * 60},
+    {true, ALERT_TEMPERATURE, ALERT_OUTSIDE, 50, 95, 2, 10 * 60},
+};
+
+static critical_section_t _alerts_lock;
+
+static alert_rule_t _rules[ALERTS_MAX_RULES];
+static _rule_state_t _states[ALERTS_MAX_RULES];
+static volatile uint32_t _firing_mask = 0;
+
+/**
+ * @brief Loads the default rules.
+ *
+ */
+void alerts_init(void) {
+    critical_section_init(&_alerts_lock);
+
+    memset(_rules, 0, sizeof(_rules));
+    memset(_states, 0, sizeof(_states));
+    _firing_mask = 0;
+
+    for (uint i = 0; i < count_of(_DEFAULT_RULES); i++) {
+        _rules[i] = _DEFAULT_RULES[i];
+    }
+}
+
+/**
+ * @brief Replaces a rule. Its state starts over, so it is not firing.
+ *
+ * @param slot Rule to replace
+ * @param rule New rule
+ * @return bool False if the slot does not exist.
+ */
+bool alerts_set_rule(uint slot, const alert_rule_t* rule) {
+    if (slot >= ALERTS_MAX_RULES) {
+        return false;
+    }
+
+    critical_section_enter_blocking(&_alerts_lock);
+
+    _rules[slot] = *rule;
+    _states[slot] = (_rule_state_t){0};
+    _firing_mask &= ~(1u << slot);
+
+    critical_section_exit(&_alerts_lock);
+
+    return true;
+}
+
+/**
+ * @brief Checks a rule's condition. Once a rule is firing, the
+ * value must be past the threshold by the hysteresis to count as
+ * back inside.
+ *
+ * @param rule Rule to check
+ * @param value Latest value
+ * @param firing True if the rule is firing
+ * @return bool True if the condition holds.
+ */
+bool _condition(const alert_rule_t* rule, int32_t value, bool firing) {
+    int32_t band = firing ? rule->hysteresis : 0;
+
+    switch (rule->kind) {
+        case ALERT_BELOW:
+            return value < rule->low + band;
+        case ALERT_ABOVE:
+            return value > rule->high - band;
+        default:
+            return value < rule->low + band || value > rule->high - band;
+    }
+}
+
+/**
+ * @brief Evaluates every rule watching a metric against a new value.
+ *
+ * @param metric Metric the value is for
+ * @param value Latest value
+ * @param timestamp_s Time of the value
+ */
+void alerts_add_sample(alert_metric_t metric, int32_t value, uint32_t timestamp_s) {
+    _transition_t transitions[ALERTS_MAX_RULES];
+    uint transition_count = 0;
+
+    critical_section_enter_blocking(&_alerts_lock);
+
+    for (uint i = 0; i < ALERTS_MAX_RULES; i++) {
+        const alert_rule_t* rule = &_rules[i];
+        _rule_state_t* state = &_states[i];
+
+        if (!rule->enabled || rule->metric != metric) {
+            continue;
+        }
+
+        bool holds = _condition(rule, value, state->firing);
+
+        if (holds == state->firing) {
+            state->pending = false;
+            continue;
+        }
+
+        if (!state->pending) {
+            state->pending = true;
+            state->since_s = timestamp_s;
+        }
+
+        uint32_t hold_s = state->firing ? ALERTS_CLEAR_HOLD_S : rule->duration_s;
+
+        if (timestamp_s - state->since_s < hold_s) {
+            continue;
+        }
+
+        state->firing = holds;
+        state->pending = false;
+
+        if (holds) {
+            _firing_mask |= 1u << i;
+        } else {
+            _firing_mask &= ~(1u << i);
+        }
+
+        // Labelled now, while the rule cannot be replaced
+        _transition_t* transition = &transitions[transition_count++];
+        transition->slot = i;
+        transition->fired = holds;
+        alerts_label(i, transition->label);
+    }
+
+    critical_section_exit(&_alerts_lock);
+
+    for (uint i = 0; i < transition_count; i++) {
+        printf("(ALERT) %u %s %s at %lu s, value %ld\n", transitions[i].slot, transitions[i].label,
+               transitions[i].fired ? "fired" : "cleared",
+               (unsigned long)timestamp_s, (long)value);
+    }
+}
+
+/**
+ * @brief Gets which rules are firing.
+ *
+ * @return uint32_t Bit n is set if rule n is firing
+ */
+uint32_t alerts_firing_mask(void) {
+    return _firing_mask;
+}
+
+/**
+ * @brief Gets how often a metric must be sampled for every enabled
+ * rule watching it to fire on time.
+ *
+ * @param metric Metric to check
+ * @return uint32_t Interval in ms, or 0 if no rule watches the metric
+ */
+uint32_t alerts_interval_ms(alert_metric_t metric) {
+    uint32_t interval_ms = 0;
+
+    for (uint i = 0; i < ALERTS_MAX_RULES; i++) {
+        const alert_rule_t* rule = &_rules[i];
+
+        if (!rule->enabled || rule->metric != metric) {
+            continue;
+        }
+
+        uint32_t rule_ms = MAX(rule->duration_s * 1000 / ALERTS_SAMPLES_PER_DURATION, 1000);
+
+        interval_ms = interval_ms ? MIN(interval_ms, rule_ms) : rule_ms;
+    }
+
+    return interval_ms;
+}
+
+/**
+ * @brief Gets the short label of a rule, e.g. "SOIL LOW".
+ *
+ * @param slot Rule
+ * @param label Set to the label
+ */
+void alerts_label(uint slot, char label[ALERTS_LABEL_LEN + 1]) {
+    const alert_rule_t* rule = &_rules[slot % ALERTS_MAX_RULES];
+
+    snprintf(label, ALERTS_LABEL_LEN + 1, "%s %s",
+             _METRIC_LABELS[rule->metric], _KIND_LABELS[rule->kind]);
+}
+
+/**
+ * @brief Prints every rule and whether it is firing over USB.
+ *
+ */
+void alerts_report(void) {
+    for (uint i = 0; i < ALERTS_MAX_RULES; i++) {
+        const alert_rule_t* rule = &_rules[i];
+
+        if (!rule->enabled) {
+            printf("(ALERT) %u off\n", i);
+            continue;
+        }
+
+        printf("(ALERT) %u %s %s", i, _METRIC_NAMES[rule->metric], _KIND_NAMES[rule->kind]);
+
+        if (rule->kind != ALERT_ABOVE) {
+            printf(" %ld", (long)rule->low);
+        }
+        if (rule->kind != ALERT_BELOW) {
+            printf(" %ld", (long)rule->high);
+        }
+
+        printf(" for %lu min, hysteresis %ld: %s\n",
+               (unsigned long)rule->duration_s / 60, (long)rule->hysteresis,
+               (_firing_mask & (1u << i)) ? "FIRING" : "ok");
+    }
+}
+
+/**
+ * @brief Sets a rule from a USB command line:
+ *   <slot> off
+ *   <slot> <temp|lux|moisture> below <low> <minutes>
+ *   <slot> <temp|lux|moisture> above <high> <minutes>
+ *   <slot> <temp|lux|moisture> outside <low> <high> <minutes>
+ *
+ * @param args Command arguments
+ * @return bool False if the arguments are invalid.
+ */
+bool alerts_configure(const char* args) {
+    unsigned slot;
+    char metric_name[9];
+    char kind_name[8];
+    long a, b, minutes;
+
+    if (sscanf(args, "%u %8s", &slot, metric_name) == 2 && strcmp(metric_name, "off") == 0) {
+        alert_rule_t rule = {0};
+        return alerts_set_rule(slot, &rule);
+    }
+
+    int fields = sscanf(args, "%u %8s %7s %ld %ld %ld", &slot, metric_name, kind_name, &a, &b, &minutes);
+
+    alert_rule_t rule = {.enabled = true};
+    int metric = -1;
+    int kind = -1;
+
+    for (int i = 0; i < ALERT_METRIC_COUNT; i++) {
+        if (fields >= 2 && strcmp(metric_name, _METRIC_NAMES[i]) == 0) {
+            metric = i;
+        }
+    }
+
+    for (int i = 0; i < count_of(_KIND_NAMES); i++) {
+        if (fields >= 3 && strcmp(kind_name, _KIND_NAMES[i]) == 0) {
+            kind = i;
+        }
+    }
+
+    if (metric < 0 || kind < 0) {
+        return false;
+    }
+
+    rule.metric = metric;
+    rule.kind = kind;
+    rule.hysteresis = _DEFAULT_HYSTERESIS[metric];
+
+    if (kind == ALERT_OUTSIDE) {
+        if (fields != 6 || a > b) {
+            return false;
+        }
+        rule.low = a;
+        rule.high = b;
+    } else {
+        if (fields != 5) {
+            return false;
+        }
+        minutes = b;
+        rule.low = a;
+        rule.high = a;
+    }
+
+    if (minutes < 0) {
+        return false;
+    }
+
+    rule.duration_s = minutes * 60;
+
+    return alerts_set_rule(slot, &rule);
+}
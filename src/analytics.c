@@ -0,0 +1,265 @@
+/*
+
+Streaming plant analytics, updated once per sample.
+
+Daily light integral (DLI): lux is converted to photosynthetic photon
+flux density with the sunlight factor of 0.0185 umol/m2/s per lux and
+integrated over time with the trapezoid rule, in integer nmol/m2.
+Samples further apart than _MAX_LIGHT_GAP_S are not integrated across.
+The probe has no real-time clock, so days are counted from boot.
+
+Dry-down: moisture samples are averaged into _DRY_BUCKET_S buckets,
+and a least-squares line is fitted through the last _DRY_WINDOW
+bucket averages. The buckets are evenly spaced, so only the sum of
+the averages and the sum of each average times its position need to
+be kept. Both are updated in constant time when a bucket enters or
+leaves the window. A gap in the buckets starts a new window.
+
+Updates come from Core1 and reads from Core0, so both are guarded by
+a critical section.
+
+*/
+
+#include "analytics.h"
+#include <stdio.h>
+#include "pico/sync.h"
+
+// PPFD per lux x 1000, as a fraction: 18.5 = 37 / 2
+#define _PPFD_PER_KLUX_NUM 37
+#define _PPFD_PER_KLUX_DEN 2
+
+#define _MAX_LIGHT_GAP_S 600
+#define _DAY_S 86400
+
+#define _DRY_BUCKET_S 900
+#define _DRY_WINDOW 48
+#define _DRY_MIN_POINTS 4
+
+// Longest time to dry that is reported
+#define _MAX_HOURS_TO_DRY 999
+
+static critical_section_t _analytics_lock;
+
+// Light integral of the current and previous day in nmol/m2
+static uint64_t _light_today = 0;
+static uint64_t _light_yesterday = 0;
+static bool _yesterday_valid = false;
+static uint32_t _light_day = 0;
+static bool _light_started = false;
+static uint16_t _last_lux = 0;
+static uint32_t _last_light_s = 0;
+
+// Moisture bucket being filled
+static bool _bucket_started = false;
+static uint32_t _bucket_index = 0;
+static uint32_t _bucket_sum = 0;
+static uint16_t _bucket_count = 0;
+
+// Bucket averages in the fit window, oldest first from _window_start
+static uint16_t _window[_DRY_WINDOW];
+static uint8_t _window_start = 0;
+static uint8_t _window_count = 0;
+static int64_t _sum_m = 0;      // Sum of averages
+static int64_t _sum_im = 0;     // Sum of position times average
+
+/**
+ * @brief Resets every accumulator.
+ *
+ */
+void analytics_init(void) {
+    critical_section_init(&_analytics_lock);
+
+    _light_today = 0;
+    _light_yesterday = 0;
+    _yesterday_valid = false;
+    _light_started = false;
+
+    _bucket_started = false;
+    _bucket_sum = 0;
+    _bucket_count = 0;
+    _window_start = 0;
+    _window_count = 0;
+    _sum_m = 0;
+    _sum_im = 0;
+}
+
+/**
+ * @brief Adds a light reading to the daily light integral.
+ *
+ * @param lux Ambient light
+ * @param timestamp_s Time of the reading
+ */
+void analytics_add_light(uint16_t lux, uint32_t timestamp_s) {
+    critical_section_enter_blocking(&_analytics_lock);
+
+    uint32_t day = timestamp_s / _DAY_S;
+
+    if (_light_started && day != _light_day) {
+        _light_yesterday = (day == _light_day + 1) ? _light_today : 0;
+        _yesterday_valid = true;
+        _light_today = 0;
+    }
+
+    if (_light_started && timestamp_s > _last_light_s
+        && timestamp_s - _last_light_s <= _MAX_LIGHT_GAP_S) {
+        uint64_t dt = timestamp_s - _last_light_s;
+
+        // Trapezoid of the PPFD in 1/1000 umol/m2/s, times seconds
+        _light_today += ((uint64_t)lux + _last_lux) * _PPFD_PER_KLUX_NUM * dt
+                        / (2 * _PPFD_PER_KLUX_DEN);
+    }
+
+    _light_started = true;
+    _light_day = day;
+    _last_lux = lux;
+    _last_light_s = timestamp_s;
+
+    critical_section_exit(&_analytics_lock);
+}
+
+/**
+ * @brief Adds a finished bucket average to the fit window, dropping
+ * the oldest once the window is full.
+ *
+ * @param average Bucket average
+ */
+void _push_bucket(uint16_t average) {
+    if (_window_count == _DRY_WINDOW) {
+        uint16_t oldest = _window[_window_start];
+
+        // The oldest is at position 0; everything else moves down one
+        _sum_m -= oldest;
+        _sum_im -= _sum_m;
+
+        _window_start = (_window_start + 1) % _DRY_WINDOW;
+        _window_count--;
+    }
+
+    _window[(_window_start + _window_count) % _DRY_WINDOW] = average;
+    _sum_m += average;
+    _sum_im += (int64_t)_window_count * average;
+    _window_count++;
+}
+
+/**
+ * @brief Adds a moisture reading to the dry-down fit.
+ *
+ * @param moisture Moisture level
+ * @param timestamp_s Time of the reading
+ */
+void analytics_add_moisture(uint16_t moisture, uint32_t timestamp_s) {
+    critical_section_enter_blocking(&_analytics_lock);
+
+    uint32_t index = timestamp_s / _DRY_BUCKET_S;
+
+    if (_bucket_started && index != _bucket_index) {
+        _push_bucket(_bucket_sum / _bucket_count);
+
+        // Positions must stay evenly spaced
+        if (index != _bucket_index + 1) {
+            _window_start = 0;
+            _window_count = 0;
+            _sum_m = 0;
+            _sum_im = 0;
+        }
+
+        _bucket_sum = 0;
+        _bucket_count = 0;
+    }
+
+    _bucket_started = true;
+    _bucket_index = index;
+    _bucket_sum += moisture;
+    _bucket_count++;
+
+    critical_section_exit(&_analytics_lock);
+}
+
+/**
+ * @brief Gets the daily light integral and the dry-down prediction.
+ *
+ * @param result Set to the current analytics
+ */
+void analytics_get(analytics_t* result) {
+    critical_section_enter_blocking(&_analytics_lock);
+
+    uint64_t light_today = _light_today;
+    uint64_t light_yesterday = _light_yesterday;
+    bool yesterday_valid = _yesterday_valid;
+    int64_t n = _window_count;
+    int64_t sum_m = _sum_m;
+    int64_t sum_im = _sum_im;
+
+    critical_section_exit(&_analytics_lock);
+
+    // nmol/m2 to mol/m2 x 100
+    result->dli_today_x100 = light_today / 10000000;
+    result->dli_yesterday_x100 = light_yesterday / 10000000;
+    result->yesterday_valid = yesterday_valid;
+
+    result->dry_points = n;
+    result->drying = false;
+    result->dry_rate_x10 = 0;
+    result->hours_to_dry = 0;
+
+    if (n < _DRY_MIN_POINTS) {
+        return;
+    }
+
+    // Least-squares slope per bucket is num / den
+    int64_t sum_i = n * (n - 1) / 2;
+    int64_t sum_ii = (n - 1) * n * (2 * n - 1) / 6;
+    int64_t num = n * sum_im - sum_i * sum_m;
+    int64_t den = n * sum_ii - sum_i * sum_i;
+
+    if (num >= 0) {
+        return;
+    }
+
+    result->drying = true;
+
+    // Moisture is in 0.1% steps, so its fall per day is in %/day x 10
+    result->dry_rate_x10 = (-num * (_DAY_S / _DRY_BUCKET_S)) / den;
+
+    // Value of the fitted line at the newest bucket
+    int64_t fitted = (sum_m * den + num * sum_i) / (n * den);
+
+    if (fitted <= ANALYTICS_DRY_MOISTURE) {
+        return;
+    }
+
+    int64_t hours = ((fitted - ANALYTICS_DRY_MOISTURE) * den * _DRY_BUCKET_S) / (-num * 3600);
+
+    result->hours_to_dry = MIN(hours, _MAX_HOURS_TO_DRY);
+}
+
+/**
+ * @brief Prints the current analytics over USB.
+ *
+ */
+void analytics_report(void) {
+    analytics_t result;
+    analytics_get(&result);
+
+    printf("(ANALYTICS) dli today=%lu.%02lu yesterday=",
+           (unsigned long)result.dli_today_x100 / 100,
+           (unsigned long)result.dli_today_x100 % 100);
+
+    if (result.yesterday_valid) {
+        printf("%lu.%02lu mol/m2",
+               (unsigned long)result.dli_yesterday_x100 / 100,
+               (unsigned long)result.dli_yesterday_x100 % 100);
+    } else {
+        printf("- mol/m2");
+    }
+
+    if (result.drying) {
+        printf(", drying %lu.%lu %%/day, dry in %lu h (%u points)\n",
+               (unsigned long)result.dry_rate_x10 / 10,
+               (unsigned long)result.dry_rate_x10 % 10,
+               (unsigned long)result.hours_to_dry,
+               result.dry_points);
+    } else {
+        printf(", not drying (%u points)\n", result.dry_points);
+    }
+}
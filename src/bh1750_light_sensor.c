@@ -10,47 +10,266 @@
 ///
 
 #include "bh1750_light_sensor.h"
+#include "ram_placement.h"
 
 #define _BH1750_I2C_ADDR 0x23       // Device's I2C address
 
+const uint8_t _POWER_DOWN_C = 0x00; // Power down command
 const uint8_t _POWER_ON_C = 0x01;   // Power on command
 const uint8_t _CONT_HRES_C = 0x10;  // Continuous high-res measurment command
+const uint8_t _CONT_LRES_C = 0x13;  // Continuous low-res measurment command
+
+// Bus time of each measurement read
+static latency_hist_t _read_latency = {.name = "bh1750 read"};
 
 /**
- * @brief Push one byte of data to TX FIFO.
+ * @brief Push one byte of data to TX FIFO. Gives up after the
+ * scheduler's job timeout so a stuck bus cannot hang the caller.
  * 
  * @param i2c Initialized RP2040 I2C block.
  * @param byte Byte of data to push.
+ * @return bool False if the byte was not acknowledged in time.
  */
-void _i2c_write_byte(i2c_inst_t* i2c, uint8_t byte) {
-    i2c_write_blocking(i2c, _BH1750_I2C_ADDR, &byte, 1, false);
+bool _i2c_write_byte(i2c_inst_t* i2c, uint8_t byte) {
+    return i2c_write_timeout_us(i2c, _BH1750_I2C_ADDR, &byte, 1, false, I2C_SCHED_JOB_TIMEOUT_US) == 1;
 }
 
 /**
  * @brief Powers on the BH1750.
  * 
  * @param i2c Initialized RP2040 I2C block.
+ * @return bool False if the BH1750 did not respond.
  */
-void bh1750_power_on(i2c_inst_t* i2c) {
-    _i2c_write_byte(i2c, _POWER_ON_C);
+bool bh1750_power_on(i2c_inst_t* i2c) {
+    return _i2c_write_byte(i2c, _POWER_ON_C);
 }
 
 /**
- * @brief Get a measurement of ambient light from the BH1750.
+ * @brief Powers down the BH1750. It must be powered on
+ * again before the next measurement.
  * 
  * @param i2c Initialized RP2040 I2C block.
+ */
+void bh1750_power_down(i2c_inst_t* i2c) {
+    _i2c_write_byte(i2c, _POWER_DOWN_C);
+}
+
+/**
+ * @brief Sets up a job which powers on the BH1750.
+ * 
+ * @param job Job to set up
+ * @param i2c I2C block the BH1750 is on.
+ */
+void bh1750_power_on_job(i2c_job_t* job, i2c_inst_t* i2c) {
+    i2c_job_write(job, i2c, _BH1750_I2C_ADDR, &_POWER_ON_C, 1);
+}
+
+/**
+ * @brief Sets up a job which starts a continuous high-res
+ * measurement. The result can be read 180 ms later.
+ * 
+ * @param job Job to set up
+ * @param i2c I2C block the BH1750 is on.
+ */
+void bh1750_start_job(i2c_job_t* job, i2c_inst_t* i2c) {
+    i2c_job_write(job, i2c, _BH1750_I2C_ADDR, &_CONT_HRES_C, 1);
+}
+
+/**
+ * @brief Sets up a job which starts a continuous low-res
+ * measurement. The result, in 4 lx steps, can be read 24 ms later.
+ * 
+ * @param job Job to set up
+ * @param i2c I2C block the BH1750 is on.
+ */
+void bh1750_start_lres_job(i2c_job_t* job, i2c_inst_t* i2c) {
+    i2c_job_write(job, i2c, _BH1750_I2C_ADDR, &_CONT_LRES_C, 1);
+}
+
+/**
+ * @brief Sets up a job which reads the latest measurement.
+ * 
+ * @param job Job to set up
+ * @param i2c I2C block the BH1750 is on.
+ * @param buff Buffer for the 2 raw measurement bytes
+ */
+void bh1750_read_job(i2c_job_t* job, i2c_inst_t* i2c, uint8_t buff[2]) {
+    i2c_job_read(job, i2c, _BH1750_I2C_ADDR, buff, 2);
+    job->latency = &_read_latency;
+}
+
+/**
+ * @brief Converts raw measurement bytes to lux.
+ * 
+ * @param buff The 2 raw measurement bytes
  * @return uint16_t Measurement result (lux).
  */
-uint16_t bh1750_read_measurement(i2c_inst_t* i2c) {
+uint16_t HOT_FUNC(bh1750_decode)(const uint8_t buff[2]) {
+    return (((uint16_t)buff[0] << 8) | buff[1]) / 1.2;
+}
+
+/**
+ * @brief Get a measurement of ambient light from the BH1750.
+ * 
+ * @param i2c Initialized RP2040 I2C block.
+ * @param lux Set to the measurement result (lux). Left alone if the
+ * read failed.
+ * @return bool False if the BH1750 did not take the command or did
+ * not answer.
+ */
+bool bh1750_read_measurement(i2c_inst_t* i2c, uint16_t* lux) {
     // Send "Continuously H-resolution mode" instruction
-    _i2c_write_byte(i2c, _CONT_HRES_C);
+    if (!_i2c_write_byte(i2c, _CONT_HRES_C)) {
+        return false;
+    }
 
     // Wait at least 180 ms to complete measurement
     sleep_ms(200);
 
     uint8_t buff[2];
 
-    i2c_read_blocking(i2c, _BH1750_I2C_ADDR, buff, 2, false);
+    if (i2c_read_timeout_us(i2c, _BH1750_I2C_ADDR, buff, 2, false, I2C_SCHED_JOB_TIMEOUT_US) != 2) {
+        return false;
+    }
 
-    return (((uint16_t)buff[0] << 8) | buff[1]) / 1.2;
-}
\ No newline at end of file
+    *lux = bh1750_decode(buff);
+
+    return true;
+}
+
+/**
+ * @brief Powers on the BH1750 through the I2C scheduler, which clears
+ * the bus if the power on finds it stuck.
+ * 
+ * @param dev BH1750 to power on
+ * @return bool False if the BH1750 did not take the command.
+ */
+bool _bh1750_sensor_power_on(bh1750_sensor_t* dev) {
+    i2c_job_t job;
+
+    bh1750_power_on_job(&job, dev->i2c);
+    i2c_sched_run(&job, 1);
+
+    if (job.result != 1) {
+        return false;
+    }
+
+    dev->powered_down = false;
+
+    return true;
+}
+
+/**
+ * @brief Sensor hook: powers on the BH1750.
+ * 
+ * @param ctx bh1750_sensor_t of the device
+ * @return bool False if the BH1750 did not respond.
+ */
+bool _bh1750_sensor_init(void* ctx) {
+    return _bh1750_sensor_power_on(ctx);
+}
+
+/**
+ * @brief Sensor hook: sets up the job starting a measurement. A
+ * BH1750 which was powered down is first powered on by a job of its
+ * own, as it takes one command per transfer.
+ * 
+ * @param ctx bh1750_sensor_t of the device
+ * @param job Job to set up
+ * @return bool False if the BH1750 was powered down and did not take
+ * the power on.
+ */
+bool _bh1750_sensor_start(void* ctx, i2c_job_t* job) {
+    bh1750_sensor_t* dev = ctx;
+
+    if (dev->powered_down && !_bh1750_sensor_power_on(dev)) {
+        return false;
+    }
+
+    if (dev->burst) {
+        bh1750_start_lres_job(job, dev->i2c);
+    } else {
+        bh1750_start_job(job, dev->i2c);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Sensor hook: gets the longest measurement time of the
+ * current resolution.
+ * 
+ * @param ctx bh1750_sensor_t of the device
+ * @return uint32_t Conversion time in ms
+ */
+uint32_t _bh1750_sensor_conversion_time(void* ctx) {
+    bh1750_sensor_t* dev = ctx;
+
+    return dev->burst ? 24 : 180;
+}
+
+/**
+ * @brief Sensor hook: sets up the job reading the measurement.
+ * 
+ * @param ctx bh1750_sensor_t of the device
+ * @param job Job to set up
+ * @param raw Buffer for the raw measurement
+ * @return bool Always true.
+ */
+bool _bh1750_sensor_collect(void* ctx, i2c_job_t* job, uint8_t raw[SENSOR_RAW_MAX]) {
+    bh1750_sensor_t* dev = ctx;
+
+    bh1750_read_job(job, dev->i2c, raw);
+
+    return true;
+}
+
+/**
+ * @brief Sensor hook: converts the raw measurement to lux.
+ * 
+ * @param ctx bh1750_sensor_t of the device
+ * @param raw Raw measurement
+ * @return int32_t Measurement result (lux).
+ */
+int32_t _bh1750_sensor_decode(void* ctx, const uint8_t raw[SENSOR_RAW_MAX]) {
+    return bh1750_decode(raw);
+}
+
+/**
+ * @brief Sensor hook: powers down the BH1750.
+ * 
+ * @param ctx bh1750_sensor_t of the device
+ */
+void _bh1750_sensor_power_down(void* ctx) {
+    bh1750_sensor_t* dev = ctx;
+
+    bh1750_power_down(dev->i2c);
+    dev->powered_down = true;
+}
+
+/**
+ * @brief Sensor hook: switches to low-res measurements, which are
+ * short enough to be oversampled.
+ * 
+ * @param ctx bh1750_sensor_t of the device
+ * @param burst True for low-res measurements
+ * @return bool Always true.
+ */
+bool _bh1750_sensor_set_burst_mode(void* ctx, bool burst) {
+    bh1750_sensor_t* dev = ctx;
+
+    dev->burst = burst;
+
+    return true;
+}
+
+const sensor_driver_t bh1750_sensor_driver = {
+    .name = "BH1750",
+    .init = _bh1750_sensor_init,
+    .start_conversion = _bh1750_sensor_start,
+    .conversion_time_ms = _bh1750_sensor_conversion_time,
+    .collect = _bh1750_sensor_collect,
+    .decode = _bh1750_sensor_decode,
+    .power_down = _bh1750_sensor_power_down,
+    .set_burst_mode = _bh1750_sensor_set_burst_mode,
+};
@@ -0,0 +1,235 @@
+/*
+
+Runtime system clock profiles.
+
+Applying a profile changes clk_sys (and clk_peri, which follows it)
+and then calls every registered listener so that peripherals can
+recompute their dividers: the 1-wire PIO clock divider, the LCD SPI
+baud rate and the I2C bus rate.
+
+Core1 is paused at a checkpoint in its sampling loop while the clock
+changes so no transfer is in flight.
+
+*/
+
+#include "clock_profile.h"
+#include <stdio.h>
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "ds18b20.h"
+#include "power.h"
+
+#define _MAX_LISTENERS 4
+
+// Longest time to wait for core1 to reach its checkpoint
+#define _PAUSE_TIMEOUT_MS 3000
+
+typedef struct {
+    const char* name;
+    uint32_t sys_khz;
+} _profile_info_t;
+
+static const _profile_info_t _PROFILES[CLOCK_PROFILE_COUNT] = {
+    {"LOW_POWER", 48000},
+    {"DEFAULT", 125000},
+    {"FAST", 133000},
+};
+
+static clock_listener_t _listeners[_MAX_LISTENERS];
+static uint8_t _listener_count = 0;
+
+static clock_profile_t _active_profile = CLOCK_PROFILE_DEFAULT;
+
+// Handshake used to pause core1 while the clock changes
+static volatile bool _pause_requested = false;
+static volatile bool _core1_paused = false;
+
+/**
+ * @brief Registers a function to call after the system clock changes.
+ *
+ * @param listener Function to register
+ * @return bool False if no more listeners can be registered.
+ */
+bool clock_profile_add_listener(clock_listener_t listener) {
+    if (_listener_count >= _MAX_LISTENERS) {
+        return false;
+    }
+
+    _listeners[_listener_count++] = listener;
+
+    return true;
+}
+
+/**
+ * @brief Gets the system clock frequency of a profile.
+ *
+ * @param profile Profile to look up
+ * @return uint32_t Frequency in kHz, or 0 for an unknown profile
+ */
+uint32_t clock_profile_sys_khz(clock_profile_t profile) {
+    if (profile >= CLOCK_PROFILE_COUNT) {
+        return 0;
+    }
+
+    return _PROFILES[profile].sys_khz;
+}
+
+/**
+ * @brief Checks that the PLL can produce the profile's frequency and
+ * that the 1-wire timing stays within spec at that frequency.
+ *
+ * @param profile Profile to check
+ * @return bool True if the profile can be applied.
+ */
+bool clock_profile_validate(clock_profile_t profile) {
+    if (profile >= CLOCK_PROFILE_COUNT) {
+        return false;
+    }
+
+    uint vco, postdiv1, postdiv2;
+
+    if (!check_sys_clock_khz(_PROFILES[profile].sys_khz, &vco, &postdiv1, &postdiv2)) {
+        return false;
+    }
+
+    ds18b20_timing_t timing;
+
+    return ds18b20_timing_for_clock(_PROFILES[profile].sys_khz * 1000, &timing);
+}
+
+/**
+ * @brief Waits for core1 to reach its checkpoint.
+ *
+ * @return bool False if core1 did not pause in time.
+ */
+bool _pause_core1(void) {
+    _pause_requested = true;
+
+    // A parked core1 only reaches its checkpoint once an epoch starts
+    if (power_low_power_enabled()) {
+        power_start_epoch();
+    }
+
+    absolute_time_t timeout = make_timeout_time_ms(_PAUSE_TIMEOUT_MS);
+
+    while (!_core1_paused) {
+        if (time_reached(timeout)) {
+            _pause_requested = false;
+            return false;
+        }
+
+        tight_loop_contents();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Lets core1 continue after _pause_core1().
+ *
+ */
+void _resume_core1(void) {
+    _pause_requested = false;
+    __sev();
+
+    // Wait for core1 to leave so the next pause is not mistaken as done
+    while (_core1_paused) {
+        tight_loop_contents();
+    }
+}
+
+/**
+ * @brief Switches the system clock to the given profile and
+ * reconfigures all registered peripherals. Called from core0.
+ *
+ * @param profile Profile to apply
+ * @return bool False if the profile is invalid or could not be applied.
+ */
+bool clock_profile_apply(clock_profile_t profile) {
+    if (!clock_profile_validate(profile)) {
+        printf("(CLOCK) Profile %d failed validation.\n", profile);
+        return false;
+    }
+
+    if (profile == _active_profile) {
+        return true;
+    }
+
+    if (!_pause_core1()) {
+        puts("(CLOCK) Core1 did not pause, clock left unchanged.");
+        return false;
+    }
+
+    bool changed = set_sys_clock_khz(_PROFILES[profile].sys_khz, false);
+
+    if (changed) {
+        uint32_t sys_hz = clock_get_hz(clk_sys);
+
+        for (int i = 0; i < _listener_count; i++) {
+            _listeners[i](sys_hz);
+        }
+
+        _active_profile = profile;
+    }
+
+    _resume_core1();
+
+    return changed;
+}
+
+/**
+ * @brief Gets the active clock profile.
+ *
+ * @return clock_profile_t The active profile
+ */
+clock_profile_t clock_profile_get(void) {
+    return _active_profile;
+}
+
+/**
+ * @brief Prints the 1-wire timing of every profile over USB.
+ *
+ */
+void clock_profile_print_validation(void) {
+    puts("(CLOCK) profile      MHz  div      tick  reset  wr0   wr1   slot  rd    rdsmp rdslot ok");
+
+    for (int p = 0; p < CLOCK_PROFILE_COUNT; p++) {
+        ds18b20_timing_t timing;
+        ds18b20_timing_for_clock(_PROFILES[p].sys_khz * 1000, &timing);
+
+        printf("(CLOCK) %-10s %5lu  %3u.%03u  %4lu  %5lu  %5lu %5lu %5lu %5lu %5lu %6lu %s\n",
+               _PROFILES[p].name,
+               (unsigned long)_PROFILES[p].sys_khz / 1000,
+               timing.div_int,
+               (timing.div_frac * 1000) / 256,
+               (unsigned long)timing.tick_ns,
+               (unsigned long)timing.reset_low_ns / 1000,
+               (unsigned long)timing.write_0_low_ns / 1000,
+               (unsigned long)timing.write_1_low_ns / 1000,
+               (unsigned long)timing.slot_ns / 1000,
+               (unsigned long)timing.read_low_ns / 1000,
+               (unsigned long)timing.read_sample_ns / 1000,
+               (unsigned long)timing.read_slot_ns / 1000,
+               clock_profile_validate(p) ? "yes" : "NO");
+    }
+}
+
+/**
+ * @brief Pauses core1 here while core0 changes the clock.
+ * Must be called by core1 at a point where it has no transfers
+ * in flight.
+ *
+ */
+void clock_profile_core1_checkpoint(void) {
+    if (!_pause_requested) {
+        return;
+    }
+
+    _core1_paused = true;
+
+    while (_pause_requested) {
+        __wfe();
+    }
+
+    _core1_paused = false;
+}
@@ -3,42 +3,407 @@
 #include "hardware/pio.h"
 #include "ds18b20.pio.h"
 #include "ds18b20.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "ram_placement.h"
+#include "latency_hist.h"
+
+// Length of one PIO cycle the delays in ds18b20.pio were written for
+// (clock divider of 266 at 125 MHz).
+#define _TICK_NS 2128
+
+// PIO cycles spent in each part of the 1-wire program
+#define _RESET_LOW_TICKS 252    // set pins + jmp loop with x = 250
+#define _BIT_START_TICKS 2      // set pins, 0 [1]
+#define _BIT_VALUE_TICKS 32     // out pins, 1 [31]
+#define _BIT_RECOVERY_TICKS 22  // set pins, 1 [20] + jmp
+#define _READ_LOW_TICKS 3       // set pindirs, 1 + set pins, 0 [1]
+#define _READ_SAMPLE_TICKS 6    // + set pindirs, 0 [2], then in pins
+#define _READ_SLOT_TICKS 29     // + in pins, 1 [22] + jmp, less the tick the
+                                // first read slot after a write starts late
+
+// Limits from the DS18B20 datasheet, in nanoseconds
+#define _RESET_LOW_MIN_NS 480000
+#define _SLOT_MIN_NS 60000
+#define _SLOT_MAX_NS 120000
+#define _WRITE_0_LOW_MIN_NS 60000
+#define _WRITE_0_LOW_MAX_NS 120000
+#define _WRITE_1_LOW_MIN_NS 1000
+#define _WRITE_1_LOW_MAX_NS 15000
+#define _READ_LOW_MIN_NS 1000
+#define _READ_LOW_MAX_NS 15000
+#define _READ_SAMPLE_MAX_NS 15000
+#define _RECOVERY_MIN_NS 1000
+
+// Value of the first word of a write op. Also sets the reset pulse length.
+#define _WRITE_OP 250
+#define _READ_OP 0
+
+// Time allowed per transaction word. A reset, or a byte of 8 slots of
+// at most 120 us, takes under 1 ms. Only a bus held low takes longer.
+#define _WORD_TIMEOUT_US 2000
+
+// How often the SM is checked once every word has been queued. It
+// raises nothing when it is done, and a slot is about this long.
+#define _IDLE_POLL_US 60
+
+// DMA channels moving transactions to and from the SM.
+// -1 if they could not be claimed, in which case transactions
+// are moved by the CPU instead.
+static int _tx_dma = -1;
+static int _rx_dma = -1;
+
+// Set by the DMA completion IRQ once every word of a transaction is
+// in the TX FIFO and every byte read has arrived
+static volatile bool _txn_queued = true;
+
+// Set once the SM has run the whole transaction
+static volatile bool _txn_done = true;
+
+// SM running the current transaction, and when it must be done by
+static PIO _txn_pio = NULL;
+static uint _txn_sm = 0;
+static absolute_time_t _txn_deadline;
+static bool _txn_timed_out = false;
+
+// Where the program was loaded, to restart the SM from the top
+static uint _program_offset = 0;
+
+// Time from starting a transaction until it has finished
+static latency_hist_t _txn_latency = {.name = "1-wire txn"};
+static uint64_t _txn_start_us = 0;
+
+// Time from starting a transaction which timed out until the SM was
+// running again
+static latency_hist_t _recovery_latency = {.name = "1-wire recovery"};
+
+/**
+ * @brief Starts building a new transaction.
+ * 
+ * @param txn Transaction to clear
+ */
+void ds18b20_txn_begin(ds18b20_txn_t* txn) {
+    txn->word_count = 0;
+    txn->read_count = 0;
+    txn->overflow = false;
+}
+
+/**
+ * @brief Adds a word to a transaction.
+ * 
+ * @param txn Transaction to add to
+ * @param word Word for the SM
+ */
+void _txn_put(ds18b20_txn_t* txn, uint32_t word) {
+    if (txn->word_count >= DS18B20_TXN_MAX_WORDS) {
+        txn->overflow = true;
+        return;
+    }
+
+    txn->words[txn->word_count++] = word;
+}
+
+/**
+ * @brief Adds a reset, a ROM command and a function command to a
+ * transaction. Every write op of the PIO program starts with a reset.
+ * 
+ * @param txn Transaction to add to
+ * @param rom ROM code of the device to address, or NULL to
+ * address all devices (Skip ROM).
+ * @param bytes Function command and any parameter bytes
+ * @param len Number of bytes in 'bytes'
+ */
+void ds18b20_txn_command(ds18b20_txn_t* txn, const uint8_t rom[8], const uint8_t* bytes, int len) {
+    int total = len + (rom ? 9 : 1);
+
+    _txn_put(txn, _WRITE_OP);
+    _txn_put(txn, total - 1);
+
+    if (rom) {
+        _txn_put(txn, 0x55);    // Match ROM
+
+        for (int i = 0; i < 8; i++) {
+            _txn_put(txn, rom[i]);
+        }
+    } else {
+        _txn_put(txn, 0xCC);    // Skip ROM
+    }
+
+    for (int i = 0; i < len; i++) {
+        _txn_put(txn, bytes[i]);
+    }
+}
+
+/**
+ * @brief Adds a read of 'len' bytes to a transaction.
+ * 
+ * @param txn Transaction to add to
+ * @param len Number of bytes to read
+ */
+void ds18b20_txn_read(ds18b20_txn_t* txn, int len) {
+    _txn_put(txn, _READ_OP);
+    _txn_put(txn, len - 1);
+
+    txn->read_count += len;
+}
+
+/**
+ * @brief DMA IRQ handler marking the current transaction as queued.
+ * The SM may still be running its last words.
+ * 
+ */
+void HOT_FUNC(_txn_dma_isr)(void) {
+    // The last channel to finish raises the IRQ
+    uint channel = _rx_dma;
+
+    if (!dma_channel_get_irq1_status(channel)) {
+        channel = _tx_dma;
+
+        if (!dma_channel_get_irq1_status(channel)) {
+            return;
+        }
+    }
+
+    dma_channel_acknowledge_irq1(channel);
+    dma_channel_set_irq1_enabled(channel, false);
+
+    _txn_queued = true;
+    __sev();
+}
 
 /**
- * @brief Writes given set of bytes to the DS18B20 from the
- * specified SM on the specified PIO.
+ * @brief Checks whether the SM has run every word it was given: its
+ * TX FIFO is empty and it waits at the pull which starts the next op.
+ * The last word of an op is never pulled there, so this only holds
+ * once the op's slots are done. Only meaningful once every word of
+ * the transaction has been queued.
  * 
  * @param pio PIO block containing the SM interfacing with
  * the DS18B20.
  * @param sm State Machine interfacing with the DS18B20.
- * @param bytes Array of bytes to write to the SM's FIFO.
- * @param len Number of bytes to write.
+ * @return bool True if the SM is idle.
  */
-void _writeBytes(PIO pio, uint sm, uint8_t bytes[], int len) {
-    pio_sm_put_blocking(pio, sm, 250);
-    pio_sm_put_blocking(pio, sm, len - 1);
+bool _sm_idle(PIO pio, uint sm) {
+    return pio_sm_is_tx_fifo_empty(pio, sm)
+        && pio_sm_get_pc(pio, sm) == _program_offset + ds18b20_wrap_target;
+}
 
-    for (int i = 0; i < len; i++) {
-        pio_sm_put_blocking(pio, sm, bytes[i]);
+/**
+ * @brief Stops the SM wherever it is, lets go of the bus and starts
+ * the program again from the top with empty FIFOs.
+ * 
+ * @param pio PIO block containing the SM interfacing with
+ * the DS18B20.
+ * @param sm State Machine interfacing with the DS18B20.
+ */
+void _restart_sm(PIO pio, uint sm) {
+    pio_sm_set_enabled(pio, sm, false);
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_set(pio_pindirs, 0));
+    pio_sm_exec(pio, sm, pio_encode_jmp(_program_offset));
+    pio_interrupt_clear(pio, sm);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+/**
+ * @brief Gives up on the current transaction: stops its DMA and
+ * restarts the SM so the next transaction starts cleanly.
+ * 
+ */
+void _txn_abort(void) {
+    if (_tx_dma >= 0) {
+        dma_channel_set_irq1_enabled(_tx_dma, false);
+        dma_channel_set_irq1_enabled(_rx_dma, false);
+        dma_channel_abort(_tx_dma);
+        dma_channel_abort(_rx_dma);
+        dma_channel_acknowledge_irq1(_tx_dma);
+        dma_channel_acknowledge_irq1(_rx_dma);
     }
+
+    _restart_sm(_txn_pio, _txn_sm);
+
+    uint32_t elapsed_us = time_us_64() - _txn_start_us;
+    latency_hist_record(&_recovery_latency, elapsed_us);
+
+    printf("(1WIRE) Transaction timed out, SM restarted after %lu.%03lu ms\n",
+           (unsigned long)elapsed_us / 1000, (unsigned long)elapsed_us % 1000);
+
+    _txn_timed_out = true;
+    _txn_queued = true;
+    _txn_done = true;
 }
 
 /**
- * @brief Reads bytes from the DS18B20 of count 'len'.
+ * @brief Moves a transaction to and from the SM with the CPU.
+ * Used when no DMA channels are available.
  * 
  * @param pio PIO block containing the SM interfacing with
  * the DS18B20.
  * @param sm State Machine interfacing with the DS18B20.
- * @param bytes Array of bytes to read data into.
- * @param len Number of bytes to read.
+ * @param txn Transaction to run
+ * @param rx Buffer for txn->read_count bytes
+ * @return bool False if the transaction was not done by its deadline.
  */
-void _readBytes(PIO pio, uint sm, uint8_t bytes[], int len) {
-    pio_sm_put_blocking(pio, sm, 0);
-    pio_sm_put_blocking(pio, sm, len - 1);
+bool _txn_run_blocking(PIO pio, uint sm, const ds18b20_txn_t* txn, uint8_t* rx) {
+    int received = 0;
 
-    for (int i = 0; i < len; i++) {
-        bytes[i] = pio_sm_get_blocking(pio, sm) >> 24;
+    for (int i = 0; i < txn->word_count; i++) {
+        // Keep draining replies so the SM never stalls on a full RX FIFO
+        while (pio_sm_is_tx_fifo_full(pio, sm)) {
+            if (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+                rx[received++] = pio_sm_get(pio, sm) >> 24;
+            } else if (time_reached(_txn_deadline)) {
+                return false;
+            }
+        }
+
+        pio_sm_put(pio, sm, txn->words[i]);
+    }
+
+    while (received < txn->read_count) {
+        if (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+            rx[received++] = pio_sm_get(pio, sm) >> 24;
+        } else if (time_reached(_txn_deadline)) {
+            return false;
+        }
+    }
+
+    // The last words are only queued, and a reset in them may still
+    // be waiting for its presence pulse
+    while (!_sm_idle(pio, sm)) {
+        if (time_reached(_txn_deadline)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Starts a transaction. The words are fed to the SM by DMA
+ * and any bytes read are drained into 'rx' by a second DMA channel,
+ * so the CPU is free until ds18b20_txn_wait() is called.
+ * 
+ * @param pio PIO block containing the SM interfacing with
+ * the DS18B20.
+ * @param sm State Machine interfacing with the DS18B20.
+ * @param txn Transaction to run. Must stay valid until it has finished.
+ * @param rx Buffer for txn->read_count bytes. Must stay valid until
+ * the transaction has finished.
+ * @return bool False if the transaction is invalid.
+ */
+bool ds18b20_txn_start(PIO pio, uint sm, const ds18b20_txn_t* txn, uint8_t* rx) {
+    if (txn->overflow || txn->word_count == 0) {
+        return false;
+    }
+
+    ds18b20_txn_wait();
+
+    _txn_start_us = time_us_64();
+    _txn_pio = pio;
+    _txn_sm = sm;
+    _txn_deadline = make_timeout_time_us((uint64_t)txn->word_count * _WORD_TIMEOUT_US);
+    _txn_timed_out = false;
+
+    // Set by the SM if a reset gets no presence pulse
+    pio_interrupt_clear(pio, sm);
+
+    if (_tx_dma < 0) {
+        if (_txn_run_blocking(pio, sm, txn, rx)) {
+            latency_hist_record(&_txn_latency, time_us_64() - _txn_start_us);
+        } else {
+            _txn_abort();
+        }
+        return true;
     }
+
+    _txn_queued = false;
+    _txn_done = false;
+
+    // Queueing is signalled by the last reply byte arriving, or by
+    // the last word being pushed if there is nothing to read. The
+    // transaction is done once the SM has run it.
+    uint done_channel = txn->read_count ? _rx_dma : _tx_dma;
+    dma_channel_acknowledge_irq1(done_channel);
+    dma_channel_set_irq1_enabled(done_channel, true);
+
+    if (txn->read_count) {
+        // Replies are shifted in from the left, so each byte is
+        // the most significant byte of the RX FIFO word.
+        dma_channel_set_read_addr(_rx_dma, (io_rw_8*)&pio->rxf[sm] + 3, false);
+        dma_channel_set_write_addr(_rx_dma, rx, false);
+        dma_channel_set_trans_count(_rx_dma, txn->read_count, true);
+    }
+
+    dma_channel_set_write_addr(_tx_dma, &pio->txf[sm], false);
+    dma_channel_set_read_addr(_tx_dma, txn->words, false);
+    dma_channel_set_trans_count(_tx_dma, txn->word_count, true);
+
+    return true;
+}
+
+/**
+ * @brief Sleeps until the SM has run the current transaction, so the
+ * presence of every reset in it is known. One which is not done by
+ * its deadline is aborted and the SM restarted.
+ * 
+ * @return bool False if the transaction timed out or a reset in it
+ * got no presence pulse.
+ */
+bool ds18b20_txn_wait(void) {
+    while (!_txn_done) {
+        if (_txn_queued && _sm_idle(_txn_pio, _txn_sm)) {
+            latency_hist_record(&_txn_latency, time_us_64() - _txn_start_us);
+            _txn_done = true;
+        } else if (time_reached(_txn_deadline)) {
+            _txn_abort();
+        } else if (_txn_queued) {
+            best_effort_wfe_or_timeout(make_timeout_time_us(_IDLE_POLL_US));
+        } else {
+            best_effort_wfe_or_timeout(_txn_deadline);
+        }
+    }
+
+    if (_txn_pio == NULL) {
+        return true;
+    }
+
+    return !_txn_timed_out && !pio_interrupt_get(_txn_pio, _txn_sm);
+}
+
+/**
+ * @brief Runs a transaction and waits for it to finish.
+ * 
+ * @param pio PIO block containing the SM interfacing with
+ * the DS18B20.
+ * @param sm State Machine interfacing with the DS18B20.
+ * @param txn Transaction to run
+ * @param rx Buffer for txn->read_count bytes
+ * @return bool False if the transaction is invalid, timed out or
+ * found no device on the bus.
+ */
+bool ds18b20_txn_run(PIO pio, uint sm, const ds18b20_txn_t* txn, uint8_t* rx) {
+    if (!ds18b20_txn_start(pio, sm, txn, rx)) {
+        return false;
+    }
+
+    return ds18b20_txn_wait();
+}
+
+/**
+ * @brief Converts the first two scratchpad bytes to a temperature.
+ * 
+ * @param data Temperature LSB and MSB
+ * @param in_fahrenheit True to convert to fahrenheit
+ * @return int8_t Whole degrees
+ */
+int8_t HOT_FUNC(_decode_temperature)(const uint8_t data[2], bool in_fahrenheit) {
+    volatile int8_t temperature = (data[1] << 4 | data[0] >> 4);
+
+    return in_fahrenheit ? (temperature * 9.0/5.0) + 32 : temperature; 
 }
 
 /**
@@ -54,19 +419,144 @@ void _readBytes(PIO pio, uint sm, uint8_t bytes[], int len) {
  * as a signed 8-bit integer.
  */
 int8_t ds18b20_get_temperature(PIO pio, uint sm, bool in_fahrenheit) {
-    _writeBytes(pio, sm, (uint8_t[]){0xCC, 0x44}, 2);
+    ds18b20_txn_t txn;
 
-    sleep_ms(1000);
+    ds18b20_txn_begin(&txn);
+    ds18b20_txn_command(&txn, NULL, (uint8_t[]){0x44}, 1);
+    ds18b20_txn_run(pio, sm, &txn, NULL);
 
-    _writeBytes(pio, sm, (uint8_t[]){0xCC, 0xBE}, 2);
+    sleep_ms(1000);
 
     uint8_t data[2];
 
-    _readBytes(pio, sm, data, 2);
+    ds18b20_txn_begin(&txn);
+    ds18b20_txn_command(&txn, NULL, (uint8_t[]){0xBE}, 1);
+    ds18b20_txn_read(&txn, 2);
+    ds18b20_txn_run(pio, sm, &txn, data);
 
-    volatile int8_t temperature = (data[1] << 4 | data[0] >> 4);
+    return _decode_temperature(data, in_fahrenheit);
+}
 
-    return in_fahrenheit ? (temperature * 9.0/5.0) + 32 : temperature; 
+/**
+ * @brief Computes the PIO clock divider which keeps the 1-wire
+ * program's timing for the given system clock.
+ * 
+ * @param sys_hz System clock frequency
+ * @param div_int Set to the integer part of the divider
+ * @param div_frac Set to the fractional part of the divider (1/256ths)
+ */
+void ds18b20_clkdiv_for(uint32_t sys_hz, uint16_t* div_int, uint8_t* div_frac) {
+    uint64_t div_fixed = ((uint64_t)sys_hz * _TICK_NS * 256 + 500000000) / 1000000000;
+
+    // The divider is 16.8 fixed point
+    div_fixed = MIN(div_fixed, 0xFFFFFF);
+    div_fixed = MAX(div_fixed, 0x100);
+
+    *div_int = div_fixed >> 8;
+    *div_frac = div_fixed & 0xFF;
+}
+
+/**
+ * @brief Computes the 1-wire bus timing the PIO program produces
+ * at the given system clock and checks it against the DS18B20 spec.
+ * 
+ * @param sys_hz System clock frequency
+ * @param timing Set to the resulting bus timing
+ * @return bool True if every timing is within spec.
+ */
+bool ds18b20_timing_for_clock(uint32_t sys_hz, ds18b20_timing_t* timing) {
+    uint16_t div_int;
+    uint8_t div_frac;
+    ds18b20_clkdiv_for(sys_hz, &div_int, &div_frac);
+
+    uint64_t div_fixed = ((uint64_t)div_int << 8) | div_frac;
+
+    timing->div_int = div_int;
+    timing->div_frac = div_frac;
+    timing->tick_ns = (div_fixed * 1000000000) / ((uint64_t)sys_hz * 256);
+    timing->reset_low_ns = timing->tick_ns * _RESET_LOW_TICKS;
+    timing->write_1_low_ns = timing->tick_ns * _BIT_START_TICKS;
+    timing->write_0_low_ns = timing->tick_ns * (_BIT_START_TICKS + _BIT_VALUE_TICKS);
+    timing->slot_ns = timing->tick_ns * (_BIT_START_TICKS + _BIT_VALUE_TICKS + _BIT_RECOVERY_TICKS);
+    timing->read_low_ns = timing->tick_ns * _READ_LOW_TICKS;
+    timing->read_sample_ns = timing->tick_ns * _READ_SAMPLE_TICKS;
+    timing->read_slot_ns = timing->tick_ns * _READ_SLOT_TICKS;
+
+    return timing->reset_low_ns >= _RESET_LOW_MIN_NS
+        && timing->write_1_low_ns >= _WRITE_1_LOW_MIN_NS
+        && timing->write_1_low_ns <= _WRITE_1_LOW_MAX_NS
+        && timing->write_0_low_ns >= _WRITE_0_LOW_MIN_NS
+        && timing->write_0_low_ns <= _WRITE_0_LOW_MAX_NS
+        && timing->slot_ns >= _SLOT_MIN_NS
+        && timing->slot_ns <= _SLOT_MAX_NS
+        && timing->read_low_ns >= _READ_LOW_MIN_NS
+        && timing->read_low_ns <= _READ_LOW_MAX_NS
+        && timing->read_sample_ns <= _READ_SAMPLE_MAX_NS
+        && timing->read_slot_ns >= _SLOT_MIN_NS + _RECOVERY_MIN_NS;
+}
+
+/**
+ * @brief Updates the SM's clock divider after the system clock
+ * has changed.
+ * 
+ * @param pio PIO block containing the SM interfacing with
+ * the DS18B20.
+ * @param sm State Machine interfacing with the DS18B20.
+ * @param sys_hz New system clock frequency
+ */
+void ds18b20_set_clock(PIO pio, uint sm, uint32_t sys_hz) {
+    uint16_t div_int;
+    uint8_t div_frac;
+    ds18b20_clkdiv_for(sys_hz, &div_int, &div_frac);
+
+    pio_sm_set_clkdiv_int_frac(pio, sm, div_int, div_frac);
+    pio_sm_clkdiv_restart(pio, sm);
+}
+
+/**
+ * @brief Claims and configures the DMA channels used for
+ * transactions. Transactions fall back to the CPU if none are free.
+ * 
+ * @param pio PIO block containing the SM interfacing with
+ * the DS18B20.
+ * @param sm State Machine interfacing with the DS18B20.
+ */
+void _txn_dma_init(PIO pio, uint sm) {
+    int tx = dma_claim_unused_channel(false);
+    int rx = dma_claim_unused_channel(false);
+
+    if (tx < 0 || rx < 0) {
+        puts("ds18b20_init: No free DMA channels, transactions use the CPU.");
+
+        if (tx >= 0) {
+            dma_channel_unclaim(tx);
+        }
+        if (rx >= 0) {
+            dma_channel_unclaim(rx);
+        }
+        return;
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(tx, &c, &pio->txf[sm], NULL, 0, false);
+
+    c = dma_channel_get_default_config(rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(rx, &c, NULL, (io_rw_8*)&pio->rxf[sm] + 3, 0, false);
+
+    // The IRQ is handled on the core which initialized the driver
+    irq_add_shared_handler(DMA_IRQ_1, _txn_dma_isr, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    _tx_dma = tx;
+    _rx_dma = rx;
 }
 
 /**
@@ -79,8 +569,9 @@ int8_t ds18b20_get_temperature(PIO pio, uint sm, bool in_fahrenheit) {
  * could not be accquired.
  */
 int ds18b20_init(PIO pio, int gpio) {
-    uint offset = pio_add_program(pio, &ds18b20_program);
-    int sm = pio_claim_unused_sm(pio, true);
+    // Claimed before the program is loaded, so a failed init can be
+    // tried again without filling the instruction memory
+    int sm = pio_claim_unused_sm(pio, false);
 
     if (sm == -1) {
         printf("ds18b20_init: Could not get an unused state machine.\n");
@@ -88,17 +579,116 @@ int ds18b20_init(PIO pio, int gpio) {
         return sm;
     }
 
+    uint offset = pio_add_program(pio, &ds18b20_program);
+
     pio_gpio_init(pio, gpio);
 
     pio_sm_config c = ds18b20_program_get_default_config(offset);
 
-    sm_config_set_clkdiv_int_frac(&c, 266, 0);
+    uint16_t div_int;
+    uint8_t div_frac;
+    ds18b20_clkdiv_for(clock_get_hz(clk_sys), &div_int, &div_frac);
+
+    sm_config_set_clkdiv_int_frac(&c, div_int, div_frac);
     sm_config_set_set_pins(&c, gpio, 1);
     sm_config_set_out_pins(&c, gpio, 1);
     sm_config_set_in_pins(&c, gpio);
     sm_config_set_in_shift(&c, true, true, 8);
-    pio_sm_init(pio0, sm, offset, &c);
-    pio_sm_set_enabled(pio0, sm, true);
+
+    // Tested after a reset for the presence pulse
+    sm_config_set_jmp_pin(&c, gpio);
+
+    pio_sm_init(pio, sm, offset, &c);
+    pio_sm_set_enabled(pio, sm, true);
+
+    _program_offset = offset;
+    _txn_dma_init(pio, sm);
 
     return sm;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Sensor hook: sets up the 1-wire bus and its SM.
+ * 
+ * @param ctx ds18b20_sensor_t of the device
+ * @return bool False if no SM was available.
+ */
+bool _ds18b20_sensor_init(void* ctx) {
+    ds18b20_sensor_t* dev = ctx;
+
+    // The board has no external pull-up on the 1-wire bus
+    gpio_init(dev->gpio);
+    gpio_pull_up(dev->gpio);
+    dev->sm = ds18b20_init(dev->pio, dev->gpio);
+
+    return dev->sm >= 0;
+}
+
+/**
+ * @brief Sensor hook: sends Convert T to every device on the bus.
+ * 
+ * @param ctx ds18b20_sensor_t of the device
+ * @param job Unused, the 1-wire bus is not I2C
+ * @return bool False if the transaction failed or no device answered.
+ */
+bool _ds18b20_sensor_start(void* ctx, i2c_job_t* job) {
+    ds18b20_sensor_t* dev = ctx;
+    ds18b20_txn_t txn;
+
+    ds18b20_txn_begin(&txn);
+    ds18b20_txn_command(&txn, NULL, (uint8_t[]){0x44}, 1);
+
+    return ds18b20_txn_run(dev->pio, dev->sm, &txn, NULL);
+}
+
+/**
+ * @brief Sensor hook: gets the 12-bit conversion time.
+ * 
+ * @param ctx ds18b20_sensor_t of the device
+ * @return uint32_t Conversion time in ms
+ */
+uint32_t _ds18b20_sensor_conversion_time(void* ctx) {
+    return 750;
+}
+
+/**
+ * @brief Sensor hook: reads the temperature from the scratchpad.
+ * 
+ * @param ctx ds18b20_sensor_t of the device
+ * @param job Unused, the 1-wire bus is not I2C
+ * @param raw Set to the temperature LSB and MSB
+ * @return bool False if the transaction failed or no device answered.
+ */
+bool _ds18b20_sensor_collect(void* ctx, i2c_job_t* job, uint8_t raw[SENSOR_RAW_MAX]) {
+    ds18b20_sensor_t* dev = ctx;
+    ds18b20_txn_t txn;
+
+    ds18b20_txn_begin(&txn);
+    ds18b20_txn_command(&txn, NULL, (uint8_t[]){0xBE}, 1);
+    ds18b20_txn_read(&txn, 2);
+
+    return ds18b20_txn_run(dev->pio, dev->sm, &txn, raw);
+}
+
+/**
+ * @brief Sensor hook: converts the scratchpad bytes to a temperature.
+ * 
+ * @param ctx ds18b20_sensor_t of the device
+ * @param raw Temperature LSB and MSB
+ * @return int32_t Whole degrees
+ */
+int32_t _ds18b20_sensor_decode(void* ctx, const uint8_t raw[SENSOR_RAW_MAX]) {
+    ds18b20_sensor_t* dev = ctx;
+
+    return _decode_temperature(raw, dev->in_fahrenheit);
+}
+
+const sensor_driver_t ds18b20_sensor_driver = {
+    .name = "DS18B20",
+    .init = _ds18b20_sensor_init,
+    .start_conversion = _ds18b20_sensor_start,
+    .conversion_time_ms = _ds18b20_sensor_conversion_time,
+    .collect = _ds18b20_sensor_collect,
+    .decode = _ds18b20_sensor_decode,
+    .power_down = NULL,
+};
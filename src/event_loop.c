@@ -0,0 +1,308 @@
+/*
+
+Event queue and tickless timer scheduler for core0.
+
+Events are posted from the button ISR, from the inter-core FIFO IRQ
+(raised by core1 whenever a new sample has been stored) and from
+software timers. Software timers share a single hardware alarm which is
+always armed for the earliest deadline, so core0 only wakes up when
+there is something to do.
+
+All producers run on core0, so the queue is protected by briefly
+disabling interrupts.
+
+*/
+
+#include "event_loop.h"
+#include "pico/multicore.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "ram_placement.h"
+
+#define _QUEUE_SIZE 16  // Must be a power of 2
+#define _MAX_TIMERS 4
+
+typedef struct {
+    bool active;
+    uint64_t deadline_us;
+    uint32_t period_us;     // 0 for one-shot timers
+    uint32_t data;
+} _event_timer_t;
+
+static event_t _queue[_QUEUE_SIZE];
+static volatile uint32_t _queue_head = 0;  // Next slot to write
+static volatile uint32_t _queue_tail = 0;  // Next slot to read
+
+static _event_timer_t _timers[_MAX_TIMERS];
+
+// Hardware alarm currently armed for the earliest timer deadline
+static alarm_id_t _armed_alarm = 0;
+
+// Called with interrupts disabled when there is nothing to do.
+// Must return once an interrupt is pending.
+static void (*_idle_handler)(void) = NULL;
+
+void _rearm_timer_alarm(void);
+
+/**
+ * @brief Fires every due software timer and re-arms the alarm for
+ * the next deadline.
+ *
+ * @return int64_t Always 0; the alarm is re-armed explicitly.
+ */
+int64_t HOT_FUNC(_timer_alarm_isr)(alarm_id_t id, void* user_data) {
+    uint64_t now = time_us_64();
+
+    _armed_alarm = 0;
+
+    for (int i = 0; i < _MAX_TIMERS; i++) {
+        _event_timer_t* timer = &_timers[i];
+
+        if (!timer->active || timer->deadline_us > now) {
+            continue;
+        }
+
+        event_post(EVENT_TIMER, timer->data);
+
+        if (timer->period_us) {
+            timer->deadline_us += timer->period_us;
+
+            // Skip periods which were missed entirely
+            if (timer->deadline_us <= now) {
+                timer->deadline_us = now + timer->period_us;
+            }
+        } else {
+            timer->active = false;
+        }
+    }
+
+    _rearm_timer_alarm();
+
+    return 0;
+}
+
+/**
+ * @brief Arms the hardware alarm for the earliest active timer.
+ * Must be called with interrupts disabled or from the alarm ISR.
+ *
+ */
+void HOT_FUNC(_rearm_timer_alarm)(void) {
+    if (_armed_alarm > 0) {
+        cancel_alarm(_armed_alarm);
+        _armed_alarm = 0;
+    }
+
+    int64_t deadline = event_timer_next_deadline_us();
+
+    if (deadline < 0) {
+        return;
+    }
+
+    // A deadline in the past fires the ISR immediately, which
+    // re-arms the alarm itself and returns 0 here.
+    alarm_id_t alarm = add_alarm_at(from_us_since_boot(deadline), _timer_alarm_isr, NULL, true);
+
+    if (alarm > 0) {
+        _armed_alarm = alarm;
+    }
+}
+
+/**
+ * @brief ISR for the inter-core FIFO. Turns every notification pushed
+ * by core1 into a sample event.
+ *
+ */
+void HOT_FUNC(_sample_fifo_isr)(void) {
+    while (multicore_fifo_rvalid()) {
+        event_post(EVENT_SAMPLE, multicore_fifo_pop_blocking());
+    }
+
+    multicore_fifo_clear_irq();
+}
+
+/**
+ * @brief Initializes the event queue and enables the inter-core FIFO
+ * interrupt. Must be called from core0.
+ *
+ */
+void event_loop_init(void) {
+    _queue_head = 0;
+    _queue_tail = 0;
+
+    for (int i = 0; i < _MAX_TIMERS; i++) {
+        _timers[i].active = false;
+    }
+
+    multicore_fifo_drain();
+    multicore_fifo_clear_irq();
+    irq_set_exclusive_handler(SIO_IRQ_PROC0, _sample_fifo_isr);
+    irq_set_enabled(SIO_IRQ_PROC0, true);
+}
+
+/**
+ * @brief Adds an event to the queue. Safe to call from any ISR on core0.
+ *
+ * @param type Type of the event
+ * @param data Event specific data
+ * @return bool False if the queue is full and the event was dropped.
+ */
+bool HOT_FUNC(event_post)(event_type_t type, uint32_t data) {
+    uint32_t status = save_and_disable_interrupts();
+
+    bool full = (_queue_head - _queue_tail) >= _QUEUE_SIZE;
+
+    if (!full) {
+        event_t* event = &_queue[_queue_head % _QUEUE_SIZE];
+        event->type = type;
+        event->data = data;
+        _queue_head++;
+    }
+
+    restore_interrupts(status);
+
+    return !full;
+}
+
+/**
+ * @brief Takes the oldest event from the queue without waiting.
+ *
+ * @param event Set to the event taken from the queue
+ * @return bool True if an event was taken.
+ */
+bool event_poll(event_t* event) {
+    uint32_t status = save_and_disable_interrupts();
+
+    bool available = _queue_head != _queue_tail;
+
+    if (available) {
+        *event = _queue[_queue_tail % _QUEUE_SIZE];
+        _queue_tail++;
+    }
+
+    restore_interrupts(status);
+
+    return available;
+}
+
+/**
+ * @brief Sleeps until an event is available, then takes it from
+ * the queue.
+ *
+ * @param event Set to the event taken from the queue
+ */
+void event_wait(event_t* event) {
+    while (1) {
+        uint32_t status = save_and_disable_interrupts();
+
+        if (_queue_head != _queue_tail) {
+            *event = _queue[_queue_tail % _QUEUE_SIZE];
+            _queue_tail++;
+            restore_interrupts(status);
+            return;
+        }
+
+        // A pending interrupt still wakes the core while masked,
+        // so an event posted before this point cannot be missed.
+        if (_idle_handler) {
+            _idle_handler();
+        } else {
+            __wfi();
+        }
+
+        restore_interrupts(status);
+    }
+}
+
+/**
+ * @brief Sets the function used to sleep while the queue is empty.
+ * The handler is called with interrupts disabled and must return
+ * once an interrupt is pending, e.g. by executing __wfi().
+ *
+ * @param handler Idle handler, or NULL to use __wfi().
+ */
+void event_set_idle_handler(void (*handler)(void)) {
+    _idle_handler = handler;
+}
+
+/**
+ * @brief Starts a software timer which posts a timer event when
+ * it expires.
+ *
+ * @param delay_ms Time until the timer expires
+ * @param repeating If true, the timer restarts every delay_ms
+ * @param data Data carried by the timer event
+ * @return int Timer handle, or -1 if no timer is free.
+ */
+int event_timer_start(uint32_t delay_ms, bool repeating, uint32_t data) {
+    uint32_t status = save_and_disable_interrupts();
+
+    int handle = -1;
+
+    for (int i = 0; i < _MAX_TIMERS; i++) {
+        if (!_timers[i].active) {
+            _timers[i].deadline_us = time_us_64() + (uint64_t)delay_ms * 1000;
+            _timers[i].period_us = repeating ? delay_ms * 1000 : 0;
+            _timers[i].data = data;
+            _timers[i].active = true;
+            handle = i;
+            break;
+        }
+    }
+
+    if (handle >= 0) {
+        _rearm_timer_alarm();
+    }
+
+    restore_interrupts(status);
+
+    return handle;
+}
+
+/**
+ * @brief Stops a software timer.
+ *
+ * @param timer Handle returned by event_timer_start()
+ */
+void event_timer_cancel(int timer) {
+    if (timer < 0 || timer >= _MAX_TIMERS) {
+        return;
+    }
+
+    uint32_t status = save_and_disable_interrupts();
+
+    _timers[timer].active = false;
+    _rearm_timer_alarm();
+
+    restore_interrupts(status);
+}
+
+/**
+ * @brief Gets the earliest deadline of all active timers.
+ *
+ * @return int64_t Deadline in microseconds since boot, or -1 if
+ * no timer is active.
+ */
+int64_t event_timer_next_deadline_us(void) {
+    int64_t deadline = -1;
+
+    for (int i = 0; i < _MAX_TIMERS; i++) {
+        if (_timers[i].active && (deadline < 0 || (int64_t)_timers[i].deadline_us < deadline)) {
+            deadline = _timers[i].deadline_us;
+        }
+    }
+
+    return deadline;
+}
+
+/**
+ * @brief Notifies core0 that a new sample has been stored.
+ * Called from core1. Never blocks: if the FIFO is full, core0
+ * already has a notification pending.
+ *
+ * @param sequence Sequence number of the sample
+ */
+void event_notify_sample(uint32_t sequence) {
+    if (multicore_fifo_wready()) {
+        multicore_fifo_push_blocking(sequence);
+    }
+}
@@ -9,22 +9,52 @@ Created by Michael Hogue
 #include "graphics.h"
 #include <stdio.h>
 #include "lcd.h"
+#include "view_templates.h"
+#include "latency_hist.h"
+
+// Area of the display used by trend graphs
+#define _GRAPH_TOP_Y 12
+#define _GRAPH_BOTTOM_Y 47
+
+// Largest values that fit the 4-digit fields of the analytics views,
+// so each line stays within the 10 columns of the display
+#define _MAX_4_DIGITS 9999
+#define _MAX_4_DIGITS_X10 99999
+
+// Smallest value range a trend graph is scaled to, so that
+// sensor noise is not magnified into a full-height graph.
+static const int16_t _TREND_MIN_SPAN[HISTORY_SENSOR_COUNT] = {20 * HISTORY_MOISTURE_SCALE, 50, 4};
+
+static const char _TREND_SENSOR_LETTER[HISTORY_SENSOR_COUNT] = {'S', 'L', 'T'};
+
+// Frame drawn ahead of time, shown later without drawing
+static uint8_t _prerendered_frame[LCD_BUF_SIZE];
+
+// Time taken to draw each view, before it is sent to the LCD
+static latency_hist_t _render_latency = {.name = "render"};
+
+// Alert drawn over the bottom row of every view, empty if none
+static char _alert_text[11] = "";
 
 /**
  * @brief Displays the top header showing the current temperature
- * and active view mode.
+ * and active view mode. The underline is part of the view template.
  * 
- * @param temperature The current temperature
+ * @param temperature The current temperature, or GRAPHICS_NO_TEMPERATURE
  * @param mode_label The active view mode
  */
-void _display_header(int8_t temperature, char mode_label[5]) {
-    // Draw header underline
-    lcd_draw_rect(0, 9, 83, 9, true);
-
+void _display_header(int8_t temperature, const char* mode_label) {
     lcd_set_cursor(0, 0);
 
     char text_line[11];
-    sprintf(text_line, "%3dF %5s", temperature, mode_label);
+
+    // Below -99 would take a fourth column
+    if (temperature == GRAPHICS_NO_TEMPERATURE) {
+        snprintf(text_line, sizeof text_line, " --F %5.5s", mode_label);
+    } else {
+        snprintf(text_line, sizeof text_line, "%3dF %5.5s", MAX(temperature, -99), mode_label);
+    }
+
     lcd_print_str(text_line, false);
 
     // Ensure text is not written on this header
@@ -33,16 +63,14 @@ void _display_header(int8_t temperature, char mode_label[5]) {
 }
 
 /**
- * @brief Displays a percentage bar spanning the full width of the
- * display at the given y position. The bar is 8px tall.
+ * @brief Fills a percentage bar spanning the full width of the
+ * display at the given y position. The bar is 8px tall and its
+ * outline is part of the view template.
  * 
  * @param percentage Portion of the bar to fill
  * @param top_y Top y-position of the bar
  */
 void _display_percentage_bar(float percentage, uint8_t top_y) {
-    // Draw outline
-    lcd_draw_rect(0, top_y, 83, top_y + 7, false);
-
     // Max percentage to 100%
     percentage = MIN(percentage, 1);
 
@@ -52,7 +80,50 @@ void _display_percentage_bar(float percentage, uint8_t top_y) {
 }
 
 /**
- * @brief Initializes the LCD
+ * @brief Shows "--" over a percentage bar whose sensor is faulted.
+ * 
+ * @param bank Bank (text line) of the bar
+ */
+void _display_no_reading(uint8_t bank) {
+    lcd_clear_line(bank);
+    lcd_set_cursor(0, bank);
+    lcd_print_str("    --    ", false);
+}
+
+/**
+ * @brief Draws the alert overlay, if any, records how long a view
+ * took to draw and sends it to the LCD.
+ * 
+ * @param start_us Time the view started drawing
+ */
+void _finish_view(uint64_t start_us) {
+    if (_alert_text[0] != '\0') {
+        lcd_clear_line(5);
+        lcd_set_cursor(0, 5);
+        lcd_print_str(_alert_text, false);
+    }
+
+    latency_hist_record(&_render_latency, time_us_64() - start_us);
+    flush_lcd_buffer();
+}
+
+/**
+ * @brief Maps a value onto a y-position within the graph area.
+ * 
+ * @param value Value to map
+ * @param low Value at the bottom of the graph
+ * @param span Value range covered by the graph
+ * @return uint8_t Y-position of the value
+ */
+uint8_t _graph_y(int16_t value, int16_t low, int16_t span) {
+    int32_t height = _GRAPH_BOTTOM_Y - _GRAPH_TOP_Y;
+
+    return _GRAPH_BOTTOM_Y - (((int32_t)value - low) * height) / span;
+}
+
+/**
+ * @brief Initializes the LCD and shows the splash screen without
+ * waiting. The splash stays up until the first view is drawn.
  * 
  */
 void graphics_init(void) {
@@ -63,6 +134,61 @@ void graphics_init(void) {
     show_splashscreen();
 }
 
+/**
+ * @brief Turns the display on or off. The current view is kept
+ * while the display is off.
+ * 
+ * @param on True to turn the display on
+ */
+void graphics_set_power(bool on) {
+    lcd_set_power(on);
+}
+
+/**
+ * @brief Draws the following views into the pre-rendered frame
+ * instead of showing them, until graphics_prerender_end().
+ * 
+ */
+void graphics_prerender_begin(void) {
+    lcd_begin_offscreen(_prerendered_frame);
+}
+
+/**
+ * @brief Ends drawing into the pre-rendered frame.
+ * 
+ */
+void graphics_prerender_end(void) {
+    lcd_end_offscreen();
+}
+
+/**
+ * @brief Shows the pre-rendered frame. Only the parts which differ
+ * from the current view are sent.
+ * 
+ */
+void graphics_show_prerendered(void) {
+    lcd_load_frame(_prerendered_frame);
+    flush_lcd_buffer();
+}
+
+/**
+ * @brief Waits until the last view has been sent to the LCD.
+ * 
+ */
+void graphics_wait_for_flush(void) {
+    lcd_wait_for_flush();
+}
+
+/**
+ * @brief Sets the alert drawn over the bottom row of every view
+ * from the next view on.
+ * 
+ * @param text Alert to draw, up to 10 characters, or NULL for none
+ */
+void graphics_set_alert(const char* text) {
+    snprintf(_alert_text, sizeof(_alert_text), "%s", text ? text : "");
+}
+
 /**
  * @brief Clears the LCD
  * 
@@ -76,9 +202,10 @@ void clear_current_view(void) {
  * 
  */
 void show_loading_view(void) {
-    clear_lcd();
-    lcd_set_cursor(0, 2);
-    lcd_print_str("LOADING...", true);
+    uint64_t start_us = time_us_64();
+
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_LOADING]);
+    _finish_view(start_us);
 }
 
 /**
@@ -86,9 +213,21 @@ void show_loading_view(void) {
  * 
  */
 void show_critical_error_view(void) {
-    clear_lcd();
-    lcd_set_cursor(0, 2);
-    lcd_print_str("  CRITICAL  ERROR!", true);
+    uint64_t start_us = time_us_64();
+
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_ERROR]);
+    _finish_view(start_us);
+}
+
+/**
+ * @brief Maps soil moisture onto the percentage bar: 200 counts is
+ * empty, 1200 counts full.
+ * 
+ * @param moisture Soil moisture in 1/HISTORY_MOISTURE_SCALE counts
+ * @return float Fraction of the bar
+ */
+float _moisture_fraction(uint16_t moisture) {
+    return ((float)moisture / HISTORY_MOISTURE_SCALE - 200) / 1000;
 }
 
 /**
@@ -96,47 +235,53 @@ void show_critical_error_view(void) {
  * for both moisture and light sensor data.
  * Also includes the given temperature in the header.
  * 
- * @param moisture Soil moisture value
- * @param lux Ambient light value
- * @param temperature Current temperature
+ * @param moisture Soil moisture in 1/HISTORY_MOISTURE_SCALE counts, or GRAPHICS_NO_READING
+ * @param lux Ambient light value, or GRAPHICS_NO_READING
+ * @param temperature Current temperature, or GRAPHICS_NO_TEMPERATURE
  */
 void show_dual_view(uint16_t moisture, uint16_t lux, int8_t temperature) {
-    clear_lcd();
-
-    _display_header(temperature, "DUAL");
+    uint64_t start_us = time_us_64();
 
-    lcd_newline();
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_DUAL]);
 
-    lcd_print_str("MOISTURE: ", false);
-
-    _display_percentage_bar((((float)moisture) - 200) / 1000, 24);
-
-    lcd_set_cursor(0, 4);
+    _display_header(temperature, "DUAL");
 
-    lcd_print_str("LIGHT: ", false);
+    if (moisture == GRAPHICS_NO_READING) {
+        _display_no_reading(3);
+    } else {
+        _display_percentage_bar(_moisture_fraction(moisture), 24);
+    }
 
-    _display_percentage_bar((float)lux / 32000, 40);
+    if (lux == GRAPHICS_NO_READING) {
+        _display_no_reading(5);
+    } else {
+        _display_percentage_bar((float)lux / 32000, 40);
+    }
 
-    flush_lcd_buffer();
+    _finish_view(start_us);
 }
 
 /**
  * @brief Shows details for the soil moisture data.
  * Also includes the given temperature in the header.
  * 
- * @param moisture Soil moisture value
- * @param temperature Current temperature
+ * @param moisture Soil moisture in 1/HISTORY_MOISTURE_SCALE counts, or GRAPHICS_NO_READING
+ * @param temperature Current temperature, or GRAPHICS_NO_TEMPERATURE
  */
-void show_soil_view(uint16_t moisture, int8_t temperature) {  
-    clear_lcd();
+void show_soil_view(uint16_t moisture, int8_t temperature) {
+    uint64_t start_us = time_us_64();
 
-    _display_header(temperature, "SOIL");
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_SOIL]);
 
-    lcd_newline();
+    _display_header(temperature, "SOIL");
 
-    lcd_print_str("MOISTURE: ", false);
+    if (moisture == GRAPHICS_NO_READING) {
+        _display_no_reading(4);
+        _finish_view(start_us);
+        return;
+    }
 
-    float moisture_percentage = (((float)moisture) - 200) / 1000;
+    float moisture_percentage = _moisture_fraction(moisture);
 
     _display_percentage_bar(moisture_percentage, 32);
 
@@ -152,24 +297,28 @@ void show_soil_view(uint16_t moisture, int8_t temperature) {
         lcd_print_str(" VERY WET ", false);
     }
 
-    flush_lcd_buffer();
+    _finish_view(start_us);
 }
 
 /**
  * @brief Shows details for the ambient light data.
  * Also includes the given temperature in the header.
  * 
- * @param lux Ambient light value
- * @param temperature Current temperature
+ * @param lux Ambient light value, or GRAPHICS_NO_READING
+ * @param temperature Current temperature, or GRAPHICS_NO_TEMPERATURE
  */
 void show_light_view(uint16_t lux, int8_t temperature) {
-    clear_lcd();
+    uint64_t start_us = time_us_64();
 
-    _display_header(temperature, "LIGHT");
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_LIGHT]);
 
-    lcd_newline();
+    _display_header(temperature, "LIGHT");
 
-    lcd_print_str("QUALITY: ", false);
+    if (lux == GRAPHICS_NO_READING) {
+        _display_no_reading(4);
+        _finish_view(start_us);
+        return;
+    }
 
     _display_percentage_bar((float)lux / 32000, 32);
 
@@ -183,5 +332,150 @@ void show_light_view(uint16_t lux, int8_t temperature) {
         lcd_print_str("  TOO DIM ", false);
     }
 
-    flush_lcd_buffer();
-}
\ No newline at end of file
+    _finish_view(start_us);
+}
+
+/**
+ * @brief Shows a sparkline of a sensor's history. Each column of the
+ * display is one history bucket, drawn as a line from the bucket's
+ * minimum to its maximum.
+ * Also includes the given temperature in the header.
+ * 
+ * @param sensor Sensor to show the history of
+ * @param resolution Length of each history bucket
+ * @param temperature Current temperature
+ */
+void show_trend_view(history_sensor_t sensor, history_resolution_t resolution, int8_t temperature) {
+    uint64_t start_us = time_us_64();
+
+    history_point_t points[HISTORY_BUCKETS];
+    history_get_trend(sensor, resolution, points);
+
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_TREND]);
+
+    char mode_label[6];
+    sprintf(mode_label, "%c %s", _TREND_SENSOR_LETTER[sensor], history_resolution_label(resolution));
+    _display_header(temperature, mode_label);
+
+    // Find the range of values to scale the graph to
+    int16_t low = INT16_MAX;
+    int16_t high = INT16_MIN;
+
+    for (int i = 0; i < HISTORY_BUCKETS; i++) {
+        if (points[i].valid) {
+            low = MIN(low, points[i].min);
+            high = MAX(high, points[i].max);
+        }
+    }
+
+    if (low > high) {
+        lcd_set_cursor(0, 3);
+        lcd_print_str(" NO DATA  ", false);
+        _finish_view(start_us);
+        return;
+    }
+
+    int16_t span = high - low;
+
+    if (span < _TREND_MIN_SPAN[sensor]) {
+        low -= (_TREND_MIN_SPAN[sensor] - span) / 2;
+        span = _TREND_MIN_SPAN[sensor];
+    }
+
+    for (int i = 0; i < HISTORY_BUCKETS; i++) {
+        if (points[i].valid) {
+            lcd_draw_vline(i, _graph_y(points[i].min, low, span), _graph_y(points[i].max, low, span));
+        }
+    }
+
+    _finish_view(start_us);
+}
+
+/**
+ * @brief Prints a value in tenths as 4 digits, a decimal and the
+ * tenths digit, followed by a unit of up to 4 characters. Values too
+ * large for 4 digits are shown as 9999.9.
+ * 
+ * @param value_x10 Value in tenths
+ * @param unit Unit printed after the value, e.g. " MOL"
+ */
+void _display_tenths(uint32_t value_x10, const char* unit) {
+    char text_line[11];
+
+    value_x10 = MIN(value_x10, _MAX_4_DIGITS_X10);
+
+    snprintf(text_line, sizeof text_line, "%4u.%u%.4s",
+             (unsigned)(value_x10 / 10), (unsigned)(value_x10 % 10), unit);
+    lcd_print_str(text_line, false);
+}
+
+/**
+ * @brief Shows the daily light integral of today so far and of
+ * the previous day.
+ * Also includes the given temperature in the header.
+ * 
+ * @param analytics Current analytics
+ * @param temperature Current temperature
+ */
+void show_dli_view(const analytics_t* analytics, int8_t temperature) {
+    uint64_t start_us = time_us_64();
+
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_DLI]);
+
+    _display_header(temperature, "DLI");
+
+    lcd_set_cursor(0, 3);
+    _display_tenths(analytics->dli_today_x100 / 10, " MOL");
+
+    lcd_set_cursor(0, 5);
+
+    if (analytics->yesterday_valid) {
+        _display_tenths(analytics->dli_yesterday_x100 / 10, " MOL");
+    } else {
+        lcd_print_str("    --    ", false);
+    }
+
+    _finish_view(start_us);
+}
+
+/**
+ * @brief Shows how fast the soil is drying and how long until it
+ * is dry.
+ * Also includes the given temperature in the header.
+ * 
+ * @param analytics Current analytics
+ * @param temperature Current temperature
+ */
+void show_dry_down_view(const analytics_t* analytics, int8_t temperature) {
+    uint64_t start_us = time_us_64();
+
+    lcd_load_frame(view_templates[VIEW_TEMPLATE_DRY_DOWN]);
+
+    _display_header(temperature, "DRY");
+
+    if (!analytics->drying) {
+        lcd_set_cursor(0, 3);
+        lcd_print_str("    --    ", false);
+        lcd_set_cursor(0, 5);
+        lcd_print_str("    --    ", false);
+        _finish_view(start_us);
+        return;
+    }
+
+    lcd_set_cursor(0, 3);
+    _display_tenths(analytics->dry_rate_x10, " %/D");
+
+    lcd_set_cursor(0, 5);
+
+    if (analytics->hours_to_dry == 0) {
+        lcd_print_str("   NOW    ", false);
+    } else {
+        char text_line[11];
+
+        snprintf(text_line, sizeof text_line, "%4u HRS  ",
+                 (unsigned)MIN(analytics->hours_to_dry, _MAX_4_DIGITS));
+        lcd_print_str(text_line, false);
+    }
+
+    _finish_view(start_us);
+}
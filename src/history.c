@@ -0,0 +1,269 @@
+/*
+
+Multi-resolution min/max/avg history of the sensor readings.
+
+Every sample is folded into the current bucket of each resolution as
+it arrives, so reading a trend is a copy of HISTORY_BUCKETS buckets
+instead of a scan over raw samples.
+
+Core1: WRITES samples.
+Core0: READS trends.
+
+*/
+
+#include "history.h"
+#include "pico/sync.h"
+
+// Aggregated samples for a single time bucket
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    uint16_t count;
+} _bucket_t;
+
+// Ring of buckets for one sensor at one resolution
+typedef struct {
+    _bucket_t buckets[HISTORY_BUCKETS];
+    uint32_t head_epoch;    // Bucket number (time / period) of the head bucket
+    uint8_t head;           // Index of the bucket currently being filled
+    bool started;
+} _tier_t;
+
+// Length of a bucket in seconds for each resolution
+static const uint32_t _PERIOD_S[HISTORY_RES_COUNT] = {60, 15 * 60, 60 * 60};
+
+static const char* _RES_LABELS[HISTORY_RES_COUNT] = {"1M", "15M", "1H"};
+
+static _tier_t _tiers[HISTORY_SENSOR_COUNT][HISTORY_RES_COUNT];
+
+// Guards _tiers between the sampling core and the display core
+static critical_section_t _history_lock;
+
+/**
+ * @brief Empties a bucket.
+ *
+ * @param bucket Bucket to clear
+ */
+void _clear_bucket(_bucket_t* bucket) {
+    bucket->min = INT16_MAX;
+    bucket->max = INT16_MIN;
+    bucket->sum = 0;
+    bucket->count = 0;
+}
+
+/**
+ * @brief Moves the head of a tier forward to the given epoch,
+ * clearing every bucket which is skipped over.
+ *
+ * @param tier Tier to advance
+ * @param epoch Bucket number the new sample belongs to
+ */
+void _advance_tier(_tier_t* tier, uint32_t epoch) {
+    if (!tier->started) {
+        for (int i = 0; i < HISTORY_BUCKETS; i++) {
+            _clear_bucket(&tier->buckets[i]);
+        }
+
+        tier->head = 0;
+        tier->head_epoch = epoch;
+        tier->started = true;
+        return;
+    }
+
+    // Samples from the past are folded into the head bucket
+    if (epoch <= tier->head_epoch) {
+        return;
+    }
+
+    uint32_t steps = MIN(epoch - tier->head_epoch, HISTORY_BUCKETS);
+
+    for (uint32_t i = 0; i < steps; i++) {
+        tier->head = (tier->head + 1) % HISTORY_BUCKETS;
+        _clear_bucket(&tier->buckets[tier->head]);
+    }
+
+    tier->head_epoch = epoch;
+}
+
+/**
+ * @brief Initializes the history. Must be called before either
+ * core accesses it.
+ *
+ */
+void history_init(void) {
+    critical_section_init(&_history_lock);
+
+    for (int s = 0; s < HISTORY_SENSOR_COUNT; s++) {
+        for (int r = 0; r < HISTORY_RES_COUNT; r++) {
+            _tiers[s][r].started = false;
+        }
+    }
+}
+
+/**
+ * @brief Folds one sample into every resolution of the sensor's
+ * history. Runs in constant time.
+ *
+ * @param sensor Sensor which produced the sample
+ * @param value Sample value
+ * @param timestamp_s Time of the sample in seconds since boot
+ */
+void history_add_sample(history_sensor_t sensor, int16_t value, uint32_t timestamp_s) {
+    if (sensor >= HISTORY_SENSOR_COUNT) {
+        return;
+    }
+
+    critical_section_enter_blocking(&_history_lock);
+
+    for (int r = 0; r < HISTORY_RES_COUNT; r++) {
+        _tier_t* tier = &_tiers[sensor][r];
+
+        _advance_tier(tier, timestamp_s / _PERIOD_S[r]);
+
+        _bucket_t* bucket = &tier->buckets[tier->head];
+
+        // A saturated bucket keeps its aggregate as is
+        if (bucket->count == UINT16_MAX) {
+            continue;
+        }
+
+        bucket->min = MIN(bucket->min, value);
+        bucket->max = MAX(bucket->max, value);
+        bucket->sum += value;
+        bucket->count++;
+    }
+
+    critical_section_exit(&_history_lock);
+}
+
+/**
+ * @brief Gets the trend of a sensor at the given resolution.
+ *
+ * @param sensor Sensor to get the trend of
+ * @param resolution Bucket length to use
+ * @param points Output for HISTORY_BUCKETS points. Index 0 is the
+ * oldest bucket, the last index is the bucket currently being filled.
+ */
+void history_get_trend(history_sensor_t sensor, history_resolution_t resolution, history_point_t points[HISTORY_BUCKETS]) {
+    if (sensor >= HISTORY_SENSOR_COUNT || resolution >= HISTORY_RES_COUNT) {
+        for (int i = 0; i < HISTORY_BUCKETS; i++) {
+            points[i].valid = false;
+        }
+        return;
+    }
+
+    critical_section_enter_blocking(&_history_lock);
+
+    const _tier_t* tier = &_tiers[sensor][resolution];
+
+    for (int i = 0; i < HISTORY_BUCKETS; i++) {
+        const _bucket_t* bucket = &tier->buckets[(tier->head + 1 + i) % HISTORY_BUCKETS];
+
+        points[i].valid = tier->started && bucket->count > 0;
+
+        if (points[i].valid) {
+            points[i].min = bucket->min;
+            points[i].max = bucket->max;
+            points[i].avg = bucket->sum / bucket->count;
+        }
+    }
+
+    critical_section_exit(&_history_lock);
+}
+
+/**
+ * @brief Gets the length of a bucket.
+ *
+ * @param resolution Resolution to get the bucket length of
+ * @return uint32_t Bucket length in seconds, 0 if unknown
+ */
+uint32_t history_period_s(history_resolution_t resolution) {
+    if (resolution >= HISTORY_RES_COUNT) {
+        return 0;
+    }
+
+    return _PERIOD_S[resolution];
+}
+
+/**
+ * @brief Gets the bucket number (time / period) of the newest bucket
+ * of any sensor at a resolution.
+ *
+ * @param resolution Resolution to check
+ * @return uint32_t Newest bucket number, 0 if nothing is stored yet
+ */
+uint32_t history_newest_epoch(history_resolution_t resolution) {
+    uint32_t newest = 0;
+
+    if (resolution >= HISTORY_RES_COUNT) {
+        return 0;
+    }
+
+    critical_section_enter_blocking(&_history_lock);
+
+    for (int s = 0; s < HISTORY_SENSOR_COUNT; s++) {
+        const _tier_t* tier = &_tiers[s][resolution];
+
+        if (tier->started) {
+            newest = MAX(newest, tier->head_epoch);
+        }
+    }
+
+    critical_section_exit(&_history_lock);
+
+    return newest;
+}
+
+/**
+ * @brief Gets a single bucket by its bucket number, without copying
+ * the rest of the trend.
+ *
+ * @param sensor Sensor to get the bucket of
+ * @param resolution Resolution of the bucket
+ * @param epoch Bucket number (time / period)
+ * @param point Set to the bucket's aggregate
+ * @return bool True if the bucket is still kept and holds samples.
+ */
+bool history_get_bucket(history_sensor_t sensor, history_resolution_t resolution, uint32_t epoch, history_point_t* point) {
+    point->valid = false;
+
+    if (sensor >= HISTORY_SENSOR_COUNT || resolution >= HISTORY_RES_COUNT) {
+        return false;
+    }
+
+    critical_section_enter_blocking(&_history_lock);
+
+    const _tier_t* tier = &_tiers[sensor][resolution];
+    uint32_t age = tier->head_epoch - epoch;
+
+    if (tier->started && epoch <= tier->head_epoch && age < HISTORY_BUCKETS) {
+        const _bucket_t* bucket = &tier->buckets[(tier->head + HISTORY_BUCKETS - age) % HISTORY_BUCKETS];
+
+        point->valid = bucket->count > 0;
+
+        if (point->valid) {
+            point->min = bucket->min;
+            point->max = bucket->max;
+            point->avg = bucket->sum / bucket->count;
+        }
+    }
+
+    critical_section_exit(&_history_lock);
+
+    return point->valid;
+}
+
+/**
+ * @brief Gets a short label describing the bucket length.
+ *
+ * @param resolution Resolution to describe
+ * @return const char* Label of at most 3 characters
+ */
+const char* history_resolution_label(history_resolution_t resolution) {
+    if (resolution >= HISTORY_RES_COUNT) {
+        return "?";
+    }
+
+    return _RES_LABELS[resolution];
+}
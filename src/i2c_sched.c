@@ -0,0 +1,648 @@
+/*
+
+Runs I2C transactions on both RP2040 I2C controllers at the same time.
+
+Jobs on the same controller run one after another in the order given,
+while jobs on different controllers overlap. Each controller is driven
+directly through its FIFOs, so one loop can keep both busy.
+
+Jobs for devices behind a TCA9548A mux have the mux channel selected
+first, as a job of its own on the same controller. Every mux caches
+its selection, so the select is only written when it differs, and
+the other muxes on the bus are closed first so devices with the same
+address behind them do not answer too. To keep switches down, a job
+which needs no select runs before one which does, and the rest are
+taken by mux and channel instead of in the order given.
+
+The time each controller spends busy is tracked to report per-bus
+utilization.
+
+A job which runs past I2C_SCHED_JOB_TIMEOUT_US, or loses arbitration
+because a device holds SDA low, fails instead of hanging the sampler.
+The bus is then cleared: SCL is clocked by hand until the device lets
+go of SDA (at most 9 clocks finish any byte it was sending), a stop
+condition is sent, and the controller is reset and set up again.
+
+*/
+
+#include "i2c_sched.h"
+#include <stdio.h>
+#include "hardware/gpio.h"
+#include "tca9548a.h"
+
+// Half of an SCL period while the bus is cleared by hand (100 kHz)
+#define _CLEAR_HALF_PERIOD_US 5
+#define _CLEAR_CLOCKS 9
+
+// Most jobs taken at once. Longer lists are run in parts.
+#define _MAX_JOBS 32
+
+// Progress of the job currently running on a controller
+typedef struct {
+    i2c_job_t* job;
+    uint16_t cmds_sent;
+    uint16_t rx_received;
+    bool aborted;
+    uint64_t start_us;
+
+    // Mux channel selects sent before a routed job
+    i2c_job_t* routed;      // Job waiting for its route, or NULL
+    i2c_job_t select;
+    uint8_t select_mask;
+    uint8_t select_mux;     // Index in _muxes
+    uint8_t select_channel;
+    uint8_t skip_muxes;     // Muxes which did not answer a close
+} _bus_ctx_t;
+
+// Pins and rate of a controller, kept to set it up again after a bus clear
+typedef struct {
+    bool added;
+    uint sda_pin;
+    uint scl_pin;
+    uint baudrate;
+} _bus_pins_t;
+
+static _bus_pins_t _bus_pins[I2C_SCHED_BUSES];
+
+// Busy time per controller since the last report
+static uint64_t _busy_us[I2C_SCHED_BUSES];
+static uint64_t _window_start_us = 0;
+
+// Bus clears per controller since the last report
+static uint32_t _recoveries[I2C_SCHED_BUSES];
+static uint32_t _last_recovery_us[I2C_SCHED_BUSES];
+static latency_hist_t _recovery_latency = {.name = "i2c recovery"};
+
+static tca9548a_t* _muxes[I2C_SCHED_MUXES];
+static uint8_t _mux_count = 0;
+
+/**
+ * @brief Initializes an added controller and gives it its pins.
+ *
+ * @param bus Controller index
+ */
+void _setup_bus(uint bus) {
+    const _bus_pins_t* pins = &_bus_pins[bus];
+
+    i2c_init(i2c_get_instance(bus), pins->baudrate);
+    gpio_set_function(pins->sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(pins->scl_pin, GPIO_FUNC_I2C);
+}
+
+/**
+ * @brief Sets up a controller and its pins for jobs. Does nothing if
+ * the controller was already added.
+ *
+ * @param i2c Controller to set up
+ * @param sda_pin SDA pin
+ * @param scl_pin SCL pin
+ * @param baudrate Bus rate in Hz
+ */
+void i2c_sched_add_bus(i2c_inst_t* i2c, uint sda_pin, uint scl_pin, uint baudrate) {
+    uint bus = i2c_hw_index(i2c);
+
+    // Sensors sharing a controller each ask for it
+    if (_bus_pins[bus].added) {
+        return;
+    }
+
+    _bus_pins[bus] = (_bus_pins_t){true, sda_pin, scl_pin, baudrate};
+    _setup_bus(bus);
+}
+
+/**
+ * @brief Adds a mux which jobs can be routed through. Does nothing if
+ * the mux was already added or there is no room for it.
+ *
+ * @param mux Mux to add
+ */
+void i2c_sched_add_mux(tca9548a_t* mux) {
+    for (uint8_t i = 0; i < _mux_count; i++) {
+        if (_muxes[i] == mux) {
+            return;
+        }
+    }
+
+    if (_mux_count < I2C_SCHED_MUXES) {
+        _muxes[_mux_count++] = mux;
+    }
+}
+
+/**
+ * @brief Sets the rate of every added controller again after the
+ * system clock has changed.
+ *
+ */
+void i2c_sched_clock_changed(void) {
+    for (uint bus = 0; bus < I2C_SCHED_BUSES; bus++) {
+        if (_bus_pins[bus].added) {
+            i2c_set_baudrate(i2c_get_instance(bus), _bus_pins[bus].baudrate);
+        }
+    }
+}
+
+/**
+ * @brief Drives an open-drain bus line low or lets it be pulled high.
+ *
+ * @param pin Line to drive
+ * @param high True to release the line
+ */
+void _drive_line(uint pin, bool high) {
+    gpio_set_dir(pin, !high);
+}
+
+/**
+ * @brief Frees a stuck bus and sets the controller up again. A device
+ * holding SDA low is clocked until it releases SDA, then a stop
+ * condition ends whatever it thought was going on.
+ *
+ * @param bus Controller index
+ * @return bool False if SDA or SCL are still held low.
+ */
+bool _recover_bus(uint bus) {
+    _bus_pins_t* pins = &_bus_pins[bus];
+    i2c_inst_t* i2c = i2c_get_instance(bus);
+    uint64_t start_us = time_us_64();
+
+    if (!pins->added) {
+        return false;
+    }
+
+    // Resetting the controller drops any transfer it has in flight
+    i2c_deinit(i2c);
+
+    // Both lines become open-drain GPIOs: released inputs pulled up,
+    // driven low by enabling the output of a 0. The pads' pull-ups
+    // keep a released line high without the board's resistors.
+    gpio_init(pins->sda_pin);
+    gpio_init(pins->scl_pin);
+    gpio_pull_up(pins->sda_pin);
+    gpio_pull_up(pins->scl_pin);
+
+    for (int i = 0; i < _CLEAR_CLOCKS && !gpio_get(pins->sda_pin); i++) {
+        _drive_line(pins->scl_pin, false);
+        busy_wait_us_32(_CLEAR_HALF_PERIOD_US);
+        _drive_line(pins->scl_pin, true);
+        busy_wait_us_32(_CLEAR_HALF_PERIOD_US);
+    }
+
+    // Stop condition: SDA rises while SCL is high
+    _drive_line(pins->scl_pin, false);
+    busy_wait_us_32(_CLEAR_HALF_PERIOD_US);
+    _drive_line(pins->sda_pin, false);
+    busy_wait_us_32(_CLEAR_HALF_PERIOD_US);
+    _drive_line(pins->scl_pin, true);
+    busy_wait_us_32(_CLEAR_HALF_PERIOD_US);
+    _drive_line(pins->sda_pin, true);
+    busy_wait_us_32(_CLEAR_HALF_PERIOD_US);
+
+    bool cleared = gpio_get(pins->sda_pin) && gpio_get(pins->scl_pin);
+
+    _setup_bus(bus);
+
+    // A select may have been cut short
+    for (uint8_t i = 0; i < _mux_count; i++) {
+        if (_muxes[i]->i2c == i2c) {
+            _muxes[i]->selected = TCA9548A_UNKNOWN;
+        }
+    }
+
+    uint32_t elapsed_us = time_us_64() - start_us;
+
+    _recoveries[bus]++;
+    _last_recovery_us[bus] = elapsed_us;
+    latency_hist_record(&_recovery_latency, elapsed_us);
+
+    printf("(I2C) i2c%u bus cleared in %lu.%03lu ms%s\n", bus,
+           (unsigned long)elapsed_us / 1000, (unsigned long)elapsed_us % 1000,
+           cleared ? "" : ", still held low");
+
+    return cleared;
+}
+
+/**
+ * @brief Sets up a write-only job.
+ *
+ * @param job Job to set up
+ * @param i2c Controller the device is on
+ * @param addr Device address
+ * @param tx Bytes to write
+ * @param tx_len Number of bytes to write
+ */
+void i2c_job_write(i2c_job_t* job, i2c_inst_t* i2c, uint8_t addr, const uint8_t* tx, uint8_t tx_len) {
+    job->i2c = i2c;
+    job->addr = addr;
+    job->mux = NULL;
+    job->mux_channel = 0;
+    job->tx = tx;
+    job->tx_len = tx_len;
+    job->rx = NULL;
+    job->rx_len = 0;
+    job->result = 0;
+    job->latency = NULL;
+}
+
+/**
+ * @brief Sets up a read-only job.
+ *
+ * @param job Job to set up
+ * @param i2c Controller the device is on
+ * @param addr Device address
+ * @param rx Buffer for the bytes read
+ * @param rx_len Number of bytes to read
+ */
+void i2c_job_read(i2c_job_t* job, i2c_inst_t* i2c, uint8_t addr, uint8_t* rx, uint8_t rx_len) {
+    job->i2c = i2c;
+    job->addr = addr;
+    job->mux = NULL;
+    job->mux_channel = 0;
+    job->tx = NULL;
+    job->tx_len = 0;
+    job->rx = rx;
+    job->rx_len = rx_len;
+    job->result = 0;
+    job->latency = NULL;
+}
+
+/**
+ * @brief Starts a job on its controller.
+ *
+ * @param ctx Controller context
+ * @param job Job to start
+ */
+void _start_job(_bus_ctx_t* ctx, i2c_job_t* job) {
+    i2c_hw_t* hw = i2c_get_hw(job->i2c);
+
+    hw->enable = 0;
+    hw->tar = job->addr;
+    hw->enable = 1;
+
+    // Clear flags left over from earlier transfers
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+
+    ctx->job = job;
+    ctx->cmds_sent = 0;
+    ctx->rx_received = 0;
+    ctx->aborted = false;
+    ctx->start_us = time_us_64();
+}
+
+/**
+ * @brief Moves a running job forward without blocking. A job is only
+ * failed on its deadline if it has not ended by then, so one which
+ * finished while the other controller was polled late still succeeds.
+ *
+ * @param ctx Controller context
+ * @return bool True once the job has finished or failed.
+ */
+bool _poll_job(_bus_ctx_t* ctx) {
+    i2c_job_t* job = ctx->job;
+    i2c_hw_t* hw = i2c_get_hw(job->i2c);
+    uint16_t total = job->tx_len + job->rx_len;
+
+    // Taken before the controller is looked at, so a job which ended
+    // by then is seen to have ended
+    uint64_t now_us = time_us_64();
+
+    // Queue write data and read commands while there is room
+    while (!ctx->aborted && ctx->cmds_sent < total && i2c_get_write_available(job->i2c) > 0) {
+        uint16_t i = ctx->cmds_sent;
+        uint32_t cmd;
+
+        if (i < job->tx_len) {
+            cmd = job->tx[i];
+        } else {
+            cmd = I2C_IC_DATA_CMD_CMD_BITS;
+
+            if (i == job->tx_len && job->tx_len > 0) {
+                cmd |= I2C_IC_DATA_CMD_RESTART_BITS;
+            }
+        }
+
+        if (i == total - 1) {
+            cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+        }
+
+        hw->data_cmd = cmd;
+        ctx->cmds_sent++;
+    }
+
+    while (ctx->rx_received < job->rx_len && i2c_get_read_available(job->i2c) > 0) {
+        job->rx[ctx->rx_received++] = (uint8_t)hw->data_cmd;
+    }
+
+    // An abort (e.g. address NACK) flushes the FIFO and sends a stop
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        bool arbitration_lost = hw->tx_abrt_source & I2C_IC_TX_ABRT_SOURCE_ARB_LOST_BITS;
+
+        (void)hw->clr_tx_abrt;
+        ctx->aborted = true;
+
+        // Another driver of SDA means no stop will be seen either
+        if (arbitration_lost) {
+            job->result = PICO_ERROR_IO;
+            return true;
+        }
+    }
+
+    bool stopped = hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+    bool complete = ctx->aborted || (ctx->cmds_sent == total && ctx->rx_received == job->rx_len);
+
+    if (!stopped || !complete) {
+        // A device stretching SCL or holding SDA forever would never
+        // let the stop condition through
+        if (now_us - ctx->start_us > I2C_SCHED_JOB_TIMEOUT_US) {
+            job->result = PICO_ERROR_TIMEOUT;
+            return true;
+        }
+
+        return false;
+    }
+
+    (void)hw->clr_stop_det;
+
+    job->result = ctx->aborted ? PICO_ERROR_GENERIC : total;
+
+    return true;
+}
+
+/**
+ * @brief Finds the next channel select a job needs before it can run.
+ * Any other mux on the bus with a channel open, or which may have one
+ * open, is closed first.
+ *
+ * @param ctx Controller context
+ * @param job Job to route
+ * @param channel Set to the channel to select
+ * @return int Index of the mux to write, or -1 if the job can run now
+ */
+int _next_select(const _bus_ctx_t* ctx, const i2c_job_t* job, uint8_t* channel) {
+    for (uint8_t i = 0; i < _mux_count; i++) {
+        const tca9548a_t* mux = _muxes[i];
+
+        if (mux != job->mux && mux->i2c == job->i2c && mux->selected != TCA9548A_NO_CHANNEL &&
+            !(ctx->skip_muxes & (1u << i))) {
+            *channel = TCA9548A_NO_CHANNEL;
+            return i;
+        }
+    }
+
+    if (job->mux && job->mux->selected != job->mux_channel) {
+        for (uint8_t i = 0; i < _mux_count; i++) {
+            if (_muxes[i] == job->mux) {
+                *channel = job->mux_channel;
+                return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Starts a channel select write on a controller.
+ *
+ * @param ctx Controller context
+ * @param index Index of the mux in _muxes
+ * @param channel Channel to open, or TCA9548A_NO_CHANNEL to close all
+ */
+void _start_select(_bus_ctx_t* ctx, int index, uint8_t channel) {
+    tca9548a_t* mux = _muxes[index];
+
+    ctx->select_mask = (channel < TCA9548A_CHANNELS) ? (1u << channel) : 0;
+    ctx->select_mux = index;
+    ctx->select_channel = channel;
+
+    i2c_job_write(&ctx->select, mux->i2c, mux->addr, &ctx->select_mask, 1);
+    mux->select_writes++;
+    mux->transactions++;
+
+    _start_job(ctx, &ctx->select);
+}
+
+/**
+ * @brief Updates the cached selection of a mux once a select is done.
+ * A mux which did not take the select has an unknown selection, and
+ * fails the job routed through it. One which could not be closed is
+ * left out for the rest of the job's route.
+ *
+ * @param ctx Controller context
+ * @return bool True if the routed job failed.
+ */
+bool _end_select(_bus_ctx_t* ctx) {
+    tca9548a_t* mux = _muxes[ctx->select_mux];
+    i2c_job_t* routed = ctx->routed;
+
+    if (ctx->select.result == 1) {
+        mux->selected = ctx->select_channel;
+        return false;
+    }
+
+    mux->selected = TCA9548A_UNKNOWN;
+
+    if (mux == routed->mux) {
+        routed->result = ctx->select.result;
+        ctx->routed = NULL;
+        return true;
+    }
+
+    ctx->skip_muxes |= 1u << ctx->select_mux;
+
+    return false;
+}
+
+/**
+ * @brief Gets whether one job comes before another when both need a
+ * channel select: direct jobs first, then by mux and channel.
+ *
+ * @param a Job to compare
+ * @param b Job to compare against
+ * @return bool True if a comes first.
+ */
+bool _route_before(const i2c_job_t* a, const i2c_job_t* b) {
+    if (a->mux != b->mux) {
+        return !a->mux || (b->mux && (uintptr_t)a->mux < (uintptr_t)b->mux);
+    }
+
+    return a->mux_channel < b->mux_channel;
+}
+
+/**
+ * @brief Picks the next job for a controller: the first which needs no
+ * channel select, else the first by mux and channel.
+ *
+ * @param ctx Controller context
+ * @param jobs Jobs being run
+ * @param count Number of jobs
+ * @param bus Controller index
+ * @param started Bit n set once job n has been taken
+ * @return int Index of the job, or -1 if none are left.
+ */
+int _next_job(const _bus_ctx_t* ctx, i2c_job_t jobs[], int count, uint bus, uint32_t started) {
+    int best = -1;
+
+    for (int i = 0; i < count; i++) {
+        uint8_t channel;
+
+        if ((started & (1u << i)) || i2c_hw_index(jobs[i].i2c) != bus) {
+            continue;
+        }
+
+        if (_next_select(ctx, &jobs[i], &channel) < 0) {
+            return i;
+        }
+
+        if (best < 0 || _route_before(&jobs[i], &jobs[best])) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Runs every job to completion. Jobs on different controllers
+ * run concurrently; jobs on the same controller run one at a time,
+ * in order apart from the grouping of jobs routed through muxes. A
+ * job which times out or finds the bus held clears the bus before
+ * the next job on that controller starts.
+ *
+ * @param jobs Jobs to run. Each job's result is set when done.
+ * @param count Number of jobs
+ */
+void i2c_sched_run(i2c_job_t jobs[], int count) {
+    _bus_ctx_t buses[I2C_SCHED_BUSES] = {0};
+    uint32_t started = 0;   // Bit n set once job n has been taken
+    int remaining = count;
+
+    if (count > _MAX_JOBS) {
+        i2c_sched_run(jobs, _MAX_JOBS);
+        i2c_sched_run(jobs + _MAX_JOBS, count - _MAX_JOBS);
+        return;
+    }
+
+    if (_window_start_us == 0) {
+        _window_start_us = time_us_64();
+    }
+
+    while (remaining > 0) {
+        for (uint bus = 0; bus < I2C_SCHED_BUSES; bus++) {
+            _bus_ctx_t* ctx = &buses[bus];
+
+            if (ctx->job) {
+                if (_poll_job(ctx)) {
+                    i2c_job_t* job = ctx->job;
+                    uint32_t elapsed_us = time_us_64() - ctx->start_us;
+                    _busy_us[bus] += elapsed_us;
+
+                    if (job->latency) {
+                        latency_hist_record(job->latency, elapsed_us);
+                    }
+
+                    if (job->result == PICO_ERROR_TIMEOUT || job->result == PICO_ERROR_IO) {
+                        _recover_bus(bus);
+                    }
+
+                    ctx->job = NULL;
+
+                    if (job == &ctx->select) {
+                        if (_end_select(ctx)) {
+                            remaining--;
+                        }
+                    } else {
+                        if (job->mux) {
+                            job->mux->transactions++;
+                        }
+                        remaining--;
+                    }
+                }
+                continue;
+            }
+
+            // Take the next job for this controller, if any
+            if (!ctx->routed) {
+                int next = _next_job(ctx, jobs, count, bus, started);
+
+                if (next < 0) {
+                    continue;
+                }
+
+                i2c_job_t* job = &jobs[next];
+
+                started |= 1u << next;
+
+                // Nothing to transfer, so there would be no stop condition
+                if (job->tx_len + job->rx_len == 0) {
+                    job->result = 0;
+                    remaining--;
+                    continue;
+                }
+
+                ctx->routed = job;
+                ctx->skip_muxes = 0;
+            }
+
+            uint8_t channel;
+            int mux = _next_select(ctx, ctx->routed, &channel);
+
+            if (mux >= 0) {
+                _start_select(ctx, mux, channel);
+            } else {
+                _start_job(ctx, ctx->routed);
+                ctx->routed = NULL;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Gets the fraction of time a controller has been busy since
+ * the last report.
+ *
+ * @param bus Controller index
+ * @return uint32_t Utilization in permille
+ */
+uint32_t i2c_sched_utilization_permille(uint bus) {
+    if (bus >= I2C_SCHED_BUSES || _window_start_us == 0) {
+        return 0;
+    }
+
+    uint64_t window = time_us_64() - _window_start_us;
+
+    if (window == 0) {
+        return 0;
+    }
+
+    return (_busy_us[bus] * 1000) / window;
+}
+
+/**
+ * @brief Prints the utilization and bus clears of each added controller
+ * over USB and starts a new measurement window.
+ *
+ */
+void i2c_sched_report(void) {
+    for (uint bus = 0; bus < I2C_SCHED_BUSES; bus++) {
+        if (!_bus_pins[bus].added) {
+            continue;
+        }
+
+        uint32_t permille = i2c_sched_utilization_permille(bus);
+
+        printf("(I2C) i2c%u busy %lu.%lu%%\n", bus,
+               (unsigned long)permille / 10, (unsigned long)permille % 10);
+
+        if (_recoveries[bus] > 0) {
+            printf("(I2C) i2c%u bus cleared %lu times, last in %lu.%03lu ms\n", bus,
+                   (unsigned long)_recoveries[bus],
+                   (unsigned long)_last_recovery_us[bus] / 1000,
+                   (unsigned long)_last_recovery_us[bus] % 1000);
+        }
+
+        _busy_us[bus] = 0;
+        _recoveries[bus] = 0;
+    }
+
+    _window_start_us = time_us_64();
+}
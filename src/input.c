@@ -0,0 +1,233 @@
+/*
+
+Debounced button input.
+
+Every edge on the button pin (re)starts a short settle alarm. When the
+alarm fires the pin has been stable for _SETTLE_US, and a change of
+its level is taken as a press or release. A press is therefore
+reported a few ms after the contacts stop bouncing, however long the
+bouncing lasts.
+
+Presses are turned into gestures:
+- press:        every debounced press, reported on its stable edge
+                without waiting for the release
+- long press:   held for _LONG_PRESS_US (reported while still held,
+                after its press)
+- double press: a press starting within _DOUBLE_PRESS_US of the
+                previous one, reported after the second press
+
+Gestures are pushed into a single-producer/single-consumer queue that
+needs no locks: the GPIO and alarm IRQs which produce them share a
+priority, so they never preempt each other, and only the run-loop
+consumes them. An EVENT_BUTTON event wakes the run-loop.
+
+*/
+
+#include "input.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include "event_loop.h"
+#include "ram_placement.h"
+
+#define _SETTLE_US 5000
+#define _LONG_PRESS_US 800000
+#define _DOUBLE_PRESS_US 350000
+
+#define _QUEUE_SIZE 8   // Must be a power of 2
+
+static uint _gpio;
+
+// Level of the pin once it stopped bouncing. The button pulls the
+// pin high when pressed.
+static volatile bool _stable_pressed = false;
+
+// Time of the first edge since the pin was last stable
+static volatile uint64_t _first_edge_us = 0;
+static volatile bool _settling = false;
+
+static alarm_id_t _settle_alarm = 0;
+static alarm_id_t _long_alarm = 0;
+
+static uint64_t _last_press_us = 0;    // 0 if no double press can follow
+
+static input_event_t _queue[_QUEUE_SIZE];
+static volatile uint32_t _queue_head = 0;  // Written by the producer only
+static volatile uint32_t _queue_tail = 0;  // Written by the consumer only
+static volatile uint32_t _dropped = 0;
+
+/**
+ * @brief Adds a gesture to the queue and wakes the run-loop.
+ *
+ * @param kind Gesture
+ * @param time_us Time of the edge which completed it
+ */
+void HOT_FUNC(_push)(input_kind_t kind, uint64_t time_us) {
+    uint32_t head = _queue_head;
+
+    if (head - _queue_tail >= _QUEUE_SIZE) {
+        _dropped++;
+        return;
+    }
+
+    _queue[head & (_QUEUE_SIZE - 1)] = (input_event_t){kind, time_us};
+
+    // The entry must be written before it is published
+    __dmb();
+    _queue_head = head + 1;
+
+    event_post(EVENT_BUTTON, kind);
+}
+
+/**
+ * @brief Reports a long press if the button is still held.
+ *
+ */
+int64_t HOT_FUNC(_long_press_alarm)(alarm_id_t id, void* user_data) {
+    _long_alarm = 0;
+
+    if (_stable_pressed) {
+        _last_press_us = 0;
+        _push(INPUT_LONG_PRESS, time_us_64());
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Handles a debounced press. The press is reported at once,
+ * followed by a double press if it came soon after the last one.
+ *
+ * @param time_us Time of the first edge of the press
+ */
+void HOT_FUNC(_on_press)(uint64_t time_us) {
+    _long_alarm = add_alarm_in_us(_LONG_PRESS_US, _long_press_alarm, NULL, true);
+
+    _push(INPUT_PRESS, time_us);
+
+    if (_last_press_us && time_us - _last_press_us <= _DOUBLE_PRESS_US) {
+        _last_press_us = 0;
+        _push(INPUT_DOUBLE_PRESS, time_us);
+    } else {
+        _last_press_us = time_us;
+    }
+}
+
+/**
+ * @brief Handles a debounced release. Stops a long press from being
+ * reported.
+ *
+ */
+void HOT_FUNC(_on_release)(void) {
+    if (_long_alarm > 0) {
+        cancel_alarm(_long_alarm);
+        _long_alarm = 0;
+    }
+}
+
+/**
+ * @brief Runs once the pin has not changed for _SETTLE_US.
+ *
+ */
+int64_t HOT_FUNC(_settle_alarm_isr)(alarm_id_t id, void* user_data) {
+    _settle_alarm = 0;
+    _settling = false;
+
+    bool pressed = gpio_get(_gpio);
+
+    // Bouncing that ended at the old level is not a change
+    if (pressed == _stable_pressed) {
+        return 0;
+    }
+
+    _stable_pressed = pressed;
+
+    if (pressed) {
+        _on_press(_first_edge_us);
+    } else {
+        _on_release();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief ISR for both edges of the button pin. Restarts the settle
+ * alarm so it only fires once the pin is stable.
+ *
+ * @param gpio GPIO that caused the interrupt.
+ * @param event_mask Active interrupt(s).
+ */
+void HOT_FUNC(_input_edge_isr)(uint gpio, uint32_t event_mask) {
+    uint64_t now = time_us_64();
+
+    if (!_settling) {
+        _settling = true;
+        _first_edge_us = now;
+    }
+
+    if (_settle_alarm > 0) {
+        cancel_alarm(_settle_alarm);
+    }
+
+    _settle_alarm = add_alarm_in_us(_SETTLE_US, _settle_alarm_isr, NULL, true);
+}
+
+/**
+ * @brief Sets up the button pin and its interrupt.
+ *
+ * @param gpio Pin of the button
+ */
+void input_init(uint gpio) {
+    _gpio = gpio;
+
+    _settling = false;
+    _settle_alarm = 0;
+    _long_alarm = 0;
+    _last_press_us = 0;
+    _queue_head = 0;
+    _queue_tail = 0;
+    _dropped = 0;
+
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_pull_down(gpio);
+
+    _stable_pressed = gpio_get(gpio);
+
+    gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
+                                       true, _input_edge_isr);
+}
+
+/**
+ * @brief Takes the oldest gesture from the queue. Must only be
+ * called from the run-loop.
+ *
+ * @param event Set to the gesture
+ * @return bool False if the queue is empty.
+ */
+bool input_poll(input_event_t* event) {
+    uint32_t tail = _queue_tail;
+
+    if (tail == _queue_head) {
+        return false;
+    }
+
+    // Read the entry only after seeing it was published
+    __dmb();
+    *event = _queue[tail & (_QUEUE_SIZE - 1)];
+    __dmb();
+
+    _queue_tail = tail + 1;
+
+    return true;
+}
+
+/**
+ * @brief Gets the number of gestures lost because the queue was full.
+ *
+ * @return uint32_t Number of gestures dropped
+ */
+uint32_t input_dropped(void) {
+    return _dropped;
+}
@@ -0,0 +1,210 @@
+/*
+
+Always-on latency histograms.
+
+Each histogram has a fixed set of buckets on a log scale: every power
+of two is split into 8 equal buckets, as in an HDR histogram. Finding
+the bucket of a value only needs its highest set bit, so recording
+takes the same time for any value and needs no floating point.
+
+Recording takes a hardware spinlock, which also masks interrupts on
+the calling core, so stages can be recorded from either core and
+from interrupt handlers. A histogram is added to the list printed by
+latency_hist_dump_all() the first time it records a value.
+
+*/
+
+#include "latency_hist.h"
+#include <stdio.h>
+#include <string.h>
+#include "hardware/sync.h"
+#include "ram_placement.h"
+
+#define _SUB_COUNT (1u << LATENCY_HIST_SUB_BITS)
+
+#define _MAX_HISTS 8
+
+static spin_lock_t* _lock = NULL;
+
+static latency_hist_t* _hists[_MAX_HISTS];
+static uint8_t _hist_count = 0;
+
+// Copy of a histogram taken under the lock, printed without it
+static latency_hist_t _snapshot;
+
+/**
+ * @brief Claims the spinlock guarding the histograms. Values recorded
+ * before this is called are dropped.
+ *
+ */
+void latency_hist_init(void) {
+    _lock = spin_lock_instance(spin_lock_claim_unused(true));
+}
+
+/**
+ * @brief Gets the bucket a value falls into.
+ *
+ * @param us Value in microseconds
+ * @return uint32_t Bucket index
+ */
+uint32_t HOT_FUNC(latency_hist_bucket)(uint32_t us) {
+    if (us < _SUB_COUNT) {
+        return us;
+    }
+
+    uint32_t exp = 31 - __builtin_clz(us);
+
+    if (exp > LATENCY_HIST_MAX_EXP) {
+        return LATENCY_HIST_BUCKETS - 1;
+    }
+
+    uint32_t sub = (us >> (exp - LATENCY_HIST_SUB_BITS)) & (_SUB_COUNT - 1);
+
+    return (exp - LATENCY_HIST_SUB_BITS + 1) * _SUB_COUNT + sub;
+}
+
+/**
+ * @brief Gets the smallest value that falls into a bucket.
+ *
+ * @param bucket Bucket index
+ * @return uint32_t Value in microseconds
+ */
+uint32_t latency_hist_bucket_low(uint32_t bucket) {
+    if (bucket < _SUB_COUNT) {
+        return bucket;
+    }
+
+    if (bucket == LATENCY_HIST_BUCKETS - 1) {
+        return 1u << (LATENCY_HIST_MAX_EXP + 1);
+    }
+
+    uint32_t exp = bucket / _SUB_COUNT + LATENCY_HIST_SUB_BITS - 1;
+    uint32_t sub = bucket % _SUB_COUNT;
+
+    return (_SUB_COUNT + sub) << (exp - LATENCY_HIST_SUB_BITS);
+}
+
+/**
+ * @brief Gets the largest value that falls into a bucket.
+ *
+ * @param bucket Bucket index
+ * @return uint32_t Value in microseconds
+ */
+uint32_t latency_hist_bucket_high(uint32_t bucket) {
+    if (bucket == LATENCY_HIST_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+
+    return latency_hist_bucket_low(bucket + 1) - 1;
+}
+
+/**
+ * @brief Adds a value to a histogram. Safe to call from either core
+ * and from interrupt handlers.
+ *
+ * @param hist Histogram to add to
+ * @param us Value in microseconds
+ */
+void HOT_FUNC(latency_hist_record)(latency_hist_t* hist, uint32_t us) {
+    if (!_lock) {
+        return;
+    }
+
+    uint32_t bucket = latency_hist_bucket(us);
+    uint32_t save = spin_lock_blocking(_lock);
+
+    hist->counts[bucket]++;
+    hist->count++;
+
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+
+    if (!hist->registered && _hist_count < _MAX_HISTS) {
+        _hists[_hist_count++] = hist;
+        hist->registered = true;
+    }
+
+    spin_unlock(_lock, save);
+}
+
+/**
+ * @brief Gets an upper bound of a percentile of a histogram.
+ *
+ * @param hist Histogram
+ * @param permille Percentile in permille, e.g. 990 for p99
+ * @return uint32_t Largest value of the bucket holding the percentile,
+ * or the largest value recorded if that is lower. 0 if empty.
+ */
+uint32_t latency_hist_percentile(const latency_hist_t* hist, uint32_t permille) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    uint64_t target = ((uint64_t)hist->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+
+        if (seen >= target) {
+            return MIN(latency_hist_bucket_high(i), hist->max_us);
+        }
+    }
+
+    return hist->max_us;
+}
+
+/**
+ * @brief Prints a histogram over USB: a summary line and one line per
+ * bucket holding values.
+ *
+ * @param hist Histogram to print
+ */
+void _print_hist(const latency_hist_t* hist) {
+    printf("(LATENCY) %s: n=%lu p50<=%lu p90<=%lu p99<=%lu p99.9<=%lu max=%lu us\n",
+           hist->name,
+           (unsigned long)hist->count,
+           (unsigned long)latency_hist_percentile(hist, 500),
+           (unsigned long)latency_hist_percentile(hist, 900),
+           (unsigned long)latency_hist_percentile(hist, 990),
+           (unsigned long)latency_hist_percentile(hist, 999),
+           (unsigned long)hist->max_us);
+
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        if (hist->counts[i]) {
+            printf("(LATENCY)   %lu-%lu us: %lu\n",
+                   (unsigned long)latency_hist_bucket_low(i),
+                   (unsigned long)latency_hist_bucket_high(i),
+                   (unsigned long)hist->counts[i]);
+        }
+    }
+}
+
+/**
+ * @brief Prints every histogram that has recorded a value over USB.
+ *
+ * @param reset True to clear each histogram once it has been copied
+ */
+void latency_hist_dump_all(bool reset) {
+    if (!_lock) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < _hist_count; i++) {
+        latency_hist_t* hist = _hists[i];
+        uint32_t save = spin_lock_blocking(_lock);
+
+        _snapshot = *hist;
+
+        if (reset) {
+            memset(hist->counts, 0, sizeof(hist->counts));
+            hist->count = 0;
+            hist->max_us = 0;
+        }
+
+        spin_unlock(_lock, save);
+
+        _print_hist(&_snapshot);
+    }
+}
@@ -8,6 +8,15 @@ Created by Michael Hogue
 
 #include "lcd.h"
 #include "hardware/spi.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "clock_profile.h"
+#include "lcd_stream.pio.h"
+#include "pcd8544_emu.h"
+#include "ram_placement.h"
+#include "latency_hist.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,16 +25,21 @@ Created by Michael Hogue
 #define LCD_DATA 1
 
 #define SPI_INST spi0
+#define SPI_BAUDRATE 4000000
 #define PIN_CS   17
 #define PIN_SCK  18
 #define PIN_MOSI 19
 #define PIN_DC   20
 #define PIN_RST  21
 
-#define LCD_BUF_SIZE (48 * 84) / 8
+// PIO block used to stream to the LCD. PIO0 is full with the 1-wire program.
+#define STREAM_PIO pio1
+
+// Each byte is one FIFO word. A segment is 2 address commands + data.
+#define STREAM_MAX_WORDS (LCD_BANKS * (2 + LCD_WIDTH))
 
 // Simple font table. Based on BBC-Micro font.
-const uint8_t _FONT_TABLE[][8] = {
+const uint8_t HOT_DATA("font") _FONT_TABLE[][8] = {
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // 32 ' '
     {0x00, 0x00, 0x00, 0xde, 0xde, 0x00, 0x00, 0x00}, // 33 '!'
     {0x00, 0x00, 0x0e, 0x00, 0x00, 0x0e, 0x00, 0x00}, // 34 '"'
@@ -90,6 +104,42 @@ const uint8_t _FONT_TABLE[][8] = {
 // Memory buffer for the LCD
 static uint8_t display_buffer[LCD_BUF_SIZE];
 
+// Buffer drawing functions write to. Normally the display buffer,
+// but views can be drawn off-screen into another frame.
+static uint8_t* draw_buffer = display_buffer;
+
+// Text cursor saved while drawing off-screen
+static uint8_t saved_cursor_x;
+static uint8_t saved_cursor_y;
+
+// Copy of what is currently in LCD memory, used to only send
+// the parts of the buffer which have changed.
+static uint8_t panel_buffer[LCD_BUF_SIZE];
+
+// A run of changed bytes within one bank (row of 8 pixels)
+typedef struct {
+    uint8_t bank;
+    uint8_t x;
+    uint8_t len;
+} _lcd_segment_t;
+
+// PIO/DMA streaming state. If the streamer could not be set up,
+// everything is sent over SPI instead.
+static bool stream_enabled = false;
+static uint stream_sm;
+static uint stream_dma;
+static uint32_t stream_words[STREAM_MAX_WORDS];
+
+// Time from starting a flush until it has been sent
+static latency_hist_t flush_latency = {.name = "lcd flush"};
+static uint64_t flush_start_us = 0;
+
+// Emulator fed with every byte sent to the LCD, if one is attached
+static pcd8544_emu_t* emu_tap = NULL;
+
+// Whether the panel is powered up
+static bool panel_on = true;
+
 // Current x/y position of the text cursor
 static uint8_t cursor_x_pos = 0; // Max: 9
 static uint8_t cursor_y_pos = 0; // Max: 5
@@ -100,6 +150,16 @@ static uint8_t cursor_y_pos = 0; // Max: 5
  * @param cmd Command to send
  */
 void _lcd_cmd(uint8_t cmd) {
+    if (emu_tap) {
+        pcd8544_emu_command(emu_tap, cmd);
+    }
+
+    if (stream_enabled) {
+        dma_channel_wait_for_finish_blocking(stream_dma);
+        pio_sm_put_blocking(STREAM_PIO, stream_sm, lcd_stream_word(LCD_COMMAND, cmd));
+        return;
+    }
+
     gpio_put(PIN_DC, LCD_COMMAND);
     spi_write_blocking(SPI_INST, &cmd, 1);
 }
@@ -111,16 +171,210 @@ void _lcd_cmd(uint8_t cmd) {
  * @param len Number of bytes to send
  */
 void _lcd_data(uint8_t *data, size_t len) {
+    if (emu_tap) {
+        pcd8544_emu_data(emu_tap, data, len);
+    }
+
+    if (stream_enabled) {
+        dma_channel_wait_for_finish_blocking(stream_dma);
+
+        for (size_t i = 0; i < len; i++) {
+            pio_sm_put_blocking(STREAM_PIO, stream_sm, lcd_stream_word(LCD_DATA, data[i]));
+        }
+        return;
+    }
+
     gpio_put(PIN_DC, LCD_DATA);
     spi_write_blocking(SPI_INST, data, len);
 }
 
+/**
+ * @brief Computes the PIO clock divider giving an SCK of SPI_BAUDRATE.
+ * 
+ * @param sys_hz System clock frequency
+ * @param div_int Set to the integer part of the divider
+ * @param div_frac Set to the fractional part of the divider (1/256ths)
+ */
+void _stream_clkdiv_for(uint32_t sys_hz, uint16_t* div_int, uint8_t* div_frac) {
+    // One SCK period is 4 SM cycles. Round up to never exceed the baud rate.
+    uint32_t sm_hz = SPI_BAUDRATE * 4;
+    uint64_t div_fixed = ((uint64_t)sys_hz * 256 + sm_hz - 1) / sm_hz;
+
+    div_fixed = MAX(div_fixed, 0x100);
+
+    *div_int = div_fixed >> 8;
+    *div_frac = div_fixed & 0xFF;
+}
+
+/**
+ * @brief DMA IRQ handler timing the end of a streamed flush.
+ * 
+ */
+void HOT_FUNC(_stream_dma_isr)(void) {
+    if (!dma_channel_get_irq0_status(stream_dma)) {
+        return;
+    }
+
+    dma_channel_acknowledge_irq0(stream_dma);
+
+    latency_hist_record(&flush_latency, time_us_64() - flush_start_us);
+}
+
+/**
+ * @brief Hands the SCK/MOSI/DC pins over to a PIO SM which is fed
+ * by DMA. Falls back to SPI if no SM or DMA channel is free.
+ * 
+ */
+void _stream_init(void) {
+    if (!pio_can_add_program(STREAM_PIO, &lcd_stream_program)) {
+        puts("(LCD) No room for the stream program, using SPI.");
+        return;
+    }
+
+    int sm = pio_claim_unused_sm(STREAM_PIO, false);
+    int dma = dma_claim_unused_channel(false);
+
+    if (sm < 0 || dma < 0) {
+        puts("(LCD) No free SM or DMA channel, using SPI.");
+
+        if (sm >= 0) {
+            pio_sm_unclaim(STREAM_PIO, sm);
+        }
+        if (dma >= 0) {
+            dma_channel_unclaim(dma);
+        }
+        return;
+    }
+
+    uint offset = pio_add_program(STREAM_PIO, &lcd_stream_program);
+
+    uint16_t div_int;
+    uint8_t div_frac;
+    _stream_clkdiv_for(clock_get_hz(clk_sys), &div_int, &div_frac);
+
+    lcd_stream_program_init(STREAM_PIO, sm, offset, PIN_SCK, PIN_MOSI, PIN_DC, div_int, div_frac);
+
+    // The stream keeps the chip select asserted
+    gpio_init(PIN_CS);
+    gpio_set_dir(PIN_CS, GPIO_OUT);
+    gpio_put(PIN_CS, 0);
+
+    dma_channel_config c = dma_channel_get_default_config(dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(STREAM_PIO, sm, true));
+    dma_channel_configure(dma, &c, &STREAM_PIO->txf[sm], stream_words, 0, false);
+
+    stream_sm = sm;
+    stream_dma = dma;
+    stream_enabled = true;
+
+    // Completion of each transfer is timed for the flush histogram
+    dma_channel_set_irq0_enabled(dma, true);
+    irq_add_shared_handler(DMA_IRQ_0, _stream_dma_isr, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+/**
+ * @brief Finds the changed part of each bank of the display buffer.
+ * 
+ * @param segments Set to one segment per changed bank
+ * @return uint8_t Number of segments found
+ */
+uint8_t HOT_FUNC(_find_changed_segments)(_lcd_segment_t segments[LCD_BANKS]) {
+    uint8_t count = 0;
+
+    for (uint8_t bank = 0; bank < LCD_BANKS; bank++) {
+        const uint8_t* row = display_buffer + (bank * LCD_WIDTH);
+        const uint8_t* panel_row = panel_buffer + (bank * LCD_WIDTH);
+
+        int first = 0;
+        while (first < LCD_WIDTH && row[first] == panel_row[first]) {
+            first++;
+        }
+
+        if (first == LCD_WIDTH) {
+            continue;
+        }
+
+        int last = LCD_WIDTH - 1;
+        while (row[last] == panel_row[last]) {
+            last--;
+        }
+
+        segments[count].bank = bank;
+        segments[count].x = first;
+        segments[count].len = last - first + 1;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Sends segments of the display buffer as one DMA transfer
+ * through the PIO streamer. Returns without waiting for the
+ * transfer to finish.
+ * 
+ * @param segments Segments to send
+ * @param count Number of segments
+ */
+void HOT_FUNC(_send_segments_stream)(const _lcd_segment_t* segments, uint8_t count) {
+    // The previous transfer may still be reading the word buffer
+    dma_channel_wait_for_finish_blocking(stream_dma);
+
+    uint32_t words = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t* data = display_buffer + (segments[i].bank * LCD_WIDTH) + segments[i].x;
+
+        stream_words[words++] = lcd_stream_word(LCD_COMMAND, 0x80 | segments[i].x);
+        stream_words[words++] = lcd_stream_word(LCD_COMMAND, 0x40 | segments[i].bank);
+
+        for (uint8_t j = 0; j < segments[i].len; j++) {
+            stream_words[words++] = lcd_stream_word(LCD_DATA, data[j]);
+        }
+    }
+
+    // The emulator sees the words the streamer is given, not the
+    // segments they were built from
+    if (emu_tap) {
+        for (uint32_t i = 0; i < words; i++) {
+            bool is_data;
+            uint8_t byte = lcd_stream_decode(stream_words[i], &is_data);
+
+            if (is_data) {
+                pcd8544_emu_data(emu_tap, &byte, 1);
+            } else {
+                pcd8544_emu_command(emu_tap, byte);
+            }
+        }
+    }
+
+    dma_channel_transfer_from_buffer_now(stream_dma, stream_words, words);
+}
+
+/**
+ * @brief Sends segments of the display buffer over SPI.
+ * 
+ * @param segments Segments to send
+ * @param count Number of segments
+ */
+void _send_segments_spi(const _lcd_segment_t* segments, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        _lcd_cmd(0x80 | segments[i].x);     // Set X-address of RAM
+        _lcd_cmd(0x40 | segments[i].bank);  // Set Y-address of RAM
+        _lcd_data(display_buffer + (segments[i].bank * LCD_WIDTH) + segments[i].x, segments[i].len);
+    }
+}
+
 /**
  * @brief Set the display buffer to all zeros.
  * 
  */
 void _clear_buffer(void) {
-    memset(display_buffer, 0, LCD_BUF_SIZE);
+    memset(draw_buffer, 0, LCD_BUF_SIZE);
 }
 
 /**
@@ -129,7 +383,7 @@ void _clear_buffer(void) {
  * wrap around to the next.
  * 
  */
-void _increment_cursor(void) {
+void HOT_FUNC(_increment_cursor)(void) {
     if (cursor_x_pos >= 9) {
         cursor_x_pos = 0;
         cursor_y_pos++;
@@ -142,12 +396,32 @@ void _increment_cursor(void) {
     }
 }
 
+/**
+ * @brief Recomputes the SPI baud rate after the system clock changed.
+ * 
+ * @param sys_hz New system clock frequency
+ */
+void _lcd_clock_changed(uint32_t sys_hz) {
+    spi_set_baudrate(SPI_INST, SPI_BAUDRATE);
+
+    if (stream_enabled) {
+        uint16_t div_int;
+        uint8_t div_frac;
+        _stream_clkdiv_for(sys_hz, &div_int, &div_frac);
+
+        dma_channel_wait_for_finish_blocking(stream_dma);
+        pio_sm_set_clkdiv_int_frac(STREAM_PIO, stream_sm, div_int, div_frac);
+        pio_sm_clkdiv_restart(STREAM_PIO, stream_sm);
+    }
+}
+
 /**
  * @brief Initialize the LCD and display buffer.
  * 
  */
 void lcd_init(void) {
-    spi_init(SPI_INST, 4000000);
+    spi_init(SPI_INST, SPI_BAUDRATE);
+    clock_profile_add_listener(_lcd_clock_changed);
     gpio_set_function(PIN_CS, GPIO_FUNC_SPI);
     gpio_set_function(PIN_SCK, GPIO_FUNC_SPI);
     gpio_set_function(PIN_MOSI, GPIO_FUNC_SPI);
@@ -157,9 +431,9 @@ void lcd_init(void) {
     gpio_set_dir(PIN_DC, GPIO_OUT);
     gpio_set_dir(PIN_RST, GPIO_OUT);
 
-    // Reset LCD
+    // Reset LCD. The PCD8544 only needs a 100 ns reset pulse.
     gpio_put(PIN_RST, 0);
-    sleep_ms(100);
+    sleep_us(10);
     gpio_put(PIN_RST, 1);
 
     // Initialize LCD
@@ -172,18 +446,167 @@ void lcd_init(void) {
 
     _clear_buffer();
     _lcd_data(display_buffer, LCD_BUF_SIZE);
+    memset(panel_buffer, 0, LCD_BUF_SIZE);
+
+    // Later updates are streamed through PIO if possible
+    _stream_init();
 
     cursor_x_pos = 0;
     cursor_y_pos = 0;
 }
 
 /**
- * @brief Send the contents of the entire buffer to
- * LCD memory.
+ * @brief Puts the LCD into or out of power-down mode.
+ * The contents of LCD memory are kept while powered down.
+ * 
+ * @param on False to power down, true to power back up.
+ */
+void lcd_set_power(bool on) {
+    _lcd_cmd(on ? 0x20 : 0x24);  // Basic instruction set, PD bit
+    panel_on = on;
+}
+
+/**
+ * @brief Send the parts of the buffer which have changed
+ * since the last flush to LCD memory.
  * 
  */
 void flush_lcd_buffer(void) {
-    _lcd_data(display_buffer, LCD_BUF_SIZE);
+    // Off-screen frames are only sent once they are loaded
+    if (draw_buffer != display_buffer) {
+        return;
+    }
+
+    _lcd_segment_t segments[LCD_BANKS];
+    uint8_t count = _find_changed_segments(segments);
+
+    if (count == 0) {
+        return;
+    }
+
+    if (stream_enabled) {
+        // The previous transfer must finish before its time is taken
+        dma_channel_wait_for_finish_blocking(stream_dma);
+        flush_start_us = time_us_64();
+        _send_segments_stream(segments, count);
+    } else {
+        flush_start_us = time_us_64();
+        _send_segments_spi(segments, count);
+        latency_hist_record(&flush_latency, time_us_64() - flush_start_us);
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t offset = (segments[i].bank * LCD_WIDTH) + segments[i].x;
+        memcpy(panel_buffer + offset, display_buffer + offset, segments[i].len);
+    }
+}
+
+/**
+ * @brief Feeds every byte sent to the LCD into an emulator from now
+ * on. The emulator is first brought to the state the panel is in.
+ * 
+ * @param emu Emulator to feed, or NULL to stop feeding
+ */
+void lcd_attach_emulator(pcd8544_emu_t* emu) {
+    emu_tap = emu;
+
+    if (!emu) {
+        return;
+    }
+
+    // Same set up as lcd_init(), then the current panel contents
+    pcd8544_emu_reset(emu);
+    pcd8544_emu_command(emu, 0x21);
+    pcd8544_emu_command(emu, 0x90);
+    pcd8544_emu_command(emu, panel_on ? 0x20 : 0x24);
+    pcd8544_emu_command(emu, 0x0C);
+    pcd8544_emu_command(emu, 0x80);
+    pcd8544_emu_command(emu, 0x40);
+    pcd8544_emu_data(emu, panel_buffer, LCD_BUF_SIZE);
+    pcd8544_emu_frame_reset(emu);
+}
+
+/**
+ * @brief Checks that an emulator shows exactly the display buffer,
+ * i.e. that every change was sent to the LCD.
+ * 
+ * @param emu Attached emulator
+ * @return bool True if the emulated panel matches the display buffer.
+ */
+bool lcd_emulator_matches_buffer(const pcd8544_emu_t* emu) {
+    return memcmp(emu->ram, display_buffer, LCD_BUF_SIZE) == 0;
+}
+
+/**
+ * @brief Computes a checksum of what is on the panel, so frames
+ * can be compared without reading the LCD back.
+ * 
+ * @return uint32_t FNV-1a hash of the panel contents
+ */
+uint32_t lcd_panel_checksum(void) {
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < LCD_BUF_SIZE; i++) {
+        hash = (hash ^ panel_buffer[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Replaces the display buffer with a pre-drawn frame and
+ * resets the text cursor, without sending anything to the LCD.
+ * 
+ * @param frame Frame to copy, LCD_BUF_SIZE bytes
+ */
+void HOT_FUNC(lcd_load_frame)(const uint8_t* frame) {
+    memcpy(draw_buffer, frame, LCD_BUF_SIZE);
+    cursor_x_pos = 0;
+    cursor_y_pos = 0;
+}
+
+/**
+ * @brief Sends all drawing to the given frame instead of the display
+ * buffer until lcd_end_offscreen(). Flushes do nothing meanwhile, so
+ * views can be drawn ahead of time and shown with lcd_load_frame().
+ * 
+ * @param frame Frame to draw into, LCD_BUF_SIZE bytes
+ */
+void lcd_begin_offscreen(uint8_t* frame) {
+    draw_buffer = frame;
+    saved_cursor_x = cursor_x_pos;
+    saved_cursor_y = cursor_y_pos;
+}
+
+/**
+ * @brief Sends drawing back to the display buffer.
+ * 
+ */
+void lcd_end_offscreen(void) {
+    draw_buffer = display_buffer;
+    cursor_x_pos = saved_cursor_x;
+    cursor_y_pos = saved_cursor_y;
+}
+
+/**
+ * @brief Waits until the last flush has been sent to the LCD.
+ * 
+ */
+void lcd_wait_for_flush(void) {
+    if (stream_enabled) {
+        dma_channel_wait_for_finish_blocking(stream_dma);
+    }
+}
+
+/**
+ * @brief Clears the display buffer and resets the text cursor
+ * without sending anything to the LCD.
+ * 
+ */
+void lcd_clear_buffer(void) {
+    _clear_buffer();
+    cursor_x_pos = 0;
+    cursor_y_pos = 0;
 }
 
 /**
@@ -198,8 +621,8 @@ void clear_lcd(void) {
 }
 
 /**
- * @brief Shows the "HOGUE" splashscreen for 3 seconds then
- * clears the screen.
+ * @brief Shows the "HOGUE" splashscreen. It stays on the screen
+ * until the next view is drawn.
  * 
  */
 void show_splashscreen(void) {
@@ -231,10 +654,6 @@ void show_splashscreen(void) {
     memcpy(display_buffer + 277, splash_bottom, 33);
 
     flush_lcd_buffer();
-
-    sleep_ms(3000);
-
-    clear_lcd();
 }
 
 /**
@@ -291,11 +710,49 @@ void lcd_get_cursor_position(uint8_t* x, uint8_t* y) {
  * @param y2 Bottom of column
  */
 void _rect_draw_column(uint16_t for_x, uint8_t y1, uint8_t y2) {
-    for (uint16_t y = y1; y <= y2; y++) {
-        uint16_t index = ((y / 8) * 84) + for_x;
-        uint8_t bit = 1 << (y % 8);
-        display_buffer[index] |= bit;
+    uint8_t first_bank = y1 / 8;
+    uint8_t last_bank = y2 / 8;
+
+    // Set whole bytes at a time rather than individual pixels
+    for (uint8_t bank = first_bank; bank <= last_bank; bank++) {
+        uint8_t mask = 0xFF;
+
+        if (bank == first_bank) {
+            mask &= 0xFF << (y1 % 8);
+        }
+
+        if (bank == last_bank) {
+            mask &= 0xFF >> (7 - (y2 % 8));
+        }
+
+        draw_buffer[(bank * 84) + for_x] |= mask;
+    }
+}
+
+/**
+ * @brief Draws a 1px-wide vertical line between two y values.
+ * Note: The buffer is NOT flushed upon completion.
+ * 
+ * @param x X position of the line
+ * @param y1 One end of the line
+ * @param y2 Other end of the line
+ * @return uint8_t 1 if any point is out of bounds. Otherwise, 0.
+ */
+uint8_t lcd_draw_vline(uint8_t x, uint8_t y1, uint8_t y2) {
+    if (x > 83 || y1 > 47 || y2 > 47) {
+        printf("(LCD) lcd_draw_vline: Coordinates out of bounds.\n");
+        return 1;
+    }
+
+    if (y1 > y2) {
+        uint8_t tmp = y1;
+        y1 = y2;
+        y2 = tmp;
     }
+
+    _rect_draw_column(x, y1, y2);
+
+    return 0;
 }
 
 /**
@@ -322,8 +779,8 @@ uint8_t lcd_draw_rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, bool fill)
                 uint16_t bottom_index = ((y2 / 8) * 84) + x;
                 uint8_t top_bit = 1 << (y1 % 8);
                 uint8_t bottom_bit = 1 << (y2 % 8);
-                display_buffer[top_index] |= top_bit;
-                display_buffer[bottom_index] |= bottom_bit;
+                draw_buffer[top_index] |= top_bit;
+                draw_buffer[bottom_index] |= bottom_bit;
             } else {
                 _rect_draw_column(x, y1, y2);
             }
@@ -348,7 +805,7 @@ uint8_t lcd_draw_rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, bool fill)
  * @param y Top-left y position (Max: 47)
  * * @return uint8_t 1 if point is out of bounds. Otherwise, 0.
  */
-uint8_t lcd_draw_bitmap_8x8(const uint8_t bitmap[8], uint8_t x, uint8_t y) {
+uint8_t HOT_FUNC(lcd_draw_bitmap_8x8)(const uint8_t bitmap[8], uint8_t x, uint8_t y) {
     if (x > 83 || y > 47) {
         printf("(LCD) lcd_draw_bitmap_8x8: Coordinates out of bounds.\n");
         return 1;
@@ -359,7 +816,7 @@ uint8_t lcd_draw_bitmap_8x8(const uint8_t bitmap[8], uint8_t x, uint8_t y) {
         if (start_index + i >= LCD_BUF_SIZE)
             return 0;
 
-        display_buffer[start_index + i] = bitmap[i];
+        draw_buffer[start_index + i] = bitmap[i];
     }
 
     return 0;
@@ -371,7 +828,7 @@ uint8_t lcd_draw_bitmap_8x8(const uint8_t bitmap[8], uint8_t x, uint8_t y) {
  * @param c Character to print
  * @param autoflush If true, buffer will automatically flushed to LCD when finished.
  */
-void lcd_print_char(const char c, bool autoflush) {
+void HOT_FUNC(lcd_print_char)(const char c, bool autoflush) {
     // Check for newline
     if (c == '\n') {
         lcd_newline();
@@ -408,7 +865,7 @@ void lcd_print_char(const char c, bool autoflush) {
  * @param str Characters to print. MUST be null terminated. 
  * @param autoflush If true, buffer will automatically flushed to LCD when finished.
  */
-uint16_t lcd_print_str(const char* str, bool autoflush) {
+uint16_t HOT_FUNC(lcd_print_str)(const char* str, bool autoflush) {
     int i = 0;
     while (*(str + i) != '\0') {
         lcd_print_char(*(str + i), false);
@@ -434,7 +891,7 @@ uint8_t lcd_clear_line(uint8_t line) {
         return 1;
     }
 
-    memset(display_buffer + (84 * line), 0, 84);
+    memset(draw_buffer + (84 * line), 0, 84);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,462 @@
+/*
+
+Read-only FAT12 volume holding the sample history as LOG.CSV and
+LOG.BIN, generated block by block as the host reads it.
+
+Every row of both files has a fixed length, and the files always
+hold every bucket of every history resolution, so their sizes and
+the whole FAT are constant. Any block maps straight to the rows it
+overlaps, which are read from the history and formatted on their own.
+Nothing is kept besides the newest bucket of each resolution, taken
+when the host reads the boot sector on mount, so that every row of
+one export lines up.
+
+Layout, in 512 byte blocks:
+  0         Boot sector
+  1         FAT
+  2         Root directory
+  3...      LOG.CSV, then LOG.BIN, one block per cluster
+
+LOG.CSV has a header row and one row per bucket. Each row holds the
+bucket length and start (seconds since boot), then the min, average
+and max of moisture, lux and temperature. Moisture is in counts with
+one decimal, from the finer history values. Buckets without samples
+are left blank.
+
+LOG.BIN starts with a 16 byte little-endian header:
+  char magic[6] = "PHPLOG", u8 version, u8 sensors, u16 rows,
+  u16 row length, u32 time of the export (seconds since boot)
+followed by one 28 byte row per bucket:
+  u32 bucket length, u32 start, u8 valid mask (bit per sensor),
+  u8 reserved, then i16 min, avg, max per sensor
+Version 2 holds moisture as the history does, in 1/8 counts.
+
+*/
+
+#include "log_export.h"
+#include <string.h>
+#include "history.h"
+#include "latency_hist.h"
+
+#define _BLOCK LOG_EXPORT_BLOCK_SIZE
+
+#define _ROWS (HISTORY_RES_COUNT * HISTORY_BUCKETS)
+
+// Sensors in the order of the columns
+static const history_sensor_t _COLUMNS[HISTORY_SENSOR_COUNT] = {
+    HISTORY_MOISTURE, HISTORY_LUX, HISTORY_TEMPERATURE,
+};
+
+// CSV field widths. Every row is padded to the same length.
+#define _CSV_PERIOD_W 8
+#define _CSV_START_W 10
+#define _CSV_VALUE_W 9
+#define _CSV_ROW_LEN (_CSV_PERIOD_W + 1 + _CSV_START_W + HISTORY_SENSOR_COUNT * 3 * (1 + _CSV_VALUE_W) + 2)
+
+static const char _CSV_HEADER[] =
+    "period_s,   start_s,moist_min,moist_avg,moist_max,"
+    "  lux_min,  lux_avg,  lux_max, temp_min, temp_avg, temp_max\r\n";
+
+#define _BIN_HEADER_LEN 16
+#define _BIN_ROW_LEN (4 + 4 + 1 + 1 + HISTORY_SENSOR_COUNT * 3 * 2)
+
+#define _CSV_SIZE ((1 + _ROWS) * _CSV_ROW_LEN)
+#define _BIN_SIZE (_BIN_HEADER_LEN + _ROWS * _BIN_ROW_LEN)
+
+#define _CLUSTERS(size) (((size) + _BLOCK - 1) / _BLOCK)
+
+#define _FAT_BLOCK 1
+#define _ROOT_BLOCK 2
+#define _DATA_BLOCK 3
+#define _CSV_CLUSTER 2
+#define _BIN_CLUSTER (_CSV_CLUSTER + _CLUSTERS(_CSV_SIZE))
+#define _END_CLUSTER (_BIN_CLUSTER + _CLUSTERS(_BIN_SIZE))
+#define _BLOCK_COUNT (_DATA_BLOCK + _END_CLUSTER - _CSV_CLUSTER)
+
+#define _ROOT_ENTRIES (_BLOCK / 32)
+
+_Static_assert(sizeof(_CSV_HEADER) - 1 == _CSV_ROW_LEN, "CSV header must be one row long");
+
+// Directory entry date and time, 2024-01-01 00:00. The probe has no
+// real-time clock.
+#define _FAT_DATE ((44 << 9) | (1 << 5) | 1)
+#define _FAT_TIME 0
+
+// Newest bucket of each resolution when the export was taken
+static uint32_t _newest_epoch[HISTORY_RES_COUNT];
+static uint32_t _export_time_s = 0;
+
+// Time to generate each block read by the host
+static latency_hist_t _block_latency = {.name = "export block"};
+
+/**
+ * @brief Gets the size of the volume.
+ *
+ * @return uint32_t Number of LOG_EXPORT_BLOCK_SIZE blocks
+ */
+uint32_t log_export_block_count(void) {
+    return _BLOCK_COUNT;
+}
+
+/**
+ * @brief Takes the newest bucket of each resolution, which the rows
+ * of the files are counted back from.
+ *
+ */
+void log_export_snapshot(void) {
+    for (int r = 0; r < HISTORY_RES_COUNT; r++) {
+        _newest_epoch[r] = history_newest_epoch(r);
+    }
+
+    _export_time_s = to_ms_since_boot(get_absolute_time()) / 1000;
+}
+
+/**
+ * @brief Writes a little-endian value.
+ *
+ * @param out Where to write
+ * @param value Value to write
+ * @param bytes Number of bytes to write
+ */
+void _put_le(uint8_t* out, uint32_t value, uint8_t bytes) {
+    for (uint8_t i = 0; i < bytes; i++) {
+        out[i] = value >> (8 * i);
+    }
+}
+
+/**
+ * @brief Writes a number right-aligned in a fixed width field,
+ * padded with spaces. Faster than printf, which matters at USB
+ * full-speed.
+ *
+ * @param out Where to write the field
+ * @param value Number to write
+ * @param width Width of the field
+ */
+void _put_field(char* out, int32_t value, uint8_t width) {
+    bool negative = value < 0;
+    uint32_t magnitude = negative ? -(uint32_t)value : (uint32_t)value;
+    int pos = width - 1;
+
+    memset(out, ' ', width);
+
+    do {
+        out[pos--] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0 && pos >= 0);
+
+    if (negative && pos >= 0) {
+        out[pos] = '-';
+    }
+}
+
+/**
+ * @brief Writes a moisture value from the history right-aligned in a
+ * fixed width field, in counts with one decimal.
+ *
+ * @param out Where to write the field
+ * @param moisture Moisture in 1/HISTORY_MOISTURE_SCALE counts, not negative
+ * @param width Width of the field
+ */
+void _put_moisture(char* out, int16_t moisture, uint8_t width) {
+    int32_t tenths = (moisture * 10 + HISTORY_MOISTURE_SCALE / 2) / HISTORY_MOISTURE_SCALE;
+
+    _put_field(out, tenths / 10, width - 2);
+    out[width - 2] = '.';
+    out[width - 1] = '0' + tenths % 10;
+}
+
+/**
+ * @brief Gets the bucket a row of the files holds.
+ *
+ * @param row Row number, not counting headers
+ * @param resolution Set to the resolution of the row
+ * @param epoch Set to the bucket number of the row
+ * @return bool False if the row is older than the history.
+ */
+bool _row_bucket(uint16_t row, history_resolution_t* resolution, uint32_t* epoch) {
+    *resolution = row / HISTORY_BUCKETS;
+
+    uint32_t age = HISTORY_BUCKETS - 1 - row % HISTORY_BUCKETS;
+
+    if (age > _newest_epoch[*resolution]) {
+        return false;
+    }
+
+    *epoch = _newest_epoch[*resolution] - age;
+
+    return true;
+}
+
+/**
+ * @brief Formats one row of LOG.CSV.
+ *
+ * @param row Row number, 0 for the header
+ * @param out Set to the row
+ */
+void _csv_row(uint16_t row, uint8_t out[_CSV_ROW_LEN]) {
+    char* text = (char*)out;
+    history_resolution_t resolution;
+    uint32_t epoch;
+
+    if (row == 0) {
+        memcpy(out, _CSV_HEADER, _CSV_ROW_LEN);
+        return;
+    }
+
+    memset(text, ' ', _CSV_ROW_LEN - 2);
+    text[_CSV_ROW_LEN - 2] = '\r';
+    text[_CSV_ROW_LEN - 1] = '\n';
+
+    char* field = text + _CSV_PERIOD_W + 1 + _CSV_START_W;
+
+    text[_CSV_PERIOD_W] = ',';
+
+    for (int v = 0; v < HISTORY_SENSOR_COUNT * 3; v++) {
+        field[v * (1 + _CSV_VALUE_W)] = ',';
+    }
+
+    if (!_row_bucket(row - 1, &resolution, &epoch)) {
+        return;
+    }
+
+    uint32_t period_s = history_period_s(resolution);
+
+    _put_field(text, period_s, _CSV_PERIOD_W);
+    _put_field(text + _CSV_PERIOD_W + 1, epoch * period_s, _CSV_START_W);
+
+    field++;
+
+    for (int s = 0; s < HISTORY_SENSOR_COUNT; s++) {
+        history_point_t point;
+
+        if (!history_get_bucket(_COLUMNS[s], resolution, epoch, &point)) {
+            field += 3 * (1 + _CSV_VALUE_W);
+            continue;
+        }
+
+        if (_COLUMNS[s] == HISTORY_MOISTURE) {
+            _put_moisture(field, point.min, _CSV_VALUE_W);
+            _put_moisture(field + (1 + _CSV_VALUE_W), point.avg, _CSV_VALUE_W);
+            _put_moisture(field + 2 * (1 + _CSV_VALUE_W), point.max, _CSV_VALUE_W);
+        } else {
+            _put_field(field, point.min, _CSV_VALUE_W);
+            _put_field(field + (1 + _CSV_VALUE_W), point.avg, _CSV_VALUE_W);
+            _put_field(field + 2 * (1 + _CSV_VALUE_W), point.max, _CSV_VALUE_W);
+        }
+
+        field += 3 * (1 + _CSV_VALUE_W);
+    }
+}
+
+/**
+ * @brief Formats one row of LOG.BIN.
+ *
+ * @param row Row number, not counting the header
+ * @param out Set to the row
+ */
+void _bin_row(uint16_t row, uint8_t out[_BIN_ROW_LEN]) {
+    history_resolution_t resolution;
+    uint32_t epoch;
+
+    memset(out, 0, _BIN_ROW_LEN);
+
+    if (!_row_bucket(row, &resolution, &epoch)) {
+        return;
+    }
+
+    uint32_t period_s = history_period_s(resolution);
+
+    _put_le(out, period_s, 4);
+    _put_le(out + 4, epoch * period_s, 4);
+
+    for (int s = 0; s < HISTORY_SENSOR_COUNT; s++) {
+        history_point_t point;
+        uint8_t* values = out + 10 + s * 6;
+
+        if (history_get_bucket(_COLUMNS[s], resolution, epoch, &point)) {
+            out[8] |= 1u << s;
+            _put_le(values, (uint16_t)point.min, 2);
+            _put_le(values + 2, (uint16_t)point.avg, 2);
+            _put_le(values + 4, (uint16_t)point.max, 2);
+        }
+    }
+}
+
+/**
+ * @brief Writes the LOG.BIN header.
+ *
+ * @param out Set to the header
+ */
+void _bin_header(uint8_t out[_BIN_HEADER_LEN]) {
+    memcpy(out, "PHPLOG", 6);
+    out[6] = 2;
+    out[7] = HISTORY_SENSOR_COUNT;
+    _put_le(out + 8, _ROWS, 2);
+    _put_le(out + 10, _BIN_ROW_LEN, 2);
+    _put_le(out + 12, _export_time_s, 4);
+}
+
+/**
+ * @brief Generates one block of LOG.CSV or LOG.BIN from the rows it
+ * overlaps. Past the end of the file the block is zero.
+ *
+ * @param block Set to the block
+ * @param offset Offset of the block in the file
+ * @param bin True for LOG.BIN, false for LOG.CSV
+ */
+void _file_block(uint8_t block[_BLOCK], uint32_t offset, bool bin) {
+    uint32_t header_len = bin ? _BIN_HEADER_LEN : 0;
+    uint32_t row_len = bin ? _BIN_ROW_LEN : _CSV_ROW_LEN;
+    uint32_t size = bin ? _BIN_SIZE : _CSV_SIZE;
+    uint32_t end = MIN(offset + _BLOCK, size);
+
+    memset(block, 0, _BLOCK);
+
+    if (bin && offset < header_len) {
+        uint8_t header[_BIN_HEADER_LEN];
+        _bin_header(header);
+        memcpy(block, header + offset, MIN(header_len - offset, end - offset));
+    }
+
+    uint32_t pos = MAX(offset, header_len);
+
+    while (pos < end) {
+        uint16_t row = (pos - header_len) / row_len;
+        uint32_t row_start = header_len + row * row_len;
+        uint32_t row_end = MIN(row_start + row_len, end);
+        uint8_t text[_CSV_ROW_LEN];
+
+        if (bin) {
+            _bin_row(row, text);
+        } else {
+            _csv_row(row, text);
+        }
+
+        memcpy(block + (pos - offset), text + (pos - row_start), row_end - pos);
+        pos = row_end;
+    }
+}
+
+/**
+ * @brief Writes the boot sector.
+ *
+ * @param block Set to the block
+ */
+void _boot_block(uint8_t block[_BLOCK]) {
+    memcpy(block, "\xEB\x3C\x90MSWIN4.1", 11);
+    _put_le(block + 11, _BLOCK, 2);             // Bytes per sector
+    block[13] = 1;                              // Sectors per cluster
+    _put_le(block + 14, _FAT_BLOCK, 2);         // Reserved sectors
+    block[16] = 1;                              // FATs
+    _put_le(block + 17, _ROOT_ENTRIES, 2);
+    _put_le(block + 19, _BLOCK_COUNT, 2);
+    block[21] = 0xF8;                           // Fixed disk
+    _put_le(block + 22, 1, 2);                  // Sectors per FAT
+    _put_le(block + 24, 1, 2);                  // Sectors per track
+    _put_le(block + 26, 1, 2);                  // Heads
+    block[36] = 0x80;                           // Drive number
+    block[38] = 0x29;                           // Extended boot signature
+    _put_le(block + 39, 0x50484C47, 4);         // Volume serial number
+    memcpy(block + 43, "PLANTPROBE FAT12   ", 19);
+    block[510] = 0x55;
+    block[511] = 0xAA;
+}
+
+/**
+ * @brief Gets the FAT entry of a cluster: the next cluster of its
+ * file, or the end of the chain.
+ *
+ * @param cluster Cluster number
+ * @return uint16_t FAT12 entry
+ */
+uint16_t _fat_entry(uint16_t cluster) {
+    if (cluster == 0) {
+        return 0xFF8;
+    }
+
+    if (cluster == 1 || cluster == _BIN_CLUSTER - 1 || cluster == _END_CLUSTER - 1) {
+        return 0xFFF;
+    }
+
+    return cluster < _END_CLUSTER ? cluster + 1 : 0;
+}
+
+/**
+ * @brief Writes the FAT, packing two 12-bit entries in three bytes.
+ *
+ * @param block Set to the block
+ */
+void _fat_block(uint8_t block[_BLOCK]) {
+    for (uint16_t cluster = 0; cluster * 3 / 2 + 2 < _BLOCK; cluster += 2) {
+        uint16_t a = _fat_entry(cluster);
+        uint16_t b = _fat_entry(cluster + 1);
+        uint8_t* out = block + cluster * 3 / 2;
+
+        out[0] = a;
+        out[1] = (a >> 8) | (b << 4);
+        out[2] = b >> 4;
+    }
+}
+
+/**
+ * @brief Writes a directory entry.
+ *
+ * @param entry Set to the entry
+ * @param name Name and extension, padded to 11 characters
+ * @param attributes FAT attributes
+ * @param cluster First cluster, 0 for none
+ * @param size File size
+ */
+void _dir_entry(uint8_t entry[32], const char* name, uint8_t attributes, uint16_t cluster, uint32_t size) {
+    memcpy(entry, name, 11);
+    entry[11] = attributes;
+    _put_le(entry + 22, _FAT_TIME, 2);
+    _put_le(entry + 24, _FAT_DATE, 2);
+    _put_le(entry + 26, cluster, 2);
+    _put_le(entry + 28, size, 4);
+}
+
+/**
+ * @brief Writes the root directory: the volume label and both files,
+ * read-only.
+ *
+ * @param block Set to the block
+ */
+void _root_block(uint8_t block[_BLOCK]) {
+    _dir_entry(block, "PLANTPROBE ", 0x08, 0, 0);
+    _dir_entry(block + 32, "LOG     CSV", 0x01, _CSV_CLUSTER, _CSV_SIZE);
+    _dir_entry(block + 64, "LOG     BIN", 0x01, _BIN_CLUSTER, _BIN_SIZE);
+}
+
+/**
+ * @brief Generates one block of the volume. Reading the boot sector
+ * takes a new snapshot of the history.
+ *
+ * @param lba Block number
+ * @param block Set to the block
+ */
+void log_export_read_block(uint32_t lba, uint8_t block[LOG_EXPORT_BLOCK_SIZE]) {
+    uint64_t start_us = time_us_64();
+
+    memset(block, 0, _BLOCK);
+
+    if (lba == 0) {
+        log_export_snapshot();
+        _boot_block(block);
+    } else if (lba == _FAT_BLOCK) {
+        _fat_block(block);
+    } else if (lba == _ROOT_BLOCK) {
+        _root_block(block);
+    } else if (lba < _BLOCK_COUNT) {
+        uint16_t cluster = lba - _DATA_BLOCK + _CSV_CLUSTER;
+
+        if (cluster < _BIN_CLUSTER) {
+            _file_block(block, (cluster - _CSV_CLUSTER) * _BLOCK, false);
+        } else {
+            _file_block(block, (cluster - _BIN_CLUSTER) * _BLOCK, true);
+        }
+    }
+
+    latency_hist_record(&_block_latency, time_us_64() - start_us);
+}
@@ -18,31 +18,94 @@ Created by Michael Hogue.
 #include "hardware/sync.h"
 #include "hardware/pio.h"
 #include "viewmode_select.h"
+#include "input.h"
 #include "bh1750_light_sensor.h"
 #include "ds18b20.h"
 #include "soil_moisture_seesaw.h"
+#include "tca9548a.h"
 #include "graphics.h"
-
-#define I2C_INSTANCE i2c1
-#define I2C_SDA_PIN 6
-#define I2C_SCL_PIN 7
+#include "history.h"
+#include "event_loop.h"
+#include "power.h"
+#include "clock_profile.h"
+#include "board_config.h"
+#include "i2c_sched.h"
+#include "sensor.h"
+#include "trace_replay.h"
+#include "sample_frame.h"
+#include "render_test.h"
+#include "xip_stats.h"
+#include "memory_stats.h"
+#include "latency_hist.h"
+#include "usb_command.h"
+#include "analytics.h"
+#include "alerts.h"
+#include "usb_device.h"
+
+// Number of sampling loops between I2C utilization and sensor
+// noise reports
+#define I2C_REPORT_INTERVAL 64
+
+// Number of samples between XIP cache reports. The cache counters
+// saturate, so the window is kept short.
+#define XIP_REPORT_INTERVAL 16
+
+// Number of samples between RAM usage reports
+#define MEMORY_REPORT_INTERVAL 64
+
+// Number of samples between light and dry-down analytics reports
+#define ANALYTICS_REPORT_INTERVAL 60
+
+// How often the history and analytics need every sensor
+#define LOG_INTERVAL_MS 15000
+
+// Longest time Core1 sleeps between samples before passing its
+// clock change checkpoint
+#define SAMPLER_IDLE_CHECK_MS 500
+
+// Core1 runs on its own stack, painted so its use can be measured
+#define CORE1_STACK_SIZE 4096
 
 #define MODE_SELECT_PIN 8
 
 #define PIO_INSTANCE pio0
 #define ONE_WIRE_PIN 9
 
+// Low-power logging mode: sample once per epoch and
+// turn the display off when the button is not in use.
+#define LOW_POWER_LOGGING false
+#define LOW_POWER_EPOCH_MS 60000
+#define DISPLAY_AWAKE_MS 15000
+
+// Trace recording and replay. Recording prints every sample as a
+// trace entry; replay plays the built-in trace through the pipeline
+// at boot instead of sampling the sensors.
+#define TRACE_RECORD false
+#define TRACE_REPLAY false
+
+// Draw every view against an emulated LCD at boot and check the
+// images against golden checksums
+#define RENDER_SELF_TEST false
+
+// The splash screen is dismissed once the first reading arrives,
+// but is shown for at least SPLASH_MIN_MS and at most SPLASH_MAX_MS
+#define SPLASH_MIN_MS 500
+#define SPLASH_MAX_MS 3000
+
+// Data carried by timer events
+#define TIMER_EPOCH 1
+#define TIMER_DISPLAY_OFF 2
+#define TIMER_SPLASH 3
+
 // Stores sensor data
 typedef struct {
     int16_t temperature;
     uint16_t lux;
-    uint16_t moisture;
+    uint16_t moisture;  // In 1/HISTORY_MOISTURE_SCALE counts
+    uint8_t faults;     // Bit n set if sensor n is faulted
 
 } sensor_data_t;
 
-// Flag set to true when the delay timer ISR has fired
-static volatile bool cycle_timer_flag = false;
-
 // This variable is shared between the two cores
 // and stores the sensor readings sampled
 // in the background from Core1.
@@ -50,63 +113,374 @@ static volatile bool cycle_timer_flag = false;
 // Core1: WRITE ONLY to this value
 // NOTE: temperature value <= -100 indicates no 
 // readings have been stored here yet.
-static volatile sensor_data_t shared_sensor_data = {0, 0, -100};
+static volatile sensor_data_t shared_sensor_data = {-100, 0, 0, 0};
+
+static uint32_t core1_stack[CORE1_STACK_SIZE / sizeof(uint32_t)];
 
-// PIO state machine instance set at initialization
-static int8_t pio_sm = -1;
+// Sensors sampled by Core1
+static ds18b20_sensor_t temperature_sensor = {PIO_INSTANCE, ONE_WIRE_PIN, -1, true};
+static bh1750_sensor_t light_sensor = {BOARD_BH1750_I2C, false, false};
+static seesaw_sensor_t soil_sensor = {BOARD_SEESAW_I2C, false, NULL};
+
+// Extra soil probes behind the board's mux, by channel
+static tca9548a_t board_mux;
+static mux_device_t muxed_probes[TCA9548A_CHANNELS];
+static seesaw_sensor_t muxed_soil_sensors[TCA9548A_CHANNELS];
+
+// Registry ids of the sensors above
+static int temperature_id = -1;
+static int lux_id = -1;
+static int moisture_id = -1;
+
+// Bucket length shown by the trend views
+static history_resolution_t trend_resolution = HISTORY_RES_15MIN;
+
+// Time since boot at which the first temperature was sampled,
+// or 0 if none has been yet. Written by Core1.
+static volatile uint64_t first_reading_us = 0;
+
+// Time since boot at which the first temperature was on the LCD,
+// or 0 if it has not been shown yet
+static uint64_t first_shown_us = 0;
 
 /**
- * @brief ISR for the delay cycle timer.
+ * @brief Recomputes the I2C rate and 1-wire PIO clock divider after
+ * the system clock has changed. Runs on Core0 while Core1 is paused.
  * 
- * @return int64_t Additional delay time. Should always return 0.
+ * @param sys_hz New system clock frequency
  */
-int64_t cycle_timer_isr() {
-    cycle_timer_flag = true;
+void core1_peripherals_clock_changed(uint32_t sys_hz) {
+    i2c_sched_clock_changed();
 
-    return 0;
+    if (temperature_sensor.sm >= 0) {
+        ds18b20_set_clock(temperature_sensor.pio, temperature_sensor.sm, sys_hz);
+    }
+}
+
+/**
+ * @brief Adds a soil sensor for each seesaw behind the board's mux,
+ * for as many as the registry has room for.
+ * 
+ */
+void register_muxed_probes(void) {
+    if (BOARD_MUX_PROBE_CHANNELS == 0) {
+        return;
+    }
+
+    tca9548a_init(&board_mux, BOARD_MUX_I2C, BOARD_MUX_ADDR);
+
+    for (uint8_t channel = 0; channel < TCA9548A_CHANNELS; channel++) {
+        if (!(BOARD_MUX_PROBE_CHANNELS & (1u << channel))) {
+            continue;
+        }
+
+        muxed_probes[channel] = (mux_device_t){&board_mux, channel, SEESAW_I2C_ADDR};
+        muxed_soil_sensors[channel] = (seesaw_sensor_t){BOARD_MUX_I2C, false, &muxed_probes[channel]};
+
+        int id = sensor_register(&seesaw_sensor_driver, &muxed_soil_sensors[channel]);
+
+        sensor_set_oversampling(id, BOARD_SEESAW_OVERSAMPLE);
+    }
+}
+
+/**
+ * @brief Adds every sensor to the registry. Sensor ids follow the
+ * order used here, which recorded traces depend on.
+ * 
+ */
+void register_sensors(void) {
+    temperature_id = sensor_register(&ds18b20_sensor_driver, &temperature_sensor);
+    lux_id = sensor_register(&bh1750_sensor_driver, &light_sensor);
+    moisture_id = sensor_register(&seesaw_sensor_driver, &soil_sensor);
+
+    // After the built-in sensors, so recorded traces keep their ids
+    register_muxed_probes();
+
+    sensor_set_oversampling(lux_id, BOARD_BH1750_OVERSAMPLE);
+    sensor_set_oversampling(moisture_id, BOARD_SEESAW_OVERSAMPLE);
+
+    // The history and analytics log every sensor
+    for (int id = 0; id < sensor_count(); id++) {
+        sensor_set_demand(id, SENSOR_CONSUMER_LOGGER, LOG_INTERVAL_MS);
+        sensor_set_demand(id, SENSOR_CONSUMER_TELEMETRY,
+                          TRACE_RECORD ? SENSOR_DEMAND_CONTINUOUS : SENSOR_DEMAND_NONE);
+    }
+}
+
+/**
+ * @brief Sets how often the alert rules need each sensor.
+ * 
+ */
+void update_alert_demand(void) {
+    sensor_set_demand(temperature_id, SENSOR_CONSUMER_ALERTS, alerts_interval_ms(ALERT_TEMPERATURE));
+    sensor_set_demand(lux_id, SENSOR_CONSUMER_ALERTS, alerts_interval_ms(ALERT_LUX));
+    sensor_set_demand(moisture_id, SENSOR_CONSUMER_ALERTS, alerts_interval_ms(ALERT_MOISTURE));
+}
+
+/**
+ * @brief Sets how often the display needs each sensor. Views showing
+ * a live value need it continuously; trend and analytics views only
+ * change as fast as the logger samples.
+ * 
+ * @param view_mode The current view-mode.
+ * @param display_on False if the display is off, so nothing is shown
+ */
+void update_view_demand(view_mode_t view_mode, bool display_on) {
+    // Every view shows the temperature in its header
+    bool temperature = display_on;
+    bool lux = display_on && (view_mode == DUAL || view_mode == LIGHT);
+    bool moisture = display_on && (view_mode == DUAL || view_mode == SOIL);
+
+    sensor_set_demand(temperature_id, SENSOR_CONSUMER_VIEW,
+                      temperature ? SENSOR_DEMAND_CONTINUOUS : SENSOR_DEMAND_NONE);
+    sensor_set_demand(lux_id, SENSOR_CONSUMER_VIEW,
+                      lux ? SENSOR_DEMAND_CONTINUOUS : SENSOR_DEMAND_NONE);
+    sensor_set_demand(moisture_id, SENSOR_CONSUMER_VIEW,
+                      moisture ? SENSOR_DEMAND_CONTINUOUS : SENSOR_DEMAND_NONE);
+}
+
+/**
+ * @brief Adds a reading to the trend history if the sensor was read.
+ * Values are clamped to fit the signed history values. Moisture keeps
+ * the fraction bits of an oversampled reading.
+ * 
+ * @param record Sample holding the reading
+ * @param id Sensor id
+ * @param history_sensor History series to add to
+ * @param timestamp_s Time of the sample
+ */
+void record_history(const sensor_record_t* record, int id, history_sensor_t history_sensor, uint32_t timestamp_s) {
+    if (!sensor_record_valid(record, id)) {
+        return;
+    }
+
+    int32_t value = record->values[id];
+
+    if (history_sensor == HISTORY_MOISTURE) {
+        value = record->fine_values[id] * HISTORY_MOISTURE_SCALE >> SENSOR_FRACTION_BITS;
+    }
+
+    history_add_sample(history_sensor, MAX(MIN(value, INT16_MAX), INT16_MIN), timestamp_s);
+}
+
+/**
+ * @brief Stores a sample in the shared sensor data and the history.
+ * Sensors which were not read keep their previous value.
+ * 
+ * @param record Sample to store
+ */
+void publish_record(const sensor_record_t* record) {
+    if (sensor_record_valid(record, temperature_id)) {
+        shared_sensor_data.temperature = record->values[temperature_id];
+
+        if (first_reading_us == 0) {
+            first_reading_us = time_us_64();
+        }
+    }
+    // The largest value is left for GRAPHICS_NO_READING
+    if (sensor_record_valid(record, lux_id)) {
+        shared_sensor_data.lux = MIN(record->values[lux_id], UINT16_MAX - 1);
+    }
+    if (sensor_record_valid(record, moisture_id)) {
+        shared_sensor_data.moisture = MIN(record->fine_values[moisture_id] * HISTORY_MOISTURE_SCALE >> SENSOR_FRACTION_BITS,
+                                          UINT16_MAX - 1);
+    }
+
+    // Faulted sensors are shown without a value, not with their last one
+    shared_sensor_data.faults = sensor_fault_mask();
+
+    uint32_t timestamp_s = record->timestamp_ms / 1000;
+    record_history(record, temperature_id, HISTORY_TEMPERATURE, timestamp_s);
+    record_history(record, lux_id, HISTORY_LUX, timestamp_s);
+    record_history(record, moisture_id, HISTORY_MOISTURE, timestamp_s);
+
+    if (sensor_record_valid(record, lux_id)) {
+        analytics_add_light(shared_sensor_data.lux, timestamp_s);
+    }
+    if (sensor_record_valid(record, moisture_id)) {
+        analytics_add_moisture(MIN(record->values[moisture_id], UINT16_MAX), timestamp_s);
+    }
+
+    // Alerts see every valid reading, whether sampled or replayed
+    if (sensor_record_valid(record, temperature_id)) {
+        alerts_add_sample(ALERT_TEMPERATURE, record->values[temperature_id], timestamp_s);
+    }
+    if (sensor_record_valid(record, lux_id)) {
+        alerts_add_sample(ALERT_LUX, record->values[lux_id], timestamp_s);
+    }
+    if (sensor_record_valid(record, moisture_id)) {
+        alerts_add_sample(ALERT_MOISTURE, record->values[moisture_id], timestamp_s);
+    }
+}
+
+/**
+ * @brief Brings up the I2C block a sensor is wired to, on the pins
+ * board_config.h gives it. The scheduler keeps the pins to clear a
+ * stuck bus.
+ * 
+ * @param i2c I2C block the sensor is on
+ */
+void add_sensor_bus(i2c_inst_t* i2c) {
+    if (i2c == i2c0) {
+        i2c_sched_add_bus(i2c0, BOARD_I2C0_SDA_PIN, BOARD_I2C0_SCL_PIN, BOARD_I2C_BAUDRATE);
+    } else {
+        i2c_sched_add_bus(i2c1, BOARD_I2C1_SDA_PIN, BOARD_I2C1_SCL_PIN, BOARD_I2C_BAUDRATE);
+    }
 }
 
 /**
  * @brief Entry point for core1. This processor is responsible for
- * sampling data from each sensor in a round-robin fashion. This allows
+ * sampling data from every registered sensor. This allows
  * core0 to handle user input/output fast.
  * 
  */
 void core1_entry() {
-    // Initialize temperature sensor
-    gpio_init(ONE_WIRE_PIN);
-    gpio_pull_up(ONE_WIRE_PIN);
-    pio_sm = ds18b20_init(PIO_INSTANCE, ONE_WIRE_PIN);
+    // Bring up the I2C blocks sensors are wired to. Sensors on
+    // different buses are sampled at the same time.
+    add_sensor_bus(BOARD_BH1750_I2C);
+    add_sensor_bus(BOARD_SEESAW_I2C);
 
-    // Print message if a SM could not be initialized
-    if (pio_sm == -1) {
-        puts("A PIO state machine could not be initialized.");
+    if (BOARD_MUX_PROBE_CHANNELS != 0) {
+        add_sensor_bus(BOARD_MUX_I2C);
     }
 
-    // Initialize I2C block
-    i2c_init(I2C_INSTANCE, 100000);
-    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
+    sensor_init_all();
 
-    // Initialize ambient light sensor
-    bh1750_power_on(I2C_INSTANCE);
+    sensor_record_t record;
 
-    // Initialize soil moisture sensor
-    seesaw_sw_reset(I2C_INSTANCE);
-
-    // Repeatedly sample sensor data. 
-    // ds18b20 sampling includes 1s delay.
+    // Repeatedly sample the sensors which are due. All conversions run
+    // at the same time, so each sample takes as long as the slowest sensor.
     while(1) {
-        int8_t temperature = ds18b20_get_temperature(PIO_INSTANCE, pio_sm, true);
+        bool low_power = power_low_power_enabled();
+
+        // In low-power mode, stay parked until Core0 starts the next epoch
+        if (low_power) {
+            power_core1_wait_for_epoch();
+        }
+
+        // No transfers are in flight here, so the clock may change
+        clock_profile_core1_checkpoint();
+
+        // Sleep until a consumer needs a sensor, coming back to the
+        // checkpoint now and then
+        if (!low_power && !sensor_wait_until_due(SAMPLER_IDLE_CHECK_MS)) {
+            continue;
+        }
+
+        sensor_sample_all(&record, low_power);
+        publish_record(&record);
+        sample_frame_print(&record);
+
+        if (TRACE_RECORD) {
+            trace_print_sample(&record);
+        }
+
+        // Wake core0 to show the new sample
+        event_notify_sample(record.sequence);
+
+        if (record.sequence % I2C_REPORT_INTERVAL == 0) {
+            i2c_sched_report();
+            sensor_noise_report();
+            sensor_demand_report();
+        }
+    }
+}
 
-        uint16_t lux = bh1750_read_measurement(I2C_INSTANCE);
+/**
+ * @brief USB command: prints the latency histograms of every stage
+ * and clears them.
+ * 
+ * @param args Unused
+ */
+void command_latency(const char* args) {
+    latency_hist_dump_all(true);
+}
 
-        uint16_t moisture = seesaw_read_moisture(I2C_INSTANCE);
+/**
+ * @brief USB command: prints the RAM usage.
+ * 
+ * @param args Unused
+ */
+void command_memory(const char* args) {
+    memory_report();
+}
 
-        shared_sensor_data.temperature = temperature;
-        shared_sensor_data.lux = lux;
-        shared_sensor_data.moisture = moisture;
+/**
+ * @brief USB command: prints the light and dry-down analytics.
+ * 
+ * @param args Unused
+ */
+void command_analytics(const char* args) {
+    analytics_report();
+}
+
+/**
+ * @brief USB command: prints every alert rule and whether it is firing.
+ * 
+ * @param args Unused
+ */
+void command_alerts(const char* args) {
+    alerts_report();
+}
+
+/**
+ * @brief USB command: sets or turns off an alert rule, e.g.
+ * "alert 2 lux below 2000 60" or "alert 2 off".
+ * 
+ * @param args Rule to set
+ */
+void command_alert(const char* args) {
+    if (!alerts_configure(args)) {
+        puts("(ALERT) usage: alert <slot> <temp|lux|moisture> below|above <value> <minutes>");
+        puts("(ALERT)        alert <slot> <temp|lux|moisture> outside <low> <high> <minutes>");
+        puts("(ALERT)        alert <slot> off");
+        return;
+    }
+
+    update_alert_demand();
+    alerts_report();
+}
+
+/**
+ * @brief Prints the time from boot until the first reading was
+ * sampled and until it was on the LCD.
+ * 
+ */
+void print_time_to_first_reading(void) {
+    if (first_shown_us == 0) {
+        puts("(BOOT) time-to-first-reading: no reading shown yet");
+        return;
     }
+
+    printf("(BOOT) time-to-first-reading %lu ms (sampled at %lu ms)\n",
+           (unsigned long)(first_shown_us / 1000), (unsigned long)(first_reading_us / 1000));
+}
+
+/**
+ * @brief USB command: prints the health of every sensor and how long
+ * the first reading took after boot.
+ * 
+ * @param args Unused
+ */
+void command_health(const char* args) {
+    sensor_health_report();
+    print_time_to_first_reading();
+}
+
+/**
+ * @brief Checks whether the button is held while the probe starts,
+ * which adds the USB log export.
+ * 
+ * @return bool True if the button is held.
+ */
+bool log_export_requested(void) {
+    gpio_init(MODE_SELECT_PIN);
+    gpio_pull_down(MODE_SELECT_PIN);
+
+    // Let the pull-down settle before reading
+    sleep_us(50);
+
+    return gpio_get(MODE_SELECT_PIN);
 }
 
 /**
@@ -115,106 +489,523 @@ void core1_entry() {
  * 
  */
 void initialize(void) {
-    // Setup GPIO IRQ for mode select button
-    setup_viewmodeselect_irq(MODE_SELECT_PIN);
-
-    // Start sensor sampling on Core1
-    multicore_reset_core1();
-    sleep_ms(100);
-    multicore_launch_core1(core1_entry);
+    // Latency is recorded from the first transfer on
+    latency_hist_init();
+
+    // Status reports are sent over USB. The log export volume is only
+    // added when asked for, so the probe is a plain serial port otherwise.
+    usb_device_init(log_export_requested());
+    stdio_init_all();
+    power_init();
+
+    usb_command_register("latency", command_latency);
+    usb_command_register("memory", command_memory);
+    usb_command_register("analytics", command_analytics);
+    usb_command_register("alerts", command_alerts);
+    usb_command_register("alert", command_alert);
+    usb_command_register("health", command_health);
+
+    // Peripherals owned by Core1 follow system clock changes
+    clock_profile_add_listener(core1_peripherals_clock_changed);
+    clock_profile_print_validation();
+
+    // Setup debounced input for mode select button
+    input_init(MODE_SELECT_PIN);
+
+    // History, analytics and alerts must be ready before Core1 starts
+    // adding samples
+    history_init();
+    analytics_init();
+    alerts_init();
+
+    // Core1 notifies Core0 of new samples through the event loop
+    event_loop_init();
+
+    // Sensors are registered before sampling or replay can decode them
+    register_sensors();
+    update_alert_demand();
+    update_view_demand(get_viewmode(), true);
+
+    // Start sensor sampling on Core1 so sensor bring-up and the
+    // first conversions run while Core0 brings up the display.
+    // A replay feeds recorded samples instead.
+    if (!TRACE_REPLAY) {
+        multicore_reset_core1();
+        memory_paint_stack(1, core1_stack, sizeof(core1_stack));
+        multicore_launch_core1_with_stack(core1_entry, core1_stack, sizeof(core1_stack));
+    }
 
-    // Initialize graphics
+    // Initialize graphics. The splash is left up while sampling starts.
     graphics_init();
+
+    if (RENDER_SELF_TEST) {
+        xip_stats_reset();
+        render_test_run();
+        xip_stats_report("render self-test");
+    }
+
+    if (LOW_POWER_LOGGING && !TRACE_REPLAY) {
+        clock_profile_apply(CLOCK_PROFILE_LOW_POWER);
+        power_set_low_power(true);
+        power_start_epoch();
+        event_timer_start(LOW_POWER_EPOCH_MS, true, TIMER_EPOCH);
+    }
 }
 
 /**
- * @brief Performs a power-efficient 0.5s delay. This delay will be 
- * cut short if the view-mode switch button is pressed.
+ * @brief Checks whether anything shown by the given view has changed
+ * since it was last drawn.
  * 
- * @param prev_view_mode The view-mode which was set before starting\
- * the delay.
+ * @param view_mode The current view-mode.
+ * @param data The current sensor data.
+ * @param drawn_view_mode The view-mode last drawn.
+ * @param drawn_data The sensor data last drawn.
+ * @param new_sample True if a new sample has arrived since the last draw.
+ * @return bool True if the view must be redrawn.
  */
-void delay_until_alarm_or_modeswitch(view_mode_t prev_view_mode) {
-    // Create 0.5 second run cycle delay
-    alarm_id_t cycle_alarm = add_alarm_in_ms(500, cycle_timer_isr, NULL, true);
+bool needs_redraw(view_mode_t view_mode, const sensor_data_t* data,
+                  view_mode_t drawn_view_mode, const sensor_data_t* drawn_data,
+                  bool new_sample) {
+    if (view_mode != drawn_view_mode) {
+        return true;
+    }
 
-    // Wait for an interrupt.
-    // If it was cycle alarm
-    // or mode switch, continue.
-    while(!cycle_timer_flag && prev_view_mode == get_viewmode()) {
-        __wfi();
+    if (data->temperature != drawn_data->temperature || data->faults != drawn_data->faults) {
+        return true;
     }
 
-    // Reset cycle alarm
-    cancel_alarm(cycle_alarm);
-    cycle_timer_flag = false;
+    switch (view_mode) {
+        case DUAL:
+            return data->moisture != drawn_data->moisture || data->lux != drawn_data->lux;
+        case SOIL:
+            return data->moisture != drawn_data->moisture;
+        case LIGHT:
+            return data->lux != drawn_data->lux;
+        default:
+            // Trend and analytics views change with every sample,
+            // even if the latest readings are the same.
+            return new_sample;
+    }
+}
+
+/**
+ * @brief Sets the alert overlay from the alerts now firing: the
+ * label of a single alert, or how many are firing.
+ * 
+ */
+void update_alert_overlay(void) {
+    uint32_t mask = alerts_firing_mask();
+
+    if (mask == 0) {
+        graphics_set_alert(NULL);
+        return;
+    }
+
+    char text[11];
+    uint count = __builtin_popcount(mask);
+
+    if (count == 1) {
+        char label[ALERTS_LABEL_LEN + 1];
+        alerts_label(__builtin_ctz(mask), label);
+        sprintf(text, "!%s", label);
+    } else {
+        sprintf(text, "!%u ALERTS", count);
+    }
+
+    graphics_set_alert(text);
+}
+
+/**
+ * @brief Checks whether a sensor is faulted in the given sensor data.
+ * 
+ * @param data Sensor data to check
+ * @param id Sensor id
+ * @return bool True if the sensor is faulted.
+ */
+bool is_faulted(const sensor_data_t* data, int id) {
+    return id >= 0 && (data->faults & (1u << id));
 }
 
 /**
  * @brief Shows sensor-data view on LCD based on the current view mode.
+ * Readings of faulted sensors are shown as "--".
  * 
  * @param view_mode The current view-mode.
+ * @param local_sensor_data Copy of the shared sensor data to show.
  */
-void output_data(view_mode_t view_mode) {
-    // // Get local copy of shared sensor data onto the stack.
-     sensor_data_t local_sensor_data = shared_sensor_data;
+void output_data(view_mode_t view_mode, sensor_data_t local_sensor_data) {
+    update_alert_overlay();
 
-    // // If no sensor data has yet been stored, display message.
-    if (local_sensor_data.temperature <= -100) {
+    // If no sensor data has yet been stored, display message.
+    // A faulted temperature sensor would never store any.
+    if (local_sensor_data.temperature <= -100 && !is_faulted(&local_sensor_data, temperature_id)) {
         show_loading_view();
         return;
     }
 
+    int8_t temperature = is_faulted(&local_sensor_data, temperature_id)
+        ? GRAPHICS_NO_TEMPERATURE : local_sensor_data.temperature;
+    uint16_t lux = is_faulted(&local_sensor_data, lux_id)
+        ? GRAPHICS_NO_READING : local_sensor_data.lux;
+    uint16_t moisture = is_faulted(&local_sensor_data, moisture_id)
+        ? GRAPHICS_NO_READING : local_sensor_data.moisture;
+
+    analytics_t analytics;
+
     switch (view_mode) {
         case DUAL:
-            show_dual_view( 
-                local_sensor_data.moisture,
-                local_sensor_data.lux,
-                local_sensor_data.temperature
-            );
+            show_dual_view(moisture, lux, temperature);
         break;
         case SOIL:
-            show_soil_view(
-                local_sensor_data.moisture, 
-                local_sensor_data.temperature
-            );
+            show_soil_view(moisture, temperature);
         break;
         case LIGHT:
-            show_light_view(
-                local_sensor_data.lux, 
-                local_sensor_data.temperature
-            );
+            show_light_view(lux, temperature);
+        break;
+        case DRY_DOWN:
+            analytics_get(&analytics);
+            show_dry_down_view(&analytics, temperature);
+        break;
+        case DLI:
+            analytics_get(&analytics);
+            show_dli_view(&analytics, temperature);
+        break;
+        case SOIL_TREND:
+            show_trend_view(HISTORY_MOISTURE, trend_resolution, temperature);
+        break;
+        case LIGHT_TREND:
+            show_trend_view(HISTORY_LUX, trend_resolution, temperature);
+        break;
+        case TEMP_TREND:
+            show_trend_view(HISTORY_TEMPERATURE, trend_resolution, temperature);
         break;
         default:
             show_critical_error_view();
     }
 }
 
+// What the pre-rendered frame of the next view in the rotation shows
+static bool prerendered_valid = false;
+static view_mode_t prerendered_view_mode;
+static sensor_data_t prerendered_data;
+
+// Button-to-photon latency: from the button interrupt until the
+// new view has been sent to the LCD
+static uint32_t latency_presses = 0;
+static uint64_t latency_total_us = 0;
+static uint32_t latency_max_us = 0;
+
+/**
+ * @brief Draws the view following the given one off-screen, so it
+ * is ready for the next button press.
+ * 
+ * @param data Sensor data to draw
+ */
+void prerender_next_view(sensor_data_t data) {
+    view_mode_t next_view_mode = get_next_viewmode();
+
+    graphics_prerender_begin();
+    output_data(next_view_mode, data);
+    graphics_prerender_end();
+
+    prerendered_valid = true;
+    prerendered_view_mode = next_view_mode;
+    prerendered_data = data;
+}
+
+/**
+ * @brief Shows the pre-rendered frame if it is of the given view and
+ * still up to date.
+ * 
+ * @param view_mode The view-mode to show.
+ * @param data The current sensor data.
+ * @return bool False if the view must be drawn instead.
+ */
+bool show_prerendered_view(view_mode_t view_mode, const sensor_data_t* data) {
+    if (!prerendered_valid || needs_redraw(view_mode, data, prerendered_view_mode,
+                                           &prerendered_data, false)) {
+        return false;
+    }
+
+    graphics_show_prerendered();
+
+    return true;
+}
+
+/**
+ * @brief Measures the time from a button press until now, once the
+ * new view is on the LCD, and prints it over USB.
+ * 
+ * @param prerendered True if a pre-rendered frame was shown
+ * @param press_us Time of the button press
+ */
+void report_button_latency(bool prerendered, uint64_t press_us) {
+    graphics_wait_for_flush();
+
+    uint32_t latency_us = time_us_64() - press_us;
+
+    latency_presses++;
+    latency_total_us += latency_us;
+    latency_max_us = MAX(latency_max_us, latency_us);
+
+    printf("(UI) button-to-photon %lu us%s, avg %lu us, max %lu us\n",
+           (unsigned long)latency_us, prerendered ? " (pre-rendered)" : "",
+           (unsigned long)(latency_total_us / latency_presses),
+           (unsigned long)latency_max_us);
+}
+
+/**
+ * @brief Applies every queued button gesture. Each press shows the
+ * next view and a long press, after returning to the view its press
+ * left, steps the trend views to the next resolution. A double press
+ * has no action of its own: both of its presses have already moved
+ * the view on.
+ * 
+ * @param press_us Set to the time of the last gesture, if any
+ * @return bool True if the trend resolution changed.
+ */
+bool handle_input(uint64_t* press_us) {
+    input_event_t input;
+    bool resolution_changed = false;
+
+    while (input_poll(&input)) {
+        viewmode_input(input.kind);
+
+        if (input.kind == INPUT_LONG_PRESS) {
+            trend_resolution = (trend_resolution + 1) % HISTORY_RES_COUNT;
+            resolution_changed = true;
+        }
+
+        *press_us = input.time_us;
+    }
+
+    return resolution_changed;
+}
+
+/**
+ * @brief Keeps the splash screen up until the first reading has
+ * arrived and the splash has been shown for SPLASH_MIN_MS, or until
+ * SPLASH_MAX_MS has passed. Button presses are still applied.
+ * 
+ * @param splash_start_us Time the splash was shown
+ */
+void wait_for_first_reading(uint64_t splash_start_us) {
+    int timer = event_timer_start(SPLASH_MAX_MS, false, TIMER_SPLASH);
+
+    while (1) {
+        sensor_data_t data = shared_sensor_data;
+
+        if (data.temperature > -100 || is_faulted(&data, temperature_id)) {
+            uint32_t shown_ms = (time_us_64() - splash_start_us) / 1000;
+
+            if (shown_ms < SPLASH_MIN_MS) {
+                sleep_ms(SPLASH_MIN_MS - shown_ms);
+            }
+
+            event_timer_cancel(timer);
+            return;
+        }
+
+        event_t event;
+        event_wait(&event);
+
+        if (event.type == EVENT_TIMER && event.data == TIMER_SPLASH) {
+            return;
+        }
+
+        if (event.type == EVENT_BUTTON) {
+            uint64_t press_us = 0;
+            handle_input(&press_us);
+        }
+    }
+}
+
+/**
+ * @brief Records when the first reading was on the LCD and prints
+ * it. Only records once; the "health" command prints it again.
+ * 
+ * @param data Sensor data that was just drawn
+ */
+void report_time_to_first_reading(const sensor_data_t* data) {
+    if (first_shown_us != 0 || data->temperature <= -100) {
+        return;
+    }
+
+    graphics_wait_for_flush();
+
+    first_shown_us = time_us_64();
+    print_time_to_first_reading();
+}
+
+// What the last replayed frame showed
+static bool replay_drawn = false;
+static view_mode_t replay_drawn_view_mode;
+static sensor_data_t replay_drawn_data;
+
+/**
+ * @brief Draws the display after a replayed sample, using the same
+ * redraw rules as the run-loop.
+ * 
+ * @return bool True if a frame was drawn.
+ */
+bool replay_render(void) {
+    view_mode_t view_mode = get_viewmode();
+    sensor_data_t data = shared_sensor_data;
+
+    if (replay_drawn && !needs_redraw(view_mode, &data, replay_drawn_view_mode,
+                                      &replay_drawn_data, true)) {
+        return false;
+    }
+
+    output_data(view_mode, data);
+
+    replay_drawn = true;
+    replay_drawn_view_mode = view_mode;
+    replay_drawn_data = data;
+
+    return true;
+}
+
 /**
  * @brief Entry point of system. Contains the run-loop.
  *
  */
 int main(void) {
+    // Must happen before anything else uses the stack
+    memory_paint_core0_stack();
+
     // Perform initialization of all components
-    initialize();    
+    initialize();
+
+    if (!TRACE_REPLAY) {
+        wait_for_first_reading(time_us_64());
+    }
+
+    if (TRACE_REPLAY) {
+        trace_replay_run(trace_builtin, trace_builtin_count, publish_record, replay_render, time_us_64);
+    }
 
     /* -- Run Loop -- */
 
-    // Keep track of plant mode index from previous cycle
-    view_mode_t prev_view_mode = SOIL;
+    // Keep track of what is currently on the display
+    view_mode_t drawn_view_mode = get_viewmode();
+    sensor_data_t drawn_sensor_data = shared_sensor_data;
+
+    output_data(drawn_view_mode, drawn_sensor_data);
+    report_time_to_first_reading(&drawn_sensor_data);
+    prerender_next_view(drawn_sensor_data);
+
+    // Alerts firing when the view was last drawn
+    uint32_t shown_alerts = 0;
+
+    // In low-power mode the display is turned off after a while
+    bool display_on = true;
+    int display_timer = power_low_power_enabled()
+        ? event_timer_start(DISPLAY_AWAKE_MS, false, TIMER_DISPLAY_OFF)
+        : -1;
+
     while (1) {
-        // Get the current active plant mode and the plant data
-        // parameters associated with that mode.
+        // Sleep until the button is pressed, a new sample
+        // arrives or a timer expires.
+        event_t event;
+        event_wait(&event);
+
+        // Commands are only checked when something else wakes Core0
+        usb_command_poll();
+
+        if (event.type == EVENT_SAMPLE && event.data % XIP_REPORT_INTERVAL == 0) {
+            xip_stats_report("sampling");
+        }
+
+        if (event.type == EVENT_SAMPLE && event.data % MEMORY_REPORT_INTERVAL == 0) {
+            memory_report();
+        }
+
+        if (event.type == EVENT_SAMPLE && event.data % ANALYTICS_REPORT_INTERVAL == 0) {
+            analytics_report();
+        }
+
+        if (event.type == EVENT_TIMER) {
+            if (event.data == TIMER_EPOCH) {
+                power_start_epoch();
+            } else if (event.data == TIMER_DISPLAY_OFF) {
+                graphics_set_power(false);
+                display_on = false;
+                display_timer = -1;
+                update_view_demand(get_viewmode(), false);
+                power_report();
+            }
+            continue;
+        }
+
+        uint64_t press_us = 0;
+        bool force_redraw = false;
+
+        // A change in alerts redraws the view, and a new alert wakes
+        // the display like a button press
+        uint32_t alerts = alerts_firing_mask();
+        bool alert_fired = (alerts & ~shown_alerts) != 0;
+
+        if (alerts != shown_alerts) {
+            prerendered_valid = false;
+            force_redraw = true;
+        }
+
+        if (event.type == EVENT_BUTTON && handle_input(&press_us)) {
+            // The pre-rendered frame shows the old resolution
+            prerendered_valid = false;
+            force_redraw = true;
+        }
+
+        // Any button press keeps the display on for a while longer
+        if ((event.type == EVENT_BUTTON || alert_fired) && power_low_power_enabled()) {
+            if (!display_on) {
+                graphics_set_power(true);
+                display_on = true;
+            }
+
+            event_timer_cancel(display_timer);
+            display_timer = event_timer_start(DISPLAY_AWAKE_MS, false, TIMER_DISPLAY_OFF);
+        }
+
+        // A view switch changes which sensors are sampled at once
+        update_view_demand(get_viewmode(), display_on);
+
+        // Nothing to draw while the display is off
+        if (!display_on) {
+            continue;
+        }
+
+        // Get the current active view mode and a local
+        // copy of the shared sensor data onto the stack.
         view_mode_t view_mode = get_viewmode();
-        
-        // Output data
-        output_data(view_mode);
+        sensor_data_t local_sensor_data = shared_sensor_data;
+
+        // Only redraw if something on the display has changed
+        if (force_redraw || needs_redraw(view_mode, &local_sensor_data, drawn_view_mode,
+                                         &drawn_sensor_data, event.type == EVENT_SAMPLE)) {
+            bool pressed = press_us != 0;
+            bool prerendered = pressed && show_prerendered_view(view_mode, &local_sensor_data);
+
+            if (!prerendered) {
+                output_data(view_mode, local_sensor_data);
+            }
+
+            if (pressed) {
+                report_button_latency(prerendered, press_us);
+            }
+
+            report_time_to_first_reading(&local_sensor_data);
 
-        // Delay for 0.5s or until mode switch button is pressed
-        delay_until_alarm_or_modeswitch(prev_view_mode);
+            drawn_view_mode = view_mode;
+            drawn_sensor_data = local_sensor_data;
+            shown_alerts = alerts;
+        } else if (event.type != EVENT_SAMPLE) {
+            continue;
+        }
 
-        // Update the previous mode index
-        prev_view_mode = view_mode;
+        // Keep the next view ready with the latest data
+        prerender_next_view(local_sensor_data);
     }
 
     /* -- End Run Loop -- */
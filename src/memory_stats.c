@@ -0,0 +1,143 @@
+/*
+
+RAM usage: stack high-water marks and static allocation.
+
+Each core's stack is filled with a known pattern before it is used.
+The deepest word which no longer holds the pattern is as far as the
+stack has ever grown, which can be read at any time from either core.
+
+Core0 runs on the stack set up by the SDK in scratch Y. Its stack is
+painted at the start of main(), from the bottom up to just below the
+current stack pointer. Core1 is launched on a stack given to it by
+main.c, which is painted before launch.
+
+The sizes of initialized data, bss and the heap come from the symbols
+the linker script places around them.
+
+*/
+
+#include "memory_stats.h"
+#include <stdio.h>
+#include <malloc.h>
+
+#define _PAINT 0xC0DEF00Du
+
+// Words left unpainted below the stack pointer when painting core0,
+// for the call frames of the painting itself
+#define _CORE0_PAINT_MARGIN 32
+
+// Symbols defined by the SDK's linker script
+extern uint32_t __StackBottom;
+extern uint32_t __StackTop;
+extern char __data_start__, __data_end__;
+extern char __bss_start__, __bss_end__;
+
+static uint32_t* _stack_bottom[2] = {NULL, NULL};
+static uint32_t _stack_words[2] = {0, 0};
+
+/**
+ * @brief Fills a range of words with the paint pattern.
+ *
+ * @param from First word to paint
+ * @param to Word after the last to paint
+ */
+void _paint(uint32_t* from, uint32_t* to) {
+    for (volatile uint32_t* word = from; word < to; word++) {
+        *word = _PAINT;
+    }
+}
+
+/**
+ * @brief Paints the unused part of core0's stack. Must be called by
+ * core0 first thing in main(), before interrupts are enabled.
+ *
+ */
+void memory_paint_core0_stack(void) {
+    uint32_t marker;
+    uint32_t* top = &marker - _CORE0_PAINT_MARGIN;
+
+    _stack_bottom[0] = &__StackBottom;
+    _stack_words[0] = &__StackTop - &__StackBottom;
+
+    if (top > &__StackBottom) {
+        _paint(&__StackBottom, top);
+    }
+}
+
+/**
+ * @brief Paints a stack which has not been used yet and tracks it as
+ * the stack of the given core.
+ *
+ * @param core Core which will run on the stack
+ * @param bottom Lowest address of the stack
+ * @param size_bytes Size of the stack
+ */
+void memory_paint_stack(uint core, uint32_t* bottom, uint32_t size_bytes) {
+    _stack_bottom[core] = bottom;
+    _stack_words[core] = size_bytes / sizeof(uint32_t);
+
+    _paint(bottom, bottom + _stack_words[core]);
+}
+
+/**
+ * @brief Gets the most stack a core has used so far.
+ *
+ * @param core Core to check
+ * @return uint32_t Bytes used, or 0 if the stack was not painted.
+ */
+uint32_t memory_stack_high_water(uint core) {
+    const volatile uint32_t* bottom = _stack_bottom[core];
+
+    if (!bottom) {
+        return 0;
+    }
+
+    // Stacks grow down, so untouched words are at the bottom
+    uint32_t untouched = 0;
+
+    while (untouched < _stack_words[core] && bottom[untouched] == _PAINT) {
+        untouched++;
+    }
+
+    return (_stack_words[core] - untouched) * sizeof(uint32_t);
+}
+
+/**
+ * @brief Gets the current RAM usage.
+ *
+ * @param stats Set to the usage
+ */
+void memory_get_stats(memory_stats_t* stats) {
+    for (uint core = 0; core < 2; core++) {
+        stats->stack_size[core] = _stack_words[core] * sizeof(uint32_t);
+        stats->stack_used[core] = memory_stack_high_water(core);
+    }
+
+    stats->data_bytes = &__data_end__ - &__data_start__;
+    stats->bss_bytes = &__bss_end__ - &__bss_start__;
+    stats->heap_bytes = mallinfo().arena;
+}
+
+/**
+ * @brief Prints the RAM usage over USB.
+ *
+ */
+void memory_report(void) {
+    memory_stats_t stats;
+    memory_get_stats(&stats);
+
+    for (uint core = 0; core < 2; core++) {
+        printf("(MEMORY) core%u stack %lu / %lu bytes\n", core,
+               (unsigned long)stats.stack_used[core],
+               (unsigned long)stats.stack_size[core]);
+    }
+
+    uint32_t used = stats.data_bytes + stats.bss_bytes + stats.heap_bytes;
+
+    printf("(MEMORY) data %lu, bss %lu, heap %lu, %lu / %lu bytes of SRAM\n",
+           (unsigned long)stats.data_bytes,
+           (unsigned long)stats.bss_bytes,
+           (unsigned long)stats.heap_bytes,
+           (unsigned long)used,
+           (unsigned long)MEMORY_SRAM_BYTES);
+}
@@ -0,0 +1,177 @@
+/*
+
+Emulator of the PCD8544 controller used by the NOKIA 5110 LCD.
+
+It takes the same command and data bytes sent to the LCD and rebuilds
+the 84x48 image the panel would show. Horizontal and vertical
+addressing, X/Y address commands, both instruction sets, display
+control and power-down are covered, which is everything lcd.c uses.
+
+Commands and data bytes are counted so the cost of each frame can be
+measured alongside its image.
+
+*/
+
+#include "pcd8544_emu.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Puts the emulator in the controller's reset state.
+ * 
+ * @param emu Emulator to reset
+ */
+void pcd8544_emu_reset(pcd8544_emu_t* emu) {
+    memset(emu->ram, 0, sizeof(emu->ram));
+    emu->x = 0;
+    emu->y = 0;
+    emu->extended = false;
+    emu->vertical = false;
+    emu->powered_down = true;
+    emu->display = PCD8544_BLANK;
+    emu->vop = 0;
+    pcd8544_emu_frame_reset(emu);
+}
+
+/**
+ * @brief Runs one command byte (D/C low).
+ * 
+ * @param emu Emulator
+ * @param cmd Command byte
+ */
+void pcd8544_emu_command(pcd8544_emu_t* emu, uint8_t cmd) {
+    emu->commands++;
+
+    // Function set is shared by both instruction sets
+    if ((cmd & 0xF8) == 0x20) {
+        emu->powered_down = cmd & 0x04;
+        emu->vertical = cmd & 0x02;
+        emu->extended = cmd & 0x01;
+        return;
+    }
+
+    if (emu->extended) {
+        // Temperature control (0x04) and bias (0x10) do not change the image
+        if (cmd & 0x80) {
+            emu->vop = cmd & 0x7F;
+        }
+        return;
+    }
+
+    if (cmd & 0x80) {
+        emu->x = MIN(cmd & 0x7F, PCD8544_WIDTH - 1);
+    } else if ((cmd & 0xF8) == 0x40) {
+        emu->y = MIN(cmd & 0x07, PCD8544_BANKS - 1);
+    } else if ((cmd & 0xFA) == 0x08) {
+        bool d = cmd & 0x04;
+        bool e = cmd & 0x01;
+
+        emu->display = d ? (e ? PCD8544_INVERSE : PCD8544_NORMAL)
+                         : (e ? PCD8544_ALL_ON : PCD8544_BLANK);
+    }
+}
+
+/**
+ * @brief Writes data bytes (D/C high) to display RAM, moving the
+ * address as the controller does.
+ * 
+ * @param emu Emulator
+ * @param data Bytes written
+ * @param len Number of bytes
+ */
+void pcd8544_emu_data(pcd8544_emu_t* emu, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        emu->ram[emu->y][emu->x] = data[i];
+        emu->data_bytes++;
+
+        if (emu->vertical) {
+            if (++emu->y >= PCD8544_BANKS) {
+                emu->y = 0;
+                emu->x = (emu->x + 1) % PCD8544_WIDTH;
+            }
+        } else {
+            if (++emu->x >= PCD8544_WIDTH) {
+                emu->x = 0;
+                emu->y = (emu->y + 1) % PCD8544_BANKS;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Starts counting commands and data bytes for a new frame.
+ * 
+ * @param emu Emulator
+ */
+void pcd8544_emu_frame_reset(pcd8544_emu_t* emu) {
+    emu->commands = 0;
+    emu->data_bytes = 0;
+}
+
+/**
+ * @brief Gets whether a pixel would be dark on the panel.
+ * 
+ * @param emu Emulator
+ * @param x Pixel column
+ * @param y Pixel row
+ * @return bool True if the pixel is dark.
+ */
+bool pcd8544_emu_pixel(const pcd8544_emu_t* emu, uint8_t x, uint8_t y) {
+    if (emu->powered_down || emu->display == PCD8544_BLANK) {
+        return false;
+    }
+
+    if (emu->display == PCD8544_ALL_ON) {
+        return true;
+    }
+
+    bool set = emu->ram[y / 8][x] & (1u << (y % 8));
+
+    return (emu->display == PCD8544_INVERSE) ? !set : set;
+}
+
+/**
+ * @brief Computes a checksum of the shown image, used to compare
+ * frames against golden images.
+ * 
+ * @param emu Emulator
+ * @return uint32_t FNV-1a hash of the image, one bit per pixel
+ */
+uint32_t pcd8544_emu_checksum(const pcd8544_emu_t* emu) {
+    uint32_t hash = 2166136261u;
+
+    for (uint8_t y = 0; y < PCD8544_HEIGHT; y++) {
+        for (uint8_t x = 0; x < PCD8544_WIDTH; x += 8) {
+            uint8_t bits = 0;
+
+            for (uint8_t b = 0; b < 8 && x + b < PCD8544_WIDTH; b++) {
+                bits |= pcd8544_emu_pixel(emu, x + b, y) << b;
+            }
+
+            hash = (hash ^ bits) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Prints the shown image over USB as a plain PBM file
+ * between BEGIN/END lines, so it can be cut from the log.
+ * 
+ * @param emu Emulator
+ * @param name Name printed with the image
+ */
+void pcd8544_emu_print_pbm(const pcd8544_emu_t* emu, const char* name) {
+    printf("(EMU) BEGIN %s.pbm\n", name);
+    printf("P1\n%d %d\n", PCD8544_WIDTH, PCD8544_HEIGHT);
+
+    for (uint8_t y = 0; y < PCD8544_HEIGHT; y++) {
+        for (uint8_t x = 0; x < PCD8544_WIDTH; x++) {
+            putchar(pcd8544_emu_pixel(emu, x, y) ? '1' : '0');
+        }
+        putchar('\n');
+    }
+
+    printf("(EMU) END %s.pbm\n", name);
+}
@@ -0,0 +1,165 @@
+/*
+
+Low-power logging mode.
+
+While enabled, core1 only samples when core0 starts an epoch and is
+parked in between. Core0 puts the chip into sleep between events with
+only the timer (next epoch or display timeout) and the IO bank (mode
+button) left clocked, so either of them wakes the system immediately.
+Peripheral registers are retained while asleep, so SPI and PIO carry on
+without being re-initialized on wake.
+
+The time spent asleep is measured to estimate the average supply
+current and project battery life.
+
+*/
+
+#include "power.h"
+#include <stdio.h>
+#include "pico/multicore.h"
+#include "pico/stdio_usb.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/scb.h"
+#include "event_loop.h"
+
+static volatile bool _low_power = false;
+
+// Accounting for the awake-time fraction
+static uint64_t _stats_start_us = 0;
+static volatile uint64_t _asleep_us = 0;
+
+/**
+ * @brief Idle handler for the event loop while in low-power mode.
+ * Called with interrupts disabled.
+ *
+ */
+void _power_idle(void) {
+    // USB needs its clocks while a host is attached
+    if (stdio_usb_connected()) {
+        __wfi();
+        return;
+    }
+
+    uint32_t sleep_en0 = clocks_hw->sleep_en0;
+    uint32_t sleep_en1 = clocks_hw->sleep_en1;
+
+    // Only keep what is needed to wake up again:
+    // the timer for alarms and the IO bank for the mode button.
+    clocks_hw->sleep_en0 = CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS;
+    clocks_hw->sleep_en1 = CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS;
+
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+
+    uint64_t start = time_us_64();
+    __wfi();
+    _asleep_us += time_us_64() - start;
+
+    scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+
+    clocks_hw->sleep_en0 = sleep_en0;
+    clocks_hw->sleep_en1 = sleep_en1;
+}
+
+/**
+ * @brief Resets the power accounting.
+ *
+ */
+void power_init(void) {
+    _stats_start_us = time_us_64();
+    _asleep_us = 0;
+}
+
+/**
+ * @brief Enables or disables low-power logging mode. Must be called
+ * from core0.
+ *
+ * @param enabled True to enable low-power mode
+ */
+void power_set_low_power(bool enabled) {
+    bool was_enabled = _low_power;
+
+    _low_power = enabled;
+
+    event_set_idle_handler(enabled ? _power_idle : NULL);
+
+    // Release core1 if it is parked waiting for an epoch
+    if (was_enabled && !enabled) {
+        power_start_epoch();
+    }
+}
+
+/**
+ * @brief Checks whether low-power logging mode is enabled.
+ *
+ * @return bool True if enabled
+ */
+bool power_low_power_enabled(void) {
+    return _low_power;
+}
+
+/**
+ * @brief Lets a parked core1 take one round of samples.
+ * Called from core0.
+ *
+ */
+void power_start_epoch(void) {
+    // If the FIFO is full, core1 already has epochs pending
+    if (multicore_fifo_wready()) {
+        multicore_fifo_push_blocking(1);
+    }
+}
+
+/**
+ * @brief Parks core1 until core0 starts the next epoch. Core1 is
+ * marked as deep-sleeping so the system can sleep while it waits.
+ * Called from core1.
+ *
+ */
+void power_core1_wait_for_epoch(void) {
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+
+    multicore_fifo_pop_blocking();
+
+    scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+}
+
+/**
+ * @brief Gets the measured awake-time fraction and the estimates
+ * derived from it.
+ *
+ * @param stats Set to the current statistics
+ */
+void power_get_stats(power_stats_t* stats) {
+    uint32_t status = save_and_disable_interrupts();
+    stats->elapsed_us = time_us_64() - _stats_start_us;
+    stats->asleep_us = _asleep_us;
+    restore_interrupts(status);
+
+    if (stats->elapsed_us == 0) {
+        stats->elapsed_us = 1;
+    }
+
+    stats->awake_permille = 1000 - (stats->asleep_us * 1000) / stats->elapsed_us;
+
+    stats->estimated_ua = ((uint64_t)POWER_ACTIVE_UA * stats->awake_permille
+                         + (uint64_t)POWER_SLEEP_UA * (1000 - stats->awake_permille)) / 1000;
+
+    stats->battery_hours = ((uint64_t)POWER_BATTERY_MAH * 1000) / stats->estimated_ua;
+}
+
+/**
+ * @brief Prints the power statistics over USB.
+ *
+ */
+void power_report(void) {
+    power_stats_t stats;
+    power_get_stats(&stats);
+
+    printf("(POWER) awake %lu.%lu%%, ~%lu uA, ~%lu h on %u mAh\n",
+           (unsigned long)stats.awake_permille / 10,
+           (unsigned long)stats.awake_permille % 10,
+           (unsigned long)stats.estimated_ua,
+           (unsigned long)stats.battery_hours,
+           POWER_BATTERY_MAH);
+}
@@ -0,0 +1,134 @@
+/*
+
+Render self-test for the LCD views.
+
+Each view is drawn with fixed readings while an emulated PCD8544 is
+fed every byte sent to the LCD. The emulated image is compared with
+the display buffer, and the commands and data bytes sent for the
+frame are printed along with the time taken to draw it. A frame which
+does not match is printed as a PBM image.
+
+The same cases are drawn by the host test test_render, which checks
+each image against a golden PBM in test/golden/. Rendering changes in
+lcd.c or graphics.c can then be checked for the same output there,
+and for their SPI savings on the board.
+
+*/
+
+#include "render_test.h"
+#include <stdio.h>
+#include "lcd.h"
+#include "graphics.h"
+#include "pcd8544_emu.h"
+
+void _draw_loading(void) {
+    show_loading_view();
+}
+
+void _draw_error(void) {
+    show_critical_error_view();
+}
+
+void _draw_dual(void) {
+    show_dual_view(600 * HISTORY_MOISTURE_SCALE, 400, 25);
+}
+
+void _draw_dual_full(void) {
+    show_dual_view(2000 * HISTORY_MOISTURE_SCALE, 65534, -20);
+}
+
+void _draw_dual_fault(void) {
+    show_dual_view(GRAPHICS_NO_READING, 400, GRAPHICS_NO_TEMPERATURE);
+}
+
+void _draw_soil(void) {
+    show_soil_view(1500 * HISTORY_MOISTURE_SCALE, 22);
+}
+
+void _draw_light(void) {
+    show_light_view(3000, 30);
+}
+
+void _draw_light_dark(void) {
+    show_light_view(0, 5);
+}
+
+void _draw_dli(void) {
+    show_dli_view(&(analytics_t){.dli_today_x100 = 1234, .dli_yesterday_x100 = 2871,
+                                 .yesterday_valid = true}, 24);
+}
+
+// Values too large for their fields are clamped to fit the line
+void _draw_dry_down_clamped(void) {
+    show_dry_down_view(&(analytics_t){.drying = true, .dry_rate_x10 = 1234567,
+                                      .hours_to_dry = 123456}, -120);
+}
+
+const render_case_t render_cases[] = {
+    {"loading", _draw_loading},
+    {"error", _draw_error},
+    {"dual", _draw_dual},
+    {"dual_full", _draw_dual_full},
+    {"dual_fault", _draw_dual_fault},
+    {"soil", _draw_soil},
+    {"light", _draw_light},
+    {"light_dark", _draw_light_dark},
+    {"dli", _draw_dli},
+    {"dry_clamped", _draw_dry_down_clamped},
+};
+
+const int render_case_count = sizeof(render_cases) / sizeof(render_cases[0]);
+
+static pcd8544_emu_t _emu;
+
+/**
+ * @brief Draws every test view and checks that the emulated panel
+ * shows what is in the display buffer. Results are printed over USB.
+ * The LCD shows the last view.
+ *
+ * @return bool True if every view matched.
+ */
+bool render_test_run(void) {
+    int failures = 0;
+    uint32_t total_commands = 0;
+    uint32_t total_bytes = 0;
+
+    // Start from a blank panel so frame costs do not depend on
+    // what was shown before
+    clear_current_view();
+    lcd_attach_emulator(&_emu);
+
+    for (int i = 0; i < render_case_count; i++) {
+        pcd8544_emu_frame_reset(&_emu);
+
+        uint64_t start_us = time_us_64();
+        render_cases[i].draw();
+        uint32_t draw_us = time_us_64() - start_us;
+
+        uint32_t checksum = pcd8544_emu_checksum(&_emu);
+        bool ok = lcd_emulator_matches_buffer(&_emu);
+
+        printf("(RENDER) %-10s %s sum=%08lx cmds=%lu bytes=%lu us=%lu%s\n",
+               render_cases[i].name, ok ? "PASS" : "FAIL",
+               (unsigned long)checksum,
+               (unsigned long)_emu.commands, (unsigned long)_emu.data_bytes,
+               (unsigned long)draw_us,
+               ok ? "" : " (panel differs from buffer)");
+
+        if (!ok) {
+            pcd8544_emu_print_pbm(&_emu, render_cases[i].name);
+            failures++;
+        }
+
+        total_commands += _emu.commands;
+        total_bytes += _emu.data_bytes;
+    }
+
+    lcd_attach_emulator(NULL);
+
+    printf("(RENDER) %d/%d passed, %lu cmds, %lu bytes\n",
+           render_case_count - failures, render_case_count,
+           (unsigned long)total_commands, (unsigned long)total_bytes);
+
+    return failures == 0;
+}
@@ -0,0 +1,103 @@
+/*
+
+Framed sample records for host-side collectors.
+
+Every sample is printed over USB as one line holding the raw bytes of
+each sensor and a checksum, in the format described in sample_frame.h.
+The line is built in a buffer and handed to stdio in a single call,
+so output from Core0 can never land inside it, and a collector can
+drop any line that was damaged or cut short instead of misreading it.
+
+Raw bytes decode the same way the firmware decodes them, including
+the bursts of oversampled sensors, so a collector keeps the full
+resolution of every sample.
+
+*/
+
+#include "sample_frame.h"
+#include <stdio.h>
+
+static const char _HEX[] = "0123456789abcdef";
+
+/**
+ * @brief Computes the CRC-16/CCITT-FALSE of some text.
+ *
+ * @param text Text to check
+ * @param len Length of the text
+ * @return uint16_t CRC of the text
+ */
+uint16_t sample_frame_crc(const char* text, size_t len) {
+    uint16_t crc = 0xFFFF;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(uint8_t)text[i] << 8;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Writes a byte as two hex digits.
+ *
+ * @param out Where to write
+ * @param byte Byte to write
+ * @return char* Just past the digits
+ */
+char* _put_hex(char* out, uint8_t byte) {
+    out[0] = _HEX[byte >> 4];
+    out[1] = _HEX[byte & 0xF];
+
+    return out + 2;
+}
+
+/**
+ * @brief Formats a sample as a frame, ending in a newline.
+ *
+ * @param record Sample to format
+ * @param out Set to the frame
+ * @return size_t Length of the frame, not counting the terminating zero
+ */
+size_t sample_frame_format(const sensor_record_t* record, char out[SAMPLE_FRAME_MAX_LEN]) {
+    char* body = out + sizeof(SAMPLE_FRAME_TAG) - 1;
+    uint8_t count = MIN(record->count, SENSOR_MAX);
+
+    int len = snprintf(out, SAMPLE_FRAME_MAX_LEN, SAMPLE_FRAME_TAG "%lu,%lu,",
+                       (unsigned long)record->sequence, (unsigned long)record->timestamp_ms);
+    char* pos = _put_hex(out + len, record->valid_mask);
+
+    for (int i = 0; i < count; i++) {
+        *pos++ = ',';
+
+        for (int b = 0; b < SENSOR_RAW_MAX; b++) {
+            pos = _put_hex(pos, record->raw[i][b]);
+        }
+    }
+
+    uint16_t crc = sample_frame_crc(body, pos - body);
+
+    *pos++ = '*';
+    pos = _put_hex(pos, crc >> 8);
+    pos = _put_hex(pos, crc);
+    *pos++ = '\n';
+    *pos = '\0';
+
+    return pos - out;
+}
+
+/**
+ * @brief Prints a sample as a frame over USB.
+ *
+ * @param record Sample to print
+ */
+void sample_frame_print(const sensor_record_t* record) {
+    char frame[SAMPLE_FRAME_MAX_LEN];
+
+    sample_frame_format(record, frame);
+
+    // A single printf, which the SDK's stdio holds its lock across
+    printf("%s", frame);
+}
@@ -0,0 +1,989 @@
+/*
+
+Sensor registry and sampling engine.
+
+Drivers register a sensor_driver_t along with their own state. Each
+sample starts a conversion on every sensor, waits only as long as the
+slowest conversion, and then collects each sensor as soon as its
+conversion is done. I2C transfers of all sensors that are due at the
+same time run together on both I2C controllers.
+
+A sensor can be oversampled: it then takes a burst of short reads
+per sample, each started as soon as the previous one is collected.
+The burst is decimated by summing 4^n reads and shifting right by n,
+which leaves n more bits than a single read. Each sample holds both
+the value rounded back to the driver's units and a fine value with
+SENSOR_FRACTION_BITS fraction bits, which keeps the extra bits for
+the views and the history. The noise report uses them as well.
+
+Consumers (the active view, the logger, alert rules and telemetry)
+say how often they need each sensor. A sample only includes sensors
+which are due at their most demanding consumer's interval, and the
+sampler sleeps while none are. A change in demand wakes the sampler,
+and a sensor which became due in the middle of a sample is started
+at once, so the change shows within one conversion time.
+
+Each sensor has a health state. A sensor which fails SENSOR_FAULT_AFTER
+samples in a row is faulted, so its last value is no longer shown as
+current. A sensor which fails to initialize starts out faulted. Failed
+sensors, and the init of sensors which failed it, are retried every
+SENSOR_FAULT_RETRY_MS, and the time from the first failure until the
+sensor reads again is reported as its recovery time.
+
+*/
+
+#include "sensor.h"
+#include <stdio.h>
+#include <string.h>
+#include "hardware/sync.h"
+
+// Where an oversampled sensor's burst is kept in its raw bytes. Only
+// sensors which can be oversampled have this layout.
+#define _RAW_SUM_BYTE 2     // Sum of the burst, big-endian
+#define _RAW_SHIFT_BYTE 6   // n of the 4^n reads, 0 if not oversampled
+
+// Noise of a sensor, from the squared differences of successive reads
+typedef struct {
+    uint64_t single_sq;     // Reads within a burst
+    uint32_t single_count;
+    uint64_t decimated_sq;  // Decimated values, with their extra bits
+    uint32_t decimated_count;
+    int32_t last_decimated;
+    uint8_t last_shift;     // Extra bits of last_decimated, 0xFF if none
+} _noise_t;
+
+typedef struct {
+    const sensor_driver_t* driver;
+    void* ctx;
+    bool ready;     // init() succeeded
+    uint8_t oversample_shift;   // Reads per sample are 4^shift
+    _noise_t noise;
+    volatile uint32_t demand_ms[SENSOR_CONSUMER_COUNT];
+    absolute_time_t last_start;
+    bool started_once;
+    uint32_t transactions;      // Conversions started and collected
+    volatile sensor_health_t health;
+    uint8_t failures;           // Failed samples in a row
+    absolute_time_t first_failure;
+    uint32_t faults;            // Times the sensor became faulted
+    uint32_t last_recovery_ms;
+    uint32_t max_recovery_ms;
+} _sensor_t;
+
+static _sensor_t _sensors[SENSOR_MAX];
+static uint8_t _sensor_count = 0;
+
+static uint32_t _sequence = 0;
+
+// Changed by every change in demand, so a waiting sampler notices
+static volatile uint32_t _demand_generation = 0;
+
+// Time the sampler slept because no sensor was due, since the last report
+static uint64_t _idle_us = 0;
+static absolute_time_t _window_start;
+
+/**
+ * @brief Adds a sensor to the registry.
+ *
+ * @param driver Driver hooks for the sensor
+ * @param ctx Driver state passed to every hook
+ * @return int Id of the sensor, or -1 if the registry is full.
+ */
+int sensor_register(const sensor_driver_t* driver, void* ctx) {
+    if (_sensor_count >= SENSOR_MAX) {
+        printf("(SENSOR) Registry full, %s not added.\n", driver->name);
+        return -1;
+    }
+
+    _sensors[_sensor_count].driver = driver;
+    _sensors[_sensor_count].ctx = ctx;
+    _sensors[_sensor_count].ready = false;
+    _sensors[_sensor_count].oversample_shift = 0;
+    _sensors[_sensor_count].noise = (_noise_t){.last_shift = 0xFF};
+    _sensors[_sensor_count].started_once = false;
+    _sensors[_sensor_count].transactions = 0;
+    _sensors[_sensor_count].health = SENSOR_HEALTH_OK;
+    _sensors[_sensor_count].failures = 0;
+    _sensors[_sensor_count].faults = 0;
+    _sensors[_sensor_count].last_recovery_ms = 0;
+    _sensors[_sensor_count].max_recovery_ms = 0;
+
+    for (int c = 0; c < SENSOR_CONSUMER_COUNT; c++) {
+        _sensors[_sensor_count].demand_ms[c] = SENSOR_DEMAND_NONE;
+    }
+
+    return _sensor_count++;
+}
+
+/**
+ * @brief Gets the number of registered sensors.
+ *
+ * @return uint8_t Number of sensors
+ */
+uint8_t sensor_count(void) {
+    return _sensor_count;
+}
+
+/**
+ * @brief Gets the name of a registered sensor.
+ *
+ * @param id Sensor id
+ * @return const char* Name of the sensor, or "?" if the id is unknown.
+ */
+const char* sensor_name(int id) {
+    if (id < 0 || id >= _sensor_count) {
+        return "?";
+    }
+
+    return _sensors[id].driver->name;
+}
+
+/**
+ * @brief Initializes every registered sensor. Sensors which fail are
+ * faulted, and left out of sampling until a retry of their init
+ * succeeds.
+ *
+ */
+void sensor_init_all(void) {
+    _window_start = get_absolute_time();
+
+    for (int i = 0; i < _sensor_count; i++) {
+        _sensor_t* s = &_sensors[i];
+
+        s->ready = s->driver->init(s->ctx);
+
+        if (!s->ready) {
+            printf("(SENSOR) %s failed to initialize, retrying every %u ms.\n",
+                   s->driver->name, SENSOR_FAULT_RETRY_MS);
+
+            s->health = SENSOR_HEALTH_FAULT;
+            s->faults++;
+            s->failures = 1;
+            s->first_failure = _window_start;
+            s->last_start = _window_start;
+            s->started_once = true;
+        }
+    }
+}
+
+/**
+ * @brief Gets the decimated value of an oversampled burst, which has
+ * as many extra bits as its shift.
+ *
+ * @param raw Raw bytes of an oversampled sensor
+ * @return int32_t Sum of the burst shifted right by its shift
+ */
+int32_t _decimated_value(const uint8_t raw[SENSOR_RAW_MAX]) {
+    const uint8_t* sum = &raw[_RAW_SUM_BYTE];
+
+    int32_t total = (int32_t)(((uint32_t)sum[0] << 24) | ((uint32_t)sum[1] << 16) |
+                              ((uint32_t)sum[2] << 8) | sum[3]);
+
+    return total >> raw[_RAW_SHIFT_BYTE];
+}
+
+/**
+ * @brief Stores the sum of an oversampled burst in its raw bytes.
+ *
+ * @param raw Raw bytes of the sensor, holding its last read
+ * @param total Sum of every read in the burst
+ * @param shift n of the 4^n reads
+ */
+void _store_burst(uint8_t raw[SENSOR_RAW_MAX], int32_t total, uint8_t shift) {
+    uint8_t* sum = &raw[_RAW_SUM_BYTE];
+
+    sum[0] = (uint32_t)total >> 24;
+    sum[1] = (uint32_t)total >> 16;
+    sum[2] = (uint32_t)total >> 8;
+    sum[3] = (uint32_t)total;
+    raw[_RAW_SHIFT_BYTE] = shift;
+}
+
+/**
+ * @brief Gets the shift of the burst kept in a sensor's raw bytes. The
+ * raw bytes of a sensor which cannot be oversampled are all its
+ * driver's to use, so it never has one.
+ *
+ * @param s Sensor the raw bytes were collected from
+ * @param raw Raw bytes of the sensor
+ * @return uint8_t n of the 4^n reads, 0 if not oversampled
+ */
+uint8_t _burst_shift(const _sensor_t* s, const uint8_t raw[SENSOR_RAW_MAX]) {
+    return s->driver->set_burst_mode ? raw[_RAW_SHIFT_BYTE] : 0;
+}
+
+/**
+ * @brief Decodes raw bytes with the driver of a registered sensor.
+ *
+ * @param id Sensor id
+ * @param raw Raw bytes collected from the sensor
+ * @return int32_t Decoded value, or 0 if the id is unknown.
+ */
+int32_t sensor_decode(int id, const uint8_t raw[SENSOR_RAW_MAX]) {
+    if (id < 0 || id >= _sensor_count) {
+        return 0;
+    }
+
+    uint8_t shift = _burst_shift(&_sensors[id], raw);
+
+    if (shift == 0) {
+        return _sensors[id].driver->decode(_sensors[id].ctx, raw);
+    }
+
+    // Round the decimated value back to the driver's units
+    return (_decimated_value(raw) + (1 << (shift - 1))) >> shift;
+}
+
+/**
+ * @brief Decodes raw bytes with the driver of a registered sensor,
+ * keeping the extra bits of an oversampled burst.
+ *
+ * @param id Sensor id
+ * @param raw Raw bytes collected from the sensor
+ * @return int32_t Decoded value with SENSOR_FRACTION_BITS fraction
+ * bits, or 0 if the id is unknown.
+ */
+int32_t sensor_decode_fine(int id, const uint8_t raw[SENSOR_RAW_MAX]) {
+    if (id < 0 || id >= _sensor_count) {
+        return 0;
+    }
+
+    uint8_t shift = _burst_shift(&_sensors[id], raw);
+
+    if (shift == 0) {
+        return _sensors[id].driver->decode(_sensors[id].ctx, raw) * (1 << SENSOR_FRACTION_BITS);
+    }
+
+    return _decimated_value(raw) * (1 << (SENSOR_FRACTION_BITS - shift));
+}
+
+/**
+ * @brief Sets how many reads a sensor takes per sample. More than one
+ * read switches the sensor to short conversions.
+ *
+ * @param id Sensor id
+ * @param reads 1, 4, 16 or 64 reads
+ * @return bool False if the sensor cannot be oversampled that much
+ * within SENSOR_BURST_BUDGET_MS.
+ */
+bool sensor_set_oversampling(int id, uint8_t reads) {
+    if (id < 0 || id >= _sensor_count) {
+        return false;
+    }
+
+    _sensor_t* s = &_sensors[id];
+    uint8_t shift = 0;
+
+    while ((1u << (2 * shift)) < reads) {
+        shift++;
+    }
+
+    if ((1u << (2 * shift)) != reads || reads > SENSOR_OVERSAMPLE_MAX) {
+        printf("(SENSOR) %s: %u reads is not a power of 4.\n", s->driver->name, reads);
+        return false;
+    }
+
+    if (!s->driver->set_burst_mode) {
+        if (reads == 1) {
+            return true;
+        }
+
+        printf("(SENSOR) %s cannot be oversampled.\n", s->driver->name);
+        return false;
+    }
+
+    s->driver->set_burst_mode(s->ctx, reads > 1);
+
+    uint32_t burst_ms = reads * s->driver->conversion_time_ms(s->ctx);
+
+    if (burst_ms > SENSOR_BURST_BUDGET_MS) {
+        printf("(SENSOR) %s: %u reads take %lu ms, over the %u ms budget.\n",
+               s->driver->name, reads, (unsigned long)burst_ms, SENSOR_BURST_BUDGET_MS);
+
+        s->driver->set_burst_mode(s->ctx, s->oversample_shift > 0);
+        return false;
+    }
+
+    s->oversample_shift = shift;
+    s->noise = (_noise_t){.last_shift = 0xFF};
+
+    return true;
+}
+
+/**
+ * @brief Runs the I2C jobs which were set up, and marks sensors whose
+ * job failed.
+ *
+ * @param jobs One job per sensor. Jobs without a bus are skipped.
+ * @param ok Per sensor success flag, cleared if its job failed
+ */
+void _run_jobs(i2c_job_t jobs[], bool ok[]) {
+    i2c_job_t batch[SENSOR_MAX];
+    uint8_t owner[SENSOR_MAX];
+    int count = 0;
+
+    for (int i = 0; i < _sensor_count; i++) {
+        if (ok[i] && jobs[i].i2c) {
+            batch[count] = jobs[i];
+            owner[count] = i;
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    i2c_sched_run(batch, count);
+
+    for (int j = 0; j < count; j++) {
+        if (batch[j].result < 0) {
+            ok[owner[j]] = false;
+        }
+    }
+}
+
+/**
+ * @brief Sets how often a consumer needs a sensor. Takes effect
+ * within one conversion time, even in the middle of a sample.
+ *
+ * @param id Sensor id
+ * @param consumer Consumer setting its demand
+ * @param interval_ms Longest time between samples, SENSOR_DEMAND_NONE
+ * or SENSOR_DEMAND_CONTINUOUS
+ */
+void sensor_set_demand(int id, sensor_consumer_t consumer, uint32_t interval_ms) {
+    if (id < 0 || id >= _sensor_count || consumer >= SENSOR_CONSUMER_COUNT) {
+        return;
+    }
+
+    if (_sensors[id].demand_ms[consumer] == interval_ms) {
+        return;
+    }
+
+    _sensors[id].demand_ms[consumer] = interval_ms;
+    _demand_generation++;
+
+    // Wake the sampler if it is waiting
+    __sev();
+}
+
+/**
+ * @brief Gets how often a sensor is sampled: the interval of its most
+ * demanding consumer, or SENSOR_KEEPALIVE_MS if no consumer needs it.
+ *
+ * @param id Sensor id
+ * @return uint32_t Interval in ms
+ */
+uint32_t sensor_interval_ms(int id) {
+    if (id < 0 || id >= _sensor_count) {
+        return SENSOR_KEEPALIVE_MS;
+    }
+
+    uint32_t interval_ms = SENSOR_KEEPALIVE_MS;
+
+    for (int c = 0; c < SENSOR_CONSUMER_COUNT; c++) {
+        uint32_t demand_ms = _sensors[id].demand_ms[c];
+
+        if (demand_ms != SENSOR_DEMAND_NONE) {
+            interval_ms = MIN(interval_ms, demand_ms);
+        }
+    }
+
+    return interval_ms;
+}
+
+/**
+ * @brief Gets when a sensor is next due. A sensor is due a little
+ * early so that samples which start slightly late do not skip it.
+ * A sensor whose last sample failed is due again within
+ * SENSOR_FAULT_RETRY_MS, and one which failed to initialize is due
+ * for another try SENSOR_FAULT_RETRY_MS after the last.
+ *
+ * @param id Sensor id
+ * @return absolute_time_t Time the sensor is due
+ */
+absolute_time_t _next_due(int id) {
+    _sensor_t* s = &_sensors[id];
+
+    if (!s->started_once) {
+        return nil_time;
+    }
+
+    if (!s->ready) {
+        return delayed_by_ms(s->last_start, SENSOR_FAULT_RETRY_MS);
+    }
+
+    uint32_t interval_ms = sensor_interval_ms(id);
+
+    if (s->failures > 0) {
+        interval_ms = MIN(interval_ms, SENSOR_FAULT_RETRY_MS);
+    }
+
+    return delayed_by_ms(s->last_start, interval_ms - interval_ms / 8);
+}
+
+/**
+ * @brief Checks whether a sensor should be included in a sample
+ * starting now. A sensor which failed to initialize is due when its
+ * init should be tried again.
+ *
+ * @param id Sensor id
+ * @param now Current time
+ * @return bool True if the sensor is due.
+ */
+bool _is_due(int id, absolute_time_t now) {
+    return absolute_time_diff_us(_next_due(id), now) >= 0;
+}
+
+/**
+ * @brief Tries the init of a sensor which failed it again. The
+ * recovery time is reported once the sensor reads.
+ *
+ * @param id Sensor id
+ * @param now Current time
+ * @return bool True if the sensor is initialized.
+ */
+bool _retry_init(int id, absolute_time_t now) {
+    _sensor_t* s = &_sensors[id];
+
+    if (s->ready) {
+        return true;
+    }
+
+    s->ready = s->driver->init(s->ctx);
+
+    if (!s->ready) {
+        s->last_start = now;
+        return false;
+    }
+
+    printf("(SENSOR) %s initialized after %lu ms.\n", s->driver->name,
+           (unsigned long)(absolute_time_diff_us(s->first_failure, now) / 1000));
+
+    return true;
+}
+
+/**
+ * @brief Sleeps until a time or until a consumer changes its demand.
+ *
+ * @param until Time to wake
+ * @param generation Demand generation last seen, updated on a change
+ * @return bool True if the demand changed.
+ */
+bool _wait_or_demand(absolute_time_t until, uint32_t* generation) {
+    while (*generation == _demand_generation) {
+        if (best_effort_wfe_or_timeout(until)) {
+            return false;
+        }
+    }
+
+    *generation = _demand_generation;
+
+    return true;
+}
+
+/**
+ * @brief Sleeps until a sensor is due or the demand changes. Called
+ * by the sampler between samples.
+ *
+ * @param timeout_ms Longest time to sleep
+ * @return bool True if a sensor is due, false on timeout.
+ */
+bool sensor_wait_until_due(uint32_t timeout_ms) {
+    absolute_time_t start = get_absolute_time();
+    absolute_time_t timeout = delayed_by_ms(start, timeout_ms);
+    uint32_t generation = _demand_generation;
+    bool due = false;
+
+    while (!due) {
+        absolute_time_t now = get_absolute_time();
+        absolute_time_t wake = timeout;
+
+        for (int i = 0; i < _sensor_count; i++) {
+            absolute_time_t next = _next_due(i);
+
+            if (absolute_time_diff_us(next, now) >= 0) {
+                due = true;
+            } else if (absolute_time_diff_us(next, wake) > 0) {
+                wake = next;
+            }
+        }
+
+        if (due || time_reached(timeout)) {
+            break;
+        }
+
+        _wait_or_demand(wake, &generation);
+    }
+
+    _idle_us += absolute_time_diff_us(start, get_absolute_time());
+
+    return due;
+}
+
+/**
+ * @brief Adds a read to a sensor's noise, from its difference to the
+ * previous read. Only meaningful while the input is steady.
+ *
+ * @param sq Sum of squared differences
+ * @param count Number of differences
+ * @param diff Difference to the previous read
+ */
+void _add_noise(uint64_t* sq, uint32_t* count, int32_t diff) {
+    *sq += (int64_t)diff * diff;
+    (*count)++;
+}
+
+/**
+ * @brief Adds a sample to a sensor's noise, from the difference of
+ * its decimated value to the previous sample's.
+ *
+ * @param noise Noise of the sensor
+ * @param record Sample the sensor was read in
+ * @param id Sensor id
+ */
+void _add_decimated_noise(_noise_t* noise, const sensor_record_t* record, int id) {
+    uint8_t shift = _burst_shift(&_sensors[id], record->raw[id]);
+    int32_t decimated = shift ? _decimated_value(record->raw[id]) : record->values[id];
+
+    if (noise->last_shift == shift) {
+        _add_noise(&noise->decimated_sq, &noise->decimated_count, decimated - noise->last_decimated);
+    }
+
+    noise->last_decimated = decimated;
+    noise->last_shift = shift;
+}
+
+/**
+ * @brief Starts a conversion on every sensor flagged, running their
+ * I2C jobs together.
+ *
+ * @param starting Per sensor flag, cleared if its conversion failed
+ * @param due Set to when each started conversion is done
+ */
+void _start_conversions(bool starting[], absolute_time_t due[]) {
+    i2c_job_t jobs[SENSOR_MAX];
+
+    for (int i = 0; i < _sensor_count; i++) {
+        _sensor_t* s = &_sensors[i];
+
+        jobs[i].i2c = NULL;
+
+        if (starting[i]) {
+            starting[i] = s->driver->start_conversion(s->ctx, &jobs[i]);
+            s->transactions++;
+        }
+    }
+
+    _run_jobs(jobs, starting);
+
+    absolute_time_t started = get_absolute_time();
+
+    for (int i = 0; i < _sensor_count; i++) {
+        if (starting[i]) {
+            due[i] = delayed_by_ms(started, _sensors[i].driver->conversion_time_ms(_sensors[i].ctx));
+        }
+    }
+}
+
+/**
+ * @brief Starts every sensor which is due and not yet part of the
+ * sample. A sensor which fails to start is still part of the sample,
+ * as a failed read. A sensor whose init fails again is left out.
+ *
+ * @param record Sample being taken
+ * @param sampling Per sensor flag, set once the sensor is part of the sample
+ * @param pending Per sensor flag, set while a conversion is running
+ * @param reads_left Set to the reads each started sensor takes
+ * @param due Set to when each started conversion is done
+ */
+void _start_due_sensors(sensor_record_t* record, bool sampling[], bool pending[],
+                        uint32_t reads_left[], absolute_time_t due[]) {
+    absolute_time_t now = get_absolute_time();
+    bool starting[SENSOR_MAX];
+
+    for (int i = 0; i < _sensor_count; i++) {
+        starting[i] = !sampling[i] && _is_due(i, now) && _retry_init(i, now);
+    }
+
+    bool due_now[SENSOR_MAX];
+
+    for (int i = 0; i < _sensor_count; i++) {
+        due_now[i] = starting[i];
+    }
+
+    _start_conversions(starting, due);
+
+    for (int i = 0; i < _sensor_count; i++) {
+        if (!due_now[i]) {
+            continue;
+        }
+
+        _sensor_t* s = &_sensors[i];
+
+        sampling[i] = true;
+        s->last_start = now;
+        s->started_once = true;
+
+        if (!starting[i]) {
+            continue;
+        }
+
+        pending[i] = true;
+        reads_left[i] = 1u << (2 * s->oversample_shift);
+        record->conversion_ms[i] = reads_left[i] * s->driver->conversion_time_ms(s->ctx);
+    }
+}
+
+/**
+ * @brief Updates a sensor's health after a sample it was part of.
+ *
+ * @param id Sensor id
+ * @param read True if the sensor was read
+ */
+void _update_health(int id, bool read) {
+    _sensor_t* s = &_sensors[id];
+    absolute_time_t now = get_absolute_time();
+
+    if (read) {
+        if (s->health == SENSOR_HEALTH_FAULT) {
+            uint32_t recovery_ms = absolute_time_diff_us(s->first_failure, now) / 1000;
+
+            s->last_recovery_ms = recovery_ms;
+            s->max_recovery_ms = MAX(s->max_recovery_ms, recovery_ms);
+            s->health = SENSOR_HEALTH_OK;
+
+            printf("(SENSOR) %s recovered after %lu ms.\n", s->driver->name, (unsigned long)recovery_ms);
+        }
+
+        s->failures = 0;
+        return;
+    }
+
+    if (s->failures == 0) {
+        s->first_failure = now;
+    }
+
+    if (s->failures < UINT8_MAX) {
+        s->failures++;
+    }
+
+    if (s->health == SENSOR_HEALTH_OK && s->failures >= SENSOR_FAULT_AFTER) {
+        s->health = SENSOR_HEALTH_FAULT;
+        s->faults++;
+
+        printf("(SENSOR) %s faulted after %u failed samples.\n", s->driver->name, s->failures);
+    }
+}
+
+/**
+ * @brief Samples every registered sensor which is due. Conversions run
+ * at the same time, so a sample takes about as long as the slowest
+ * sensor or burst. A sensor which becomes due while the sample runs
+ * is added to it.
+ *
+ * @param record Filled with the sample
+ * @param power_down True to power down sensors after they are read
+ * @return bool True if every sensor sampled was read.
+ */
+bool sensor_sample_all(sensor_record_t* record, bool power_down) {
+    i2c_job_t jobs[SENSOR_MAX];
+    bool sampling[SENSOR_MAX] = {false};
+    bool pending[SENSOR_MAX] = {false};
+    absolute_time_t due[SENSOR_MAX];
+    uint32_t reads_left[SENSOR_MAX];
+    int32_t burst_sum[SENSOR_MAX] = {0};
+    int32_t last_read[SENSOR_MAX];
+    uint8_t (*raw)[SENSOR_RAW_MAX] = record->raw;
+    uint32_t generation = _demand_generation;
+
+    memset(record->raw, 0, sizeof(record->raw));
+    memset(record->values, 0, sizeof(record->values));
+    memset(record->fine_values, 0, sizeof(record->fine_values));
+    memset(record->conversion_ms, 0, sizeof(record->conversion_ms));
+    record->count = _sensor_count;
+    record->valid_mask = 0;
+
+    _start_due_sensors(record, sampling, pending, reads_left, due);
+
+    // Collect sensors in the order their conversions finish
+    while (true) {
+        int next = -1;
+
+        for (int i = 0; i < _sensor_count; i++) {
+            if (pending[i] && (next < 0 || absolute_time_diff_us(due[i], due[next]) > 0)) {
+                next = i;
+            }
+        }
+
+        if (next < 0) {
+            break;
+        }
+
+        // A change in demand may make another sensor due
+        if (_wait_or_demand(due[next], &generation)) {
+            _start_due_sensors(record, sampling, pending, reads_left, due);
+            continue;
+        }
+
+        // Every sensor which is done by now is collected together
+        absolute_time_t now = get_absolute_time();
+        bool collecting[SENSOR_MAX] = {false};
+
+        for (int i = 0; i < _sensor_count; i++) {
+            if (pending[i] && absolute_time_diff_us(due[i], now) >= 0) {
+                _sensor_t* s = &_sensors[i];
+
+                jobs[i].i2c = NULL;
+                collecting[i] = s->driver->collect(s->ctx, &jobs[i], raw[i]);
+                s->transactions++;
+                pending[i] = false;
+            }
+        }
+
+        _run_jobs(jobs, collecting);
+
+        bool restarting[SENSOR_MAX] = {false};
+
+        for (int i = 0; i < _sensor_count; i++) {
+            if (!collecting[i]) {
+                continue;
+            }
+
+            _sensor_t* s = &_sensors[i];
+            int32_t value = s->driver->decode(s->ctx, raw[i]);
+
+            if (s->oversample_shift == 0) {
+                record->values[i] = value;
+                record->fine_values[i] = value * (1 << SENSOR_FRACTION_BITS);
+                record->valid_mask |= 1u << i;
+                continue;
+            }
+
+            // A burst read: keep it and start the next one
+            if (reads_left[i] < (1u << (2 * s->oversample_shift))) {
+                _add_noise(&s->noise.single_sq, &s->noise.single_count, value - last_read[i]);
+            }
+
+            burst_sum[i] += value;
+            last_read[i] = value;
+
+            if (--reads_left[i] > 0) {
+                restarting[i] = true;
+                continue;
+            }
+
+            _store_burst(raw[i], burst_sum[i], s->oversample_shift);
+            record->values[i] = sensor_decode(i, raw[i]);
+            record->fine_values[i] = sensor_decode_fine(i, raw[i]);
+            record->valid_mask |= 1u << i;
+        }
+
+        _start_conversions(restarting, due);
+
+        for (int i = 0; i < _sensor_count; i++) {
+            pending[i] = pending[i] || restarting[i];
+        }
+    }
+
+    if (power_down) {
+        for (int i = 0; i < _sensor_count; i++) {
+            if (sampling[i] && _sensors[i].driver->power_down) {
+                _sensors[i].driver->power_down(_sensors[i].ctx);
+            }
+        }
+    }
+
+    record->timestamp_ms = to_ms_since_boot(get_absolute_time());
+    record->sequence = ++_sequence;
+
+    uint8_t sampled_mask = 0;
+
+    for (int i = 0; i < _sensor_count; i++) {
+        if (sampling[i]) {
+            sampled_mask |= 1u << i;
+            _update_health(i, record->valid_mask & (1u << i));
+        }
+
+        if (record->valid_mask & (1u << i)) {
+            _add_decimated_noise(&_sensors[i].noise, record, i);
+        }
+    }
+
+    return record->valid_mask == sampled_mask;
+}
+
+/**
+ * @brief Checks whether a sensor was read in a sample.
+ *
+ * @param record Sample to check
+ * @param id Sensor id
+ * @return bool True if the sensor's value is valid.
+ */
+bool sensor_record_valid(const sensor_record_t* record, int id) {
+    if (id < 0 || id >= record->count) {
+        return false;
+    }
+
+    return record->valid_mask & (1u << id);
+}
+
+/**
+ * @brief Gets the health of a sensor.
+ *
+ * @param id Sensor id
+ * @return sensor_health_t Health of the sensor, SENSOR_HEALTH_FAULT
+ * if the id is unknown.
+ */
+sensor_health_t sensor_health(int id) {
+    if (id < 0 || id >= _sensor_count) {
+        return SENSOR_HEALTH_FAULT;
+    }
+
+    return _sensors[id].health;
+}
+
+/**
+ * @brief Gets which sensors are faulted. Safe to call from either core.
+ *
+ * @return uint8_t Bit n set if sensor n is faulted
+ */
+uint8_t sensor_fault_mask(void) {
+    uint8_t mask = 0;
+
+    for (int i = 0; i < _sensor_count; i++) {
+        if (_sensors[i].health == SENSOR_HEALTH_FAULT) {
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * @brief Prints the health of every sensor over USB: how often it
+ * faulted and how long it took to read again.
+ *
+ */
+void sensor_health_report(void) {
+    for (int i = 0; i < _sensor_count; i++) {
+        _sensor_t* s = &_sensors[i];
+
+        printf("(SENSOR) %s %s: %lu faults, recovery last %lu ms, longest %lu ms\n",
+               s->driver->name, s->health == SENSOR_HEALTH_OK ? "ok" : "FAULT",
+               (unsigned long)s->faults, (unsigned long)s->last_recovery_ms,
+               (unsigned long)s->max_recovery_ms);
+    }
+}
+
+/**
+ * @brief Gets the RMS noise of a sensor from the squared differences
+ * of successive reads. Each difference holds the noise of two reads.
+ *
+ * @param sq Sum of squared differences
+ * @param count Number of differences
+ * @param shift Extra bits the reads have
+ * @return uint32_t RMS noise in hundredths of the driver's units
+ */
+uint32_t _noise_x100(uint64_t sq, uint32_t count, uint8_t shift) {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t variance_x10000 = (sq * 10000) / ((uint64_t)count * 2) >> (2 * shift);
+    uint64_t root = 0;
+
+    // Integer square root, one bit at a time
+    for (uint64_t bit = 1ull << 62; bit != 0; bit >>= 2) {
+        if (variance_x10000 >= root + bit) {
+            variance_x10000 -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+
+    return root;
+}
+
+/**
+ * @brief Prints the noise floor of every sensor over USB: of single
+ * reads within a burst and of the values after decimation, then
+ * starts measuring again. Only meaningful while the inputs are steady.
+ *
+ */
+void sensor_noise_report(void) {
+    for (int i = 0; i < _sensor_count; i++) {
+        _sensor_t* s = &_sensors[i];
+        _noise_t* noise = &s->noise;
+        uint8_t shift = noise->last_shift == 0xFF ? 0 : noise->last_shift;
+
+        uint32_t single = _noise_x100(noise->single_sq, noise->single_count, 0);
+        uint32_t decimated = _noise_x100(noise->decimated_sq, noise->decimated_count, shift);
+
+        if (noise->single_count > 0) {
+            printf("(SENSOR) %s x%u noise: single %lu.%02lu, decimated %lu.%02lu rms\n",
+                   s->driver->name, 1u << (2 * s->oversample_shift),
+                   (unsigned long)single / 100, (unsigned long)single % 100,
+                   (unsigned long)decimated / 100, (unsigned long)decimated % 100);
+        } else if (noise->decimated_count > 0) {
+            printf("(SENSOR) %s x%u noise: %lu.%02lu rms\n",
+                   s->driver->name, 1u << (2 * s->oversample_shift),
+                   (unsigned long)decimated / 100, (unsigned long)decimated % 100);
+        }
+
+        *noise = (_noise_t){.last_shift = 0xFF};
+    }
+}
+
+/**
+ * @brief Prints how often each sensor is sampled over USB, with the
+ * bus transactions and awake time saved compared to sampling every
+ * sensor continuously. Then starts a new measurement window.
+ *
+ */
+void sensor_demand_report(void) {
+    absolute_time_t now = get_absolute_time();
+    uint64_t window_us = absolute_time_diff_us(_window_start, now);
+
+    // Sampling every sensor continuously takes as long per sample as
+    // the slowest sensor or burst
+    uint64_t full_sample_us = 0;
+
+    for (int i = 0; i < _sensor_count; i++) {
+        _sensor_t* s = &_sensors[i];
+
+        if (s->ready) {
+            uint32_t reads = 1u << (2 * s->oversample_shift);
+            full_sample_us = MAX(full_sample_us, (uint64_t)reads * s->driver->conversion_time_ms(s->ctx) * 1000);
+        }
+    }
+
+    for (int i = 0; i < _sensor_count; i++) {
+        _sensor_t* s = &_sensors[i];
+
+        if (!s->ready || full_sample_us == 0) {
+            continue;
+        }
+
+        uint32_t reads = 1u << (2 * s->oversample_shift);
+        uint32_t full = (window_us / full_sample_us) * reads * 2;
+        uint32_t saved = full > s->transactions ? full - s->transactions : 0;
+
+        printf("(SENSOR) %s every %lu ms: %lu transactions, %lu saved\n",
+               s->driver->name, (unsigned long)sensor_interval_ms(i),
+               (unsigned long)s->transactions, (unsigned long)saved);
+
+        s->transactions = 0;
+    }
+
+    uint32_t idle_permille = window_us ? (_idle_us * 1000) / window_us : 0;
+
+    printf("(SENSOR) sampler asleep %lu ms of %lu ms (%lu.%lu%%)\n",
+           (unsigned long)(_idle_us / 1000), (unsigned long)(window_us / 1000),
+           (unsigned long)idle_permille / 10, (unsigned long)idle_permille % 10);
+
+    _idle_us = 0;
+    _window_start = now;
+}
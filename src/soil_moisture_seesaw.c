@@ -10,11 +10,23 @@
 #include "soil_moisture_seesaw.h"
 #include "pico/stdlib.h"
 #include "soil_moisture_seesaw.h"
+#include "ram_placement.h"
 
-#define I2C_ADDR 0x36   // I2C address of the device
+#define I2C_ADDR SEESAW_I2C_ADDR   // I2C address of the device
+#define CONVERSION_MS 200   // Time between requesting and reading moisture
+#define BURST_CONVERSION_MS 5   // Shortest time the seesaw needs, used in bursts
 
-const uint8_t TOUCH_BASE = 0x0F;            // Moisture sensor register base address
-const uint8_t TOUCH_CHANNEL_OFFSET = 0x10;  // Moisture sensor register offset
+#define TOUCH_BASE 0x0F             // Moisture sensor register base address
+#define TOUCH_CHANNEL_OFFSET 0x10   // Moisture sensor register offset
+
+// Register address written to request a moisture reading
+static const uint8_t _MOISTURE_REQUEST[2] = {TOUCH_BASE, TOUCH_CHANNEL_OFFSET};
+
+// Software reset register and value
+static const uint8_t _RESET[3] = {0x00, 0xFF, 0xFF};
+
+// Bus time of each moisture read
+static latency_hist_t _read_latency = {.name = "seesaw read"};
 
 /**
  * @brief Perform software reset on the soil moisture sensor.
@@ -22,28 +34,192 @@ const uint8_t TOUCH_CHANNEL_OFFSET = 0x10;  // Moisture sensor register offset
  * @param i2c Initialized I2C block on RP2040.
  */
 void seesaw_sw_reset(i2c_inst_t* i2c) {
-    uint8_t reset_bytes[3] = {0x00, 0xFF, 0xFF};
+    i2c_write_timeout_us(i2c, I2C_ADDR, _RESET, 3, false, I2C_SCHED_JOB_TIMEOUT_US);
+}
 
-    i2c_write_blocking(i2c, I2C_ADDR, reset_bytes, 3, false);
+/**
+ * @brief Sets up a job which resets the seesaw.
+ * 
+ * @param job Job to set up
+ * @param i2c I2C block the seesaw is on.
+ */
+void seesaw_reset_job(i2c_job_t* job, i2c_inst_t* i2c) {
+    i2c_job_write(job, i2c, I2C_ADDR, _RESET, 3);
+}
+
+/**
+ * @brief Sets up a job which requests a moisture reading.
+ * The result can be read 200 ms later.
+ * 
+ * @param job Job to set up
+ * @param i2c I2C block the seesaw is on.
+ */
+void seesaw_start_job(i2c_job_t* job, i2c_inst_t* i2c) {
+    i2c_job_write(job, i2c, I2C_ADDR, _MOISTURE_REQUEST, 2);
+}
+
+/**
+ * @brief Sets up a job which reads the requested moisture reading.
+ * 
+ * @param job Job to set up
+ * @param i2c I2C block the seesaw is on.
+ * @param buff Buffer for the 2 raw moisture bytes
+ */
+void seesaw_read_job(i2c_job_t* job, i2c_inst_t* i2c, uint8_t buff[2]) {
+    i2c_job_read(job, i2c, I2C_ADDR, buff, 2);
+    job->latency = &_read_latency;
+}
+
+/**
+ * @brief Converts raw moisture bytes to a moisture level.
+ * 
+ * @param buff The 2 raw moisture bytes
+ * @return uint16_t Moisture level: 200 (very dry) to 2000 (very wet)
+ */
+uint16_t HOT_FUNC(seesaw_decode)(const uint8_t buff[2]) {
+    return ((uint16_t)buff[0] << 8) | buff[1];
 }
 
 /**
  * @brief Reads moisture data from seesaw device.
  * 
  * @param i2c Initialized I2C block on RP2040.
- * @return uint16_t Moisture level: 200 (very dry) to 2000 (very wet)
+ * @param moisture Set to the moisture level: 200 (very dry) to 2000
+ * (very wet). Left alone if the read failed.
+ * @return bool False if the seesaw did not take the request or
+ * did not answer.
  */
-uint16_t seesaw_read_moisture(i2c_inst_t* i2c) {
-    // Request data from moisture sensor registers
-    uint8_t write_bytes[2] = {TOUCH_BASE, TOUCH_CHANNEL_OFFSET};
-    i2c_write_blocking(i2c, I2C_ADDR, write_bytes, 2, false);
+bool seesaw_read_moisture(i2c_inst_t* i2c, uint16_t* moisture) {
+    // Select the moisture register; a read without it gets whatever
+    // register was selected last
+    if (i2c_write_timeout_us(i2c, I2C_ADDR, _MOISTURE_REQUEST, 2, false, I2C_SCHED_JOB_TIMEOUT_US) != 2) {
+        return false;
+    }
 
-    sleep_ms(200);
+    sleep_ms(CONVERSION_MS);
 
     uint8_t buff[2];
 
     // Read soil moisture data
-    i2c_read_blocking(i2c, I2C_ADDR, buff, 2, false);
+    if (i2c_read_timeout_us(i2c, I2C_ADDR, buff, 2, false, I2C_SCHED_JOB_TIMEOUT_US) != 2) {
+        return false;
+    }
 
-    return ((uint16_t)buff[0] << 8) | buff[1];
-}
\ No newline at end of file
+    *moisture = seesaw_decode(buff);
+
+    return true;
+}
+
+/**
+ * @brief Routes a job to the seesaw if it is behind a mux.
+ * 
+ * @param dev Seesaw the job is for
+ * @param job Job set up for the seesaw's bus
+ */
+void _route(const seesaw_sensor_t* dev, i2c_job_t* job) {
+    if (dev->mux) {
+        tca9548a_route_job(job, dev->mux);
+    }
+}
+
+/**
+ * @brief Sensor hook: resets the seesaw. The reset goes through the
+ * I2C scheduler, so the mux channel of a seesaw behind a mux is
+ * selected first.
+ * 
+ * @param ctx seesaw_sensor_t of the device
+ * @return bool False if the seesaw did not take the reset.
+ */
+bool _seesaw_sensor_init(void* ctx) {
+    seesaw_sensor_t* dev = ctx;
+    i2c_job_t job;
+
+    seesaw_reset_job(&job, dev->i2c);
+    _route(dev, &job);
+    i2c_sched_run(&job, 1);
+
+    return job.result == 3;
+}
+
+/**
+ * @brief Sensor hook: sets up the job requesting a moisture reading.
+ * 
+ * @param ctx seesaw_sensor_t of the device
+ * @param job Job to set up
+ * @return bool Always true.
+ */
+bool _seesaw_sensor_start(void* ctx, i2c_job_t* job) {
+    seesaw_sensor_t* dev = ctx;
+
+    seesaw_start_job(job, dev->i2c);
+    _route(dev, job);
+
+    return true;
+}
+
+/**
+ * @brief Sensor hook: gets the time between request and read.
+ * 
+ * @param ctx seesaw_sensor_t of the device
+ * @return uint32_t Conversion time in ms
+ */
+uint32_t _seesaw_sensor_conversion_time(void* ctx) {
+    seesaw_sensor_t* dev = ctx;
+
+    return dev->burst ? BURST_CONVERSION_MS : CONVERSION_MS;
+}
+
+/**
+ * @brief Sensor hook: sets up the job reading the moisture.
+ * 
+ * @param ctx seesaw_sensor_t of the device
+ * @param job Job to set up
+ * @param raw Buffer for the raw moisture
+ * @return bool Always true.
+ */
+bool _seesaw_sensor_collect(void* ctx, i2c_job_t* job, uint8_t raw[SENSOR_RAW_MAX]) {
+    seesaw_sensor_t* dev = ctx;
+
+    seesaw_read_job(job, dev->i2c, raw);
+    _route(dev, job);
+
+    return true;
+}
+
+/**
+ * @brief Sensor hook: converts raw moisture to a moisture level.
+ * 
+ * @param ctx seesaw_sensor_t of the device
+ * @param raw Raw moisture
+ * @return int32_t Moisture level: 200 (very dry) to 2000 (very wet)
+ */
+int32_t _seesaw_sensor_decode(void* ctx, const uint8_t raw[SENSOR_RAW_MAX]) {
+    return seesaw_decode(raw);
+}
+
+/**
+ * @brief Sensor hook: switches to short reads, so bursts of them
+ * can be oversampled.
+ * 
+ * @param ctx seesaw_sensor_t of the device
+ * @param burst True for short reads
+ * @return bool Always true.
+ */
+bool _seesaw_sensor_set_burst_mode(void* ctx, bool burst) {
+    seesaw_sensor_t* dev = ctx;
+
+    dev->burst = burst;
+
+    return true;
+}
+
+const sensor_driver_t seesaw_sensor_driver = {
+    .name = "SEESAW",
+    .init = _seesaw_sensor_init,
+    .start_conversion = _seesaw_sensor_start,
+    .conversion_time_ms = _seesaw_sensor_conversion_time,
+    .collect = _seesaw_sensor_collect,
+    .decode = _seesaw_sensor_decode,
+    .power_down = NULL,
+    .set_burst_mode = _seesaw_sensor_set_burst_mode,
+};
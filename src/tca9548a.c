@@ -0,0 +1,53 @@
+///
+/// tca9548a.c
+///
+/// Driver for the TCA9548A 8-channel I2C multiplexer.
+/// Devices behind the mux are addressed by (mux, channel, address).
+/// Jobs for them are routed through the mux and run by the I2C
+/// scheduler, which writes the channel select only when the cached
+/// selection differs.
+///
+
+#include "tca9548a.h"
+
+/**
+ * @brief Sets up a mux and adds it to the I2C scheduler. Nothing is
+ * sent: the open channel is unknown until the first job through the
+ * mux selects one.
+ *
+ * @param mux Mux to set up
+ * @param i2c I2C block the mux is on, added to the scheduler
+ * @param addr I2C address of the mux (0x70 to 0x77)
+ */
+void tca9548a_init(tca9548a_t* mux, i2c_inst_t* i2c, uint8_t addr) {
+    mux->i2c = i2c;
+    mux->addr = addr;
+    mux->selected = TCA9548A_UNKNOWN;
+    tca9548a_reset_stats(mux);
+
+    i2c_sched_add_mux(mux);
+}
+
+/**
+ * @brief Routes a job to a device behind the mux. Call after the job
+ * has been set up for the device's bus.
+ *
+ * @param job Job to route
+ * @param dev Device the job is for
+ */
+void tca9548a_route_job(i2c_job_t* job, const mux_device_t* dev) {
+    job->i2c = dev->mux->i2c;
+    job->addr = dev->addr;
+    job->mux = dev->mux;
+    job->mux_channel = dev->channel;
+}
+
+/**
+ * @brief Clears the transaction counters of a mux.
+ *
+ * @param mux Mux to clear
+ */
+void tca9548a_reset_stats(tca9548a_t* mux) {
+    mux->select_writes = 0;
+    mux->transactions = 0;
+}
@@ -0,0 +1,42 @@
+/*
+
+Built-in trace for trace_replay_run().
+
+Samples use the format printed when TRACE_RECORD is enabled, so
+recorded traces can replace or extend this one. Raw bytes are
+indexed by sensor id: DS18B20 (scratchpad LSB, MSB), BH1750 (MSB, LSB),
+then seesaw (MSB, LSB). The trace covers the cases which were hard to
+reproduce on live hardware: a late first temperature reading, missed
+reads which leave a value stale, and sudden jumps.
+
+*/
+
+#include "trace_replay.h"
+
+const trace_sample_t trace_builtin[] = {
+    // Temperature not read yet: LOADING stays up
+    {1000, 0x06, {{0x90, 0x01}, {0x01, 0xec}, {0x02, 0x64}}},
+    {1750, 0x06, {{0x90, 0x01}, {0x01, 0xee}, {0x02, 0x63}}},
+    // First full sample
+    {2500, 0x07, {{0x90, 0x01}, {0x01, 0xf2}, {0x02, 0x63}}},
+    {3250, 0x07, {{0x92, 0x01}, {0x01, 0xf5}, {0x02, 0x62}}},
+    {4000, 0x07, {{0x92, 0x01}, {0x01, 0xf8}, {0x02, 0x62}}},
+    {4750, 0x07, {{0x93, 0x01}, {0x01, 0xf9}, {0x02, 0x61}}},
+    // Light sensor misses two reads: lux is held
+    {5500, 0x05, {{0x93, 0x01}, {0x01, 0xf9}, {0x02, 0x61}}},
+    {6250, 0x05, {{0x93, 0x01}, {0x01, 0xf9}, {0x02, 0x60}}},
+    // Sun on the probe: lux jumps
+    {7000, 0x07, {{0x95, 0x01}, {0x0d, 0xd4}, {0x02, 0x60}}},
+    {7750, 0x07, {{0x96, 0x01}, {0x0e, 0x1c}, {0x02, 0x5f}}},
+    // Watered: moisture jumps
+    {8500, 0x07, {{0x9a, 0x01}, {0x0e, 0xa0}, {0x05, 0xaa}}},
+    {9250, 0x07, {{0x9b, 0x01}, {0x0e, 0x70}, {0x05, 0xc8}}},
+    // Soil sensor misses a read
+    {10000, 0x03, {{0x9d, 0x01}, {0x0e, 0x4c}, {0x05, 0xc8}}},
+    {10750, 0x07, {{0x9e, 0x01}, {0x0e, 0x04}, {0x05, 0xbe}}},
+    // Single bad temperature read
+    {11500, 0x07, {{0xe8, 0xff}, {0x0e, 0x04}, {0x05, 0xbe}}},
+    {12250, 0x07, {{0xa0, 0x01}, {0x0d, 0xec}, {0x05, 0xb9}}},
+};
+
+const int trace_builtin_count = sizeof(trace_builtin) / sizeof(trace_builtin[0]);
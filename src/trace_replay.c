@@ -0,0 +1,143 @@
+/*
+
+Replays recorded sensor traces through the sampling and display
+pipeline.
+
+A trace holds the raw bytes each driver collected, so replaying it
+runs the real driver decode, the same storage of samples as Core1
+and the real view code. Samples are played back on a virtual clock
+taken from the trace, as fast as the pipeline allows, so hours of
+field data replay in seconds.
+
+Every drawn frame is printed with a checksum of the panel contents,
+followed by the time spent in each stage. Stages are timed with the
+clock passed in: time_us_64() on the device, the host's own clock
+when the replay runs against the SDK stubs in test/.
+
+Traces are recorded by printing live samples with
+trace_print_sample() and pasting the lines into a trace table.
+
+*/
+
+#include "trace_replay.h"
+#include <stdio.h>
+#include <string.h>
+#include "lcd.h"
+
+typedef enum {_STAGE_DECODE, _STAGE_PUBLISH, _STAGE_RENDER, _STAGE_COUNT} _stage_t;
+
+static const char* _STAGE_NAMES[_STAGE_COUNT] = {"decode", "publish", "render"};
+
+typedef struct {
+    uint64_t total_us;
+    uint32_t max_us;
+} _stage_stats_t;
+
+/**
+ * @brief Prints a live sample as a trace table entry over USB.
+ *
+ * @param record Sample to print
+ */
+void trace_print_sample(const sensor_record_t* record) {
+    printf("(TRACE) {%lu, 0x%02x, {", (unsigned long)record->timestamp_ms, record->valid_mask);
+
+    for (int i = 0; i < record->count; i++) {
+        printf("{");
+
+        for (int b = 0; b < SENSOR_RAW_MAX; b++) {
+            printf(b ? ", 0x%02x" : "0x%02x", record->raw[i][b]);
+        }
+
+        printf(i + 1 < record->count ? "}, " : "}");
+    }
+
+    printf("}},\n");
+}
+
+/**
+ * @brief Adds the time since the last stage ended to a stage.
+ *
+ * @param stats Stats of the stage
+ * @param last_us Time the last stage ended, moved to now
+ * @param clock Clock the stages are timed with
+ */
+void _end_stage(_stage_stats_t* stats, uint64_t* last_us, trace_clock_fn clock) {
+    uint64_t now_us = clock();
+    uint32_t elapsed_us = now_us - *last_us;
+
+    stats->total_us += elapsed_us;
+    stats->max_us = MAX(stats->max_us, elapsed_us);
+
+    *last_us = now_us;
+}
+
+/**
+ * @brief Plays a trace through the pipeline and prints the frames
+ * drawn and the time spent in each stage over USB.
+ *
+ * @param trace Samples to play, oldest first
+ * @param count Number of samples
+ * @param publish Stores each decoded sample
+ * @param render Draws the display after each sample
+ * @param clock Clock the stages are timed with, in microseconds
+ */
+void trace_replay_run(const trace_sample_t trace[], int count,
+                      trace_publish_fn publish, trace_render_fn render,
+                      trace_clock_fn clock) {
+    _stage_stats_t stages[_STAGE_COUNT] = {0};
+    uint32_t frames = 0;
+
+    printf("(REPLAY) %d samples\n", count);
+
+    uint64_t start_us = clock();
+
+    for (int n = 0; n < count; n++) {
+        sensor_record_t record;
+        uint64_t last_us = clock();
+
+        memset(&record, 0, sizeof(record));
+        record.timestamp_ms = trace[n].time_ms;
+        record.sequence = n + 1;
+        record.count = sensor_count();
+        record.valid_mask = trace[n].valid_mask;
+
+        for (int i = 0; i < record.count; i++) {
+            memcpy(record.raw[i], trace[n].raw[i], SENSOR_RAW_MAX);
+
+            if (sensor_record_valid(&record, i)) {
+                record.values[i] = sensor_decode(i, record.raw[i]);
+                record.fine_values[i] = sensor_decode_fine(i, record.raw[i]);
+            }
+        }
+
+        _end_stage(&stages[_STAGE_DECODE], &last_us, clock);
+
+        publish(&record);
+        _end_stage(&stages[_STAGE_PUBLISH], &last_us, clock);
+
+        bool drawn = render();
+        _end_stage(&stages[_STAGE_RENDER], &last_us, clock);
+
+        if (drawn) {
+            frames++;
+            printf("(REPLAY) frame %lu sample %d t=%lu ms sum=%08lx\n",
+                   (unsigned long)frames, n, (unsigned long)trace[n].time_ms,
+                   (unsigned long)lcd_panel_checksum());
+        }
+    }
+
+    uint64_t wall_us = clock() - start_us;
+
+    for (int s = 0; s < _STAGE_COUNT; s++) {
+        printf("(REPLAY) %-8s avg %lu us max %lu us\n", _STAGE_NAMES[s],
+               (unsigned long)(count ? stages[s].total_us / count : 0),
+               (unsigned long)stages[s].max_us);
+    }
+
+    // Printing frames is included, as it is part of a replay run
+    uint64_t span_us = count > 1 ? (uint64_t)(trace[count - 1].time_ms - trace[0].time_ms) * 1000 : 0;
+
+    printf("(REPLAY) %lu frames in %lu us, %lux real time\n",
+           (unsigned long)frames, (unsigned long)wall_us,
+           (unsigned long)(wall_us ? span_us / wall_us : 0));
+}
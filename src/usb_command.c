@@ -0,0 +1,109 @@
+/*
+
+Commands typed over the USB serial port.
+
+Characters are read without blocking whenever usb_command_poll() is
+called. The first word of each line names the command, and the rest
+of the line is passed to it as its arguments. Commands are for
+diagnostics and settings, so they are only checked when the run-loop
+wakes up anyway rather than waking it.
+
+*/
+
+#include "usb_command.h"
+#include <stdio.h>
+#include <string.h>
+
+#define _MAX_COMMANDS 8
+#define _MAX_LINE 48
+
+typedef struct {
+    const char* name;
+    usb_command_handler_t handler;
+} _command_t;
+
+static _command_t _commands[_MAX_COMMANDS];
+static uint8_t _command_count = 0;
+
+static char _line[_MAX_LINE + 1];
+static uint8_t _line_len = 0;
+static bool _line_overflow = false;
+
+/**
+ * @brief Adds a command.
+ *
+ * @param name Name typed to run the command
+ * @param handler Function run by the command
+ * @return bool False if no more commands can be added.
+ */
+bool usb_command_register(const char* name, usb_command_handler_t handler) {
+    if (_command_count >= _MAX_COMMANDS) {
+        return false;
+    }
+
+    _commands[_command_count++] = (_command_t){name, handler};
+
+    return true;
+}
+
+/**
+ * @brief Runs the command named by the current line.
+ *
+ */
+void _run_line(void) {
+    if (_line_overflow) {
+        puts("(CMD) Line too long.");
+        return;
+    }
+
+    if (_line_len == 0) {
+        return;
+    }
+
+    // Split the name from the arguments
+    char* args = strchr(_line, ' ');
+
+    if (args) {
+        *args++ = '\0';
+    } else {
+        args = _line + _line_len;
+    }
+
+    for (uint8_t i = 0; i < _command_count; i++) {
+        if (strcmp(_line, _commands[i].name) == 0) {
+            _commands[i].handler(args);
+            return;
+        }
+    }
+
+    printf("(CMD) Unknown command '%s'. Commands:", _line);
+
+    for (uint8_t i = 0; i < _command_count; i++) {
+        printf(" %s", _commands[i].name);
+    }
+
+    printf("\n");
+}
+
+/**
+ * @brief Reads any characters received over USB and runs each
+ * complete line as a command. Never blocks.
+ *
+ */
+void usb_command_poll(void) {
+    int c;
+
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if (c == '\r' || c == '\n') {
+            _line[_line_len] = '\0';
+            _run_line();
+
+            _line_len = 0;
+            _line_overflow = false;
+        } else if (_line_len < _MAX_LINE) {
+            _line[_line_len++] = c;
+        } else {
+            _line_overflow = true;
+        }
+    }
+}
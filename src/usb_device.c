@@ -0,0 +1,285 @@
+/*
+
+USB device: the serial port used by stdio and commands, and, when the
+log export is enabled at boot, a read-only mass-storage volume with
+the sample log (see log_export.c).
+
+The probe links TinyUSB itself, so it provides the descriptors and
+services the stack. The USB interrupt pends a low-priority interrupt
+which runs tud_task(), the same way the SDK's stdio_usb does, so
+Core0 can keep sleeping in its event loop.
+
+*/
+
+#include "usb_device.h"
+#include <string.h>
+#include "tusb.h"
+#include "hardware/irq.h"
+#include "pico/unique_id.h"
+#include "log_export.h"
+
+#define _USB_VID 0x2E8A     // Raspberry Pi
+#define _USB_PID 0x000A     // Raspberry Pi Pico SDK CDC
+
+enum {_ITF_CDC_CONTROL, _ITF_CDC_DATA, _ITF_MSC};
+
+#define _ITF_COUNT_CDC 2        // CDC control and data
+#define _ITF_COUNT_EXPORT 3     // And mass storage
+
+enum {_STR_LANGUAGE, _STR_MANUFACTURER, _STR_PRODUCT, _STR_SERIAL, _STR_CDC, _STR_MSC};
+
+#define _EP_CDC_NOTIFY 0x81
+#define _EP_CDC_OUT 0x02
+#define _EP_CDC_IN 0x82
+#define _EP_MSC_OUT 0x03
+#define _EP_MSC_IN 0x83
+
+#define _CONFIG_CDC_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN)
+#define _CONFIG_EXPORT_LEN (_CONFIG_CDC_LEN + TUD_MSC_DESC_LEN)
+
+static bool _log_export = false;
+
+// Low-priority interrupt which runs the USB stack
+static uint8_t _task_irq;
+
+// The device release differs with the log export, so hosts do not
+// reuse the interfaces they cached for the other configuration
+static tusb_desc_device_t _device_descriptor = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = 0x0200,
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = _USB_VID,
+    .idProduct = _USB_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = _STR_MANUFACTURER,
+    .iProduct = _STR_PRODUCT,
+    .iSerialNumber = _STR_SERIAL,
+    .bNumConfigurations = 1,
+};
+
+static const uint8_t _CONFIG_CDC[] = {
+    TUD_CONFIG_DESCRIPTOR(1, _ITF_COUNT_CDC, 0, _CONFIG_CDC_LEN, 0, 100),
+    TUD_CDC_DESCRIPTOR(_ITF_CDC_CONTROL, _STR_CDC, _EP_CDC_NOTIFY, 8, _EP_CDC_OUT, _EP_CDC_IN, 64),
+};
+
+static const uint8_t _CONFIG_EXPORT[] = {
+    TUD_CONFIG_DESCRIPTOR(1, _ITF_COUNT_EXPORT, 0, _CONFIG_EXPORT_LEN, 0, 100),
+    TUD_CDC_DESCRIPTOR(_ITF_CDC_CONTROL, _STR_CDC, _EP_CDC_NOTIFY, 8, _EP_CDC_OUT, _EP_CDC_IN, 64),
+    TUD_MSC_DESCRIPTOR(_ITF_MSC, _STR_MSC, _EP_MSC_OUT, _EP_MSC_IN, 64),
+};
+
+static const char* _STRINGS[] = {
+    [_STR_MANUFACTURER] = "Raspberry Pi",
+    [_STR_PRODUCT] = "Plant Health Probe",
+    [_STR_CDC] = "Probe Serial",
+    [_STR_MSC] = "Probe Log",
+};
+
+// Block generated for reads which do not start on a block boundary
+static uint8_t _partial_block[LOG_EXPORT_BLOCK_SIZE];
+
+/**
+ * @brief Runs the USB stack. Pended by the USB interrupt.
+ *
+ */
+void _usb_task_irq(void) {
+    tud_task();
+}
+
+/**
+ * @brief Pends the low-priority interrupt after the stack's own USB
+ * interrupt handler has queued its events.
+ *
+ */
+void _usb_irq(void) {
+    irq_set_pending(_task_irq);
+}
+
+/**
+ * @brief Starts the USB stack. Must be called before stdio_init_all().
+ *
+ * @param log_export True to add the mass-storage log export
+ */
+void usb_device_init(bool log_export) {
+    _log_export = log_export;
+    _device_descriptor.bcdDevice = log_export ? 0x0101 : 0x0100;
+
+    if (log_export) {
+        log_export_snapshot();
+    }
+
+    tusb_init();
+
+    _task_irq = user_irq_claim_unused(true);
+    irq_set_exclusive_handler(_task_irq, _usb_task_irq);
+    irq_set_enabled(_task_irq, true);
+
+    irq_add_shared_handler(USBCTRL_IRQ, _usb_irq, PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY);
+}
+
+/**
+ * @brief Checks whether the log export was enabled at boot.
+ *
+ * @return bool True if the probe enumerates with mass storage.
+ */
+bool usb_device_log_export_enabled(void) {
+    return _log_export;
+}
+
+/**
+ * @brief TinyUSB callback: gets the device descriptor.
+ *
+ * @return uint8_t const* Device descriptor
+ */
+uint8_t const* tud_descriptor_device_cb(void) {
+    return (uint8_t const*)&_device_descriptor;
+}
+
+/**
+ * @brief TinyUSB callback: gets the configuration descriptor, with
+ * or without the mass-storage interface.
+ *
+ * @param index Configuration index
+ * @return uint8_t const* Configuration descriptor
+ */
+uint8_t const* tud_descriptor_configuration_cb(uint8_t index) {
+    return _log_export ? _CONFIG_EXPORT : _CONFIG_CDC;
+}
+
+/**
+ * @brief TinyUSB callback: gets a string descriptor. The serial
+ * number is the flash chip's unique id.
+ *
+ * @param index String index
+ * @param langid Language, only English is provided
+ * @return uint16_t const* UTF-16 string descriptor, or NULL if unknown
+ */
+uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    static uint16_t descriptor[33];
+    char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    const char* text;
+    uint8_t len;
+
+    if (index == _STR_LANGUAGE) {
+        descriptor[1] = 0x0409;
+        len = 1;
+    } else {
+        if (index == _STR_SERIAL) {
+            pico_get_unique_board_id_string(serial, sizeof(serial));
+            text = serial;
+        } else if (index < count_of(_STRINGS) && _STRINGS[index]) {
+            text = _STRINGS[index];
+        } else {
+            return NULL;
+        }
+
+        len = MIN(strlen(text), count_of(descriptor) - 1);
+
+        for (uint8_t i = 0; i < len; i++) {
+            descriptor[1 + i] = text[i];
+        }
+    }
+
+    descriptor[0] = (TUSB_DESC_STRING << 8) | (2 * len + 2);
+
+    return descriptor;
+}
+
+/**
+ * @brief TinyUSB callback: identifies the volume.
+ *
+ */
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4]) {
+    memcpy(vendor_id, "PLANT   ", 8);
+    memcpy(product_id, "PROBE LOG EXPORT", 16);
+    memcpy(product_rev, "1.0 ", 4);
+}
+
+/**
+ * @brief TinyUSB callback: the volume is always ready.
+ *
+ */
+bool tud_msc_test_unit_ready_cb(uint8_t lun) {
+    return true;
+}
+
+/**
+ * @brief TinyUSB callback: gets the size of the volume.
+ *
+ */
+void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size) {
+    *block_count = log_export_block_count();
+    *block_size = LOG_EXPORT_BLOCK_SIZE;
+}
+
+/**
+ * @brief TinyUSB callback: there is no media to load or eject.
+ *
+ */
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject) {
+    return true;
+}
+
+/**
+ * @brief TinyUSB callback: generates the blocks the host reads.
+ * Whole blocks are generated straight into the transfer buffer.
+ *
+ * @param lun Unused, there is one volume
+ * @param lba First block to read
+ * @param offset Offset into the first block
+ * @param buffer Transfer buffer
+ * @param bufsize Bytes to read
+ * @return int32_t Bytes read
+ */
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize) {
+    uint8_t* out = buffer;
+    uint32_t done = 0;
+
+    while (done < bufsize) {
+        uint32_t len = MIN(LOG_EXPORT_BLOCK_SIZE - offset, bufsize - done);
+
+        if (offset == 0 && len == LOG_EXPORT_BLOCK_SIZE) {
+            log_export_read_block(lba, out + done);
+        } else {
+            log_export_read_block(lba, _partial_block);
+            memcpy(out + done, _partial_block + offset, len);
+        }
+
+        done += len;
+        offset = 0;
+        lba++;
+    }
+
+    return done;
+}
+
+/**
+ * @brief TinyUSB callback: the volume is read-only.
+ *
+ */
+bool tud_msc_is_writable_cb(uint8_t lun) {
+    return false;
+}
+
+/**
+ * @brief TinyUSB callback: writes are refused.
+ *
+ */
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize) {
+    return -1;
+}
+
+/**
+ * @brief TinyUSB callback: SCSI commands other than the ones above
+ * are not supported.
+ *
+ */
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, uint16_t bufsize) {
+    tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+
+    return -1;
+}
@@ -1,62 +1,75 @@
 /*
 
-Responsible for the interrupt caused by pressing the view-mode switch button.
+Keeps track of the active view mode, which the mode select button
+rotates through. A long press is reported after the press which began
+it, so it returns to the view that press left.
 
 Created by Michael Hogue.
 
 */
 
 #include "viewmode_select.h"
-#include "pico/stdio.h"
-#include "hardware/gpio.h"
-#include "pico/time.h"
 
-#define _MODE_HIGHEST 2
-#define _DEBOUNCE_TIME 200000
+#define _MODE_HIGHEST TEMP_TREND
 
-// For button debouncing
-static volatile absolute_time_t _last_interrupt_time = {0};
-
-// Stores state of the current view mode
+// Stores state of the current view mode. Only changed by the run-loop.
 static volatile view_mode_t _view_mode = DUAL;
 
+// View shown before the last press
+static view_mode_t _pressed_from = DUAL;
+
 /**
- * @brief ISR for interrupt triggered by mode select button press.
+ * @brief Gets the view mode which follows the given one.
  * 
- * @param gpio GPIO that caused the interrupt.
- * @param event_mask Active interrupt(s).
+ * @param mode A view mode
+ * @return view_mode_t The next view mode in the rotation
  */
-void _viewmodeselect_isr(uint gpio, uint32_t event_mask) {
-    absolute_time_t current_interrupt_time = get_absolute_time();
-    int64_t time_diff = absolute_time_diff_us(_last_interrupt_time, current_interrupt_time);
+view_mode_t _next_mode(view_mode_t mode) {
+    return (mode == _MODE_HIGHEST) ? DUAL : mode + 1;
+}
 
-    if (time_diff > _DEBOUNCE_TIME) {
-        irq_set_mask_enabled(event_mask, false);
+/**
+ * @brief Rotates to the next view mode.
+ * 
+ * @return view_mode_t The new active view-mode
+ */
+view_mode_t viewmode_next(void) {
+    _view_mode = _next_mode(_view_mode);
 
-        // Rotate the current view mode
-        if (_view_mode == LIGHT) {
-            _view_mode = DUAL;
-        } else {
-            _view_mode++;
-        }
+    return _view_mode;
+}
 
-        irq_set_mask_enabled(event_mask, true);
+/**
+ * @brief Applies a button gesture. A press shows the next view, a long
+ * press goes back to the view its press left and a double press,
+ * whose presses have both moved the view on, changes nothing.
+ * 
+ * @param kind Gesture
+ * @return view_mode_t The new active view-mode
+ */
+view_mode_t viewmode_input(input_kind_t kind) {
+    switch (kind) {
+        case INPUT_PRESS:
+            _pressed_from = _view_mode;
+            _view_mode = _next_mode(_view_mode);
+        break;
+        case INPUT_LONG_PRESS:
+            _view_mode = _pressed_from;
+        break;
+        case INPUT_DOUBLE_PRESS:
+        break;
     }
 
-    _last_interrupt_time = current_interrupt_time;
+    return _view_mode;
 }
 
 /**
- * @brief Sets up the interrupt for view-mode select button press.
+ * @brief Sets the active view mode.
  * 
- * @param gpio Pin for the view-mode select button
+ * @param mode The view-mode to make active
  */
-void setup_viewmodeselect_irq(uint gpio) {
-    gpio_init(gpio);
-    gpio_set_dir(gpio, GPIO_IN);
-    gpio_pull_down(gpio);
-
-    gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_FALL, true, _viewmodeselect_isr); 
+void viewmode_set(view_mode_t mode) {
+    _view_mode = mode;
 }
 
 /**
@@ -66,4 +79,13 @@ void setup_viewmodeselect_irq(uint gpio) {
  */
 view_mode_t get_viewmode(void) {
     return _view_mode;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Get the view-mode shown after the next button press
+ * 
+ * @return view_mode_t The next view-mode
+ */
+view_mode_t get_next_viewmode(void) {
+    return _next_mode(_view_mode);
+}
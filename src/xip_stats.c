@@ -0,0 +1,64 @@
+/*
+
+XIP cache statistics.
+
+Code and read-only data in flash are fetched through the 16 KB XIP
+cache, which counts every access and every hit. Both counters
+saturate and are shared by the two cores, so they are cleared at the
+start of every measurement window.
+
+The report states whether the hot paths were placed in SRAM, so runs
+of a build with HOT_PATHS_IN_RAM set and one without can be compared.
+
+*/
+
+#include "xip_stats.h"
+#include <stdio.h>
+#include "hardware/structs/xip_ctrl.h"
+#include "ram_placement.h"
+
+/**
+ * @brief Clears both XIP cache counters.
+ *
+ */
+void xip_stats_reset(void) {
+    // Writing any value clears a counter
+    xip_ctrl_hw->ctr_acc = 0;
+    xip_ctrl_hw->ctr_hit = 0;
+}
+
+/**
+ * @brief Reads the XIP cache counters since the last reset.
+ *
+ * @param stats Set to the counters and the hit rate
+ */
+void xip_stats_get(xip_stats_t* stats) {
+    // Read hits first so they never exceed the accesses read after
+    stats->hits = xip_ctrl_hw->ctr_hit;
+    stats->accesses = xip_ctrl_hw->ctr_acc;
+
+    stats->hit_permille = stats->accesses
+        ? ((uint64_t)stats->hits * 1000) / stats->accesses
+        : 1000;
+}
+
+/**
+ * @brief Prints the XIP cache counters over USB and starts a new
+ * measurement window.
+ *
+ * @param label Name of the measured window
+ */
+void xip_stats_report(const char* label) {
+    xip_stats_t stats;
+    xip_stats_get(&stats);
+
+    printf("(XIP) %s: %lu accesses, %lu misses, %lu.%lu%% hit (hot paths in %s)\n",
+           label,
+           (unsigned long)stats.accesses,
+           (unsigned long)(stats.accesses - stats.hits),
+           (unsigned long)stats.hit_permille / 10,
+           (unsigned long)stats.hit_permille % 10,
+           HOT_PATHS_IN_RAM ? "SRAM" : "flash");
+
+    xip_stats_reset();
+}
@@ -0,0 +1,191 @@
+/*
+
+Simulated I2C devices, driven by the stub I2C controllers one part of
+a transfer at a time.
+
+*/
+
+#include "i2c_device.h"
+#include <string.h>
+
+// The seesaw's moisture register, and its shortest conversion
+#define _TOUCH_BASE 0x0F
+#define _TOUCH_CHANNEL_OFFSET 0x10
+#define _CONVERSION_US 5000
+
+static bool _mux_write(stub_i2c_device_t* i2c, uint8_t byte) {
+    i2c_mux_t* mux = (i2c_mux_t*)i2c;
+
+    mux->mask = byte;
+    mux->select_writes++;
+
+    return true;
+}
+
+static uint8_t _mux_read(stub_i2c_device_t* i2c) {
+    return ((i2c_mux_t*)i2c)->mask;
+}
+
+static int _mux_route(stub_i2c_device_t* i2c, uint8_t addr, stub_i2c_device_t** found, int max) {
+    i2c_mux_t* mux = (i2c_mux_t*)i2c;
+    int count = 0;
+
+    for (int channel = 0; channel < I2C_MUX_CHANNELS; channel++) {
+        if (!(mux->mask & (1u << channel))) {
+            continue;
+        }
+
+        for (int i = 0; i < mux->channel_count[channel] && count < max; i++) {
+            if (mux->channels[channel][i]->addr == addr) {
+                found[count++] = mux->channels[channel][i];
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Sets up a mux with every channel closed, as after power on.
+ *
+ * @param mux Mux to set up
+ * @param addr Its address
+ */
+void i2c_mux_init(i2c_mux_t* mux, uint8_t addr) {
+    memset(mux, 0, sizeof(*mux));
+
+    mux->i2c.addr = addr;
+    mux->i2c.write = _mux_write;
+    mux->i2c.read = _mux_read;
+    mux->i2c.route = _mux_route;
+}
+
+/**
+ * @brief Puts a device on one of the mux's channels.
+ *
+ * @param mux Mux to attach to
+ * @param channel Channel the device is on
+ * @param device Device to attach
+ */
+void i2c_mux_attach(i2c_mux_t* mux, uint8_t channel, stub_i2c_device_t* device) {
+    mux->channels[channel][mux->channel_count[channel]++] = device;
+}
+
+static bool _seesaw_start(stub_i2c_device_t* i2c, bool read) {
+    seesaw_device_t* device = (seesaw_device_t*)i2c;
+
+    if (device->nack) {
+        return false;
+    }
+
+    device->stalled = device->stall_transfers > 0;
+
+    if (device->stalled) {
+        device->stall_transfers--;
+    }
+
+    device->reg_len = 0;
+
+    if (read) {
+        device->read_index = 0;
+        device->reads++;
+
+        if (stub_now_ps() / 1000000 < device->request_us + _CONVERSION_US) {
+            device->early_reads++;
+        }
+    }
+
+    return true;
+}
+
+static bool _seesaw_write(stub_i2c_device_t* i2c, uint8_t byte) {
+    seesaw_device_t* device = (seesaw_device_t*)i2c;
+
+    if (device->reg_len < sizeof(device->reg)) {
+        device->reg[device->reg_len++] = byte;
+    }
+
+    return true;
+}
+
+static uint8_t _seesaw_read(stub_i2c_device_t* i2c) {
+    seesaw_device_t* device = (seesaw_device_t*)i2c;
+
+    return device->read_index++ == 0 ? device->moisture >> 8 : device->moisture & 0xFF;
+}
+
+static bool _seesaw_stretches(stub_i2c_device_t* i2c) {
+    return ((seesaw_device_t*)i2c)->stalled;
+}
+
+static void _seesaw_stop(stub_i2c_device_t* i2c) {
+    seesaw_device_t* device = (seesaw_device_t*)i2c;
+
+    if (device->reg_len == 2 && device->reg[0] == _TOUCH_BASE && device->reg[1] == _TOUCH_CHANNEL_OFFSET) {
+        device->requests++;
+        device->request_us = stub_now_ps() / 1000000;
+    } else if (device->reg_len == 3 && device->reg[0] == 0x00 && device->reg[1] == 0xFF) {
+        device->resets++;
+    }
+
+    device->reg_len = 0;
+}
+
+/**
+ * @brief Sets up a seesaw at its default address.
+ *
+ * @param device Device to set up
+ * @param moisture Moisture level it reads
+ */
+void seesaw_device_init(seesaw_device_t* device, uint16_t moisture) {
+    memset(device, 0, sizeof(*device));
+
+    device->i2c.addr = 0x36;
+    device->i2c.start = _seesaw_start;
+    device->i2c.write = _seesaw_write;
+    device->i2c.read = _seesaw_read;
+    device->i2c.stop = _seesaw_stop;
+    device->i2c.stretches = _seesaw_stretches;
+    device->moisture = moisture;
+}
+
+static bool _stuck_pulls_low(stub_gpio_device_t* gpio, uint pin, uint64_t time_ps) {
+    i2c_stuck_device_t* device = (i2c_stuck_device_t*)gpio;
+
+    return pin == device->sda_pin && device->holding;
+}
+
+static void _stuck_edge(stub_gpio_device_t* gpio, uint pin, bool level, uint64_t time_ps) {
+    i2c_stuck_device_t* device = (i2c_stuck_device_t*)gpio;
+
+    // Each rising edge of SCL clocks out one more bit
+    if (pin != device->scl_pin || !level || !device->holding) {
+        return;
+    }
+
+    if (++device->clocks >= device->release_after) {
+        device->holding = false;
+    }
+}
+
+/**
+ * @brief Sets up a device holding SDA low, and puts it on both lines.
+ *
+ * @param device Device to set up
+ * @param sda_pin SDA of its bus
+ * @param scl_pin SCL of its bus
+ * @param release_after SCL clocks until it lets go of SDA
+ */
+void i2c_stuck_device_init(i2c_stuck_device_t* device, uint sda_pin, uint scl_pin, uint32_t release_after) {
+    memset(device, 0, sizeof(*device));
+
+    device->gpio.pulls_low = _stuck_pulls_low;
+    device->gpio.edge = _stuck_edge;
+    device->sda_pin = sda_pin;
+    device->scl_pin = scl_pin;
+    device->holding = true;
+    device->release_after = release_after;
+
+    stub_gpio_attach(sda_pin, &device->gpio);
+    stub_gpio_attach(scl_pin, &device->gpio);
+}
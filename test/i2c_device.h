@@ -0,0 +1,69 @@
+#ifndef I2C_DEVICE_H
+#define I2C_DEVICE_H
+
+// Simulated I2C devices: a TCA9548A mux and the seesaw soil sensor.
+//
+// The mux passes a transfer on to the devices of every channel open
+// in its control register, so two devices with the same address on
+// open channels both answer, as on a real bus.
+//
+// The seesaw takes a register address and answers a read of the
+// moisture register with its moisture level. A read sooner than the
+// seesaw's shortest conversion after the request is counted. Faults
+// can be switched on: NACKing its address, or stretching SCL for
+// good in some of its next transfers.
+//
+// A stuck device holds SDA low, as one does when a transfer to it was
+// cut short in the middle of a byte, until SCL is clocked enough
+// times to finish the byte.
+
+#include "sdk_stub.h"
+
+#define I2C_MUX_CHANNELS 8
+#define I2C_MUX_PER_CHANNEL 4
+
+typedef struct {
+    stub_i2c_device_t i2c;      // First, so the stub's pointer is ours
+    uint8_t mask;               // Open channels
+    stub_i2c_device_t* channels[I2C_MUX_CHANNELS][I2C_MUX_PER_CHANNEL];
+    uint8_t channel_count[I2C_MUX_CHANNELS];
+    uint32_t select_writes;
+} i2c_mux_t;
+
+void i2c_mux_init(i2c_mux_t* mux, uint8_t addr);
+
+void i2c_mux_attach(i2c_mux_t* mux, uint8_t channel, stub_i2c_device_t* device);
+
+typedef struct {
+    stub_i2c_device_t i2c;      // First, so the stub's pointer is ours
+    uint16_t moisture;
+    uint8_t reg[3];
+    uint8_t reg_len;
+    uint8_t read_index;
+    uint64_t request_us;
+
+    uint32_t requests;
+    uint32_t reads;
+    uint32_t early_reads;
+    uint32_t resets;
+
+    // Faults
+    bool nack;                  // NACKs its address
+    uint32_t stall_transfers;   // Transfers left in which it stretches SCL
+    bool stalled;
+} seesaw_device_t;
+
+void seesaw_device_init(seesaw_device_t* device, uint16_t moisture);
+
+typedef struct {
+    stub_gpio_device_t gpio;    // First, so the stub's pointer is ours
+    uint sda_pin;
+    uint scl_pin;
+    bool holding;               // SDA held low
+    uint32_t release_after;     // SCL clocks until it lets go
+    uint32_t clocks;            // SCL clocks seen while holding
+} i2c_stuck_device_t;
+
+void i2c_stuck_device_init(i2c_stuck_device_t* device, uint sda_pin, uint scl_pin, uint32_t release_after);
+
+#endif
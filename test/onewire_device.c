@@ -0,0 +1,254 @@
+/*
+
+Simulated DS18B20. It only sees the level the master puts on the
+pin and answers by pulling the line low, so the firmware's PIO
+program is tested the same way as against a real device.
+
+*/
+
+#include "onewire_device.h"
+#include <string.h>
+
+#define _PS_PER_US 1000000ull
+
+// Shortest low pulse taken as a reset
+#define _RESET_MIN_PS (480 * _PS_PER_US)
+
+// Presence pulse: latest start and shortest length the datasheet allows
+#define _PRESENCE_WAIT_PS (60 * _PS_PER_US)
+#define _PRESENCE_LOW_PS (60 * _PS_PER_US)
+
+// A write slot is a 1 if the master lets go within this
+#define _WRITE_1_MAX_PS (15 * _PS_PER_US)
+
+// How long a 0 is held in a read slot
+#define _READ_0_HOLD_PS (15 * _PS_PER_US)
+
+enum {_IDLE, _ROM, _MATCH, _FUNCTION, _SEND, _DONE};
+
+static uint8_t _crc8(const uint8_t* bytes, int len) {
+    uint8_t crc = 0;
+
+    for (int i = 0; i < len; i++) {
+        uint8_t byte = bytes[i];
+
+        for (int bit = 0; bit < 8; bit++) {
+            bool mix = (crc ^ byte) & 1;
+
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            byte >>= 1;
+        }
+    }
+
+    return crc;
+}
+
+static void _span_add(onewire_span_t* span, uint64_t length_ps) {
+    if (!span->count || length_ps < span->min_ps) {
+        span->min_ps = length_ps;
+    }
+
+    if (!span->count || length_ps > span->max_ps) {
+        span->max_ps = length_ps;
+    }
+
+    span->count++;
+}
+
+static void _start_send(onewire_device_t* device, const uint8_t* bytes, uint8_t len) {
+    device->send = bytes;
+    device->send_len = len;
+    device->send_bit = 0;
+    device->state = _SEND;
+}
+
+static void _on_byte(onewire_device_t* device, uint8_t byte) {
+    switch (device->state) {
+    case _ROM:
+        if (byte == 0xCC) {             // Skip ROM
+            device->state = _FUNCTION;
+        } else if (byte == 0x55) {      // Match ROM
+            device->match_count = 0;
+            device->match_failed = false;
+            device->state = _MATCH;
+        } else if (byte == 0x33) {      // Read ROM
+            _start_send(device, device->rom, sizeof(device->rom));
+        } else {
+            device->state = _DONE;
+        }
+        break;
+
+    case _MATCH:
+        if (byte != device->rom[device->match_count]) {
+            device->match_failed = true;
+        }
+
+        if (++device->match_count == sizeof(device->rom)) {
+            device->state = device->match_failed ? _DONE : _FUNCTION;
+        }
+        break;
+
+    case _FUNCTION:
+        if (byte == 0x44) {             // Convert T
+            device->conversions++;
+            device->state = _DONE;
+        } else if (byte == 0xBE) {      // Read Scratchpad
+            device->scratchpad_reads++;
+            _start_send(device, device->scratchpad, sizeof(device->scratchpad));
+        } else {
+            device->state = _DONE;
+        }
+        break;
+    }
+}
+
+static bool _pulls_low(stub_gpio_device_t* gpio, uint pin, uint64_t time_ps) {
+    onewire_device_t* device = (onewire_device_t*)gpio;
+
+    if (device->mode == ONEWIRE_STUCK_LOW) {
+        return true;
+    }
+
+    if (time_ps >= device->presence_from_ps && time_ps < device->presence_until_ps) {
+        return true;
+    }
+
+    return time_ps < device->hold_until_ps;
+}
+
+static void _on_fall(onewire_device_t* device, uint64_t time_ps) {
+    if (device->slot_fall_ps) {
+        _span_add(&device->recovery, time_ps - device->rise_ps);
+        _span_add(device->last_slot_read ? &device->read_period : &device->write_period,
+                  time_ps - device->slot_fall_ps);
+    }
+
+    device->fall_ps = time_ps;
+
+    if (device->state == _SEND) {
+        uint16_t bit = device->send_bit++;
+
+        if (!((device->send[bit / 8] >> (bit % 8)) & 1)) {
+            device->hold_until_ps = time_ps + _READ_0_HOLD_PS;
+        }
+    }
+}
+
+static void _on_rise(onewire_device_t* device, uint64_t time_ps) {
+    uint64_t low_ps = time_ps - device->fall_ps;
+
+    device->rise_ps = time_ps;
+
+    if (low_ps >= _RESET_MIN_PS) {
+        _span_add(&device->reset_low, low_ps);
+
+        device->slot_fall_ps = 0;
+        device->byte = 0;
+        device->bit_count = 0;
+        device->hold_until_ps = 0;
+
+        if (device->mode == ONEWIRE_PRESENT) {
+            device->presence_from_ps = time_ps + _PRESENCE_WAIT_PS;
+            device->presence_until_ps = device->presence_from_ps + _PRESENCE_LOW_PS;
+            device->state = _ROM;
+        } else {
+            device->state = _IDLE;
+        }
+        return;
+    }
+
+    device->slot_fall_ps = device->fall_ps;
+    device->last_slot_read = device->state == _SEND;
+
+    if (device->state == _SEND) {
+        _span_add(&device->read_low, low_ps);
+
+        if (device->send_bit == device->send_len * 8) {
+            device->state = _DONE;
+        }
+        return;
+    }
+
+    bool bit = low_ps < _WRITE_1_MAX_PS;
+
+    _span_add(bit ? &device->write_1_low : &device->write_0_low, low_ps);
+
+    if (device->state == _ROM || device->state == _MATCH || device->state == _FUNCTION) {
+        device->byte |= bit << device->bit_count;
+
+        if (++device->bit_count == 8) {
+            uint8_t byte = device->byte;
+
+            device->byte = 0;
+            device->bit_count = 0;
+            _on_byte(device, byte);
+        }
+    }
+}
+
+static void _edge(stub_gpio_device_t* gpio, uint pin, bool level, uint64_t time_ps) {
+    onewire_device_t* device = (onewire_device_t*)gpio;
+
+    if (level) {
+        _on_rise(device, time_ps);
+    } else {
+        _on_fall(device, time_ps);
+    }
+}
+
+/**
+ * @brief Sets up a device with a fixed ROM code and a temperature
+ * of 25 C.
+ *
+ * @param device Device to set up
+ * @param mode Whether it answers, is missing or holds the bus low
+ */
+void onewire_device_init(onewire_device_t* device, onewire_mode_t mode) {
+    memset(device, 0, sizeof(*device));
+
+    device->gpio.pulls_low = _pulls_low;
+    device->gpio.edge = _edge;
+    device->mode = mode;
+    device->state = _IDLE;
+
+    static const uint8_t rom[7] = {0x28, 0x1D, 0x39, 0x31, 0x02, 0x00, 0x00};
+
+    memcpy(device->rom, rom, sizeof(rom));
+    device->rom[7] = _crc8(rom, sizeof(rom));
+
+    static const uint8_t config[6] = {0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10};
+
+    memcpy(device->scratchpad + 2, config, sizeof(config));
+    onewire_device_set_temperature(device, 25 * 16);
+}
+
+/**
+ * @brief Sets the temperature the scratchpad holds.
+ *
+ * @param device Device to change
+ * @param sixteenths Temperature in 1/16 C
+ */
+void onewire_device_set_temperature(onewire_device_t* device, int16_t sixteenths) {
+    device->scratchpad[0] = (uint16_t)sixteenths & 0xFF;
+    device->scratchpad[1] = (uint16_t)sixteenths >> 8;
+    device->scratchpad[8] = _crc8(device->scratchpad, 8);
+}
+
+/**
+ * @brief Forgets the pulses measured so far.
+ *
+ * @param device Device to reset the measurements of
+ */
+void onewire_device_clear_spans(onewire_device_t* device) {
+    onewire_span_t* spans[] = {
+        &device->reset_low, &device->write_0_low, &device->write_1_low, &device->read_low,
+        &device->write_period, &device->read_period, &device->recovery,
+    };
+
+    for (size_t i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+        *spans[i] = (onewire_span_t){0};
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef ONEWIRE_DEVICE_H
+#define ONEWIRE_DEVICE_H
+
+// A DS18B20 on a simulated 1-wire pin. It answers resets with a
+// presence pulse, takes Skip ROM and Match ROM, counts Convert T and
+// sends its scratchpad for Read Scratchpad, with the least generous
+// timing the datasheet allows: a write slot is only a 1 if the master
+// lets go within 15 us, and a 0 is only held for 15 us of a read slot.
+//
+// Every pulse the master drives is measured so tests can check the
+// bus timing against the datasheet.
+
+#include "sdk_stub.h"
+
+typedef enum {ONEWIRE_PRESENT, ONEWIRE_ABSENT, ONEWIRE_STUCK_LOW} onewire_mode_t;
+
+// Shortest and longest of one kind of pulse, in picoseconds
+typedef struct {
+    uint32_t count;
+    uint64_t min_ps;
+    uint64_t max_ps;
+} onewire_span_t;
+
+typedef struct {
+    stub_gpio_device_t gpio;    // First, so the stub's pointer is ours
+    onewire_mode_t mode;
+    uint8_t rom[8];
+    uint8_t scratchpad[9];
+
+    // Bus state
+    int state;
+    uint8_t byte;
+    uint8_t bit_count;
+    uint8_t match_count;
+    bool match_failed;
+    const uint8_t* send;
+    uint8_t send_len;
+    uint16_t send_bit;
+    bool last_slot_read;
+    uint64_t fall_ps;
+    uint64_t rise_ps;
+    uint64_t slot_fall_ps;      // Falling edge of the last slot, 0 after a reset
+    uint64_t presence_from_ps;
+    uint64_t presence_until_ps;
+    uint64_t hold_until_ps;
+
+    // What the master did
+    uint32_t conversions;
+    uint32_t scratchpad_reads;
+    onewire_span_t reset_low;
+    onewire_span_t write_0_low;
+    onewire_span_t write_1_low;
+    onewire_span_t read_low;
+    onewire_span_t write_period;    // Falling edge to the next one
+    onewire_span_t read_period;
+    onewire_span_t recovery;        // High time before a slot
+} onewire_device_t;
+
+void onewire_device_init(onewire_device_t* device, onewire_mode_t mode);
+
+void onewire_device_set_temperature(onewire_device_t* device, int16_t sixteenths);
+
+void onewire_device_clear_spans(onewire_device_t* device);
+
+#endif
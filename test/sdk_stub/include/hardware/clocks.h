@@ -0,0 +1,25 @@
+#pragma once
+#include "pico/types.h"
+enum clock_index { clk_gpout0=0, clk_gpout1, clk_gpout2, clk_gpout3, clk_ref, clk_sys, clk_peri, clk_usb, clk_adc, clk_rtc, CLK_COUNT };
+uint32_t clock_get_hz(enum clock_index clk);
+bool clock_configure(enum clock_index clk, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq);
+typedef struct { volatile uint32_t wake_en0, wake_en1, sleep_en0, sleep_en1, enabled0, enabled1; } clocks_hw_t;
+extern clocks_hw_t *clocks_hw;
+#define CLOCKS_SLEEP_EN0_CLK_SYS_TIMER_BITS 0
+#define CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS (1u<<15)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PROC0_BITS 0
+#define CLOCKS_SLEEP_EN1_CLK_SYS_XOSC_BITS (1u<<14)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS (1u<<10)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PADS_BITS (1u<<19)
+#define CLOCKS_SLEEP_EN1_CLK_USB_USBCTRL_BITS (1u<<13)
+#define CLOCKS_SLEEP_EN1_CLK_SYS_USBCTRL_BITS (1u<<12)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PLL_SYS_BITS (1u<<18)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PLL_USB_BITS (1u<<19)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_CLOCKS_BITS (1u<<1)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SIO_BITS (1u<<1)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS (1u<<2)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SRAM0_BITS 0
+#define CLOCKS_SLEEP_EN1_CLK_SYS_SRAM4_BITS 0
+#define CLOCKS_SLEEP_EN1_CLK_SYS_SRAM5_BITS 0
+#define CLOCKS_SLEEP_EN0_CLK_SYS_RESETS_BITS 0
+#define CLOCKS_SLEEP_EN1_CLK_SYS_WATCHDOG_BITS 0
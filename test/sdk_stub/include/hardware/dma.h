@@ -0,0 +1,32 @@
+#pragma once
+#include "pico/types.h"
+typedef struct { uint8_t size; bool read_increment, write_increment, irq_quiet; uint8_t dreq, chain_to; } dma_channel_config;
+#define DREQ_FORCE 0x3f
+enum dma_channel_transfer_size { DMA_SIZE_8=0, DMA_SIZE_16=1, DMA_SIZE_32=2 };
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint ch);
+dma_channel_config dma_channel_get_default_config(uint ch);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size s);
+void channel_config_set_read_increment(dma_channel_config *c, bool i);
+void channel_config_set_write_increment(dma_channel_config *c, bool i);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void channel_config_set_chain_to(dma_channel_config *c, uint ch);
+void channel_config_set_irq_quiet(dma_channel_config *c, bool q);
+void dma_channel_configure(uint ch, const dma_channel_config *c, volatile void *w, const volatile void *r, uint count, bool trigger);
+void dma_channel_set_read_addr(uint ch, const volatile void *r, bool trigger);
+void dma_channel_set_write_addr(uint ch, volatile void *w, bool trigger);
+void dma_channel_set_trans_count(uint ch, uint32_t n, bool trigger);
+void dma_channel_transfer_from_buffer_now(uint ch, const volatile void *r, uint32_t n);
+void dma_channel_transfer_to_buffer_now(uint ch, volatile void *w, uint32_t n);
+void dma_channel_wait_for_finish_blocking(uint ch);
+bool dma_channel_is_busy(uint ch);
+void dma_channel_abort(uint ch);
+void dma_channel_start(uint ch);
+void dma_channel_set_irq0_enabled(uint ch, bool en);
+void dma_channel_set_irq1_enabled(uint ch, bool en);
+void dma_channel_acknowledge_irq0(uint ch);
+void dma_channel_acknowledge_irq1(uint ch);
+bool dma_channel_get_irq0_status(uint ch);
+bool dma_channel_get_irq1_status(uint ch);
+typedef struct { volatile uint32_t ints0, ints1; } dma_hw_t;
+extern dma_hw_t *dma_hw;
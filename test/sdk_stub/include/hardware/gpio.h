@@ -0,0 +1,28 @@
+#pragma once
+#include "pico/types.h"
+#include "hardware/irq.h"
+enum gpio_function { GPIO_FUNC_XIP=0, GPIO_FUNC_SPI=1, GPIO_FUNC_UART=2, GPIO_FUNC_I2C=3, GPIO_FUNC_PWM=4, GPIO_FUNC_SIO=5, GPIO_FUNC_PIO0=6, GPIO_FUNC_PIO1=7, GPIO_FUNC_NULL=0x1f };
+enum gpio_irq_level { GPIO_IRQ_LEVEL_LOW=1, GPIO_IRQ_LEVEL_HIGH=2, GPIO_IRQ_EDGE_FALL=4, GPIO_IRQ_EDGE_RISE=8 };
+#define GPIO_OUT 1
+#define GPIO_IN 0
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+void gpio_init(uint gpio);
+void gpio_deinit(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_disable_pulls(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+enum gpio_function gpio_get_function(uint gpio);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t cb);
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void gpio_acknowledge_irq(uint gpio, uint32_t events);
+void gpio_set_dormant_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void gpio_set_input_hysteresis_enabled(uint gpio, bool enabled);
+void gpio_set_slew_rate(uint gpio, int slew);
+void gpio_set_oeover(uint gpio, uint value);
+#define GPIO_OVERRIDE_NORMAL 0
+#define GPIO_OVERRIDE_HIGH 3
+#define GPIO_OVERRIDE_LOW 2
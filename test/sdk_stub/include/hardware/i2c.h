@@ -0,0 +1,32 @@
+#pragma once
+#include "pico/types.h"
+#include "pico/time.h"
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t i2c0_inst, i2c1_inst;
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+typedef struct { volatile uint32_t con, tar, sar, _p0, data_cmd, ss_scl_hcnt, ss_scl_lcnt, fs_scl_hcnt, fs_scl_lcnt, _p1[2], intr_stat, intr_mask, raw_intr_stat, rx_tl, tx_tl, clr_intr, clr_rx_under, clr_rx_over, clr_tx_over, clr_rd_req, clr_tx_abrt, clr_rx_done, clr_activity, clr_stop_det, clr_start_det, clr_gen_call, enable, status, txflr, rxflr, sda_hold, tx_abrt_source, slv_data_nack_only, dma_cr, dma_tdlr, dma_rdlr, sda_setup, ack_general_call, enable_status, fs_spklen, _p2, clr_restart_det; } i2c_hw_t;
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c);
+uint i2c_hw_index(i2c_inst_t *i2c);
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us);
+int i2c_write_blocking_until(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, absolute_time_t until);
+int i2c_read_blocking_until(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, absolute_time_t until);
+size_t i2c_get_write_available(i2c_inst_t *i2c);
+size_t i2c_get_read_available(i2c_inst_t *i2c);
+#define I2C_IC_DATA_CMD_STOP_BITS 0x200
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x400
+#define I2C_IC_DATA_CMD_CMD_BITS 0x100
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x40
+#define I2C_IC_TX_ABRT_SOURCE_ARB_LOST_BITS 0x1000
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS 0x1
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS 0x8
+i2c_inst_t* i2c_get_instance(uint num);
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x200
+#define I2C_IC_STATUS_ACTIVITY_BITS 0x1
+#define I2C_IC_ENABLE_ENABLE_BITS 0x1
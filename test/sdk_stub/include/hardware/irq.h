@@ -0,0 +1,16 @@
+#pragma once
+#include "pico/types.h"
+typedef void (*irq_handler_t)(void);
+enum { TIMER_IRQ_0=0, TIMER_IRQ_1, TIMER_IRQ_2, TIMER_IRQ_3, PWM_IRQ_WRAP, USBCTRL_IRQ, XIP_IRQ, PIO0_IRQ_0, PIO0_IRQ_1, PIO1_IRQ_0, PIO1_IRQ_1, DMA_IRQ_0, DMA_IRQ_1, IO_IRQ_BANK0, IO_IRQ_QSPI, SIO_IRQ_PROC0, SIO_IRQ_PROC1, CLOCKS_IRQ, SPI0_IRQ, SPI1_IRQ, UART0_IRQ, UART1_IRQ, ADC_IRQ_FIFO, I2C0_IRQ, I2C1_IRQ, RTC_IRQ };
+void irq_set_exclusive_handler(uint num, irq_handler_t h);
+void irq_add_shared_handler(uint num, irq_handler_t h, uint8_t prio);
+void irq_set_enabled(uint num, bool en);
+void irq_set_mask_enabled(uint32_t mask, bool en);
+void irq_set_priority(uint num, uint8_t p);
+void irq_clear(uint num);
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+#ifndef PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY
+#define PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY 0
+#endif
+int user_irq_claim_unused(bool required);
+void irq_set_pending(unsigned num);
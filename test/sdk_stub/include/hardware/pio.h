@@ -0,0 +1,77 @@
+#pragma once
+#include "pico/types.h"
+#include "hardware/gpio.h"
+
+// Register layout follows the RP2040; the SM config values use the
+// hardware's bit fields, which is what the stub's PIO runs from.
+typedef struct { volatile uint32_t ctrl, fstat, fdebug, flevel, txf[4], rxf[4], irq, irq_force, input_sync_bypass, dbg_padout, dbg_padoe, dbg_cfginfo, instr_mem[32]; struct { volatile uint32_t clkdiv, execctrl, shiftctrl, addr, instr, pinctrl; } sm[4]; volatile uint32_t intr; } pio_hw_t;
+typedef pio_hw_t *PIO;
+extern pio_hw_t stub_pio_hw[2];
+#define pio0_hw (&stub_pio_hw[0])
+#define pio1_hw (&stub_pio_hw[1])
+#define pio0 pio0_hw
+#define pio1 pio1_hw
+typedef struct { uint32_t clkdiv, execctrl, shiftctrl, pinctrl; } pio_sm_config;
+typedef struct pio_program { const uint16_t *instructions; uint8_t length; int8_t origin; } pio_program_t;
+uint pio_add_program(PIO pio, const pio_program_t *p);
+bool pio_can_add_program(PIO pio, const pio_program_t *p);
+void pio_remove_program(PIO pio, const pio_program_t *p, uint offset);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_claim(PIO pio, uint sm);
+void pio_sm_unclaim(PIO pio, uint sm);
+void pio_gpio_init(PIO pio, uint pin);
+pio_sm_config pio_get_default_sm_config(void);
+void sm_config_set_wrap(pio_sm_config *c, uint wt, uint w);
+void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t i, uint8_t f);
+void sm_config_set_clkdiv(pio_sm_config *c, float div);
+void sm_config_set_set_pins(pio_sm_config *c, uint b, uint n);
+void sm_config_set_out_pins(pio_sm_config *c, uint b, uint n);
+void sm_config_set_in_pins(pio_sm_config *c, uint b);
+void sm_config_set_sideset_pins(pio_sm_config *c, uint b);
+void sm_config_set_sideset(pio_sm_config *c, uint bits, bool opt, bool pindirs);
+void sm_config_set_in_shift(pio_sm_config *c, bool right, bool autopush, uint thr);
+void sm_config_set_out_shift(pio_sm_config *c, bool right, bool autopull, uint thr);
+void sm_config_set_jmp_pin(pio_sm_config *c, uint pin);
+void sm_config_set_out_special(pio_sm_config *c, bool sticky, bool has_enable_pin, uint enable_pin_index);
+enum pio_fifo_join { PIO_FIFO_JOIN_NONE = 0, PIO_FIFO_JOIN_TX = 1, PIO_FIFO_JOIN_RX = 2 };
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join);
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *c);
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *c);
+void pio_sm_set_enabled(PIO pio, uint sm, bool en);
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t i, uint8_t f);
+void pio_sm_clkdiv_restart(PIO pio, uint sm);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
+uint32_t pio_sm_get(PIO pio, uint sm);
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+bool pio_sm_is_rx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint base, uint n, bool out);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t v, uint32_t m);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t v, uint32_t m);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+uint pio_get_index(PIO pio);
+void pio_sm_drain_tx_fifo(PIO pio, uint sm);
+bool pio_interrupt_get(PIO pio, uint n);
+void pio_interrupt_clear(PIO pio, uint n);
+
+enum pio_src_dest { pio_pins = 0, pio_x = 1, pio_y = 2, pio_null = 3, pio_pindirs = 4, pio_exec_mov = 4, pio_status = 5, pio_pc = 5, pio_isr = 6, pio_osr = 7, pio_exec_out = 7 };
+static inline uint pio_encode_jmp(uint addr) { return 0x0000 | addr; }
+static inline uint pio_encode_jmp_not_x(uint addr) { return 0x0020 | addr; }
+static inline uint pio_encode_set(enum pio_src_dest d, uint v) { return 0xe000 | (d << 5) | v; }
+static inline uint pio_encode_out(enum pio_src_dest d, uint n) { return 0x6000 | (d << 5) | (n & 0x1f); }
+static inline uint pio_encode_in(enum pio_src_dest s, uint n) { return 0x4000 | (s << 5) | (n & 0x1f); }
+static inline uint pio_encode_pull(bool if_empty, bool block) { return 0x8080 | (if_empty << 6) | (block << 5); }
+static inline uint pio_encode_push(bool if_full, bool block) { return 0x8000 | (if_full << 6) | (block << 5); }
+static inline uint pio_encode_mov(enum pio_src_dest d, enum pio_src_dest s) { return 0xa000 | (d << 5) | s; }
+static inline uint pio_encode_nop(void) { return 0xa042; }
+static inline uint pio_encode_sideset(uint bits, uint value) { return value << (13 - bits); }
+static inline uint pio_encode_delay(uint cycles) { return cycles << 8; }
@@ -0,0 +1,3 @@
+#pragma once
+#define M0PLUS_SCR_SLEEPDEEP_BITS 0x4
+#define M0PLUS_SCR_SEVONPEND_BITS 0x10
@@ -0,0 +1,15 @@
+#pragma once
+#include "pico/types.h"
+typedef struct spi_inst spi_inst_t;
+extern spi_inst_t spi0_inst, spi1_inst;
+#define spi0 (&spi0_inst)
+#define spi1 (&spi1_inst)
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_deinit(spi_inst_t *spi);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t *spi);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+bool spi_is_busy(const spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+typedef struct { volatile uint32_t cr0, cr1, dr, sr, cpsr, imsc, ris, mis, icr, dmacr; } spi_hw_t;
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
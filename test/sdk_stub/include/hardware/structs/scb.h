@@ -0,0 +1,5 @@
+#pragma once
+#include "pico/types.h"
+#include "hardware/regs/m0plus.h"
+typedef struct { volatile uint32_t cpuid, icsr, vtor, aircr, scr; } armv6m_scb_t;
+extern armv6m_scb_t *scb_hw;
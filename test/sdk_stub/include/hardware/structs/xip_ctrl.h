@@ -0,0 +1,4 @@
+#pragma once
+#include "pico/types.h"
+typedef struct { volatile uint32_t ctrl, flush, stat, ctr_hit, ctr_acc, stream_addr, stream_ctr, stream_fifo; } xip_ctrl_hw_t;
+#define xip_ctrl_hw ((xip_ctrl_hw_t*)0x14000000)
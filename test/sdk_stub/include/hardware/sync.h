@@ -0,0 +1,15 @@
+#pragma once
+#include "pico/types.h"
+typedef volatile uint32_t spin_lock_t;
+void __wfi(void);
+void __wfe(void);
+void __sev(void);
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t s);
+int spin_lock_claim_unused(bool required);
+spin_lock_t *spin_lock_init(uint n);
+spin_lock_t *spin_lock_instance(uint n);
+uint32_t spin_lock_blocking(spin_lock_t *l);
+void spin_unlock(spin_lock_t *l, uint32_t s);
+void __mem_fence_acquire(void);
+void __mem_fence_release(void);
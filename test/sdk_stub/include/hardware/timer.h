@@ -0,0 +1,12 @@
+#pragma once
+#include "pico/types.h"
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+typedef struct { volatile uint32_t timehw, timelw, timehr, timelr, alarm[4], armed, timerawh, timerawl, dbgpause, pause, intr, inte, intf, ints; } timer_hw_t;
+extern timer_hw_t *timer_hw;
+void hardware_alarm_claim(uint n);
+int hardware_alarm_claim_unused(bool required);
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t cb);
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(uint alarm_num);
@@ -0,0 +1,9 @@
+#pragma once
+#include "pico/types.h"
+uint get_core_num(void);
+static inline void tight_loop_contents(void){}
+static inline void __breakpoint(void){}
+#define __compiler_memory_barrier() __asm volatile("" ::: "memory")
+static inline void __dmb(void){}
+static inline void __dsb(void){}
+static inline void __isb(void){}
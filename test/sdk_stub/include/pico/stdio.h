@@ -0,0 +1,7 @@
+#pragma once
+#include "pico/types.h"
+#include <stdio.h>
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t us);
+void stdio_set_chars_available_callback(void (*fn)(void*), void *param);
+void stdio_flush(void);
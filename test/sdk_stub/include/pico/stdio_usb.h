@@ -0,0 +1,4 @@
+#pragma once
+#include "pico/types.h"
+bool stdio_usb_init(void);
+bool stdio_usb_connected(void);
@@ -0,0 +1,11 @@
+#pragma once
+#include "pico/types.h"
+#include "pico/time.h"
+#include "pico/stdio.h"
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "hardware/uart.h"
+#include "pico/platform.h"
+bool set_sys_clock_khz(uint32_t khz, bool required);
+bool check_sys_clock_khz(uint32_t khz, uint *vco, uint *postdiv1, uint *postdiv2);
+void set_sys_clock_48mhz(void);
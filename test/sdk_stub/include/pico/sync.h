@@ -0,0 +1,6 @@
+#pragma once
+#include "hardware/sync.h"
+typedef struct { spin_lock_t *spin_lock; uint32_t save; } critical_section_t;
+void critical_section_init(critical_section_t *c);
+void critical_section_enter_blocking(critical_section_t *c);
+void critical_section_exit(critical_section_t *c);
@@ -0,0 +1,31 @@
+#pragma once
+#include "pico/types.h"
+absolute_time_t get_absolute_time(void);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+uint64_t to_us_since_boot(absolute_time_t t);
+uint32_t to_ms_since_boot(absolute_time_t t);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+absolute_time_t make_timeout_time_us(uint64_t us);
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us);
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms);
+void update_us_since_boot(absolute_time_t *t, uint64_t us);
+bool time_reached(absolute_time_t t);
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+void busy_wait_us(uint64_t us);
+void busy_wait_us_32(uint32_t us);
+void busy_wait_ms(uint32_t ms);
+bool best_effort_wfe_or_timeout(absolute_time_t t);
+void sleep_until(absolute_time_t t);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t cb, void *ud, bool fire_if_past);
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t cb, void *ud, bool fire_if_past);
+alarm_id_t add_alarm_at(absolute_time_t t, alarm_callback_t cb, void *ud, bool fire_if_past);
+bool cancel_alarm(alarm_id_t id);
+typedef struct repeating_timer { int64_t delay_us; void *user_data; alarm_id_t alarm_id; } repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+bool add_repeating_timer_ms(int32_t ms, repeating_timer_callback_t cb, void *ud, repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *t);
+#define nil_time 0
+#define at_the_end_of_time UINT64_MAX
+static inline bool is_nil_time(absolute_time_t t){return t==0;}
+absolute_time_t from_us_since_boot(uint64_t us);
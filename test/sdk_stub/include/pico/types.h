@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/error.h"
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+#ifndef MIN
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#endif
+#define __not_in_flash_func(f) f
+#define __not_in_flash(g) 
+#define __in_flash(g)
+#define __time_critical_func(f) f
+#define __scratch_x(g)
+#define __scratch_y(g)
+#define __aligned(x) __attribute__((aligned(x)))
+#define count_of(a) (sizeof(a)/sizeof((a)[0]))
+#define PICO_NO_HARDWARE 0
+#define __force_inline inline
+#define hard_assert(x) ((void)(x))
+#define invalid_params_if(a,b)
+#define static_assert _Static_assert
+typedef volatile uint8_t io_rw_8; typedef volatile uint32_t io_rw_32;
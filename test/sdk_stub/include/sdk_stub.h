@@ -0,0 +1,106 @@
+#ifndef SDK_STUB_H
+#define SDK_STUB_H
+
+#include "pico/types.h"
+
+// Host stand-ins for the parts of the Pico SDK the firmware uses.
+//
+// Time is virtual: it only moves when a test advances it, when code
+// sleeps or waits for an interrupt, or by a fixed step on every read
+// of the timer (for code which polls a deadline). Alarms, raised IRQs
+// and scheduled stimuli run as interrupts on the test's main thread,
+// in time order, whenever interrupts are enabled.
+
+// Puts every stub back to its power-on state. Call at the start of
+// each test.
+void stub_reset(void);
+
+// Moves virtual time forward, running everything which falls due
+void stub_advance_us(uint64_t us);
+
+void stub_advance_to_us(uint64_t time_us);
+
+// Moves time forward by this much on every time_us_64() call
+void stub_set_auto_advance_us(uint32_t step_us);
+
+// Runs fn(arg) as an interrupt at the given time since boot
+void stub_schedule_at_us(uint64_t time_us, void (*fn)(void* arg), void* arg);
+
+// Marks an IRQ pending. Its handler runs once it is enabled and
+// interrupts are enabled.
+void stub_irq_raise(uint num);
+
+bool stub_irq_enabled(uint num);
+
+// Number of times the core went to sleep in __wfi() or
+// best_effort_wfe_or_timeout()
+uint32_t stub_sleep_count(void);
+
+bool stub_interrupts_disabled(void);
+
+// Current virtual time in picoseconds. Inside a PIO cycle, the time
+// of that cycle.
+uint64_t stub_now_ps(void);
+
+// GPIO
+
+#define STUB_GPIO_COUNT 30
+
+// Something outside the chip on a pin, e.g. a device on an
+// open-drain bus. level is what everything else puts on the pin.
+typedef struct stub_gpio_device {
+    bool (*pulls_low)(struct stub_gpio_device* device, uint pin, uint64_t time_ps);
+    void (*edge)(struct stub_gpio_device* device, uint pin, bool level, uint64_t time_ps);
+} stub_gpio_device_t;
+
+void stub_gpio_attach(uint pin, stub_gpio_device_t* device);
+
+// Holds a pin low (0) or high (1) from outside, or lets go (-1)
+void stub_gpio_hold(uint pin, int level);
+
+bool stub_gpio_level(uint pin);
+
+bool stub_gpio_pulled_up(uint pin);
+
+bool stub_gpio_output_enabled(uint pin);
+
+// Clocks
+
+// Frequency clk_sys starts at, 125 MHz
+#define STUB_SYS_HZ_DEFAULT 125000000
+
+// I2C
+
+// A device on a simulated I2C bus, told about each part of a transfer
+// addressed to it. start and write return false to NACK; a NULL hook
+// ACKs and ignores the data, or reads 0xFF.
+typedef struct stub_i2c_device {
+    uint8_t addr;
+    bool (*start)(struct stub_i2c_device* device, bool read);
+    bool (*write)(struct stub_i2c_device* device, uint8_t byte);
+    uint8_t (*read)(struct stub_i2c_device* device);
+    void (*stop)(struct stub_i2c_device* device);
+
+    // Optional, for devices others sit behind (e.g. a mux): adds those
+    // answering an address to found, up to max. Returns how many.
+    int (*route)(struct stub_i2c_device* device, uint8_t addr, struct stub_i2c_device** found, int max);
+
+    // Optional: true while the device, once addressed, stretches SCL.
+    // The transfer makes no progress until it lets go.
+    bool (*stretches)(struct stub_i2c_device* device);
+} stub_i2c_device_t;
+
+void stub_i2c_attach(uint bus, stub_i2c_device_t* device);
+
+// Transfers started on a bus, each from start to stop
+uint32_t stub_i2c_transfers(uint bus);
+
+// Transfers to an address more than one device answered
+uint32_t stub_i2c_clashes(uint bus);
+
+// PIO
+
+// Cycles an SM has executed since it was last enabled
+uint64_t stub_pio_cycles(uint pio_index, uint sm);
+
+#endif
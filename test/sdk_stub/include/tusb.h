@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "tusb_config.h"
+typedef struct { uint8_t bLength, bDescriptorType; uint16_t bcdUSB; uint8_t bDeviceClass, bDeviceSubClass, bDeviceProtocol, bMaxPacketSize0; uint16_t idVendor, idProduct, bcdDevice; uint8_t iManufacturer, iProduct, iSerialNumber, bNumConfigurations; } tusb_desc_device_t;
+enum { TUSB_DESC_DEVICE = 1, TUSB_DESC_STRING = 3, TUSB_CLASS_MISC = 0xEF, MISC_SUBCLASS_COMMON = 2, MISC_PROTOCOL_IAD = 1, SCSI_SENSE_ILLEGAL_REQUEST = 5 };
+#define TUD_CONFIG_DESC_LEN 9
+#define TUD_CDC_DESC_LEN 66
+#define TUD_MSC_DESC_LEN 23
+#define TUD_CONFIG_DESCRIPTOR(a,b,c,d,e,f) 9, 2, (d) & 0xff, (d) >> 8, b, a, c, 0x80 | (e), (f)/2
+#define TUD_CDC_DESCRIPTOR(a,b,c,d,e,f,g) a, b, c, d, e, f, g
+#define TUD_MSC_DESCRIPTOR(a,b,c,d,e) a, b, c, d, e
+bool tusb_init(void); void tud_task(void); bool tud_msc_set_sense(uint8_t lun, uint8_t key, uint8_t asc, uint8_t ascq);
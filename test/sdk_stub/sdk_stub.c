@@ -0,0 +1,671 @@
+/*
+
+Core of the host SDK stubs: the virtual clock, alarms, interrupts,
+spin locks and the inter-core FIFO.
+
+Everything which would run as an interrupt on the device (alarm
+callbacks, IRQ handlers and stimuli scheduled by tests) runs on the
+test's main thread, one at a time, whenever the code under test has
+interrupts enabled and time has reached it. Other threads, used to
+stand in for core1, only take part in spin locks.
+
+*/
+
+#include "sdk_stub.h"
+#include "stub_internal.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/time.h"
+#include "pico/sync.h"
+#include "pico/multicore.h"
+#include "pico/unique_id.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+
+#define _MAX_SCHEDULED 32
+#define _IRQ_COUNT 32
+#define _SPIN_LOCK_COUNT 32
+#define _FIFO_DEPTH 8
+
+typedef struct {
+    bool active;
+    alarm_id_t id;
+    uint64_t time_us;
+    alarm_callback_t alarm;     // Alarm, or
+    void (*stimulus)(void*);    // stimulus scheduled by a test
+    void* arg;
+} _scheduled_t;
+
+static uint64_t _now_us;
+static uint32_t _auto_advance_us;
+static _scheduled_t _scheduled[_MAX_SCHEDULED];
+static alarm_id_t _next_alarm_id;
+
+#define _MAX_SHARED_HANDLERS 4
+
+static irq_handler_t _irq_handlers[_IRQ_COUNT][_MAX_SHARED_HANDLERS];
+static bool _irq_enabled[_IRQ_COUNT];
+static uint32_t _irq_pending;
+
+static __thread bool _interrupts_disabled;
+static bool _in_interrupt;
+static bool _stop_on_irq;      // Whether a raised IRQ ends a PIO run
+static pthread_t _main_thread;
+static uint32_t _sleep_count;
+
+static spin_lock_t _spin_locks[_SPIN_LOCK_COUNT];
+static pthread_mutex_t _spin_mutexes[_SPIN_LOCK_COUNT];
+static uint32_t _spin_locks_claimed;
+static pthread_mutex_t _claim_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t _fifo[_FIFO_DEPTH];
+static int _fifo_count;
+
+static bool _can_interrupt(void) {
+    return !_interrupts_disabled && !_in_interrupt && pthread_equal(pthread_self(), _main_thread);
+}
+
+static _scheduled_t* _next_scheduled(void) {
+    _scheduled_t* next = NULL;
+
+    for (int i = 0; i < _MAX_SCHEDULED; i++) {
+        if (_scheduled[i].active && (!next || _scheduled[i].time_us < next->time_us)) {
+            next = &_scheduled[i];
+        }
+    }
+
+    return next;
+}
+
+static _scheduled_t* _free_slot(void) {
+    for (int i = 0; i < _MAX_SCHEDULED; i++) {
+        if (!_scheduled[i].active) {
+            return &_scheduled[i];
+        }
+    }
+
+    fprintf(stderr, "sdk_stub: too many alarms\n");
+    abort();
+}
+
+// Runs the scheduled entry as an interrupt. Alarms are rescheduled the
+// way the SDK does: >0 from the time they were due, <0 from now.
+static void _fire(_scheduled_t* entry) {
+    _scheduled_t fired = *entry;
+
+    entry->active = false;
+
+    if (fired.stimulus) {
+        fired.stimulus(fired.arg);
+        return;
+    }
+
+    int64_t again = fired.alarm(fired.id, fired.arg);
+
+    if (again != 0) {
+        // The callback may have taken the slot for a new alarm
+        _scheduled_t* next = _free_slot();
+
+        *next = fired;
+        next->active = true;
+        next->time_us = again > 0 ? fired.time_us + again : _now_us - again;
+    }
+}
+
+// Lowest pending IRQ which is enabled, or -1
+static int _next_irq(void) {
+    for (uint num = 0; num < _IRQ_COUNT; num++) {
+        if ((_irq_pending & (1u << num)) && _irq_enabled[num]) {
+            return num;
+        }
+    }
+
+    return -1;
+}
+
+bool stub_irq_waiting(void) {
+    return _stop_on_irq && _next_irq() >= 0;
+}
+
+void stub_service_interrupts(void) {
+    bool pio_running;
+
+    stub_pio_time_ps(&pio_running);
+
+    // A PIO run stops for raised IRQs, and they are run after it
+    if (!_can_interrupt() || pio_running) {
+        return;
+    }
+
+    _in_interrupt = true;
+
+    while (1) {
+        int num = _next_irq();
+
+        if (num >= 0) {
+            _irq_pending &= ~(1u << num);
+
+            for (int i = 0; i < _MAX_SHARED_HANDLERS; i++) {
+                if (_irq_handlers[num][i]) {
+                    _irq_handlers[num][i]();
+                }
+            }
+            continue;
+        }
+
+        _scheduled_t* next = _next_scheduled();
+
+        if (!next || next->time_us > _now_us) {
+            break;
+        }
+
+        _fire(next);
+    }
+
+    _in_interrupt = false;
+}
+
+uint64_t stub_now_us(void) {
+    return _now_us;
+}
+
+uint64_t stub_now_ps(void) {
+    bool pio_running;
+    uint64_t pio_ps = stub_pio_time_ps(&pio_running);
+
+    return pio_running ? pio_ps : _now_us * 1000000;
+}
+
+// Runs the peripherals to a time. Stops early when they raise an IRQ
+// which should be run, with the time moved to when it was raised.
+static void _run_peripherals_to(uint64_t time_us, bool stop_on_irq) {
+    _stop_on_irq = stop_on_irq;
+
+    uint64_t reached_ps = stub_pio_run_until_ps(time_us * 1000000);
+    uint64_t reached_us = reached_ps / 1000000;
+
+    _stop_on_irq = false;
+
+    if (reached_us > _now_us) {
+        _now_us = reached_us;
+    }
+
+    if (reached_ps >= time_us * 1000000 && time_us > _now_us) {
+        _now_us = time_us;
+    }
+}
+
+void stub_reset(void) {
+    _now_us = 0;
+    _auto_advance_us = 0;
+    memset(_scheduled, 0, sizeof(_scheduled));
+    _next_alarm_id = 1;
+
+    memset(_irq_handlers, 0, sizeof(_irq_handlers));
+    memset(_irq_enabled, 0, sizeof(_irq_enabled));
+    _irq_pending = 0;
+
+    _interrupts_disabled = false;
+    _in_interrupt = false;
+    _main_thread = pthread_self();
+    _sleep_count = 0;
+
+    _spin_locks_claimed = 0;
+    _fifo_count = 0;
+
+    for (int i = 0; i < _SPIN_LOCK_COUNT; i++) {
+        _spin_locks[i] = 0;
+        pthread_mutex_init(&_spin_mutexes[i], NULL);
+    }
+
+    stub_clocks_reset();
+    stub_gpio_reset();
+    stub_pio_reset();
+    stub_dma_reset();
+    stub_i2c_reset();
+    stub_spi_reset();
+}
+
+void stub_advance_to_us(uint64_t time_us) {
+    stub_service_interrupts();
+
+    // Stop at each due entry, so interrupts see the time they were due
+    while (_now_us < time_us) {
+        uint64_t step_us = time_us;
+        _scheduled_t* next = _next_scheduled();
+
+        if (_can_interrupt() && next && next->time_us > _now_us && next->time_us < step_us) {
+            step_us = next->time_us;
+        }
+
+        _run_peripherals_to(step_us, _can_interrupt());
+        stub_service_interrupts();
+    }
+}
+
+void stub_advance_us(uint64_t us) {
+    stub_advance_to_us(_now_us + us);
+}
+
+void stub_set_auto_advance_us(uint32_t step_us) {
+    _auto_advance_us = step_us;
+}
+
+void stub_schedule_at_us(uint64_t time_us, void (*fn)(void* arg), void* arg) {
+    _scheduled_t* entry = _free_slot();
+
+    entry->active = true;
+    entry->id = 0;
+    entry->time_us = time_us;
+    entry->alarm = NULL;
+    entry->stimulus = fn;
+    entry->arg = arg;
+}
+
+void stub_irq_raise(uint num) {
+    _irq_pending |= 1u << num;
+    stub_service_interrupts();
+}
+
+bool stub_irq_enabled(uint num) {
+    return _irq_enabled[num];
+}
+
+uint32_t stub_sleep_count(void) {
+    return _sleep_count;
+}
+
+bool stub_interrupts_disabled(void) {
+    return _interrupts_disabled;
+}
+
+// Sleeps until the next interrupt, or until the deadline if there is
+// one. Interrupts run once they are enabled again.
+static void _sleep_until(uint64_t deadline_us) {
+    _sleep_count++;
+
+    // A pending IRQ wakes the core even while interrupts are masked
+    while (_next_irq() < 0 && _now_us < deadline_us) {
+        _scheduled_t* next = _next_scheduled();
+        uint64_t wake_us = next && next->time_us < deadline_us ? next->time_us : deadline_us;
+
+        if (wake_us == UINT64_MAX) {
+            if (!stub_pio_busy() && !stub_dma_busy()) {
+                fprintf(stderr, "sdk_stub: core sleeps with nothing left to wake it\n");
+                abort();
+            }
+
+            // Only the peripherals can wake it, give them a while
+            wake_us = _now_us + 1000;
+        }
+
+        _run_peripherals_to(MAX(wake_us, _now_us), true);
+
+        if (next && next->time_us <= _now_us) {
+            break;
+        }
+    }
+
+    stub_service_interrupts();
+}
+
+// pico/time.h
+
+uint64_t time_us_64(void) {
+    if (_auto_advance_us) {
+        stub_advance_to_us(_now_us + _auto_advance_us);
+    }
+
+    stub_i2c_sync();
+
+    return _now_us;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+absolute_time_t from_us_since_boot(uint64_t us) {
+    return us;
+}
+
+uint64_t to_us_since_boot(absolute_time_t t) {
+    return t;
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t) {
+    return t / 1000;
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+    return (int64_t)(to - from);
+}
+
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) {
+    return t + us;
+}
+
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) {
+    return t + (uint64_t)ms * 1000;
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us) {
+    return delayed_by_us(get_absolute_time(), us);
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms) {
+    return delayed_by_ms(get_absolute_time(), ms);
+}
+
+void update_us_since_boot(absolute_time_t* t, uint64_t us) {
+    *t = us;
+}
+
+bool time_reached(absolute_time_t t) {
+    return time_us_64() >= t;
+}
+
+void sleep_until(absolute_time_t t) {
+    stub_advance_to_us(t);
+}
+
+void sleep_us(uint64_t us) {
+    stub_advance_us(us);
+}
+
+void sleep_ms(uint32_t ms) {
+    stub_advance_us((uint64_t)ms * 1000);
+}
+
+void busy_wait_us(uint64_t us) {
+    stub_advance_us(us);
+}
+
+void busy_wait_us_32(uint32_t us) {
+    stub_advance_us(us);
+}
+
+void busy_wait_ms(uint32_t ms) {
+    stub_advance_us((uint64_t)ms * 1000);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t t) {
+    if (_now_us >= t) {
+        return true;
+    }
+
+    _sleep_until(t);
+
+    return _now_us >= t;
+}
+
+alarm_id_t add_alarm_at(absolute_time_t t, alarm_callback_t cb, void* ud, bool fire_if_past) {
+    alarm_id_t id = _next_alarm_id++;
+
+    if (t <= _now_us) {
+        if (!fire_if_past) {
+            return 0;
+        }
+
+        // Like the SDK, a past alarm runs in the caller's context
+        int64_t again = cb(id, ud);
+
+        if (again == 0) {
+            return 0;
+        }
+
+        t = again > 0 ? t + again : _now_us - again;
+    }
+
+    _scheduled_t* entry = _free_slot();
+
+    entry->active = true;
+    entry->id = id;
+    entry->time_us = t;
+    entry->alarm = cb;
+    entry->stimulus = NULL;
+    entry->arg = ud;
+
+    return id;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t cb, void* ud, bool fire_if_past) {
+    return add_alarm_at(_now_us + us, cb, ud, fire_if_past);
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t cb, void* ud, bool fire_if_past) {
+    return add_alarm_at(_now_us + (uint64_t)ms * 1000, cb, ud, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t id) {
+    for (int i = 0; i < _MAX_SCHEDULED; i++) {
+        if (_scheduled[i].active && _scheduled[i].alarm && _scheduled[i].id == id) {
+            _scheduled[i].active = false;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// hardware/sync.h
+
+void __wfi(void) {
+    _sleep_until(UINT64_MAX);
+}
+
+void __wfe(void) {
+    _sleep_until(UINT64_MAX);
+}
+
+void __sev(void) {
+}
+
+void __mem_fence_acquire(void) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+void __mem_fence_release(void) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    uint32_t status = _interrupts_disabled;
+
+    _interrupts_disabled = true;
+
+    return status;
+}
+
+void restore_interrupts(uint32_t status) {
+    _interrupts_disabled = status;
+    stub_service_interrupts();
+}
+
+int spin_lock_claim_unused(bool required) {
+    pthread_mutex_lock(&_claim_mutex);
+
+    int lock = -1;
+
+    for (int i = 0; i < _SPIN_LOCK_COUNT; i++) {
+        if (!(_spin_locks_claimed & (1u << i))) {
+            _spin_locks_claimed |= 1u << i;
+            lock = i;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&_claim_mutex);
+
+    if (lock < 0 && required) {
+        fprintf(stderr, "sdk_stub: no spin lock left\n");
+        abort();
+    }
+
+    return lock;
+}
+
+spin_lock_t* spin_lock_instance(uint n) {
+    return &_spin_locks[n];
+}
+
+spin_lock_t* spin_lock_init(uint n) {
+    _spin_locks[n] = 0;
+    return &_spin_locks[n];
+}
+
+uint32_t spin_lock_blocking(spin_lock_t* lock) {
+    uint32_t status = save_and_disable_interrupts();
+
+    pthread_mutex_lock(&_spin_mutexes[lock - _spin_locks]);
+    *lock = 1;
+
+    return status;
+}
+
+void spin_unlock(spin_lock_t* lock, uint32_t status) {
+    *lock = 0;
+    pthread_mutex_unlock(&_spin_mutexes[lock - _spin_locks]);
+
+    restore_interrupts(status);
+}
+
+// pico/sync.h
+
+void critical_section_init(critical_section_t* crit) {
+    crit->spin_lock = spin_lock_instance(spin_lock_claim_unused(true));
+}
+
+void critical_section_enter_blocking(critical_section_t* crit) {
+    crit->save = spin_lock_blocking(crit->spin_lock);
+}
+
+void critical_section_exit(critical_section_t* crit) {
+    spin_unlock(crit->spin_lock, crit->save);
+}
+
+// hardware/irq.h
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    memset(_irq_handlers[num], 0, sizeof(_irq_handlers[num]));
+    _irq_handlers[num][0] = handler;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t priority) {
+    for (int i = 0; i < _MAX_SHARED_HANDLERS; i++) {
+        if (!_irq_handlers[num][i] || _irq_handlers[num][i] == handler) {
+            _irq_handlers[num][i] = handler;
+            return;
+        }
+    }
+
+    fprintf(stderr, "sdk_stub: too many shared handlers\n");
+    abort();
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    _irq_enabled[num] = enabled;
+    stub_service_interrupts();
+}
+
+void irq_set_mask_enabled(uint32_t mask, bool enabled) {
+    for (uint num = 0; num < _IRQ_COUNT; num++) {
+        if (mask & (1u << num)) {
+            _irq_enabled[num] = enabled;
+        }
+    }
+
+    stub_service_interrupts();
+}
+
+void irq_set_priority(uint num, uint8_t priority) {
+}
+
+void irq_clear(uint num) {
+    _irq_pending &= ~(1u << num);
+}
+
+void irq_set_pending(uint num) {
+    stub_irq_raise(num);
+}
+
+int user_irq_claim_unused(bool required) {
+    return 26;
+}
+
+// pico/unique_id.h
+
+void pico_get_unique_board_id_string(char* id_out, unsigned len) {
+    snprintf(id_out, len, "E6614C311B2C4E2F");
+}
+
+// pico/multicore.h: core1 pushes into core0's FIFO
+
+void multicore_fifo_push_blocking(uint32_t data) {
+    if (_fifo_count == _FIFO_DEPTH) {
+        fprintf(stderr, "sdk_stub: push to a full FIFO would block forever\n");
+        abort();
+    }
+
+    _fifo[_fifo_count++] = data;
+    stub_irq_raise(SIO_IRQ_PROC0);
+}
+
+bool multicore_fifo_push_timeout_us(uint32_t data, uint64_t timeout_us) {
+    if (_fifo_count == _FIFO_DEPTH) {
+        return false;
+    }
+
+    multicore_fifo_push_blocking(data);
+
+    return true;
+}
+
+uint32_t multicore_fifo_pop_blocking(void) {
+    if (!_fifo_count) {
+        fprintf(stderr, "sdk_stub: pop from an empty FIFO would block forever\n");
+        abort();
+    }
+
+    uint32_t data = _fifo[0];
+
+    memmove(_fifo, _fifo + 1, --_fifo_count * sizeof(_fifo[0]));
+
+    return data;
+}
+
+bool multicore_fifo_pop_timeout_us(uint64_t timeout_us, uint32_t* out) {
+    if (!_fifo_count) {
+        return false;
+    }
+
+    *out = multicore_fifo_pop_blocking();
+
+    return true;
+}
+
+bool multicore_fifo_rvalid(void) {
+    return _fifo_count > 0;
+}
+
+bool multicore_fifo_wready(void) {
+    return _fifo_count < _FIFO_DEPTH;
+}
+
+void multicore_fifo_drain(void) {
+    _fifo_count = 0;
+}
+
+void multicore_fifo_clear_irq(void) {
+}
+
+uint get_core_num(void) {
+    return pthread_equal(pthread_self(), _main_thread) ? 0 : 1;
+}
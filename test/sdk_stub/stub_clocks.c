@@ -0,0 +1,82 @@
+/*
+
+Clock stub. clk_sys can be changed to any frequency the system PLL
+can make from the 12 MHz crystal, found the same way as the SDK.
+
+*/
+
+#include "sdk_stub.h"
+#include "stub_internal.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#define _XOSC_KHZ 12000
+#define _VCO_MIN_KHZ 750000
+#define _VCO_MAX_KHZ 1600000
+
+static uint32_t _sys_hz;
+static clocks_hw_t _clocks_hw;
+clocks_hw_t* clocks_hw = &_clocks_hw;
+
+void stub_clocks_reset(void) {
+    _sys_hz = STUB_SYS_HZ_DEFAULT;
+    _clocks_hw = (clocks_hw_t){0};
+}
+
+uint32_t clock_get_hz(enum clock_index clk) {
+    switch (clk) {
+    case clk_sys:
+    case clk_peri:
+        return _sys_hz;
+    case clk_usb:
+    case clk_adc:
+        return 48000000;
+    case clk_ref:
+        return _XOSC_KHZ * 1000;
+    default:
+        return 0;
+    }
+}
+
+bool clock_configure(enum clock_index clk, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq) {
+    if (clk == clk_sys) {
+        _sys_hz = freq;
+    }
+
+    return true;
+}
+
+bool check_sys_clock_khz(uint32_t khz, uint* vco_out, uint* postdiv1_out, uint* postdiv2_out) {
+    for (uint fbdiv = 320; fbdiv >= 16; fbdiv--) {
+        uint vco = fbdiv * _XOSC_KHZ;
+
+        if (vco < _VCO_MIN_KHZ || vco > _VCO_MAX_KHZ) {
+            continue;
+        }
+
+        for (uint postdiv1 = 7; postdiv1 >= 1; postdiv1--) {
+            for (uint postdiv2 = postdiv1; postdiv2 >= 1; postdiv2--) {
+                if (vco / (postdiv1 * postdiv2) == khz && vco % (postdiv1 * postdiv2) == 0) {
+                    *vco_out = vco * 1000;
+                    *postdiv1_out = postdiv1;
+                    *postdiv2_out = postdiv2;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+bool set_sys_clock_khz(uint32_t khz, bool required) {
+    uint vco, postdiv1, postdiv2;
+
+    if (!check_sys_clock_khz(khz, &vco, &postdiv1, &postdiv2)) {
+        return false;
+    }
+
+    _sys_hz = khz * 1000;
+
+    return true;
+}
@@ -0,0 +1,312 @@
+/*
+
+DMA stub. A triggered channel moves data whenever its DREQ allows,
+checked after every PIO cycle, so transfers to and from SM FIFOs
+are paced by the SM the same way as on the chip. Unpaced channels
+finish at once. A finished channel raises DMA_IRQ_0 or DMA_IRQ_1 if
+enabled for it, and triggers the channel it is chained to.
+
+*/
+
+#include "sdk_stub.h"
+#include "stub_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+
+#define _CHANNEL_COUNT 12
+
+typedef struct {
+    bool claimed;
+    bool busy;
+    bool irq0_enabled;
+    bool irq1_enabled;
+    dma_channel_config config;
+    const volatile uint8_t* read_addr;
+    volatile uint8_t* write_addr;
+    uint32_t count;             // Reloaded on each trigger
+    uint32_t remaining;
+} _channel_t;
+
+static _channel_t _channels[_CHANNEL_COUNT];
+static dma_hw_t _dma_hw;
+dma_hw_t* dma_hw = &_dma_hw;
+
+void stub_dma_reset(void) {
+    memset(_channels, 0, sizeof(_channels));
+    memset(&_dma_hw, 0, sizeof(_dma_hw));
+}
+
+static bool _paced_ready(uint dreq) {
+    if (dreq == DREQ_FORCE) {
+        return true;
+    }
+
+    if (dreq < 16) {
+        return stub_pio_dreq_ready(dreq);
+    }
+
+    return true;
+}
+
+static uint32_t _read(const volatile uint8_t* address, uint size) {
+    PIO pio;
+    uint sm;
+    bool is_tx;
+
+    if (stub_pio_fifo_address(address, &pio, &sm, &is_tx) && !is_tx) {
+        uint shift = 8 * (address - (const volatile uint8_t*)&pio->rxf[sm]);
+        uint32_t word = pio_sm_get(pio, sm);
+
+        return word >> shift;
+    }
+
+    uint32_t value = 0;
+
+    memcpy(&value, (const void*)address, size);
+
+    return value;
+}
+
+static void _write(volatile uint8_t* address, uint size, uint32_t value) {
+    PIO pio;
+    uint sm;
+    bool is_tx;
+
+    if (stub_pio_fifo_address(address, &pio, &sm, &is_tx) && is_tx) {
+        pio_sm_put(pio, sm, value);
+        return;
+    }
+
+    memcpy((void*)address, &value, size);
+}
+
+static void _finish(uint channel) {
+    _channel_t* ch = &_channels[channel];
+
+    ch->busy = false;
+
+    if (!ch->config.irq_quiet) {
+        if (ch->irq0_enabled) {
+            _dma_hw.ints0 |= 1u << channel;
+            stub_irq_raise(DMA_IRQ_0);
+        }
+
+        if (ch->irq1_enabled) {
+            _dma_hw.ints1 |= 1u << channel;
+            stub_irq_raise(DMA_IRQ_1);
+        }
+    }
+
+    if (ch->config.chain_to != channel) {
+        dma_channel_start(ch->config.chain_to);
+    }
+}
+
+void stub_dma_service(void) {
+    for (uint channel = 0; channel < _CHANNEL_COUNT; channel++) {
+        _channel_t* ch = &_channels[channel];
+        uint size = 1u << ch->config.size;
+
+        while (ch->busy && ch->remaining && _paced_ready(ch->config.dreq)) {
+            _write(ch->write_addr, size, _read(ch->read_addr, size));
+
+            if (ch->config.read_increment) {
+                ch->read_addr += size;
+            }
+
+            if (ch->config.write_increment) {
+                ch->write_addr += size;
+            }
+
+            ch->remaining--;
+        }
+
+        if (ch->busy && !ch->remaining) {
+            _finish(channel);
+        }
+    }
+}
+
+bool stub_dma_feeds(const volatile void* address) {
+    for (uint channel = 0; channel < _CHANNEL_COUNT; channel++) {
+        if (_channels[channel].busy && (const volatile void*)_channels[channel].write_addr == address) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool stub_dma_busy(void) {
+    for (uint channel = 0; channel < _CHANNEL_COUNT; channel++) {
+        if (_channels[channel].busy) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int dma_claim_unused_channel(bool required) {
+    for (int channel = 0; channel < _CHANNEL_COUNT; channel++) {
+        if (!_channels[channel].claimed) {
+            _channels[channel].claimed = true;
+            return channel;
+        }
+    }
+
+    if (required) {
+        fprintf(stderr, "stub_dma: no free channel\n");
+        abort();
+    }
+
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    _channels[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = {
+        .size = DMA_SIZE_32,
+        .read_increment = true,
+        .write_increment = false,
+        .irq_quiet = false,
+        .dreq = DREQ_FORCE,
+        .chain_to = channel,
+    };
+
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config* c, bool increment) {
+    c->read_increment = increment;
+}
+
+void channel_config_set_write_increment(dma_channel_config* c, bool increment) {
+    c->write_increment = increment;
+}
+
+void channel_config_set_dreq(dma_channel_config* c, uint dreq) {
+    c->dreq = dreq;
+}
+
+void channel_config_set_chain_to(dma_channel_config* c, uint channel) {
+    c->chain_to = channel;
+}
+
+void channel_config_set_irq_quiet(dma_channel_config* c, bool quiet) {
+    c->irq_quiet = quiet;
+}
+
+void dma_channel_start(uint channel) {
+    _channel_t* ch = &_channels[channel];
+
+    ch->busy = true;
+    ch->remaining = ch->count;
+    stub_dma_service();
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config* c, volatile void* write_addr,
+                           const volatile void* read_addr, uint count, bool trigger) {
+    _channel_t* ch = &_channels[channel];
+
+    ch->config = *c;
+    ch->write_addr = write_addr;
+    ch->read_addr = read_addr;
+    ch->count = count;
+
+    if (trigger) {
+        dma_channel_start(channel);
+    }
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void* read_addr, bool trigger) {
+    _channels[channel].read_addr = read_addr;
+
+    if (trigger) {
+        dma_channel_start(channel);
+    }
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void* write_addr, bool trigger) {
+    _channels[channel].write_addr = write_addr;
+
+    if (trigger) {
+        dma_channel_start(channel);
+    }
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t count, bool trigger) {
+    _channels[channel].count = count;
+
+    if (trigger) {
+        dma_channel_start(channel);
+    }
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void* read_addr, uint32_t count) {
+    _channels[channel].read_addr = read_addr;
+    _channels[channel].count = count;
+    dma_channel_start(channel);
+}
+
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void* write_addr, uint32_t count) {
+    _channels[channel].write_addr = write_addr;
+    _channels[channel].count = count;
+    dma_channel_start(channel);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return _channels[channel].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+    uint64_t give_up_us = stub_now_us() + 10000000;
+
+    while (_channels[channel].busy) {
+        if (stub_now_us() > give_up_us) {
+            fprintf(stderr, "stub_dma: channel %u never finished\n", channel);
+            abort();
+        }
+
+        stub_advance_us(1);
+    }
+}
+
+void dma_channel_abort(uint channel) {
+    _channels[channel].busy = false;
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    _channels[channel].irq0_enabled = enabled;
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+    _channels[channel].irq1_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+    return (_dma_hw.ints0 >> channel) & 1;
+}
+
+bool dma_channel_get_irq1_status(uint channel) {
+    return (_dma_hw.ints1 >> channel) & 1;
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+    _dma_hw.ints0 &= ~(1u << channel);
+}
+
+void dma_channel_acknowledge_irq1(uint channel) {
+    _dma_hw.ints1 &= ~(1u << channel);
+}
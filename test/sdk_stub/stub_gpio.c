@@ -0,0 +1,258 @@
+/*
+
+GPIO stub: a model of each pin's level and of what drives it.
+
+A pin is driven by SIO or by a PIO block, depending on its function.
+Tests can hold a pin at a level (a button), and attach a device
+which pulls it low (an open-drain bus). All drivers are wired-AND:
+any low wins, then any high, then the pad's pull. A pin with no pull
+and nothing driving it reads low.
+
+Devices are told whenever the level everything else puts on their
+pin changes, with the time of the change in picoseconds. Edge IRQs
+are raised for changes of the full level.
+
+*/
+
+#include "sdk_stub.h"
+#include "stub_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+
+typedef struct {
+    enum gpio_function function;
+    bool out;
+    bool output_enabled;
+    bool pull_up;
+    bool pull_down;
+    int held;                   // Level held by a test, or -1
+    stub_gpio_device_t* device;
+    bool device_view;           // Level others put on the pin, last told to the device
+    bool level;                 // Last full level, for edge IRQs
+    uint32_t irq_events;
+    uint32_t pending_events;
+} _gpio_t;
+
+static _gpio_t _pins[STUB_GPIO_COUNT];
+static gpio_irq_callback_t _irq_callback;
+static bool _updating;
+
+static int _chip_drive(uint pin) {
+    const _gpio_t* gpio = &_pins[pin];
+
+    switch (gpio->function) {
+    case GPIO_FUNC_SIO:
+        return gpio->output_enabled ? gpio->out : -1;
+    case GPIO_FUNC_PIO0:
+        return stub_pio_pin_drive(0, pin);
+    case GPIO_FUNC_PIO1:
+        return stub_pio_pin_drive(1, pin);
+    default:
+        return -1;
+    }
+}
+
+static bool _level(uint pin, bool with_device) {
+    const _gpio_t* gpio = &_pins[pin];
+    int chip = _chip_drive(pin);
+
+    if (chip == 0 || gpio->held == 0) {
+        return false;
+    }
+
+    if (with_device && gpio->device && gpio->device->pulls_low(gpio->device, pin, stub_now_ps())) {
+        return false;
+    }
+
+    if (chip == 1 || gpio->held == 1) {
+        return true;
+    }
+
+    return gpio->pull_up;
+}
+
+static void _bank_irq(void) {
+    for (uint pin = 0; pin < STUB_GPIO_COUNT; pin++) {
+        uint32_t events = _pins[pin].pending_events;
+
+        if (events) {
+            _pins[pin].pending_events = 0;
+
+            if (_irq_callback) {
+                _irq_callback(pin, events);
+            }
+        }
+    }
+}
+
+void stub_gpio_update(void) {
+    // Devices may change what they pull in response to an edge
+    if (_updating) {
+        return;
+    }
+
+    _updating = true;
+
+    bool changed = true;
+
+    for (int pass = 0; changed && pass < 8; pass++) {
+        changed = false;
+
+        for (uint pin = 0; pin < STUB_GPIO_COUNT; pin++) {
+            _gpio_t* gpio = &_pins[pin];
+
+            if (gpio->device) {
+                bool view = _level(pin, false);
+
+                if (view != gpio->device_view) {
+                    gpio->device_view = view;
+                    gpio->device->edge(gpio->device, pin, view, stub_now_ps());
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    bool raise = false;
+
+    for (uint pin = 0; pin < STUB_GPIO_COUNT; pin++) {
+        _gpio_t* gpio = &_pins[pin];
+        bool level = _level(pin, true);
+
+        if (level != gpio->level) {
+            uint32_t event = level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+
+            gpio->level = level;
+
+            if (gpio->irq_events & event) {
+                gpio->pending_events |= event;
+                raise = true;
+            }
+        }
+    }
+
+    _updating = false;
+
+    if (raise) {
+        stub_irq_raise(IO_IRQ_BANK0);
+    }
+}
+
+void stub_gpio_reset(void) {
+    memset(_pins, 0, sizeof(_pins));
+
+    for (uint pin = 0; pin < STUB_GPIO_COUNT; pin++) {
+        _pins[pin].function = GPIO_FUNC_NULL;
+        _pins[pin].pull_down = true;
+        _pins[pin].held = -1;
+    }
+
+    _irq_callback = NULL;
+    _updating = false;
+}
+
+void stub_gpio_hold(uint pin, int level) {
+    _pins[pin].held = level;
+    stub_gpio_update();
+}
+
+void stub_gpio_attach(uint pin, stub_gpio_device_t* device) {
+    _pins[pin].device = device;
+    _pins[pin].device_view = _level(pin, false);
+}
+
+bool stub_gpio_level(uint pin) {
+    return _level(pin, true);
+}
+
+bool stub_gpio_pulled_up(uint pin) {
+    return _pins[pin].pull_up;
+}
+
+bool stub_gpio_output_enabled(uint pin) {
+    return _pins[pin].output_enabled;
+}
+
+enum gpio_function gpio_get_function(uint pin) {
+    return _pins[pin].function;
+}
+
+void gpio_init(uint pin) {
+    _pins[pin].output_enabled = false;
+    _pins[pin].out = false;
+    _pins[pin].function = GPIO_FUNC_SIO;
+    stub_gpio_update();
+}
+
+void gpio_deinit(uint pin) {
+    _pins[pin].function = GPIO_FUNC_NULL;
+    stub_gpio_update();
+}
+
+void gpio_set_function(uint pin, enum gpio_function function) {
+    _pins[pin].function = function;
+    stub_gpio_update();
+}
+
+void gpio_set_dir(uint pin, bool out) {
+    _pins[pin].output_enabled = out;
+    stub_gpio_update();
+}
+
+void gpio_put(uint pin, bool value) {
+    _pins[pin].out = value;
+    stub_gpio_update();
+}
+
+bool gpio_get(uint pin) {
+    return _level(pin, true);
+}
+
+void gpio_pull_up(uint pin) {
+    _pins[pin].pull_up = true;
+    _pins[pin].pull_down = false;
+    stub_gpio_update();
+}
+
+void gpio_pull_down(uint pin) {
+    _pins[pin].pull_up = false;
+    _pins[pin].pull_down = true;
+    stub_gpio_update();
+}
+
+void gpio_disable_pulls(uint pin) {
+    _pins[pin].pull_up = false;
+    _pins[pin].pull_down = false;
+    stub_gpio_update();
+}
+
+void gpio_set_irq_enabled(uint pin, uint32_t events, bool enabled) {
+    if (enabled) {
+        _pins[pin].irq_events |= events;
+    } else {
+        _pins[pin].irq_events &= ~events;
+    }
+
+    _pins[pin].level = _level(pin, true);
+}
+
+void gpio_set_irq_enabled_with_callback(uint pin, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(pin, events, enabled);
+
+    _irq_callback = callback;
+    irq_set_exclusive_handler(IO_IRQ_BANK0, _bank_irq);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void gpio_acknowledge_irq(uint pin, uint32_t events) {
+    _pins[pin].pending_events &= ~events;
+}
+
+void gpio_set_dormant_irq_enabled(uint pin, uint32_t events, bool enabled) {
+}
+
+void gpio_set_input_hysteresis_enabled(uint pin, bool enabled) {
+}
@@ -0,0 +1,474 @@
+/*
+
+I2C stub: a model of each controller's FIFOs and of the bus behind
+it, run on the virtual clock at the controller's baud rate.
+
+Code under test drives the controller through its registers, as on
+the chip. A plain store cannot be seen, so the stub looks at the
+registers whenever it is called: on every read of the timer and on
+every FIFO level query. That is enough for code which queries the
+FIFO level before each access, as the SDK and the firmware do:
+
+- A value stored in DATA_CMD is taken as the next command. The stub
+  then leaves a marker in DATA_CMD which no command can equal.
+- A read byte is put in DATA_CMD when the RX level is queried, and
+  counts as read from then on.
+- A transfer ends with a marker bit set in TAR. Writing TAR for the
+  next transfer clears it, which stands in for the reads of the
+  CLR_ registers that clear STOP_DET and TX_ABRT on the chip.
+
+Devices are attached to a bus and answer by address. A device may
+route to others behind it, e.g. a mux, and every device which answers
+an address takes part: writes go to all of them and reads are the
+wired-AND of their bytes. Each transfer and each address answered by
+more than one device is counted. A target which stretches the clock
+stalls the transfer until it lets go, or until the controller is
+reset.
+
+A controller only starts a transfer while its SDA pin is high, if its
+pins are set to the I2C function; otherwise arbitration is lost.
+
+*/
+
+#include "sdk_stub.h"
+#include "stub_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/error.h"
+#include "hardware/i2c.h"
+#include "hardware/gpio.h"
+
+#define _BUS_COUNT 2
+#define _FIFO_DEPTH 16
+#define _MAX_DEVICES 16
+#define _MAX_TARGETS 8
+
+#define _IDLE_DATA 0xFFFFFFFFu  // In DATA_CMD once a command was taken
+#define _SHOWN_RX 0x80000000u   // Marks a read byte put in DATA_CMD
+#define _TAR_DONE 0x80000000u   // Set in TAR once a transfer has ended
+
+struct i2c_inst {
+    uint index;
+};
+
+i2c_inst_t i2c0_inst = {0};
+i2c_inst_t i2c1_inst = {1};
+
+typedef struct {
+    i2c_hw_t hw;
+    bool initialized;
+    uint baudrate;
+    uint32_t shown;             // Value the stub last left in DATA_CMD
+
+    uint32_t tx[_FIFO_DEPTH];
+    int tx_count;
+    uint64_t tx_time_ps;        // When the oldest command was taken
+    uint8_t rx[_FIFO_DEPTH];
+    int rx_count;
+
+    bool active;                // Between start and stop
+    bool reading;
+    bool ended;                 // Transfer over, until TAR is written again
+    uint64_t free_ps;           // When the bus is done with the last step
+    stub_i2c_device_t* targets[_MAX_TARGETS];
+    int target_count;
+
+    stub_i2c_device_t* devices[_MAX_DEVICES];
+    int device_count;
+    uint32_t transfers;
+    uint32_t clashes;
+} _bus_t;
+
+static _bus_t _buses[_BUS_COUNT];
+
+void stub_i2c_reset(void) {
+    memset(_buses, 0, sizeof(_buses));
+
+    for (int i = 0; i < _BUS_COUNT; i++) {
+        _buses[i].hw.data_cmd = _IDLE_DATA;
+        _buses[i].shown = _IDLE_DATA;
+        _buses[i].baudrate = 100000;
+    }
+}
+
+void stub_i2c_attach(uint bus, stub_i2c_device_t* device) {
+    _bus_t* b = &_buses[bus];
+
+    if (b->device_count == _MAX_DEVICES) {
+        fprintf(stderr, "sdk_stub: too many I2C devices\n");
+        abort();
+    }
+
+    b->devices[b->device_count++] = device;
+}
+
+uint32_t stub_i2c_transfers(uint bus) {
+    return _buses[bus].transfers;
+}
+
+uint32_t stub_i2c_clashes(uint bus) {
+    return _buses[bus].clashes;
+}
+
+static uint64_t _bit_ps(const _bus_t* b) {
+    return 1000000000000ull / b->baudrate;
+}
+
+// SDA pin of a bus, or -1 if no pin has its I2C function
+static int _sda_pin(uint bus) {
+    for (uint pin = 0; pin < STUB_GPIO_COUNT; pin += 2) {
+        if (gpio_get_function(pin) == GPIO_FUNC_I2C && ((pin >> 1) & 1) == bus) {
+            return pin;
+        }
+    }
+
+    return -1;
+}
+
+static void _find_targets(_bus_t* b, uint8_t addr) {
+    b->target_count = 0;
+
+    for (int i = 0; i < b->device_count; i++) {
+        stub_i2c_device_t* device = b->devices[i];
+
+        if (device->addr == addr && b->target_count < _MAX_TARGETS) {
+            b->targets[b->target_count++] = device;
+        }
+
+        if (device->route) {
+            b->target_count += device->route(device, addr, b->targets + b->target_count,
+                                             _MAX_TARGETS - b->target_count);
+        }
+    }
+
+    if (b->target_count > 1) {
+        b->clashes++;
+    }
+}
+
+// True if a target of the transfer is holding SCL low
+static bool _stretched(_bus_t* b) {
+    for (int i = 0; i < b->target_count; i++) {
+        if (b->targets[i]->stretches && b->targets[i]->stretches(b->targets[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void _end(_bus_t* b, uint32_t intr) {
+    for (int i = 0; i < b->target_count; i++) {
+        if (b->targets[i]->stop) {
+            b->targets[i]->stop(b->targets[i]);
+        }
+    }
+
+    b->hw.raw_intr_stat |= intr;
+    b->hw.tar |= _TAR_DONE;
+    b->active = false;
+    b->ended = true;
+    b->tx_count = 0;
+    b->target_count = 0;
+}
+
+static void _abort(_bus_t* b, uint32_t source) {
+    b->hw.tx_abrt_source |= source;
+    _end(b, I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_RAW_INTR_STAT_STOP_DET_BITS);
+}
+
+// Addresses the target for the direction of the next command.
+// Returns false if nobody answered.
+static bool _address(_bus_t* b, bool read) {
+    if (!b->active) {
+        _find_targets(b, b->hw.tar & 0x7F);
+        b->transfers++;
+        b->active = true;
+    }
+
+    bool ack = false;
+
+    for (int i = 0; i < b->target_count; i++) {
+        stub_i2c_device_t* device = b->targets[i];
+
+        if (!device->start || device->start(device, read)) {
+            ack = true;
+        }
+    }
+
+    b->reading = read;
+
+    return ack;
+}
+
+// Runs the bus up to the current time, one command at a time
+static void _advance(uint bus) {
+    _bus_t* b = &_buses[bus];
+    uint64_t now_ps = stub_now_ps();
+
+    while (b->tx_count > 0 && !b->ended) {
+        uint32_t cmd = b->tx[0];
+        bool read = cmd & I2C_IC_DATA_CMD_CMD_BITS;
+        bool address = !b->active || read != b->reading || (cmd & I2C_IC_DATA_CMD_RESTART_BITS);
+        uint64_t begin_ps = MAX(b->free_ps, b->tx_time_ps);
+        uint64_t end_ps = begin_ps + 9 * _bit_ps(b);
+
+        // A full RX FIFO holds SCL low until there is room
+        if (read && b->rx_count == _FIFO_DEPTH) {
+            return;
+        }
+
+        // The bus time starts over once the target lets go
+        if (b->active && _stretched(b)) {
+            b->free_ps = now_ps;
+            return;
+        }
+
+        if (address) {
+            end_ps += 10 * _bit_ps(b);
+        }
+        if (cmd & I2C_IC_DATA_CMD_STOP_BITS) {
+            end_ps += _bit_ps(b);
+        }
+
+        if (end_ps > now_ps) {
+            return;
+        }
+
+        b->free_ps = end_ps;
+        b->tx_time_ps = end_ps;
+
+        if (address && !b->active) {
+            int sda = _sda_pin(bus);
+
+            if (sda >= 0 && !stub_gpio_level(sda)) {
+                b->hw.tx_abrt_source |= I2C_IC_TX_ABRT_SOURCE_ARB_LOST_BITS;
+                b->hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+                b->hw.tar |= _TAR_DONE;
+                b->ended = true;
+                b->tx_count = 0;
+                return;
+            }
+        }
+
+        if (address && !_address(b, read)) {
+            _abort(b, I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS);
+            return;
+        }
+
+        memmove(b->tx, b->tx + 1, --b->tx_count * sizeof(b->tx[0]));
+
+        if (read) {
+            uint8_t byte = 0xFF;
+
+            for (int i = 0; i < b->target_count; i++) {
+                if (b->targets[i]->read) {
+                    byte &= b->targets[i]->read(b->targets[i]);
+                }
+            }
+
+            b->rx[b->rx_count++] = byte;
+        } else {
+            bool ack = false;
+
+            for (int i = 0; i < b->target_count; i++) {
+                if (b->targets[i]->write && b->targets[i]->write(b->targets[i], cmd & 0xFF)) {
+                    ack = true;
+                }
+            }
+
+            if (!ack) {
+                _abort(b, I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS);
+                return;
+            }
+        }
+
+        if (cmd & I2C_IC_DATA_CMD_STOP_BITS) {
+            _end(b, I2C_IC_RAW_INTR_STAT_STOP_DET_BITS);
+        }
+    }
+}
+
+// Looks at what the code under test stored in the registers
+static void _sync(uint bus) {
+    _bus_t* b = &_buses[bus];
+
+    if (!b->initialized || !(b->hw.enable & I2C_IC_ENABLE_ENABLE_BITS)) {
+        return;
+    }
+
+    // TAR written for a new transfer
+    if (b->ended && !(b->hw.tar & _TAR_DONE)) {
+        b->ended = false;
+        b->hw.raw_intr_stat = 0;
+        b->hw.tx_abrt_source = 0;
+    }
+
+    if (b->hw.data_cmd != b->shown) {
+        if (b->ended) {
+            // Flushed, as after an abort until it is cleared
+        } else if (b->tx_count < _FIFO_DEPTH) {
+            if (b->tx_count == 0) {
+                b->tx_time_ps = stub_now_ps();
+            }
+            b->tx[b->tx_count++] = b->hw.data_cmd & 0x7FF;
+        }
+
+        b->hw.data_cmd = _IDLE_DATA;
+        b->shown = _IDLE_DATA;
+    }
+
+    _advance(bus);
+}
+
+void stub_i2c_sync(void) {
+    for (uint bus = 0; bus < _BUS_COUNT; bus++) {
+        _sync(bus);
+    }
+}
+
+// hardware/i2c.h
+
+i2c_hw_t* i2c_get_hw(i2c_inst_t* i2c) {
+    return &_buses[i2c->index].hw;
+}
+
+uint i2c_hw_index(i2c_inst_t* i2c) {
+    return i2c->index;
+}
+
+i2c_inst_t* i2c_get_instance(uint num) {
+    return num ? i2c1 : i2c0;
+}
+
+uint i2c_init(i2c_inst_t* i2c, uint baudrate) {
+    _bus_t* b = &_buses[i2c->index];
+
+    b->initialized = true;
+    b->hw.enable = I2C_IC_ENABLE_ENABLE_BITS;
+    b->hw.raw_intr_stat = 0;
+    b->hw.tx_abrt_source = 0;
+    b->hw.data_cmd = _IDLE_DATA;
+    b->shown = _IDLE_DATA;
+    b->tx_count = 0;
+    b->rx_count = 0;
+    b->active = false;
+    b->ended = false;
+    b->target_count = 0;
+
+    return i2c_set_baudrate(i2c, baudrate);
+}
+
+void i2c_deinit(i2c_inst_t* i2c) {
+    _bus_t* b = &_buses[i2c->index];
+
+    b->initialized = false;
+    b->hw.enable = 0;
+    b->tx_count = 0;
+    b->rx_count = 0;
+    b->active = false;
+    b->target_count = 0;
+}
+
+uint i2c_set_baudrate(i2c_inst_t* i2c, uint baudrate) {
+    _buses[i2c->index].baudrate = baudrate;
+
+    return baudrate;
+}
+
+size_t i2c_get_write_available(i2c_inst_t* i2c) {
+    _sync(i2c->index);
+
+    return _FIFO_DEPTH - _buses[i2c->index].tx_count;
+}
+
+size_t i2c_get_read_available(i2c_inst_t* i2c) {
+    _bus_t* b = &_buses[i2c->index];
+
+    _sync(i2c->index);
+
+    if (b->rx_count == 0) {
+        return 0;
+    }
+
+    // The byte shown counts as read
+    b->shown = _SHOWN_RX | b->rx[0];
+    b->hw.data_cmd = b->shown;
+    memmove(b->rx, b->rx + 1, --b->rx_count);
+
+    return b->rx_count + 1;
+}
+
+// Blocking transfers, as in the SDK but always ending with a stop
+static int _transfer(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, uint8_t* dst, size_t len,
+                     uint64_t until_us) {
+    i2c_hw_t* hw = i2c_get_hw(i2c);
+    size_t sent = 0;
+    size_t received = 0;
+
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = 1;
+
+    while (true) {
+        if (sent < len && i2c_get_write_available(i2c) > 0) {
+            uint32_t cmd = src ? src[sent] : I2C_IC_DATA_CMD_CMD_BITS;
+
+            if (sent == len - 1) {
+                cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+            }
+
+            hw->data_cmd = cmd;
+            sent++;
+            continue;
+        }
+
+        while (dst && received < len && i2c_get_read_available(i2c) > 0) {
+            dst[received++] = (uint8_t)hw->data_cmd;
+        }
+
+        if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+            return PICO_ERROR_GENERIC;
+        }
+
+        if ((hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS) && (!dst || received == len)) {
+            return len;
+        }
+
+        if (stub_now_us() >= until_us) {
+            return PICO_ERROR_TIMEOUT;
+        }
+
+        stub_advance_us(1);
+        _sync(i2c->index);
+    }
+}
+
+int i2c_write_blocking_until(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop,
+                             absolute_time_t until) {
+    return _transfer(i2c, addr, src, NULL, len, to_us_since_boot(until));
+}
+
+int i2c_read_blocking_until(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop,
+                            absolute_time_t until) {
+    return _transfer(i2c, addr, NULL, dst, len, to_us_since_boot(until));
+}
+
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop,
+                         uint timeout_us) {
+    return _transfer(i2c, addr, src, NULL, len, stub_now_us() + timeout_us);
+}
+
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop,
+                        uint timeout_us) {
+    return _transfer(i2c, addr, NULL, dst, len, stub_now_us() + timeout_us);
+}
+
+int i2c_write_blocking(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop) {
+    return _transfer(i2c, addr, src, NULL, len, UINT64_MAX);
+}
+
+int i2c_read_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop) {
+    return _transfer(i2c, addr, NULL, dst, len, UINT64_MAX);
+}
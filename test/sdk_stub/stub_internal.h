@@ -0,0 +1,58 @@
+#ifndef STUB_INTERNAL_H
+#define STUB_INTERNAL_H
+
+#include "pico/types.h"
+#include "hardware/pio.h"
+
+// Shared between the stub modules
+
+// Runs pending IRQs and due alarms if interrupts may run now
+void stub_service_interrupts(void);
+
+uint64_t stub_now_us(void);
+
+// Peripheral models, reset by stub_reset()
+void stub_gpio_reset(void);
+void stub_pio_reset(void);
+void stub_clocks_reset(void);
+void stub_dma_reset(void);
+void stub_i2c_reset(void);
+void stub_spi_reset(void);
+
+// Lets the I2C controllers see what was stored in their registers
+// and runs their buses up to now
+void stub_i2c_sync(void);
+
+// Tells devices and edge IRQs about pin changes
+void stub_gpio_update(void);
+
+// Level a PIO block drives a pin to, or -1 if it does not drive it
+int stub_pio_pin_drive(uint pio_index, uint pin);
+
+// Runs the PIO blocks up to a time. Returns early, with the time
+// reached, if they raised an interrupt.
+uint64_t stub_pio_run_until_ps(uint64_t time_ps);
+
+// True while any SM could still change something on its own
+bool stub_pio_busy(void);
+
+// Time of the PIO cycle being run, if one is
+uint64_t stub_pio_time_ps(bool* running);
+
+// Finds the SM whose FIFO register an address is in
+bool stub_pio_fifo_address(const volatile void* address, PIO* pio, uint* sm, bool* is_tx);
+
+bool stub_pio_dreq_ready(uint dreq);
+
+// Moves whatever data the DMA channels can move now
+void stub_dma_service(void);
+
+// True if a busy channel writes to the address
+bool stub_dma_feeds(const volatile void* address);
+
+bool stub_dma_busy(void);
+
+// True if an IRQ is waiting which should stop the PIO run
+bool stub_irq_waiting(void);
+
+#endif
@@ -0,0 +1,1014 @@
+/*
+
+PIO stub: runs PIO programs cycle by cycle on the virtual clock.
+
+Each SM executes from the instruction memory with the configuration
+written by pio_sm_init(), at clk_sys divided by its clock divider.
+Side-set, delays, wrap, stalls, autopull/autopush, FIFO joins and
+IRQ flags follow the RP2040 datasheet. Pins an SM drives reach the
+GPIO model when the pin's function is that PIO block.
+
+An SM stalled on an empty TX FIFO which nothing can fill is skipped
+over, so idle SMs cost nothing while time moves on.
+
+*/
+
+#include "sdk_stub.h"
+#include "stub_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+
+#define _FIFO_DEPTH 4
+
+// CLKDIV
+#define _CLKDIV_INT_LSB 16
+#define _CLKDIV_FRAC_LSB 8
+
+// EXECCTRL
+#define _EXEC_SIDE_EN (1u << 30)
+#define _EXEC_SIDE_PINDIR (1u << 29)
+#define _EXEC_JMP_PIN_LSB 24
+#define _EXEC_WRAP_TOP_LSB 12
+#define _EXEC_WRAP_BOTTOM_LSB 7
+
+// SHIFTCTRL
+#define _SHIFT_FJOIN_RX (1u << 31)
+#define _SHIFT_FJOIN_TX (1u << 30)
+#define _SHIFT_PULL_THRESH_LSB 25
+#define _SHIFT_PUSH_THRESH_LSB 20
+#define _SHIFT_OUT_RIGHT (1u << 19)
+#define _SHIFT_IN_RIGHT (1u << 18)
+#define _SHIFT_AUTOPULL (1u << 17)
+#define _SHIFT_AUTOPUSH (1u << 16)
+
+// PINCTRL
+#define _PIN_SIDESET_COUNT_LSB 29
+#define _PIN_SET_COUNT_LSB 26
+#define _PIN_OUT_COUNT_LSB 20
+#define _PIN_IN_BASE_LSB 15
+#define _PIN_SIDESET_BASE_LSB 10
+#define _PIN_SET_BASE_LSB 5
+#define _PIN_OUT_BASE_LSB 0
+
+#define _FIELD(reg, lsb, bits) (((reg) >> (lsb)) & ((1u << (bits)) - 1))
+
+typedef struct {
+    bool claimed;
+    bool enabled;
+    uint8_t pc;
+    uint32_t x, y, osr, isr;
+    uint8_t osr_count;          // Bits shifted out of the OSR, 32 when empty
+    uint8_t isr_count;          // Bits shifted into the ISR
+    uint32_t tx[2 * _FIFO_DEPTH];
+    uint32_t rx[2 * _FIFO_DEPTH];
+    uint8_t tx_count, rx_count;
+    uint8_t delay;              // Delay cycles left
+    bool irq_waiting;           // In an IRQ WAIT for its flag to clear
+    uint64_t next_ps;           // Time of the next cycle
+    uint64_t cycles;
+} _sm_t;
+
+typedef struct {
+    _sm_t sm[4];
+    uint32_t used_instructions;
+    uint32_t pad_out;
+    uint32_t pad_oe;
+    uint32_t pads;              // Pins whose function is this block
+} _pio_t;
+
+pio_hw_t stub_pio_hw[2];
+static _pio_t _pios[2];
+
+static bool _running;
+static uint64_t _run_time_ps;
+
+static uint _index(PIO pio) {
+    return pio == pio0 ? 0 : 1;
+}
+
+static _sm_t* _sm(PIO pio, uint sm) {
+    return &_pios[_index(pio)].sm[sm];
+}
+
+static uint _tx_depth(PIO pio, uint sm) {
+    uint32_t shiftctrl = pio->sm[sm].shiftctrl;
+
+    return shiftctrl & _SHIFT_FJOIN_TX ? 2 * _FIFO_DEPTH : shiftctrl & _SHIFT_FJOIN_RX ? 0 : _FIFO_DEPTH;
+}
+
+static uint _rx_depth(PIO pio, uint sm) {
+    uint32_t shiftctrl = pio->sm[sm].shiftctrl;
+
+    return shiftctrl & _SHIFT_FJOIN_RX ? 2 * _FIFO_DEPTH : shiftctrl & _SHIFT_FJOIN_TX ? 0 : _FIFO_DEPTH;
+}
+
+static uint _threshold(uint32_t shiftctrl, uint lsb) {
+    uint thresh = _FIELD(shiftctrl, lsb, 5);
+
+    return thresh ? thresh : 32;
+}
+
+static uint64_t _cycle_ps(PIO pio, uint sm) {
+    uint32_t clkdiv = pio->sm[sm].clkdiv;
+    uint64_t div_int = clkdiv >> _CLKDIV_INT_LSB;
+    uint64_t div_fixed = ((div_int ? div_int : 65536) << 8) | _FIELD(clkdiv, _CLKDIV_FRAC_LSB, 8);
+
+    return (div_fixed * 1000000000000ull + (uint64_t)clock_get_hz(clk_sys) * 128) / ((uint64_t)clock_get_hz(clk_sys) * 256);
+}
+
+void stub_pio_reset(void) {
+    memset(stub_pio_hw, 0, sizeof(stub_pio_hw));
+    memset(_pios, 0, sizeof(_pios));
+    _running = false;
+}
+
+uint64_t stub_pio_cycles(uint pio_index, uint sm) {
+    return _pios[pio_index].sm[sm].cycles;
+}
+
+int stub_pio_pin_drive(uint pio_index, uint pin) {
+    const _pio_t* block = &_pios[pio_index];
+
+    if (!(block->pad_oe & (1u << pin))) {
+        return -1;
+    }
+
+    return (block->pad_out >> pin) & 1;
+}
+
+uint64_t stub_pio_time_ps(bool* running) {
+    *running = _running;
+    return _run_time_ps;
+}
+
+// Writes 'count' bits of 'value' to the pins from 'base', wrapping at 32
+static void _write_pins(uint32_t* pads, uint base, uint count, uint32_t value) {
+    for (uint i = 0; i < count; i++) {
+        uint pin = (base + i) % 32;
+
+        if (value & (1u << i)) {
+            *pads |= 1u << pin;
+        } else {
+            *pads &= ~(1u << pin);
+        }
+    }
+}
+
+static uint32_t _read_pins(uint base) {
+    uint32_t value = 0;
+
+    for (uint i = 0; i < 32; i++) {
+        uint pin = (base + i) % 32;
+
+        if (pin < STUB_GPIO_COUNT && stub_gpio_level(pin)) {
+            value |= 1u << i;
+        }
+    }
+
+    return value;
+}
+
+static uint32_t _reverse(uint32_t value) {
+    uint32_t reversed = 0;
+
+    for (int i = 0; i < 32; i++) {
+        reversed |= ((value >> i) & 1) << (31 - i);
+    }
+
+    return reversed;
+}
+
+static bool _tx_pop(PIO pio, uint sm, uint32_t* value) {
+    _sm_t* state = _sm(pio, sm);
+
+    if (!state->tx_count) {
+        return false;
+    }
+
+    *value = state->tx[0];
+    memmove(state->tx, state->tx + 1, --state->tx_count * sizeof(uint32_t));
+
+    return true;
+}
+
+static bool _rx_push(PIO pio, uint sm, uint32_t value) {
+    _sm_t* state = _sm(pio, sm);
+
+    if (state->rx_count >= _rx_depth(pio, sm)) {
+        return false;
+    }
+
+    state->rx[state->rx_count++] = value;
+
+    return true;
+}
+
+static uint _irq_index(uint sm, uint index) {
+    if (index & 0x10) {
+        return (index & 0x4) | ((index + sm) & 0x3);
+    }
+
+    return index & 0x7;
+}
+
+// Executes one instruction. Returns false if it stalled.
+static bool _execute(PIO pio, uint sm, uint16_t instr, bool* jumped) {
+    uint block_index = _index(pio);
+    _pio_t* block = &_pios[block_index];
+    _sm_t* state = _sm(pio, sm);
+    uint32_t execctrl = pio->sm[sm].execctrl;
+    uint32_t shiftctrl = pio->sm[sm].shiftctrl;
+    uint32_t pinctrl = pio->sm[sm].pinctrl;
+    uint op = instr >> 13;
+    uint arg1 = (instr >> 5) & 0x7;
+    uint arg2 = instr & 0x1f;
+    uint count = arg2 ? arg2 : 32;
+    uint32_t mask = count == 32 ? 0xFFFFFFFF : (1u << count) - 1;
+
+    *jumped = false;
+
+    switch (op) {
+    case 0: {   // JMP
+        bool take;
+
+        switch (arg1) {
+        case 0: take = true; break;
+        case 1: take = state->x == 0; break;
+        case 2: take = state->x != 0; state->x--; break;
+        case 3: take = state->y == 0; break;
+        case 4: take = state->y != 0; state->y--; break;
+        case 5: take = state->x != state->y; break;
+        case 6: take = stub_gpio_level(_FIELD(execctrl, _EXEC_JMP_PIN_LSB, 5)); break;
+        default: take = state->osr_count < _threshold(shiftctrl, _SHIFT_PULL_THRESH_LSB); break;
+        }
+
+        if (take) {
+            state->pc = arg2;
+            *jumped = true;
+        }
+        return true;
+    }
+
+    case 1: {   // WAIT
+        bool polarity = (instr >> 7) & 1;
+        uint source = (instr >> 5) & 0x3;
+        bool level;
+
+        if (source == 0) {
+            level = stub_gpio_level(arg2);
+        } else if (source == 1) {
+            level = stub_gpio_level((_FIELD(pinctrl, _PIN_IN_BASE_LSB, 5) + arg2) % 32);
+        } else {
+            uint flag = _irq_index(sm, arg2);
+
+            level = (pio->irq >> flag) & 1;
+
+            if (polarity && level) {
+                pio->irq &= ~(1u << flag);
+            }
+        }
+
+        return level == polarity;
+    }
+
+    case 2: {   // IN
+        bool right = shiftctrl & _SHIFT_IN_RIGHT;
+        uint thresh = _threshold(shiftctrl, _SHIFT_PUSH_THRESH_LSB);
+        bool autopush = shiftctrl & _SHIFT_AUTOPUSH;
+        uint32_t data;
+
+        if (autopush && state->isr_count + count >= thresh && state->rx_count >= _rx_depth(pio, sm)) {
+            return false;
+        }
+
+        switch (arg1) {
+        case 0: data = _read_pins(_FIELD(pinctrl, _PIN_IN_BASE_LSB, 5)); break;
+        case 1: data = state->x; break;
+        case 2: data = state->y; break;
+        case 6: data = state->isr; break;
+        case 7: data = state->osr; break;
+        default: data = 0; break;
+        }
+
+        data &= mask;
+
+        if (count == 32) {
+            state->isr = data;
+        } else if (right) {
+            state->isr = (state->isr >> count) | (data << (32 - count));
+        } else {
+            state->isr = (state->isr << count) | data;
+        }
+
+        state->isr_count = MIN(32, state->isr_count + count);
+
+        if (autopush && state->isr_count >= thresh) {
+            _rx_push(pio, sm, state->isr);
+            state->isr = 0;
+            state->isr_count = 0;
+        }
+        return true;
+    }
+
+    case 3: {   // OUT
+        bool right = shiftctrl & _SHIFT_OUT_RIGHT;
+        uint thresh = _threshold(shiftctrl, _SHIFT_PULL_THRESH_LSB);
+
+        if ((shiftctrl & _SHIFT_AUTOPULL) && state->osr_count >= thresh) {
+            if (!_tx_pop(pio, sm, &state->osr)) {
+                return false;
+            }
+
+            state->osr_count = 0;
+        }
+
+        uint32_t data;
+
+        if (count == 32) {
+            data = state->osr;
+            state->osr = 0;
+        } else if (right) {
+            data = state->osr & mask;
+            state->osr >>= count;
+        } else {
+            data = state->osr >> (32 - count);
+            state->osr <<= count;
+        }
+
+        state->osr_count = MIN(32, state->osr_count + count);
+
+        // The bits are zero-extended to 32, so every OUT pin is written
+        switch (arg1) {
+        case 0:
+            _write_pins(&block->pad_out, _FIELD(pinctrl, _PIN_OUT_BASE_LSB, 5),
+                        _FIELD(pinctrl, _PIN_OUT_COUNT_LSB, 6), data);
+            break;
+        case 1: state->x = data; break;
+        case 2: state->y = data; break;
+        case 4:
+            _write_pins(&block->pad_oe, _FIELD(pinctrl, _PIN_OUT_BASE_LSB, 5),
+                        _FIELD(pinctrl, _PIN_OUT_COUNT_LSB, 6), data);
+            break;
+        case 5: state->pc = data & 0x1f; *jumped = true; break;
+        case 6: state->isr = data; state->isr_count = count; break;
+        default: break;
+        }
+        return true;
+    }
+
+    case 4: {
+        bool if_flag = (instr >> 6) & 1;
+        bool block_flag = (instr >> 5) & 1;
+
+        if (instr & 0x80) {     // PULL
+            if (if_flag && state->osr_count < _threshold(shiftctrl, _SHIFT_PULL_THRESH_LSB)) {
+                return true;
+            }
+
+            if (!_tx_pop(pio, sm, &state->osr)) {
+                if (block_flag) {
+                    return false;
+                }
+
+                state->osr = state->x;
+            }
+
+            state->osr_count = 0;
+            return true;
+        }
+
+        // PUSH
+        if (if_flag && state->isr_count < _threshold(shiftctrl, _SHIFT_PUSH_THRESH_LSB)) {
+            return true;
+        }
+
+        if (state->rx_count >= _rx_depth(pio, sm) && block_flag) {
+            return false;
+        }
+
+        _rx_push(pio, sm, state->isr);
+        state->isr = 0;
+        state->isr_count = 0;
+        return true;
+    }
+
+    case 5: {   // MOV
+        uint operation = (instr >> 3) & 0x3;
+        uint source = instr & 0x7;
+        uint32_t data;
+
+        switch (source) {
+        case 0: data = _read_pins(_FIELD(pinctrl, _PIN_IN_BASE_LSB, 5)); break;
+        case 1: data = state->x; break;
+        case 2: data = state->y; break;
+        case 6: data = state->isr; break;
+        case 7: data = state->osr; break;
+        default: data = 0; break;
+        }
+
+        if (operation == 1) {
+            data = ~data;
+        } else if (operation == 2) {
+            data = _reverse(data);
+        }
+
+        switch (arg1) {
+        case 0:
+            _write_pins(&block->pad_out, _FIELD(pinctrl, _PIN_OUT_BASE_LSB, 5),
+                        _FIELD(pinctrl, _PIN_OUT_COUNT_LSB, 6), data);
+            break;
+        case 1: state->x = data; break;
+        case 2: state->y = data; break;
+        case 5: state->pc = data & 0x1f; *jumped = true; break;
+        case 6: state->isr = data; state->isr_count = 0; break;
+        case 7: state->osr = data; state->osr_count = 0; break;
+        default: break;
+        }
+        return true;
+    }
+
+    case 6: {   // IRQ
+        bool clear = (instr >> 6) & 1;
+        bool wait = (instr >> 5) & 1;
+        uint flag = _irq_index(sm, arg2);
+
+        if (clear) {
+            pio->irq &= ~(1u << flag);
+            return true;
+        }
+
+        if (state->irq_waiting) {
+            if (pio->irq & (1u << flag)) {
+                return false;
+            }
+
+            state->irq_waiting = false;
+            return true;
+        }
+
+        pio->irq |= 1u << flag;
+
+        if (wait) {
+            state->irq_waiting = true;
+            return false;
+        }
+        return true;
+    }
+
+    default: {  // SET
+        uint base = _FIELD(pinctrl, _PIN_SET_BASE_LSB, 5);
+        uint pins = _FIELD(pinctrl, _PIN_SET_COUNT_LSB, 3);
+
+        switch (arg1) {
+        case 0: _write_pins(&block->pad_out, base, pins, arg2); break;
+        case 1: state->x = arg2; break;
+        case 2: state->y = arg2; break;
+        case 4: _write_pins(&block->pad_oe, base, pins, arg2); break;
+        default: break;
+        }
+        return true;
+    }
+    }
+}
+
+// Applies the side-set of an instruction. Returns its delay.
+static uint _side_set(PIO pio, uint sm, uint16_t instr) {
+    _pio_t* block = &_pios[_index(pio)];
+    uint32_t execctrl = pio->sm[sm].execctrl;
+    uint32_t pinctrl = pio->sm[sm].pinctrl;
+    uint side_count = _FIELD(pinctrl, _PIN_SIDESET_COUNT_LSB, 3);
+    uint field = (instr >> 8) & 0x1f;
+    uint delay_bits = 5 - side_count;
+    uint delay = field & ((1u << delay_bits) - 1);
+
+    if (!side_count) {
+        return delay;
+    }
+
+    uint side = field >> delay_bits;
+    uint side_bits = side_count;
+
+    if (execctrl & _EXEC_SIDE_EN) {
+        side_bits--;
+
+        if (!(side & (1u << side_bits))) {
+            return delay;
+        }
+
+        side &= (1u << side_bits) - 1;
+    }
+
+    uint32_t* pads = execctrl & _EXEC_SIDE_PINDIR ? &block->pad_oe : &block->pad_out;
+
+    _write_pins(pads, _FIELD(pinctrl, _PIN_SIDESET_BASE_LSB, 5), side_bits, side);
+
+    return delay;
+}
+
+static void _step(PIO pio, uint sm) {
+    _sm_t* state = _sm(pio, sm);
+
+    state->cycles++;
+
+    if (state->delay) {
+        state->delay--;
+        return;
+    }
+
+    uint16_t instr = pio->instr_mem[state->pc];
+    uint delay = _side_set(pio, sm, instr);
+    bool jumped;
+
+    if (!_execute(pio, sm, instr, &jumped)) {
+        stub_gpio_update();
+        return;
+    }
+
+    state->delay = delay;
+
+    if (!jumped) {
+        uint32_t execctrl = pio->sm[sm].execctrl;
+
+        if (state->pc == _FIELD(execctrl, _EXEC_WRAP_TOP_LSB, 5)) {
+            state->pc = _FIELD(execctrl, _EXEC_WRAP_BOTTOM_LSB, 5);
+        } else {
+            state->pc = (state->pc + 1) % 32;
+        }
+    }
+
+    stub_gpio_update();
+}
+
+// True if the SM waits for a word nobody is going to give it
+static bool _starved(PIO pio, uint sm) {
+    _sm_t* state = _sm(pio, sm);
+
+    if (state->delay || state->tx_count || stub_dma_feeds(&pio->txf[sm])) {
+        return false;
+    }
+
+    uint16_t instr = pio->instr_mem[state->pc];
+    uint op = instr >> 13;
+    uint32_t shiftctrl = pio->sm[sm].shiftctrl;
+
+    if (op == 4 && (instr & 0xa0) == 0xa0) {
+        return !((instr >> 6) & 1) || state->osr_count >= _threshold(shiftctrl, _SHIFT_PULL_THRESH_LSB);
+    }
+
+    return op == 3 && (shiftctrl & _SHIFT_AUTOPULL)
+        && state->osr_count >= _threshold(shiftctrl, _SHIFT_PULL_THRESH_LSB);
+}
+
+bool stub_pio_busy(void) {
+    for (uint p = 0; p < 2; p++) {
+        for (uint sm = 0; sm < 4; sm++) {
+            if (_pios[p].sm[sm].enabled && !_starved(&stub_pio_hw[p], sm)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+uint64_t stub_pio_run_until_ps(uint64_t time_ps) {
+    if (_running) {
+        return time_ps;
+    }
+
+    _running = true;
+
+    while (1) {
+        PIO next_pio = NULL;
+        uint next_sm = 0;
+        uint64_t next_ps = time_ps;
+
+        for (uint p = 0; p < 2; p++) {
+            for (uint sm = 0; sm < 4; sm++) {
+                _sm_t* state = &_pios[p].sm[sm];
+
+                if (!state->enabled) {
+                    continue;
+                }
+
+                if (state->next_ps <= time_ps && _starved(&stub_pio_hw[p], sm)) {
+                    state->next_ps = time_ps + 1;
+                    continue;
+                }
+
+                if (state->next_ps <= next_ps) {
+                    next_ps = state->next_ps;
+                    next_pio = &stub_pio_hw[p];
+                    next_sm = sm;
+                }
+            }
+        }
+
+        if (!next_pio) {
+            break;
+        }
+
+        _run_time_ps = next_ps;
+        _step(next_pio, next_sm);
+        stub_dma_service();
+        _sm(next_pio, next_sm)->next_ps += _cycle_ps(next_pio, next_sm);
+
+        if (stub_irq_waiting()) {
+            _running = false;
+            return next_ps;
+        }
+    }
+
+    _running = false;
+
+    return time_ps;
+}
+
+// SDK API
+
+static bool _can_add(PIO pio, const pio_program_t* program, uint* offset) {
+    uint32_t mask = (program->length == 32 ? 0xFFFFFFFF : (1u << program->length) - 1);
+    uint32_t used = _pios[_index(pio)].used_instructions;
+
+    if (program->origin >= 0) {
+        *offset = program->origin;
+        return !(used & (mask << program->origin));
+    }
+
+    // Like the SDK, programs are placed as high as they fit
+    for (int at = 32 - program->length; at >= 0; at--) {
+        if (!(used & (mask << at))) {
+            *offset = at;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t* program) {
+    uint offset;
+
+    return _can_add(pio, program, &offset);
+}
+
+uint pio_add_program(PIO pio, const pio_program_t* program) {
+    uint offset;
+
+    if (!_can_add(pio, program, &offset)) {
+        fprintf(stderr, "stub_pio: no program space\n");
+        abort();
+    }
+
+    for (uint i = 0; i < program->length; i++) {
+        uint16_t instr = program->instructions[i];
+
+        // JMP targets are relative to the program
+        if ((instr >> 13) == 0) {
+            instr += offset;
+        }
+
+        pio->instr_mem[offset + i] = instr;
+    }
+
+    _pios[_index(pio)].used_instructions |= (program->length == 32 ? 0xFFFFFFFF : (1u << program->length) - 1) << offset;
+
+    return offset;
+}
+
+void pio_remove_program(PIO pio, const pio_program_t* program, uint offset) {
+    _pios[_index(pio)].used_instructions &= ~(((program->length == 32 ? 0xFFFFFFFF : (1u << program->length) - 1)) << offset);
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    for (uint sm = 0; sm < 4; sm++) {
+        if (!_sm(pio, sm)->claimed) {
+            _sm(pio, sm)->claimed = true;
+            return sm;
+        }
+    }
+
+    if (required) {
+        fprintf(stderr, "stub_pio: no free SM\n");
+        abort();
+    }
+
+    return -1;
+}
+
+void pio_sm_claim(PIO pio, uint sm) {
+    _sm(pio, sm)->claimed = true;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+    _sm(pio, sm)->claimed = false;
+}
+
+void pio_gpio_init(PIO pio, uint pin) {
+    gpio_set_function(pin, pio == pio0 ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1);
+}
+
+uint pio_get_index(PIO pio) {
+    return _index(pio);
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    return _index(pio) * 8 + (is_tx ? 0 : 4) + sm;
+}
+
+pio_sm_config pio_get_default_sm_config(void) {
+    pio_sm_config c = {0};
+
+    c.clkdiv = 1u << _CLKDIV_INT_LSB;
+    sm_config_set_wrap(&c, 0, 31);
+    sm_config_set_in_shift(&c, true, false, 32);
+    sm_config_set_out_shift(&c, true, false, 32);
+
+    return c;
+}
+
+void sm_config_set_wrap(pio_sm_config* c, uint wrap_target, uint wrap) {
+    c->execctrl = (c->execctrl & ~((0x1fu << _EXEC_WRAP_TOP_LSB) | (0x1fu << _EXEC_WRAP_BOTTOM_LSB)))
+                | (wrap << _EXEC_WRAP_TOP_LSB) | (wrap_target << _EXEC_WRAP_BOTTOM_LSB);
+}
+
+void sm_config_set_clkdiv_int_frac(pio_sm_config* c, uint16_t div_int, uint8_t div_frac) {
+    c->clkdiv = ((uint32_t)div_int << _CLKDIV_INT_LSB) | ((uint32_t)div_frac << _CLKDIV_FRAC_LSB);
+}
+
+void sm_config_set_clkdiv(pio_sm_config* c, float div) {
+    uint16_t div_int = (uint16_t)div;
+    uint8_t div_frac = (uint8_t)((div - div_int) * 256);
+
+    sm_config_set_clkdiv_int_frac(c, div_int, div_frac);
+}
+
+void sm_config_set_set_pins(pio_sm_config* c, uint base, uint count) {
+    c->pinctrl = (c->pinctrl & ~((0x7u << _PIN_SET_COUNT_LSB) | (0x1fu << _PIN_SET_BASE_LSB)))
+               | (count << _PIN_SET_COUNT_LSB) | (base << _PIN_SET_BASE_LSB);
+}
+
+void sm_config_set_out_pins(pio_sm_config* c, uint base, uint count) {
+    c->pinctrl = (c->pinctrl & ~((0x3fu << _PIN_OUT_COUNT_LSB) | (0x1fu << _PIN_OUT_BASE_LSB)))
+               | (count << _PIN_OUT_COUNT_LSB) | (base << _PIN_OUT_BASE_LSB);
+}
+
+void sm_config_set_in_pins(pio_sm_config* c, uint base) {
+    c->pinctrl = (c->pinctrl & ~(0x1fu << _PIN_IN_BASE_LSB)) | (base << _PIN_IN_BASE_LSB);
+}
+
+void sm_config_set_sideset_pins(pio_sm_config* c, uint base) {
+    c->pinctrl = (c->pinctrl & ~(0x1fu << _PIN_SIDESET_BASE_LSB)) | (base << _PIN_SIDESET_BASE_LSB);
+}
+
+void sm_config_set_sideset(pio_sm_config* c, uint bits, bool optional, bool pindirs) {
+    c->pinctrl = (c->pinctrl & ~(0x7u << _PIN_SIDESET_COUNT_LSB)) | (bits << _PIN_SIDESET_COUNT_LSB);
+    c->execctrl = (c->execctrl & ~(_EXEC_SIDE_EN | _EXEC_SIDE_PINDIR))
+                | (optional ? _EXEC_SIDE_EN : 0) | (pindirs ? _EXEC_SIDE_PINDIR : 0);
+}
+
+void sm_config_set_in_shift(pio_sm_config* c, bool shift_right, bool autopush, uint threshold) {
+    c->shiftctrl = (c->shiftctrl & ~(_SHIFT_IN_RIGHT | _SHIFT_AUTOPUSH | (0x1fu << _SHIFT_PUSH_THRESH_LSB)))
+                 | (shift_right ? _SHIFT_IN_RIGHT : 0) | (autopush ? _SHIFT_AUTOPUSH : 0)
+                 | ((threshold & 0x1f) << _SHIFT_PUSH_THRESH_LSB);
+}
+
+void sm_config_set_out_shift(pio_sm_config* c, bool shift_right, bool autopull, uint threshold) {
+    c->shiftctrl = (c->shiftctrl & ~(_SHIFT_OUT_RIGHT | _SHIFT_AUTOPULL | (0x1fu << _SHIFT_PULL_THRESH_LSB)))
+                 | (shift_right ? _SHIFT_OUT_RIGHT : 0) | (autopull ? _SHIFT_AUTOPULL : 0)
+                 | ((threshold & 0x1f) << _SHIFT_PULL_THRESH_LSB);
+}
+
+void sm_config_set_jmp_pin(pio_sm_config* c, uint pin) {
+    c->execctrl = (c->execctrl & ~(0x1fu << _EXEC_JMP_PIN_LSB)) | (pin << _EXEC_JMP_PIN_LSB);
+}
+
+void sm_config_set_out_special(pio_sm_config* c, bool sticky, bool has_enable_pin, uint enable_pin_index) {
+}
+
+void sm_config_set_fifo_join(pio_sm_config* c, enum pio_fifo_join join) {
+    c->shiftctrl = (c->shiftctrl & ~(_SHIFT_FJOIN_TX | _SHIFT_FJOIN_RX))
+                 | (join == PIO_FIFO_JOIN_TX ? _SHIFT_FJOIN_TX : 0)
+                 | (join == PIO_FIFO_JOIN_RX ? _SHIFT_FJOIN_RX : 0);
+}
+
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config* c) {
+    pio->sm[sm].clkdiv = c->clkdiv;
+    pio->sm[sm].execctrl = c->execctrl;
+    pio->sm[sm].shiftctrl = c->shiftctrl;
+    pio->sm[sm].pinctrl = c->pinctrl;
+}
+
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config* c) {
+    pio_sm_set_enabled(pio, sm, false);
+    pio_sm_set_config(pio, sm, c);
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_clkdiv_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(initial_pc));
+
+    return 0;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    _sm_t* state = _sm(pio, sm);
+
+    if (enabled && !state->enabled) {
+        state->next_ps = stub_now_ps();
+        state->cycles = 0;
+    }
+
+    state->enabled = enabled;
+}
+
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac) {
+    pio->sm[sm].clkdiv = ((uint32_t)div_int << _CLKDIV_INT_LSB) | ((uint32_t)div_frac << _CLKDIV_FRAC_LSB);
+}
+
+void pio_sm_clkdiv_restart(PIO pio, uint sm) {
+}
+
+void pio_sm_restart(PIO pio, uint sm) {
+    _sm_t* state = _sm(pio, sm);
+
+    state->isr = 0;
+    state->isr_count = 0;
+    state->osr_count = 32;
+    state->delay = 0;
+    state->irq_waiting = false;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm) {
+    _sm(pio, sm)->tx_count = 0;
+    _sm(pio, sm)->rx_count = 0;
+}
+
+void pio_sm_drain_tx_fifo(PIO pio, uint sm) {
+    _sm(pio, sm)->tx_count = 0;
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+    bool jumped;
+
+    _side_set(pio, sm, instr);
+    _execute(pio, sm, instr, &jumped);
+    stub_gpio_update();
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm) {
+    return _sm(pio, sm)->pc;
+}
+
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t values, uint32_t mask) {
+    _pio_t* block = &_pios[_index(pio)];
+
+    block->pad_out = (block->pad_out & ~mask) | (values & mask);
+    stub_gpio_update();
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t dirs, uint32_t mask) {
+    _pio_t* block = &_pios[_index(pio)];
+
+    block->pad_oe = (block->pad_oe & ~mask) | (dirs & mask);
+    stub_gpio_update();
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint base, uint count, bool out) {
+    uint32_t mask = 0;
+
+    for (uint i = 0; i < count; i++) {
+        mask |= 1u << ((base + i) % 32);
+    }
+
+    pio_sm_set_pindirs_with_mask(pio, sm, out ? mask : 0, mask);
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) {
+    return _sm(pio, sm)->tx_count >= _tx_depth(pio, sm);
+}
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm) {
+    return _sm(pio, sm)->tx_count == 0;
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm) {
+    return _sm(pio, sm)->rx_count == 0;
+}
+
+bool pio_sm_is_rx_fifo_full(PIO pio, uint sm) {
+    return _sm(pio, sm)->rx_count >= _rx_depth(pio, sm);
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm) {
+    return _sm(pio, sm)->tx_count;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm) {
+    return _sm(pio, sm)->rx_count;
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+    _sm_t* state = _sm(pio, sm);
+
+    // A write to a full FIFO is lost, as on the chip
+    if (state->tx_count < _tx_depth(pio, sm)) {
+        state->tx[state->tx_count++] = data;
+    }
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm) {
+    _sm_t* state = _sm(pio, sm);
+
+    if (!state->rx_count) {
+        return 0xFFFFFFFF;
+    }
+
+    uint32_t data = state->rx[0];
+    memmove(state->rx, state->rx + 1, --state->rx_count * sizeof(uint32_t));
+
+    return data;
+}
+
+// Lets time pass until cond() holds, as a core spinning on it would
+static void _spin(PIO pio, uint sm, bool (*cond)(PIO, uint)) {
+    uint64_t give_up_us = stub_now_us() + 10000000;
+
+    while (!cond(pio, sm)) {
+        if (stub_now_us() > give_up_us) {
+            fprintf(stderr, "stub_pio: SM %u never got there\n", sm);
+            abort();
+        }
+
+        stub_advance_us(1);
+    }
+}
+
+static bool _tx_not_full(PIO pio, uint sm) {
+    return !pio_sm_is_tx_fifo_full(pio, sm);
+}
+
+static bool _rx_not_empty(PIO pio, uint sm) {
+    return !pio_sm_is_rx_fifo_empty(pio, sm);
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+    _spin(pio, sm, _tx_not_full);
+    pio_sm_put(pio, sm, data);
+}
+
+uint32_t pio_sm_get_blocking(PIO pio, uint sm) {
+    _spin(pio, sm, _rx_not_empty);
+    return pio_sm_get(pio, sm);
+}
+
+bool pio_interrupt_get(PIO pio, uint n) {
+    return (pio->irq >> n) & 1;
+}
+
+void pio_interrupt_clear(PIO pio, uint n) {
+    pio->irq &= ~(1u << n);
+}
+
+// DMA access to the FIFO registers
+
+bool stub_pio_fifo_address(const volatile void* address, PIO* pio, uint* sm, bool* is_tx) {
+    for (uint p = 0; p < 2; p++) {
+        pio_hw_t* hw = &stub_pio_hw[p];
+
+        for (uint i = 0; i < 4; i++) {
+            const volatile uint8_t* tx = (const volatile uint8_t*)&hw->txf[i];
+            const volatile uint8_t* rx = (const volatile uint8_t*)&hw->rxf[i];
+            const volatile uint8_t* at = address;
+
+            if (at >= tx && at < tx + 4) {
+                *pio = hw;
+                *sm = i;
+                *is_tx = true;
+                return true;
+            }
+
+            if (at >= rx && at < rx + 4) {
+                *pio = hw;
+                *sm = i;
+                *is_tx = false;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool stub_pio_dreq_ready(uint dreq) {
+    PIO pio = dreq < 8 ? pio0 : pio1;
+    uint sm = dreq & 3;
+
+    if (dreq & 4) {
+        return !pio_sm_is_rx_fifo_empty(pio, sm);
+    }
+
+    return !pio_sm_is_tx_fifo_full(pio, sm);
+}
@@ -0,0 +1,65 @@
+/*
+
+SPI stub. Blocking writes take as long as the bytes would take to
+shift out at the set baud rate. Nothing is put on the pins: the LCD
+stream program is what tests watch there.
+
+*/
+
+#include "sdk_stub.h"
+#include "stub_internal.h"
+#include <string.h>
+#include "hardware/spi.h"
+
+struct spi_inst {
+    uint baudrate;
+    spi_hw_t hw;
+};
+
+spi_inst_t spi0_inst, spi1_inst;
+
+void stub_spi_reset(void) {
+    memset(&spi0_inst, 0, sizeof(spi0_inst));
+    memset(&spi1_inst, 0, sizeof(spi1_inst));
+}
+
+uint spi_init(spi_inst_t* spi, uint baudrate) {
+    return spi_set_baudrate(spi, baudrate);
+}
+
+void spi_deinit(spi_inst_t* spi) {
+    spi->baudrate = 0;
+}
+
+uint spi_set_baudrate(spi_inst_t* spi, uint baudrate) {
+    spi->baudrate = baudrate;
+    return baudrate;
+}
+
+uint spi_get_baudrate(const spi_inst_t* spi) {
+    return spi->baudrate;
+}
+
+int spi_write_blocking(spi_inst_t* spi, const uint8_t* src, size_t len) {
+    (void)src;
+
+    if (spi->baudrate) {
+        stub_advance_us(((uint64_t)len * 8 * 1000000 + spi->baudrate - 1) / spi->baudrate);
+    }
+
+    return (int)len;
+}
+
+bool spi_is_busy(const spi_inst_t* spi) {
+    (void)spi;
+    return false;
+}
+
+uint spi_get_dreq(spi_inst_t* spi, bool is_tx) {
+    // DREQ_SPI0_TX is 16, each block has a TX and an RX DREQ
+    return 16 + (spi == spi1 ? 2 : 0) + (is_tx ? 0 : 1);
+}
+
+spi_hw_t* spi_get_hw(spi_inst_t* spi) {
+    return &spi->hw;
+}
@@ -0,0 +1,62 @@
+/*
+
+Simulated SPI receiver listening on the SCK, MOSI and D/C pins.
+
+*/
+
+#include "spi_device.h"
+#include <string.h>
+
+static bool _pulls_low(stub_gpio_device_t* gpio, uint pin, uint64_t time_ps) {
+    return false;
+}
+
+static void _edge(stub_gpio_device_t* gpio, uint pin, bool level, uint64_t time_ps) {
+    spi_device_t* device = (spi_device_t*)gpio;
+
+    if (!level) {
+        return;
+    }
+
+    if (device->last_rise_ps) {
+        uint64_t period_ps = time_ps - device->last_rise_ps;
+
+        if (!device->min_period_ps || period_ps < device->min_period_ps) {
+            device->min_period_ps = period_ps;
+        }
+    }
+    device->last_rise_ps = time_ps;
+
+    device->shift = (device->shift << 1) | stub_gpio_level(device->pin_mosi);
+
+    if (++device->bit_count < 8) {
+        return;
+    }
+
+    if (device->count < SPI_DEVICE_MAX_BYTES) {
+        device->bytes[device->count] = device->shift;
+        device->is_data[device->count] = stub_gpio_level(device->pin_dc);
+        device->count++;
+    }
+
+    device->bit_count = 0;
+}
+
+/**
+ * @brief Starts listening on the given pins.
+ *
+ * @param device Device to set up
+ * @param pin_sck Clock pin
+ * @param pin_mosi Data pin
+ * @param pin_dc Data/command pin, high for data
+ */
+void spi_device_attach(spi_device_t* device, uint pin_sck, uint pin_mosi, uint pin_dc) {
+    memset(device, 0, sizeof(*device));
+
+    device->gpio.pulls_low = _pulls_low;
+    device->gpio.edge = _edge;
+    device->pin_mosi = pin_mosi;
+    device->pin_dc = pin_dc;
+
+    stub_gpio_attach(pin_sck, &device->gpio);
+}
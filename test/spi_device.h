@@ -0,0 +1,29 @@
+#ifndef SPI_DEVICE_H
+#define SPI_DEVICE_H
+
+// A write-only SPI device with a D/C line, like the PCD8544. Bits are
+// read from MOSI on each rising edge of SCK, MSB first, and D/C is
+// read with the last bit of each byte.
+
+#include "sdk_stub.h"
+
+#define SPI_DEVICE_MAX_BYTES 1024
+
+typedef struct {
+    stub_gpio_device_t gpio;    // First, so the stub's pointer is ours
+    uint pin_mosi;
+    uint pin_dc;
+
+    uint8_t shift;
+    uint8_t bit_count;
+    uint64_t last_rise_ps;
+
+    uint16_t count;
+    uint8_t bytes[SPI_DEVICE_MAX_BYTES];
+    bool is_data[SPI_DEVICE_MAX_BYTES];
+    uint64_t min_period_ps;     // Shortest SCK period seen
+} spi_device_t;
+
+void spi_device_attach(spi_device_t* device, uint pin_sck, uint pin_mosi, uint pin_dc);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TEST_H
+#define TEST_H
+
+// Minimal host test harness. Each test is a void function run with
+// RUN_TEST(); checks report the failing line and carry on, and
+// test_report() turns the result into the exit status.
+
+#include <stdio.h>
+#include <string.h>
+#include "sdk_stub.h"
+
+static int _test_failures = 0;
+static int _test_count = 0;
+static const char* _test_name = "";
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("  %s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, _test_name, #cond); \
+        _test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+    long long _a = (long long)(actual), _e = (long long)(expected); \
+    if (_a != _e) { \
+        printf("  %s:%d: %s: %s is %lld, expected %lld\n", __FILE__, __LINE__, _test_name, #actual, _a, _e); \
+        _test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) do { \
+    double _a = (double)(actual), _e = (double)(expected); \
+    if (_a - _e > (tolerance) || _e - _a > (tolerance)) { \
+        printf("  %s:%d: %s: %s is %g, expected %g +/- %g\n", __FILE__, __LINE__, _test_name, #actual, _a, _e, (double)(tolerance)); \
+        _test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_STR(actual, expected) do { \
+    const char *_a = (actual), *_e = (expected); \
+    if (strcmp(_a, _e) != 0) { \
+        printf("  %s:%d: %s: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, _test_name, #actual, _a, _e); \
+        _test_failures++; \
+    } \
+} while (0)
+
+#define RUN_TEST(fn) do { \
+    int _before = _test_failures; \
+    _test_name = #fn; \
+    _test_count++; \
+    stub_reset(); \
+    fn(); \
+    printf("%s %s\n", _test_failures == _before ? "ok  " : "FAIL", #fn); \
+} while (0)
+
+static inline int test_report(void) {
+    printf("%d tests, %d failed checks\n", _test_count, _test_failures);
+    return _test_failures ? 1 : 0;
+}
+
+#endif
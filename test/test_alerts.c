@@ -0,0 +1,187 @@
+/*
+
+Alert rules replayed against sample sequences. Samples are added a
+minute apart, as the probe reads them, and the "(ALERT)" events
+printed are captured and compared with the transitions expected of
+each rule. Every event must be printed with interrupts enabled, i.e.
+after the alerts' critical section has been left.
+
+*/
+
+#define _GNU_SOURCE
+#include "test.h"
+#include "alerts.h"
+
+#define _MAX_EVENTS 16
+#define _EVENT_LEN 64
+
+static char _events[_MAX_EVENTS][_EVENT_LEN];
+static int _event_count;
+static int _locked_writes;
+
+// Collects what alerts.c prints, one event per line
+static ssize_t _capture_write(void* cookie, const char* buffer, size_t size) {
+    static char line[_EVENT_LEN];
+    static size_t length;
+
+    _locked_writes += stub_interrupts_disabled();
+
+    for (size_t i = 0; i < size; i++) {
+        if (buffer[i] != '\n') {
+            if (length < _EVENT_LEN - 1) {
+                line[length++] = buffer[i];
+            }
+            continue;
+        }
+
+        line[length] = '\0';
+        length = 0;
+
+        if (_event_count < _MAX_EVENTS) {
+            strcpy(_events[_event_count], line);
+        }
+        _event_count++;
+    }
+
+    return size;
+}
+
+static FILE* _test_stdout;
+
+static void _capture_start(void) {
+    _event_count = 0;
+    _locked_writes = 0;
+
+    _test_stdout = stdout;
+    stdout = fopencookie(NULL, "w", (cookie_io_functions_t){.write = _capture_write});
+    setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+static void _capture_stop(void) {
+    fclose(stdout);
+    stdout = _test_stdout;
+}
+
+static void _check_events(const char* const* expected, int count) {
+    CHECK_EQ(_event_count, count);
+    CHECK_EQ(_locked_writes, 0);
+
+    for (int i = 0; i < MIN(_event_count, count); i++) {
+        CHECK_STR(_events[i], expected[i]);
+    }
+}
+
+// Soil drying past the default 40 % threshold, hovering around it
+// within the hysteresis band, then watered
+static int32_t _moisture_at(int minute) {
+    if (minute < 60) {
+        return MAX(500 - 5 * minute, 350);
+    }
+    if (minute < 120) {
+        return minute % 2 ? 415 : 395;
+    }
+    return 600;
+}
+
+// A one-minute spike, then a quarter of an hour too hot
+static int32_t _temperature_at(int minute) {
+    if (minute == 10 || (minute >= 30 && minute < 46)) {
+        return 97;
+    }
+    return 70;
+}
+
+static void test_default_rules_fire_and_clear(void) {
+    static const char* const expected[] = {
+        "(ALERT) 1 TEMP OUT fired at 2400 s, value 97",
+        "(ALERT) 1 TEMP OUT cleared at 2820 s, value 70",
+        "(ALERT) 0 SOIL LOW fired at 3060 s, value 350",
+        "(ALERT) 0 SOIL LOW cleared at 7260 s, value 600",
+    };
+
+    alerts_init();
+    _capture_start();
+
+    uint32_t masks[4];
+    int mask_changes = 0;
+    uint32_t last_mask = 0;
+
+    for (int minute = 0; minute < 180; minute++) {
+        alerts_add_sample(ALERT_TEMPERATURE, _temperature_at(minute), minute * 60);
+        alerts_add_sample(ALERT_MOISTURE, _moisture_at(minute), minute * 60);
+
+        uint32_t mask = alerts_firing_mask();
+
+        if (mask != last_mask && mask_changes < 4) {
+            masks[mask_changes++] = mask;
+        }
+        last_mask = mask;
+    }
+
+    _capture_stop();
+    _check_events(expected, 4);
+
+    CHECK_EQ(mask_changes, 4);
+    CHECK_EQ(masks[0], 0x2);
+    CHECK_EQ(masks[1], 0x0);
+    CHECK_EQ(masks[2], 0x1);
+    CHECK_EQ(masks[3], 0x0);
+}
+
+static void test_noise_around_threshold_does_not_fire(void) {
+    alerts_init();
+    _capture_start();
+
+    // Below the threshold every other minute: each return above it
+    // starts the 30 minutes over
+    for (int minute = 0; minute < 600; minute++) {
+        alerts_add_sample(ALERT_MOISTURE, minute % 2 ? 405 : 395, minute * 60);
+    }
+
+    _capture_stop();
+    _check_events(NULL, 0);
+
+    CHECK_EQ(alerts_firing_mask(), 0);
+}
+
+static void test_configured_rule_fires_and_is_replaced(void) {
+    static const char* const expected[] = {
+        "(ALERT) 2 LUX HIGH fired at 600 s, value 60000",
+    };
+
+    alerts_init();
+
+    CHECK(alerts_configure("2 lux above 50000 10"));
+    CHECK_EQ(alerts_interval_ms(ALERT_LUX), 60000);
+
+    _capture_start();
+
+    for (int minute = 0; minute <= 20; minute++) {
+        alerts_add_sample(ALERT_LUX, 60000, minute * 60);
+    }
+
+    CHECK_EQ(alerts_firing_mask(), 0x4);
+
+    // Replacing a firing rule clears it without an event
+    CHECK(alerts_configure("2 lux above 70000 10"));
+    CHECK_EQ(alerts_firing_mask(), 0);
+
+    for (int minute = 21; minute <= 40; minute++) {
+        alerts_add_sample(ALERT_LUX, 60000, minute * 60);
+    }
+
+    _capture_stop();
+    _check_events(expected, 1);
+
+    CHECK_EQ(alerts_firing_mask(), 0);
+    CHECK(alerts_configure("2 off"));
+    CHECK_EQ(alerts_interval_ms(ALERT_LUX), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_default_rules_fire_and_clear);
+    RUN_TEST(test_noise_around_threshold_does_not_fire);
+    RUN_TEST(test_configured_rule_fires_and_is_replaced);
+
+    return test_report();
+}
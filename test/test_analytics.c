@@ -0,0 +1,138 @@
+/*
+
+Analytics against offline reference traces. Each trace in traces/ is
+fed to analytics.c sample by sample, and the results are compared
+with those a floating point reference computed for the same trace
+(see traces/make_analytics_traces.py).
+
+*/
+
+#include "test.h"
+#include <stdlib.h>
+#include "analytics.h"
+
+#define _MAX_EXPECT 8
+
+typedef struct {
+    char key[24];
+    long value;
+} _expect_t;
+
+typedef struct {
+    _expect_t expect[_MAX_EXPECT];
+    int expect_count;
+    bool not_drying;
+    int samples;
+} _trace_t;
+
+// Feeds a trace to the analytics and reads what it expects
+static bool _play(const char* name, _trace_t* trace) {
+    char path[64];
+    snprintf(path, sizeof(path), "traces/%s.csv", name);
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("  %s: cannot open %s\n", _test_name, path);
+        return false;
+    }
+
+    memset(trace, 0, sizeof(*trace));
+    analytics_init();
+
+    char line[80];
+
+    while (fgets(line, sizeof(line), file)) {
+        long t, lux, moisture;
+        _expect_t* expect = &trace->expect[trace->expect_count];
+
+        if (line[0] == '#') {
+            continue;
+        } else if (strncmp(line, "expect not_drying", 17) == 0) {
+            trace->not_drying = true;
+        } else if (trace->expect_count < _MAX_EXPECT &&
+                   sscanf(line, "expect %23s %ld", expect->key, &expect->value) == 2) {
+            trace->expect_count++;
+        } else if (sscanf(line, "%ld,%ld,%ld", &t, &lux, &moisture) == 3) {
+            if (lux >= 0) {
+                analytics_add_light(lux, t);
+            }
+            if (moisture >= 0) {
+                analytics_add_moisture(moisture, t);
+            }
+            trace->samples++;
+        }
+    }
+
+    fclose(file);
+    return trace->samples > 0;
+}
+
+static long _result(const analytics_t* result, const char* key) {
+    if (strcmp(key, "dli_today_x100") == 0) return result->dli_today_x100;
+    if (strcmp(key, "dli_yesterday_x100") == 0) return result->dli_yesterday_x100;
+    if (strcmp(key, "dry_points") == 0) return result->dry_points;
+    if (strcmp(key, "dry_rate_x10") == 0) return result->dry_rate_x10;
+    if (strcmp(key, "hours_to_dry") == 0) return result->hours_to_dry;
+    return -1;
+}
+
+// Integer results are truncated where the reference is rounded, and
+// the device keeps whole bucket means, so results may be one step or
+// 1% off, whichever is more. Point counts must match.
+static void _check_trace(const char* name) {
+    _trace_t trace;
+
+    if (!_play(name, &trace)) {
+        _test_failures++;
+        return;
+    }
+
+    analytics_t result;
+    analytics_get(&result);
+
+    CHECK(trace.expect_count > 0);
+    CHECK_EQ(result.drying, !trace.not_drying);
+
+    for (int i = 0; i < trace.expect_count; i++) {
+        const _expect_t* expect = &trace.expect[i];
+        long actual = _result(&result, expect->key);
+
+        if (strcmp(expect->key, "dli_yesterday_x100") == 0) {
+            CHECK(result.yesterday_valid);
+        }
+
+        long tolerance = MAX(1, expect->value / 100);
+
+        if (strcmp(expect->key, "dry_points") == 0) {
+            CHECK_EQ(actual, expect->value);
+        } else if (labs(actual - expect->value) > tolerance) {
+            printf("  %s: %s is %ld, reference %ld\n", name, expect->key, actual, expect->value);
+            _test_failures++;
+        }
+    }
+}
+
+static void test_light_two_days(void) {
+    _check_trace("light_two_days");
+}
+
+static void test_dry_down(void) {
+    _check_trace("dry_down");
+}
+
+static void test_dry_down_after_gap(void) {
+    _check_trace("dry_down_after_gap");
+}
+
+static void test_wet_soil(void) {
+    _check_trace("wet_soil");
+}
+
+int main(void) {
+    RUN_TEST(test_light_two_days);
+    RUN_TEST(test_dry_down);
+    RUN_TEST(test_dry_down_after_gap);
+    RUN_TEST(test_wet_soil);
+
+    return test_report();
+}
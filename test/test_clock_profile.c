@@ -0,0 +1,191 @@
+/*
+
+1-wire timing at every clock profile. The firmware's PIO program runs
+on the stub PIO at each profile's clk_sys with the divider the driver
+computes, against a simulated DS18B20 which measures every pulse.
+The limits below are taken from the DS18B20 datasheet, not from the
+driver, so a wrong tick count in the driver's own table shows up here.
+
+*/
+
+#include "test.h"
+#include "onewire_device.h"
+#include "clock_profile.h"
+#include "ds18b20.h"
+#include "hardware/clocks.h"
+
+#define _PIN 22
+
+// DS18B20 datasheet limits, in microseconds
+#define _RESET_LOW_MIN_US 480.0
+#define _WRITE_0_LOW_MIN_US 60.0
+#define _WRITE_0_LOW_MAX_US 120.0
+#define _WRITE_1_LOW_MIN_US 1.0
+#define _WRITE_1_LOW_MAX_US 15.0
+#define _READ_LOW_MIN_US 1.0
+#define _READ_LOW_MAX_US 15.0
+#define _SLOT_MIN_US 60.0
+#define _RECOVERY_MIN_US 1.0
+
+// clock_profile.c only needs these when low power mode is on
+bool power_low_power_enabled(void) {
+    return false;
+}
+
+void power_start_epoch(void) {
+}
+
+static double _us(uint64_t ps) {
+    return ps / 1e6;
+}
+
+// Sets up the driver at the current clock and reads the temperature
+// once, the way the sensor task does.
+static bool _read_once(ds18b20_sensor_t* sensor, onewire_device_t* device, uint8_t raw[SENSOR_RAW_MAX]) {
+    // Attached once the pull-up is on, as the line only idles high from then
+    if (sensor->sm < 0) {
+        if (!ds18b20_sensor_driver.init(sensor)) {
+            return false;
+        }
+
+        stub_gpio_attach(_PIN, &device->gpio);
+    }
+
+    if (!ds18b20_sensor_driver.start_conversion(sensor, NULL)) {
+        return false;
+    }
+
+    stub_advance_us(ds18b20_sensor_driver.conversion_time_ms(sensor) * 1000);
+
+    return ds18b20_sensor_driver.collect(sensor, NULL, raw);
+}
+
+static void _check_in_spec(const onewire_device_t* device) {
+    CHECK(device->reset_low.count >= 2);
+    CHECK(_us(device->reset_low.min_ps) >= _RESET_LOW_MIN_US);
+
+    CHECK(device->write_0_low.count > 0);
+    CHECK(_us(device->write_0_low.min_ps) >= _WRITE_0_LOW_MIN_US);
+    CHECK(_us(device->write_0_low.max_ps) <= _WRITE_0_LOW_MAX_US);
+
+    CHECK(device->write_1_low.count > 0);
+    CHECK(_us(device->write_1_low.min_ps) >= _WRITE_1_LOW_MIN_US);
+    CHECK(_us(device->write_1_low.max_ps) <= _WRITE_1_LOW_MAX_US);
+
+    CHECK(device->read_low.count > 0);
+    CHECK(_us(device->read_low.min_ps) >= _READ_LOW_MIN_US);
+    CHECK(_us(device->read_low.max_ps) <= _READ_LOW_MAX_US);
+
+    // A slot is at least 60 us and is followed by at least 1 us of recovery
+    CHECK(_us(device->write_period.min_ps) >= _SLOT_MIN_US + _RECOVERY_MIN_US);
+    CHECK(_us(device->read_period.min_ps) >= _SLOT_MIN_US + _RECOVERY_MIN_US);
+    CHECK(_us(device->recovery.min_ps) >= _RECOVERY_MIN_US);
+}
+
+static void test_every_profile_validates(void) {
+    for (clock_profile_t p = 0; p < CLOCK_PROFILE_COUNT; p++) {
+        ds18b20_timing_t timing;
+
+        CHECK(clock_profile_validate(p));
+        CHECK(ds18b20_timing_for_clock(clock_profile_sys_khz(p) * 1000, &timing));
+
+        // Every profile keeps the tick the program's delays were written for
+        CHECK_NEAR(timing.tick_ns, 2128, 10);
+    }
+
+    CHECK(!clock_profile_validate(CLOCK_PROFILE_COUNT));
+}
+
+static void test_bus_timing_in_spec_at_every_profile(void) {
+    for (clock_profile_t p = 0; p < CLOCK_PROFILE_COUNT; p++) {
+        stub_reset();
+        CHECK(set_sys_clock_khz(clock_profile_sys_khz(p), false));
+
+        onewire_device_t device;
+        onewire_device_init(&device, ONEWIRE_PRESENT);
+        onewire_device_set_temperature(&device, -10 * 16 - 8);
+
+        ds18b20_sensor_t sensor = {pio0, _PIN, -1, false};
+        uint8_t raw[SENSOR_RAW_MAX] = {0};
+
+        CHECK(_read_once(&sensor, &device, raw));
+        CHECK_EQ(device.conversions, 1);
+        CHECK_EQ(device.scratchpad_reads, 1);
+
+        // Only right if every bit was sampled while the device held it
+        CHECK_EQ(raw[0], device.scratchpad[0]);
+        CHECK_EQ(raw[1], device.scratchpad[1]);
+
+        _check_in_spec(&device);
+
+        // The driver's own table matches what reached the bus. The first
+        // slot after a reset is one tick longer, as set pindirs drives
+        // the line low before set pins does.
+        ds18b20_timing_t timing;
+        ds18b20_timing_for_clock(clock_get_hz(clk_sys), &timing);
+        double tick_us = timing.tick_ns / 1000.0;
+
+        CHECK_NEAR(_us(device.reset_low.min_ps), timing.reset_low_ns / 1000.0, tick_us);
+        CHECK_NEAR(_us(device.write_0_low.min_ps), timing.write_0_low_ns / 1000.0, tick_us / 2);
+        CHECK_NEAR(_us(device.write_0_low.max_ps), timing.write_0_low_ns / 1000.0, tick_us * 1.5);
+        CHECK_NEAR(_us(device.write_1_low.min_ps), timing.write_1_low_ns / 1000.0, tick_us / 2);
+        CHECK_NEAR(_us(device.read_low.max_ps), timing.read_low_ns / 1000.0, tick_us / 2);
+        CHECK_NEAR(_us(device.read_period.min_ps), timing.read_slot_ns / 1000.0, tick_us / 2);
+    }
+}
+
+static void test_reclocking_keeps_timing_in_spec(void) {
+    onewire_device_t device;
+    onewire_device_init(&device, ONEWIRE_PRESENT);
+
+    ds18b20_sensor_t sensor = {pio0, _PIN, -1, false};
+    uint8_t raw[SENSOR_RAW_MAX];
+
+    CHECK(_read_once(&sensor, &device, raw));
+
+    // What the clock listener in main.c does after a profile change
+    for (clock_profile_t p = 0; p < CLOCK_PROFILE_COUNT; p++) {
+        CHECK(set_sys_clock_khz(clock_profile_sys_khz(p), false));
+        ds18b20_set_clock(sensor.pio, sensor.sm, clock_get_hz(clk_sys));
+        onewire_device_clear_spans(&device);
+
+        CHECK(_read_once(&sensor, &device, raw));
+        CHECK_EQ(raw[0], device.scratchpad[0]);
+        _check_in_spec(&device);
+    }
+}
+
+static void test_stale_divider_is_out_of_spec(void) {
+    onewire_device_t device;
+    onewire_device_init(&device, ONEWIRE_PRESENT);
+
+    ds18b20_sensor_t sensor = {pio0, _PIN, -1, false};
+    uint8_t raw[SENSOR_RAW_MAX];
+
+    CHECK(_read_once(&sensor, &device, raw));
+
+    // Without the listener, the 125 MHz divider stretches every slot
+    CHECK(set_sys_clock_khz(clock_profile_sys_khz(CLOCK_PROFILE_LOW_POWER), false));
+    onewire_device_clear_spans(&device);
+    _read_once(&sensor, &device, raw);
+
+    CHECK(_us(device.write_0_low.max_ps) > _WRITE_0_LOW_MAX_US);
+}
+
+static void test_too_slow_clock_fails_validation(void) {
+    ds18b20_timing_t timing;
+
+    // The divider cannot go below 1, so the tick gets too long
+    CHECK(!ds18b20_timing_for_clock(200000, &timing));
+    CHECK_EQ(timing.div_int, 1);
+}
+
+int main(void) {
+    RUN_TEST(test_every_profile_validates);
+    RUN_TEST(test_bus_timing_in_spec_at_every_profile);
+    RUN_TEST(test_reclocking_keeps_timing_in_spec);
+    RUN_TEST(test_stale_divider_is_out_of_spec);
+    RUN_TEST(test_too_slow_clock_fails_validation);
+
+    return test_report();
+}
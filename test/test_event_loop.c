@@ -0,0 +1,156 @@
+/*
+
+Event loop on the virtual clock: timers fire at their deadlines,
+samples from core1 arrive through the FIFO IRQ, and core0 only wakes
+when there is an event.
+
+*/
+
+#include "test.h"
+#include "event_loop.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+static void _notify_sample(void* arg) {
+    event_notify_sample((uint32_t)(uintptr_t)arg);
+}
+
+static void test_timers_fire_at_deadlines(void) {
+    event_loop_init();
+
+    event_timer_start(500, true, 1);
+    event_timer_start(200, false, 2);
+
+    event_t event;
+    uint32_t expected_data[] = {2, 1, 1, 1};
+    uint64_t expected_ms[] = {200, 500, 1000, 1500};
+
+    for (int i = 0; i < 4; i++) {
+        event_wait(&event);
+        CHECK_EQ(event.type, EVENT_TIMER);
+        CHECK_EQ(event.data, expected_data[i]);
+        CHECK_EQ(time_us_64() / 1000, expected_ms[i]);
+    }
+
+    // Tickless: one sleep per event, no periodic wakeups
+    CHECK_EQ(stub_sleep_count(), 4);
+}
+
+static void test_sample_from_core1_wakes_core0(void) {
+    event_loop_init();
+
+    stub_schedule_at_us(1234000, _notify_sample, (void*)7);
+
+    event_t event;
+
+    event_wait(&event);
+    CHECK_EQ(event.type, EVENT_SAMPLE);
+    CHECK_EQ(event.data, 7);
+    CHECK_EQ(time_us_64(), 1234000);
+    CHECK_EQ(stub_sleep_count(), 1);
+}
+
+static void test_samples_and_timers_interleave(void) {
+    event_loop_init();
+
+    event_timer_start(1000, true, 0);
+    stub_schedule_at_us(1500000, _notify_sample, (void*)1);
+    stub_schedule_at_us(2500000, _notify_sample, (void*)2);
+
+    event_type_t expected[] = {EVENT_TIMER, EVENT_SAMPLE, EVENT_TIMER, EVENT_SAMPLE, EVENT_TIMER};
+    event_t event;
+
+    for (int i = 0; i < 5; i++) {
+        event_wait(&event);
+        CHECK_EQ(event.type, expected[i]);
+    }
+
+    CHECK_EQ(time_us_64(), 3000000);
+}
+
+static void test_cancelled_timer_does_not_fire(void) {
+    event_loop_init();
+
+    int timer = event_timer_start(100, false, 1);
+
+    event_timer_start(300, false, 2);
+    event_timer_cancel(timer);
+
+    event_t event;
+
+    event_wait(&event);
+    CHECK_EQ(event.data, 2);
+    CHECK_EQ(time_us_64(), 300000);
+    CHECK_EQ(event_timer_next_deadline_us(), -1);
+}
+
+static void test_missed_periods_are_skipped(void) {
+    event_loop_init();
+
+    event_timer_start(100, true, 1);
+
+    // Core0 was busy with interrupts off for five periods
+    uint32_t status = save_and_disable_interrupts();
+    stub_advance_us(550000);
+    restore_interrupts(status);
+
+    event_t event;
+    int count = 0;
+
+    while (event_poll(&event)) {
+        count++;
+    }
+
+    CHECK_EQ(count, 1);
+    CHECK_EQ(event_timer_next_deadline_us(), 650000);
+}
+
+static void test_full_queue_drops_events(void) {
+    event_loop_init();
+
+    for (int i = 0; i < 16; i++) {
+        CHECK(event_post(EVENT_BUTTON, i));
+    }
+
+    CHECK(!event_post(EVENT_BUTTON, 16));
+
+    event_t event;
+
+    CHECK(event_poll(&event));
+    CHECK_EQ(event.data, 0);
+}
+
+static void test_full_fifo_does_not_block_core1(void) {
+    event_loop_init();
+
+    // Core0 has not serviced the FIFO yet
+    uint32_t status = save_and_disable_interrupts();
+
+    for (int i = 0; i < 20; i++) {
+        event_notify_sample(i);
+    }
+
+    restore_interrupts(status);
+
+    event_t event;
+    int count = 0;
+
+    while (event_poll(&event)) {
+        CHECK_EQ(event.type, EVENT_SAMPLE);
+        count++;
+    }
+
+    CHECK_EQ(count, 8);
+}
+
+int main(void) {
+    RUN_TEST(test_timers_fire_at_deadlines);
+    RUN_TEST(test_sample_from_core1_wakes_core0);
+    RUN_TEST(test_samples_and_timers_interleave);
+    RUN_TEST(test_cancelled_timer_does_not_fire);
+    RUN_TEST(test_missed_periods_are_skipped);
+    RUN_TEST(test_full_queue_drops_events);
+    RUN_TEST(test_full_fifo_does_not_block_core1);
+
+    return test_report();
+}
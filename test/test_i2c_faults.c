@@ -0,0 +1,330 @@
+/*
+
+Faults on an I2C bus. A simulated seesaw NACKs or stretches SCL for
+good, and a stuck device holds SDA low, while the seesaw driver's
+jobs run on the I2C scheduler. A NACK fails only its job; a stall or
+a held SDA also has the bus cleared, after which jobs run again, as
+does one found by the BH1750's power on before a measurement. A
+job which ended before it was polled late is not a timeout. The
+sampler faults a sensor which keeps failing, retries it and its init,
+and reads it again once the bus answers.
+
+*/
+
+#include "test.h"
+#include "i2c_device.h"
+#include "i2c_sched.h"
+#include "soil_moisture_seesaw.h"
+#include "bh1750_light_sensor.h"
+#include "sensor.h"
+#include "hardware/gpio.h"
+
+#define _SDA_PIN 6
+#define _SCL_PIN 7
+#define _BUS 1
+#define _BAUD 100000
+
+#define _MOISTURE 812
+
+static seesaw_device_t _model;
+static seesaw_sensor_t _seesaw = {i2c1, false, NULL};
+static int _seesaw_id;
+
+static uint64_t _now_us(void) {
+    return stub_now_ps() / 1000000;
+}
+
+// Sensors keep when they last started across tests, so each test
+// starts later than the last
+static void _start(void) {
+    static uint64_t start_us = 0;
+
+    start_us += 100000000;
+    stub_advance_to_us(start_us);
+}
+
+static void _setup(void) {
+    _start();
+
+    // The board's pull-ups
+    stub_gpio_hold(_SDA_PIN, 1);
+    stub_gpio_hold(_SCL_PIN, 1);
+
+    // The scheduler only sets a bus up once, the stub forgets it
+    i2c_sched_add_bus(i2c1, _SDA_PIN, _SCL_PIN, _BAUD);
+    i2c_init(i2c1, _BAUD);
+    gpio_set_function(_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(_SCL_PIN, GPIO_FUNC_I2C);
+
+    // The scheduler polls the controllers against the timer
+    stub_set_auto_advance_us(1);
+
+    seesaw_device_init(&_model, _MOISTURE);
+    stub_i2c_attach(_BUS, &_model.i2c);
+}
+
+static int _run_request(void) {
+    i2c_job_t job;
+
+    seesaw_sensor_driver.start_conversion(&_seesaw, &job);
+    i2c_sched_run(&job, 1);
+
+    return job.result;
+}
+
+static int _run_read(uint16_t* moisture) {
+    i2c_job_t job;
+    uint8_t raw[SENSOR_RAW_MAX];
+
+    seesaw_sensor_driver.collect(&_seesaw, &job, raw);
+    i2c_sched_run(&job, 1);
+
+    if (job.result == 2) {
+        *moisture = seesaw_decode(raw);
+    }
+
+    return job.result;
+}
+
+// The bus is handed back to the controller, with the pads pulled up
+static void _check_bus_restored(void) {
+    CHECK_EQ(gpio_get_function(_SDA_PIN), GPIO_FUNC_I2C);
+    CHECK_EQ(gpio_get_function(_SCL_PIN), GPIO_FUNC_I2C);
+    CHECK(stub_gpio_pulled_up(_SDA_PIN));
+    CHECK(stub_gpio_pulled_up(_SCL_PIN));
+    CHECK(stub_gpio_level(_SDA_PIN));
+    CHECK(stub_gpio_level(_SCL_PIN));
+}
+
+static void test_nack_fails_only_its_job(void) {
+    _setup();
+    _model.nack = true;
+
+    uint64_t start_us = _now_us();
+
+    CHECK_EQ(_run_request(), PICO_ERROR_GENERIC);
+    CHECK(_now_us() - start_us < I2C_SCHED_JOB_TIMEOUT_US);
+
+    // No bus clear was needed: the pins never left the controller
+    CHECK(!stub_gpio_output_enabled(_SCL_PIN));
+    CHECK_EQ(gpio_get_function(_SCL_PIN), GPIO_FUNC_I2C);
+
+    _model.nack = false;
+
+    uint16_t moisture = 0;
+
+    CHECK_EQ(_run_request(), 2);
+    stub_advance_us(200000);
+    CHECK_EQ(_run_read(&moisture), 2);
+    CHECK_EQ(moisture, _MOISTURE);
+    CHECK_EQ(_model.requests, 1);
+}
+
+// Keeps the core busy past a job's deadline, as a bus clear on the
+// other controller or a long interrupt does
+static void _hold_core(void* arg) {
+    busy_wait_us_32(I2C_SCHED_JOB_TIMEOUT_US + 1000);
+}
+
+static void test_late_poll_of_finished_job_succeeds(void) {
+    _setup();
+
+    uint64_t start_us = _now_us();
+
+    stub_schedule_at_us(start_us + 100, _hold_core, NULL);
+
+    CHECK_EQ(_run_request(), 2);
+    CHECK(_now_us() - start_us > I2C_SCHED_JOB_TIMEOUT_US);
+    CHECK_EQ(_model.requests, 1);
+    CHECK_EQ(stub_i2c_transfers(_BUS), 1);
+}
+
+static void test_blocking_reads_check_every_transfer(void) {
+    _setup();
+    _model.nack = true;
+
+    uint16_t moisture = 1;
+    uint16_t lux = 1;
+
+    // A refused register select is not followed by a read
+    CHECK(!seesaw_read_moisture(i2c1, &moisture));
+    CHECK_EQ(moisture, 1);
+    CHECK_EQ(stub_i2c_transfers(_BUS), 1);
+
+    // No BH1750 on the bus
+    CHECK(!bh1750_read_measurement(i2c1, &lux));
+    CHECK_EQ(lux, 1);
+    CHECK_EQ(stub_i2c_transfers(_BUS), 2);
+
+    _model.nack = false;
+
+    CHECK(seesaw_read_moisture(i2c1, &moisture));
+    CHECK_EQ(moisture, _MOISTURE);
+    CHECK_EQ(_model.requests, 1);
+    CHECK_EQ(_model.early_reads, 0);
+}
+
+static void test_stall_times_out_and_clears_bus(void) {
+    _setup();
+    _model.stall_transfers = 1;
+
+    uint64_t start_us = _now_us();
+    uint16_t moisture = 0;
+
+    CHECK_EQ(_run_read(&moisture), PICO_ERROR_TIMEOUT);
+
+    // Given up after the timeout, with the clear on top
+    uint64_t elapsed_us = _now_us() - start_us;
+    CHECK(elapsed_us > I2C_SCHED_JOB_TIMEOUT_US);
+    CHECK(elapsed_us < I2C_SCHED_JOB_TIMEOUT_US + 1000);
+
+    _check_bus_restored();
+
+    CHECK_EQ(_run_read(&moisture), 2);
+    CHECK_EQ(moisture, _MOISTURE);
+}
+
+static void test_held_sda_is_clocked_free(void) {
+    i2c_stuck_device_t stuck;
+
+    _setup();
+    i2c_stuck_device_init(&stuck, _SDA_PIN, _SCL_PIN, 5);
+
+    // The controller cannot start with SDA low
+    CHECK_EQ(_run_request(), PICO_ERROR_IO);
+
+    // Clocked until it let go, then a stop
+    CHECK(!stuck.holding);
+    CHECK_EQ(stuck.clocks, 5);
+    CHECK(!stub_gpio_output_enabled(_SDA_PIN));
+    CHECK(!stub_gpio_output_enabled(_SCL_PIN));
+    _check_bus_restored();
+
+    CHECK_EQ(_run_request(), 2);
+    CHECK_EQ(_model.requests, 1);
+}
+
+static void test_bh1750_power_on_clears_held_bus(void) {
+    i2c_stuck_device_t stuck;
+    bh1750_sensor_t light = {i2c1, true, false};
+    i2c_job_t job;
+
+    _setup();
+    i2c_stuck_device_init(&stuck, _SDA_PIN, _SCL_PIN, 5);
+
+    // The power on ahead of the start finds the bus held, and frees it
+    CHECK(!bh1750_sensor_driver.start_conversion(&light, &job));
+    CHECK(light.powered_down);
+    CHECK(!stuck.holding);
+    _check_bus_restored();
+}
+
+static void test_held_sda_gives_up_after_nine_clocks(void) {
+    i2c_stuck_device_t stuck;
+
+    _setup();
+    i2c_stuck_device_init(&stuck, _SDA_PIN, _SCL_PIN, 100);
+
+    CHECK_EQ(_run_request(), PICO_ERROR_IO);
+
+    // Nine clocks finish any byte, then SCL rises once more for the stop
+    CHECK(stuck.holding);
+    CHECK_EQ(stuck.clocks, 9 + 1);
+    CHECK(!stub_gpio_level(_SDA_PIN));
+    CHECK_EQ(gpio_get_function(_SCL_PIN), GPIO_FUNC_I2C);
+}
+
+// Waits for the seesaw to be due and takes a sample
+static bool _sample(sensor_record_t* record) {
+    CHECK(sensor_wait_until_due(2 * SENSOR_FAULT_RETRY_MS));
+
+    sensor_sample_all(record, false);
+
+    return sensor_record_valid(record, _seesaw_id);
+}
+
+static void test_failed_init_is_retried(void) {
+    _setup();
+    _model.nack = true;
+
+    sensor_set_demand(_seesaw_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_CONTINUOUS);
+
+    uint64_t start_us = _now_us();
+
+    sensor_init_all();
+    CHECK_EQ(sensor_health(_seesaw_id), SENSOR_HEALTH_FAULT);
+
+    // Tried again once every retry interval
+    sensor_record_t record;
+
+    for (int i = 1; i <= 3; i++) {
+        CHECK(!_sample(&record));
+        CHECK_EQ(stub_i2c_transfers(_BUS), 1 + i);
+        CHECK_NEAR(_now_us() - start_us, i * SENSOR_FAULT_RETRY_MS * 1000, 1000);
+    }
+
+    _model.nack = false;
+
+    // The next retry resets it, and the sample it starts reads it
+    uint64_t answering_us = _now_us();
+
+    CHECK(_sample(&record));
+    CHECK_EQ(_model.resets, 1);
+    CHECK_EQ(record.values[_seesaw_id], _MOISTURE);
+    CHECK_EQ(sensor_health(_seesaw_id), SENSOR_HEALTH_OK);
+    CHECK(_now_us() - answering_us < (SENSOR_FAULT_RETRY_MS + 250) * 1000);
+
+    sensor_set_demand(_seesaw_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_NONE);
+}
+
+static void test_failing_sensor_faults_and_recovers(void) {
+    _setup();
+
+    sensor_set_demand(_seesaw_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_CONTINUOUS);
+    sensor_init_all();
+
+    sensor_record_t record;
+
+    CHECK(_sample(&record));
+    CHECK_EQ(sensor_health(_seesaw_id), SENSOR_HEALTH_OK);
+
+    // Stalls every transfer, so each one clears the bus
+    _model.stall_transfers = UINT32_MAX;
+
+    for (int i = 0; i < SENSOR_FAULT_AFTER; i++) {
+        CHECK_EQ(sensor_health(_seesaw_id), SENSOR_HEALTH_OK);
+        CHECK(!_sample(&record));
+    }
+
+    CHECK_EQ(sensor_health(_seesaw_id), SENSOR_HEALTH_FAULT);
+    CHECK_EQ(sensor_fault_mask(), 1u << _seesaw_id);
+
+    _model.stall_transfers = 0;
+
+    uint64_t answering_us = _now_us();
+
+    CHECK(_sample(&record));
+    CHECK_EQ(record.values[_seesaw_id], _MOISTURE);
+    CHECK_EQ(sensor_health(_seesaw_id), SENSOR_HEALTH_OK);
+    CHECK(_now_us() - answering_us < (SENSOR_FAULT_RETRY_MS + 250) * 1000);
+    _check_bus_restored();
+
+    sensor_set_demand(_seesaw_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_NONE);
+}
+
+int main(void) {
+    // The registry cannot be emptied, so the seesaw is added once
+    _seesaw_id = sensor_register(&seesaw_sensor_driver, &_seesaw);
+
+    RUN_TEST(test_nack_fails_only_its_job);
+    RUN_TEST(test_late_poll_of_finished_job_succeeds);
+    RUN_TEST(test_blocking_reads_check_every_transfer);
+    RUN_TEST(test_stall_times_out_and_clears_bus);
+    RUN_TEST(test_held_sda_is_clocked_free);
+    RUN_TEST(test_bh1750_power_on_clears_held_bus);
+    RUN_TEST(test_held_sda_gives_up_after_nine_clocks);
+    RUN_TEST(test_failed_init_is_retried);
+    RUN_TEST(test_failing_sensor_faults_and_recovers);
+
+    return test_report();
+}
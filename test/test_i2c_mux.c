@@ -0,0 +1,310 @@
+/*
+
+Soil probes behind TCA9548A muxes. The seesaw driver's jobs run on
+the I2C scheduler against the stub I2C controllers, with simulated
+muxes and seesaws on their buses, and every transfer is counted.
+
+As on the board, the muxes are on i2c0 and one seesaw is on i2c1 by
+itself: on the same bus it would answer along with every probe.
+
+*/
+
+#include "test.h"
+#include "i2c_device.h"
+#include "i2c_sched.h"
+#include "tca9548a.h"
+#include "soil_moisture_seesaw.h"
+#include "sensor.h"
+#include "hardware/gpio.h"
+
+#define _MUX_SDA_PIN 4
+#define _MUX_SCL_PIN 5
+#define _DIRECT_SDA_PIN 6
+#define _DIRECT_SCL_PIN 7
+#define _BAUD 100000
+
+#define _MUX_BUS 0
+#define _DIRECT_BUS 1
+
+#define _MUXES 2
+#define _PROBES_PER_MUX 8
+#define _SCAN_SIZE (1 + _MUXES * _PROBES_PER_MUX)
+
+#define _CONVERSION_US 200000
+
+// Bus models
+static i2c_mux_t _mux_models[_MUXES];
+static seesaw_device_t _probe_models[_MUXES][_PROBES_PER_MUX];
+static seesaw_device_t _direct_model;
+
+// The firmware's view of them. The scheduler keeps its muxes across
+// tests, so the same ones are set up again each time.
+static tca9548a_t _muxes[_MUXES];
+static mux_device_t _routes[_MUXES][_PROBES_PER_MUX];
+static seesaw_sensor_t _probes[_MUXES][_PROBES_PER_MUX];
+static seesaw_sensor_t _direct = {i2c1, false, NULL};
+
+static void _bring_up_bus(i2c_inst_t* i2c, uint sda_pin, uint scl_pin) {
+    // The board's pull-ups
+    stub_gpio_hold(sda_pin, 1);
+    stub_gpio_hold(scl_pin, 1);
+
+    // The scheduler only sets a bus up once, the stub forgets it
+    i2c_sched_add_bus(i2c, sda_pin, scl_pin, _BAUD);
+    i2c_init(i2c, _BAUD);
+    gpio_set_function(sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(scl_pin, GPIO_FUNC_I2C);
+}
+
+// Sets up a seesaw on every channel of each mux, all at the same
+// address, and the one by itself. Muxes not present do not answer.
+static void _setup(int muxes_present) {
+    _bring_up_bus(i2c0, _MUX_SDA_PIN, _MUX_SCL_PIN);
+    _bring_up_bus(i2c1, _DIRECT_SDA_PIN, _DIRECT_SCL_PIN);
+
+    // The scheduler polls the controllers against the timer
+    stub_set_auto_advance_us(1);
+
+    seesaw_device_init(&_direct_model, 1000);
+    stub_i2c_attach(_DIRECT_BUS, &_direct_model.i2c);
+
+    for (int m = 0; m < _MUXES; m++) {
+        i2c_mux_init(&_mux_models[m], 0x70 + m);
+
+        if (m < muxes_present) {
+            stub_i2c_attach(_MUX_BUS, &_mux_models[m].i2c);
+        }
+
+        tca9548a_init(&_muxes[m], i2c0, 0x70 + m);
+
+        for (int c = 0; c < _PROBES_PER_MUX; c++) {
+            seesaw_device_init(&_probe_models[m][c], 300 + 100 * m + c);
+            i2c_mux_attach(&_mux_models[m], c, &_probe_models[m][c].i2c);
+
+            _routes[m][c] = (mux_device_t){&_muxes[m], c, SEESAW_I2C_ADDR};
+            _probes[m][c] = (seesaw_sensor_t){i2c0, false, &_routes[m][c]};
+        }
+    }
+}
+
+static uint64_t _now_us(void) {
+    return stub_now_ps() / 1000000;
+}
+
+static uint32_t _select_writes(void) {
+    uint32_t writes = 0;
+
+    for (int m = 0; m < _MUXES; m++) {
+        writes += _muxes[m].select_writes;
+    }
+
+    return writes;
+}
+
+// Every probe in a mixed-up order
+static void _scan_list(seesaw_sensor_t* sensors[_SCAN_SIZE]) {
+    for (int i = 0; i < _SCAN_SIZE; i++) {
+        int n = (i * 7) % _SCAN_SIZE;
+
+        sensors[i] = n == 0 ? &_direct : &_probes[(n - 1) % _MUXES][(n - 1) / _MUXES];
+    }
+}
+
+// Requests a reading from every sensor, then reads them all back, in
+// one batch of jobs each, the way the sampler does
+static void _scan(seesaw_sensor_t* sensors[], int count, int results[], uint16_t moisture[]) {
+    i2c_job_t jobs[_SCAN_SIZE];
+    uint8_t raw[_SCAN_SIZE][SENSOR_RAW_MAX];
+
+    for (int i = 0; i < count; i++) {
+        seesaw_sensor_driver.start_conversion(sensors[i], &jobs[i]);
+    }
+
+    i2c_sched_run(jobs, count);
+    stub_advance_us(_CONVERSION_US);
+
+    for (int i = 0; i < count; i++) {
+        seesaw_sensor_driver.collect(sensors[i], &jobs[i], raw[i]);
+    }
+
+    i2c_sched_run(jobs, count);
+
+    for (int i = 0; i < count; i++) {
+        results[i] = jobs[i].result;
+        moisture[i] = jobs[i].result == 2 ? seesaw_decode(raw[i]) : 0;
+    }
+}
+
+static void test_scan_reads_every_probe(void) {
+    _setup(_MUXES);
+
+    seesaw_sensor_t* sensors[_SCAN_SIZE];
+    int results[_SCAN_SIZE];
+    uint16_t moisture[_SCAN_SIZE];
+
+    _scan_list(sensors);
+    _scan(sensors, _SCAN_SIZE, results, moisture);
+
+    for (int i = 0; i < _SCAN_SIZE; i++) {
+        CHECK_EQ(results[i], 2);
+    }
+
+    // Every probe answered alone, with its own value
+    CHECK_EQ(stub_i2c_clashes(_MUX_BUS), 0);
+    CHECK_EQ(_direct_model.requests, 1);
+    CHECK_EQ(_direct_model.reads, 1);
+
+    for (int i = 0; i < _SCAN_SIZE; i++) {
+        CHECK_EQ(moisture[i], sensors[i]->mux ? 300 + 100 * (sensors[i]->mux->mux - _muxes) + sensors[i]->mux->channel : 1000);
+    }
+
+    for (int m = 0; m < _MUXES; m++) {
+        for (int c = 0; c < _PROBES_PER_MUX; c++) {
+            CHECK_EQ(_probe_models[m][c].requests, 1);
+            CHECK_EQ(_probe_models[m][c].reads, 1);
+            CHECK_EQ(_probe_models[m][c].early_reads, 0);
+        }
+
+        CHECK_EQ(_mux_models[m].select_writes, _muxes[m].select_writes);
+    }
+}
+
+static void test_scan_transactions(void) {
+    _setup(_MUXES);
+
+    seesaw_sensor_t* sensors[_SCAN_SIZE];
+    int results[_SCAN_SIZE];
+    uint16_t moisture[_SCAN_SIZE];
+
+    _scan_list(sensors);
+    _scan(sensors, _SCAN_SIZE, results, moisture);
+
+    // Requests: both muxes start unknown. The second is closed, each
+    // channel of the first is opened once, then the first is closed
+    // and each channel of the second opened once: 1 + 8 + 1 + 8.
+    // Reads: the open channel is read first, then the same again
+    // without it: 0 + 1 + 8 + 1 + 7.
+    CHECK_EQ(_select_writes(), 18 + 17);
+    CHECK_EQ(stub_i2c_transfers(_MUX_BUS), 2 * _MUXES * _PROBES_PER_MUX + 18 + 17);
+    CHECK_EQ(stub_i2c_transfers(_DIRECT_BUS), 2);
+    CHECK_EQ(stub_i2c_clashes(_MUX_BUS), 0);
+
+    // Each mux counts the selects and probe transfers through it
+    CHECK_EQ(_muxes[0].transactions + _muxes[1].transactions,
+             _select_writes() + 2 * _MUXES * _PROBES_PER_MUX);
+
+    // Every conversion runs while the others are requested and read,
+    // so the scan takes one conversion and the bus time
+    CHECK(_now_us() < _CONVERSION_US + 20000);
+}
+
+static void test_cached_selection_is_not_written_again(void) {
+    _setup(_MUXES);
+
+    i2c_job_t job;
+    uint8_t raw[SENSOR_RAW_MAX];
+
+    // Both muxes start unknown: the other is closed, then the channel opened
+    seesaw_sensor_driver.start_conversion(&_probes[0][3], &job);
+    i2c_sched_run(&job, 1);
+    CHECK_EQ(job.result, 2);
+    CHECK_EQ(_select_writes(), 2);
+    CHECK_EQ(_muxes[0].selected, 3);
+    CHECK_EQ(_muxes[1].selected, TCA9548A_NO_CHANNEL);
+
+    // Nothing to select for the same channel
+    stub_advance_us(_CONVERSION_US);
+    seesaw_sensor_driver.collect(&_probes[0][3], &job, raw);
+    i2c_sched_run(&job, 1);
+    CHECK_EQ(job.result, 2);
+    CHECK_EQ(seesaw_decode(raw), 303);
+    CHECK_EQ(_select_writes(), 2);
+
+    // The first mux is closed for the second
+    seesaw_sensor_driver.start_conversion(&_probes[1][5], &job);
+    i2c_sched_run(&job, 1);
+    CHECK_EQ(_select_writes(), 4);
+    CHECK_EQ(_muxes[0].selected, TCA9548A_NO_CHANNEL);
+
+    // Closed is cached too, so only the channel is written
+    seesaw_sensor_driver.start_conversion(&_probes[1][6], &job);
+    i2c_sched_run(&job, 1);
+    CHECK_EQ(_select_writes(), 5);
+
+    CHECK_EQ(stub_i2c_transfers(_MUX_BUS), 4 + 5);
+    CHECK_EQ(_mux_models[0].select_writes, 2);
+    CHECK_EQ(_mux_models[1].select_writes, 3);
+}
+
+static void test_missing_mux_fails_only_its_probes(void) {
+    _setup(1);
+
+    seesaw_sensor_t* sensors[_SCAN_SIZE];
+    int results[_SCAN_SIZE];
+    uint16_t moisture[_SCAN_SIZE];
+
+    _scan_list(sensors);
+    _scan(sensors, _SCAN_SIZE, results, moisture);
+
+    for (int i = 0; i < _SCAN_SIZE; i++) {
+        bool behind_missing = sensors[i]->mux && sensors[i]->mux->mux == &_muxes[1];
+
+        CHECK_EQ(results[i], behind_missing ? PICO_ERROR_GENERIC : 2);
+    }
+
+    // Tried again next time, as nothing is known about it
+    CHECK_EQ(_muxes[1].selected, TCA9548A_UNKNOWN);
+    CHECK_EQ(stub_i2c_clashes(_MUX_BUS), 0);
+}
+
+static void test_sampler_scan(void) {
+    _setup(_MUXES);
+
+    // The registry holds the direct probe and 7 behind the first mux
+    sensor_register(&seesaw_sensor_driver, &_direct);
+
+    for (int c = 0; c < SENSOR_MAX - 1; c++) {
+        sensor_register(&seesaw_sensor_driver, &_probes[0][c]);
+    }
+
+    for (int id = 0; id < sensor_count(); id++) {
+        sensor_set_demand(id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_CONTINUOUS);
+    }
+
+    // Resets go through the scheduler too
+    sensor_init_all();
+    CHECK_EQ(_direct_model.resets, 1);
+
+    for (int c = 0; c < SENSOR_MAX - 1; c++) {
+        CHECK_EQ(_probe_models[0][c].resets, 1);
+    }
+
+    uint32_t before = stub_i2c_transfers(_MUX_BUS);
+    uint64_t start_us = _now_us();
+    sensor_record_t record;
+
+    CHECK(sensor_sample_all(&record, false));
+    CHECK_EQ(record.valid_mask, 0xFF);
+    CHECK_EQ(record.values[0], 1000);
+
+    for (int c = 0; c < SENSOR_MAX - 1; c++) {
+        CHECK_EQ(record.values[c + 1], 300 + c);
+        CHECK_EQ(_probe_models[0][c].early_reads, 0);
+    }
+
+    // The resets left channel 6 open. Requests start there and open
+    // the other 6 channels once, and reads start at the last of them.
+    CHECK_EQ(stub_i2c_transfers(_MUX_BUS) - before, 2 * (SENSOR_MAX - 1) + 6 + 6);
+    CHECK(_now_us() - start_us < _CONVERSION_US + 20000);
+    CHECK_EQ(stub_i2c_clashes(_MUX_BUS), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_scan_reads_every_probe);
+    RUN_TEST(test_scan_transactions);
+    RUN_TEST(test_cached_selection_is_not_written_again);
+    RUN_TEST(test_missing_mux_fails_only_its_probes);
+    RUN_TEST(test_sampler_scan);
+
+    return test_report();
+}
@@ -0,0 +1,230 @@
+/*
+
+Button input on the virtual clock. Presses are fed to the pin as
+edge sequences with contact bounce at set times, and the gestures
+taken from the queue are checked for kind, timestamp and how soon
+after the last bounce they were reported, and for the view they leave
+shown once applied.
+
+*/
+
+#include "test.h"
+#include "input.h"
+#include "event_loop.h"
+#include "viewmode_select.h"
+
+#define _PIN 15
+
+// input.c settles for 5 ms after the last edge
+#define _SETTLE_US 5000
+
+static void _hold_pressed(void* arg) {
+    stub_gpio_hold(_PIN, 1);
+}
+
+static void _let_go(void* arg) {
+    stub_gpio_hold(_PIN, -1);
+}
+
+// Changes the pin at start_us and then at each offset in bounces,
+// ending at the new level. The button pulls the pin high when pressed.
+static void _edges(uint64_t start_us, bool pressed, const uint32_t* bounces, int count) {
+    bool level = pressed;
+
+    stub_schedule_at_us(start_us, level ? _hold_pressed : _let_go, NULL);
+
+    // An odd number of bounces would end at the old level
+    for (int i = 0; i < count; i++) {
+        level = !level;
+        stub_schedule_at_us(start_us + bounces[i], level ? _hold_pressed : _let_go, NULL);
+    }
+}
+
+static void _clean_press(uint64_t start_us, uint64_t length_us) {
+    _edges(start_us, true, NULL, 0);
+    _edges(start_us + length_us, false, NULL, 0);
+}
+
+static void _start(void) {
+    event_loop_init();
+    input_init(_PIN);
+}
+
+static void test_bouncing_press_is_one_press(void) {
+    static const uint32_t press_bounce[] = {200, 500, 900, 1600};
+    static const uint32_t release_bounce[] = {150, 400, 700, 2100};
+
+    _start();
+
+    _edges(10000, true, press_bounce, 4);
+    _edges(110000, false, release_bounce, 4);
+
+    // Not yet stable 5 ms after the last bounce
+    stub_advance_to_us(10000 + 1600 + _SETTLE_US - 100);
+
+    input_event_t event;
+    CHECK(!input_poll(&event));
+
+    // Reported on the stable edge, stamped with the first edge
+    stub_advance_to_us(10000 + 1600 + _SETTLE_US + 100);
+
+    CHECK(input_poll(&event));
+    CHECK_EQ(event.kind, INPUT_PRESS);
+    CHECK_EQ(event.time_us, 10000);
+
+    // The release and its bounce add nothing
+    stub_advance_us(1000000);
+    CHECK(!input_poll(&event));
+    CHECK_EQ(input_dropped(), 0);
+}
+
+static void test_bounce_back_to_released_is_not_a_press(void) {
+    static const uint32_t glitch[] = {300, 700, 1000};
+
+    _start();
+
+    _edges(10000, true, glitch, 3);
+    stub_advance_us(100000);
+
+    input_event_t event;
+    CHECK(!input_poll(&event));
+}
+
+static void test_long_press_follows_its_press(void) {
+    _start();
+
+    _clean_press(10000, 1200000);
+    stub_advance_us(2000000);
+
+    input_event_t event;
+
+    CHECK(input_poll(&event));
+    CHECK_EQ(event.kind, INPUT_PRESS);
+
+    // Reported while still held, 800 ms after the press settled
+    CHECK(input_poll(&event));
+    CHECK_EQ(event.kind, INPUT_LONG_PRESS);
+    CHECK_NEAR(event.time_us, 10000 + _SETTLE_US + 800000, 100);
+
+    CHECK(!input_poll(&event));
+}
+
+static void test_long_press_stays_on_its_view(void) {
+    _start();
+    viewmode_set(SOIL_TREND);
+
+    _clean_press(10000, 1200000);
+
+    input_event_t event;
+
+    // The press moves on at once, as it may be a short one
+    stub_advance_to_us(10000 + _SETTLE_US + 100);
+    CHECK(input_poll(&event));
+    CHECK_EQ(viewmode_input(event.kind), LIGHT_TREND);
+
+    // Held on, it was a long press on the view it started on
+    stub_advance_us(1000000);
+    CHECK(input_poll(&event));
+    CHECK_EQ(event.kind, INPUT_LONG_PRESS);
+    CHECK_EQ(viewmode_input(event.kind), SOIL_TREND);
+
+    CHECK(!input_poll(&event));
+
+    // The next press carries on from there
+    _clean_press(2000000, 100000);
+    stub_advance_us(1000000);
+    CHECK(input_poll(&event));
+    CHECK_EQ(viewmode_input(event.kind), LIGHT_TREND);
+}
+
+static void test_short_hold_is_not_a_long_press(void) {
+    _start();
+
+    _clean_press(10000, 700000);
+    stub_advance_us(2000000);
+
+    input_event_t event;
+
+    CHECK(input_poll(&event));
+    CHECK_EQ(event.kind, INPUT_PRESS);
+    CHECK(!input_poll(&event));
+}
+
+static void test_double_press_is_its_own_gesture(void) {
+    static const uint32_t bounce[] = {100, 400, 800, 1100};
+
+    _start();
+
+    // Two bouncing presses 200 ms apart, then a third 200 ms later
+    _edges(10000, true, bounce, 4);
+    _edges(80000, false, bounce, 4);
+    _edges(210000, true, bounce, 4);
+    _edges(280000, false, bounce, 4);
+    _edges(410000, true, bounce, 4);
+    _edges(480000, false, bounce, 4);
+    stub_advance_us(1000000);
+
+    input_event_t event;
+    static const input_kind_t expected[] = {INPUT_PRESS, INPUT_PRESS, INPUT_DOUBLE_PRESS, INPUT_PRESS};
+    static const uint64_t expected_us[] = {10000, 210000, 210000, 410000};
+
+    // Both presses are reported as presses; the third starts a new pair
+    for (int i = 0; i < 4; i++) {
+        CHECK(input_poll(&event));
+        CHECK_EQ(event.kind, expected[i]);
+        CHECK_EQ(event.time_us, expected_us[i]);
+    }
+
+    CHECK(!input_poll(&event));
+}
+
+static void test_slow_presses_are_not_a_double_press(void) {
+    _start();
+
+    _clean_press(10000, 100000);
+    _clean_press(400000, 100000);
+    stub_advance_us(1000000);
+
+    input_event_t event;
+
+    for (int i = 0; i < 2; i++) {
+        CHECK(input_poll(&event));
+        CHECK_EQ(event.kind, INPUT_PRESS);
+    }
+
+    CHECK(!input_poll(&event));
+}
+
+static void test_full_queue_drops_gestures(void) {
+    _start();
+
+    // Presses far apart, so each is a single gesture
+    for (int i = 0; i < 10; i++) {
+        _clean_press(10000 + i * 500000, 100000);
+    }
+    stub_advance_us(6000000);
+
+    input_event_t event;
+    int taken = 0;
+
+    while (input_poll(&event)) {
+        CHECK_EQ(event.kind, INPUT_PRESS);
+        taken++;
+    }
+
+    CHECK_EQ(taken, 8);
+    CHECK_EQ(input_dropped(), 2);
+}
+
+int main(void) {
+    RUN_TEST(test_bouncing_press_is_one_press);
+    RUN_TEST(test_bounce_back_to_released_is_not_a_press);
+    RUN_TEST(test_long_press_follows_its_press);
+    RUN_TEST(test_long_press_stays_on_its_view);
+    RUN_TEST(test_short_hold_is_not_a_long_press);
+    RUN_TEST(test_double_press_is_its_own_gesture);
+    RUN_TEST(test_slow_presses_are_not_a_double_press);
+    RUN_TEST(test_full_queue_drops_gestures);
+
+    return test_report();
+}
@@ -0,0 +1,181 @@
+/*
+
+Latency histograms. Bucket bounds are checked against every value up
+to 2^20 us and at each power of two above, percentiles against exact
+ones, and recording from threads standing in for core1 and from
+interrupts against a single-threaded count of the same values.
+
+*/
+
+#include "test.h"
+#include <pthread.h>
+#include "latency_hist.h"
+
+#define _THREADS 3
+#define _VALUES_PER_THREAD 1000000
+#define _INTERRUPTS 20
+
+static latency_hist_t _shared = {.name = "shared"};
+
+// Lets every thread start recording at once
+static pthread_barrier_t _start;
+
+// The value a thread records at step i. Spread over many buckets.
+static uint32_t _value(int thread, int i) {
+    return ((uint32_t)i * 7919u + (uint32_t)thread * 104729u) % 300000u;
+}
+
+static void test_buckets_hold_their_values(void) {
+    uint32_t last_bucket = 0;
+
+    for (uint32_t us = 0; us <= (1u << 20); us++) {
+        uint32_t bucket = latency_hist_bucket(us);
+
+        if (latency_hist_bucket_low(bucket) > us || latency_hist_bucket_high(bucket) < us) {
+            CHECK_EQ(us, latency_hist_bucket_low(bucket));
+            return;
+        }
+
+        // Buckets only grow with the value
+        CHECK(bucket >= last_bucket);
+        last_bucket = bucket;
+    }
+
+    for (int exp = 21; exp < 32; exp++) {
+        uint32_t values[] = {(1u << exp) - 1, 1u << exp, (1u << exp) + 1};
+
+        for (int i = 0; i < 3; i++) {
+            uint32_t bucket = latency_hist_bucket(values[i]);
+
+            CHECK(latency_hist_bucket_low(bucket) <= values[i]);
+            CHECK(latency_hist_bucket_high(bucket) >= values[i]);
+        }
+    }
+
+    CHECK_EQ(latency_hist_bucket(UINT32_MAX), LATENCY_HIST_BUCKETS - 1);
+}
+
+static void test_buckets_are_contiguous_and_narrow(void) {
+    CHECK_EQ(latency_hist_bucket_low(0), 0);
+    CHECK_EQ(latency_hist_bucket_high(LATENCY_HIST_BUCKETS - 1), UINT32_MAX);
+
+    for (uint32_t b = 0; b + 1 < LATENCY_HIST_BUCKETS; b++) {
+        uint32_t low = latency_hist_bucket_low(b);
+        uint32_t high = latency_hist_bucket_high(b);
+
+        CHECK_EQ(latency_hist_bucket_low(b + 1), high + 1);
+
+        // Exact below 8 us, then at most 1/8 of the values held
+        if (low < 8) {
+            CHECK_EQ(high, low);
+        } else {
+            CHECK((uint64_t)(high - low + 1) * 8 <= low);
+        }
+    }
+}
+
+static void test_percentiles_are_upper_bounds(void) {
+    static latency_hist_t hist = {.name = "percentiles"};
+    static const uint32_t permilles[] = {500, 900, 990, 999};
+
+    latency_hist_init();
+
+    // 1..5000 us once each: the exact percentile is its rank
+    for (uint32_t us = 1; us <= 5000; us++) {
+        latency_hist_record(&hist, us);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        uint32_t exact = (5000 * permilles[i] + 999) / 1000;
+        uint32_t bound = latency_hist_percentile(&hist, permilles[i]);
+
+        CHECK(bound >= exact);
+        CHECK(bound <= exact + exact / 8);
+    }
+
+    CHECK_EQ(latency_hist_percentile(&hist, 1000), 5000);
+    CHECK_EQ(hist.max_us, 5000);
+}
+
+static void* _record_thread(void* arg) {
+    int thread = (int)(intptr_t)arg;
+
+    pthread_barrier_wait(&_start);
+
+    for (int i = 0; i < _VALUES_PER_THREAD; i++) {
+        latency_hist_record(&_shared, _value(thread, i));
+    }
+
+    return NULL;
+}
+
+static void _record_interrupt(void* arg) {
+    latency_hist_record(&_shared, (uint32_t)(uintptr_t)arg);
+}
+
+static void test_concurrent_recording_loses_nothing(void) {
+    static uint32_t expected[LATENCY_HIST_BUCKETS];
+    uint32_t expected_max = 0;
+
+    latency_hist_init();
+    memset(expected, 0, sizeof(expected));
+
+    // Threads 1.._THREADS stand in for core1, thread 0 is core0
+    for (int thread = 0; thread <= _THREADS; thread++) {
+        for (int i = 0; i < _VALUES_PER_THREAD; i++) {
+            expected[latency_hist_bucket(_value(thread, i))]++;
+            expected_max = MAX(expected_max, _value(thread, i));
+        }
+    }
+
+    // Interrupts on core0 record between its own records
+    for (int i = 0; i < _INTERRUPTS; i++) {
+        stub_schedule_at_us(1 + i * 10, _record_interrupt, (void*)(uintptr_t)(1000 + i));
+        expected[latency_hist_bucket(1000 + i)]++;
+    }
+
+    pthread_t threads[_THREADS];
+    pthread_barrier_init(&_start, NULL, _THREADS + 1);
+
+    for (int t = 0; t < _THREADS; t++) {
+        pthread_create(&threads[t], NULL, _record_thread, (void*)(intptr_t)(t + 1));
+    }
+
+    pthread_barrier_wait(&_start);
+
+    for (int i = 0; i < _VALUES_PER_THREAD; i++) {
+        latency_hist_record(&_shared, _value(0, i));
+
+        if (i % 1000 == 0) {
+            stub_advance_us(1);
+        }
+    }
+
+    for (int t = 0; t < _THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    pthread_barrier_destroy(&_start);
+
+    stub_advance_us(1000);
+
+    CHECK_EQ(_shared.count, (_THREADS + 1) * _VALUES_PER_THREAD + _INTERRUPTS);
+    CHECK_EQ(_shared.max_us, expected_max);
+
+    int wrong_buckets = 0;
+
+    for (uint32_t b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+        wrong_buckets += _shared.counts[b] != expected[b];
+    }
+
+    CHECK_EQ(wrong_buckets, 0);
+}
+
+int main(void) {
+    RUN_TEST(test_buckets_hold_their_values);
+    RUN_TEST(test_buckets_are_contiguous_and_narrow);
+    RUN_TEST(test_percentiles_are_upper_bounds);
+    RUN_TEST(test_concurrent_recording_loses_nothing);
+
+    return test_report();
+}
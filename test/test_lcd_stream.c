@@ -0,0 +1,127 @@
+/*
+
+LCD stream PIO program. FIFO words are encoded the way lcd.c builds
+them, fed to the program by DMA on the stub PIO, and decoded again
+from the pins by a simulated SPI receiver.
+
+*/
+
+#include "test.h"
+#include "spi_device.h"
+#include "hardware/dma.h"
+#include "lcd_stream.pio.h"
+
+// Pins lcd.c uses
+#define _PIN_SCK 18
+#define _PIN_MOSI 19
+#define _PIN_DC 20
+
+// 4 MHz SCK from 125 MHz, 4 SM cycles per SCK period
+#define _DIV_INT 7
+#define _DIV_FRAC 208
+
+static void _stream(uint pin_sck, uint pin_mosi, uint pin_dc, const uint32_t* words, uint count) {
+    uint offset = pio_add_program(pio1, &lcd_stream_program);
+    uint sm = pio_claim_unused_sm(pio1, true);
+    uint dma = dma_claim_unused_channel(true);
+
+    lcd_stream_program_init(pio1, sm, offset, pin_sck, pin_mosi, pin_dc, _DIV_INT, _DIV_FRAC);
+
+    dma_channel_config c = dma_channel_get_default_config(dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio1, sm, true));
+    dma_channel_configure(dma, &c, &pio1->txf[sm], words, count, true);
+
+    dma_channel_wait_for_finish_blocking(dma);
+
+    // Let the SM shift out what is still in its FIFO
+    stub_advance_us(100);
+}
+
+static void test_word_round_trip(void) {
+    for (int is_data = 0; is_data < 2; is_data++) {
+        for (int byte = 0; byte < 256; byte++) {
+            bool decoded_is_data;
+            uint8_t decoded = lcd_stream_decode(lcd_stream_word(is_data, byte), &decoded_is_data);
+
+            CHECK_EQ(decoded, byte);
+            CHECK_EQ(decoded_is_data, is_data);
+        }
+    }
+}
+
+static void test_commands_and_data_reach_the_pins(void) {
+    // A segment as lcd.c sends it: set X, set bank, then data
+    static const struct {
+        bool is_data;
+        uint8_t byte;
+    } sent[] = {
+        {false, 0x80 | 12}, {false, 0x40 | 3},
+        {true, 0xFF}, {true, 0x00}, {true, 0xA5}, {true, 0x01}, {true, 0x80}, {true, 0xFE},
+        {false, 0x0C}, {true, 0x7F},
+    };
+    const uint count = sizeof(sent) / sizeof(sent[0]);
+    uint32_t words[sizeof(sent) / sizeof(sent[0])];
+
+    for (uint i = 0; i < count; i++) {
+        words[i] = lcd_stream_word(sent[i].is_data, sent[i].byte);
+    }
+
+    spi_device_t device;
+    spi_device_attach(&device, _PIN_SCK, _PIN_MOSI, _PIN_DC);
+
+    _stream(_PIN_SCK, _PIN_MOSI, _PIN_DC, words, count);
+
+    CHECK_EQ(device.count, count);
+
+    for (uint i = 0; i < count && i < device.count; i++) {
+        CHECK_EQ(device.bytes[i], sent[i].byte);
+        CHECK_EQ(device.is_data[i], sent[i].is_data);
+    }
+}
+
+static void test_sck_within_baud_rate(void) {
+    uint32_t words[64];
+
+    for (uint i = 0; i < 64; i++) {
+        words[i] = lcd_stream_word(true, i * 37);
+    }
+
+    spi_device_t device;
+    spi_device_attach(&device, _PIN_SCK, _PIN_MOSI, _PIN_DC);
+
+    _stream(_PIN_SCK, _PIN_MOSI, _PIN_DC, words, 64);
+
+    CHECK_EQ(device.count, 64);
+
+    // 4 MHz at most
+    CHECK(device.min_period_ps >= 250000);
+}
+
+static void test_dc_need_not_follow_mosi(void) {
+    uint32_t words[] = {
+        lcd_stream_word(false, 0x21), lcd_stream_word(true, 0x55), lcd_stream_word(false, 0x20),
+    };
+
+    spi_device_t device;
+    spi_device_attach(&device, 2, 3, 10);
+
+    _stream(2, 3, 10, words, 3);
+
+    CHECK_EQ(device.count, 3);
+    CHECK_EQ(device.bytes[1], 0x55);
+    CHECK_EQ(device.is_data[0], false);
+    CHECK_EQ(device.is_data[1], true);
+    CHECK_EQ(device.is_data[2], false);
+}
+
+int main(void) {
+    RUN_TEST(test_word_round_trip);
+    RUN_TEST(test_commands_and_data_reach_the_pins);
+    RUN_TEST(test_sck_within_baud_rate);
+    RUN_TEST(test_dc_need_not_follow_mosi);
+
+    return test_report();
+}
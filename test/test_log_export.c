@@ -0,0 +1,297 @@
+/*
+
+The log export volume, read as a host would. The image is read
+through the mass-storage callbacks of usb_device.c, then parsed as
+FAT12 from the boot sector alone: the FAT and root directory are
+found from its fields, and each file is put together by following
+its cluster chain. LOG.CSV and LOG.BIN are then checked against the
+history they were made from.
+
+*/
+
+#include "test.h"
+#include <stdlib.h>
+#include "history.h"
+#include "log_export.h"
+#include "tusb.h"
+
+#define _BLOCK LOG_EXPORT_BLOCK_SIZE
+
+// Three hours of samples, one a minute
+#define _MINUTES 180
+
+#define _BIN_HEADER_LEN 16
+#define _BIN_ROW_LEN 28
+
+// What TinyUSB's MSC driver calls, implemented by usb_device.c
+void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size);
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
+
+// usb_device.c only calls these to run the device
+bool tusb_init(void) {
+    return true;
+}
+
+void tud_task(void) {
+}
+
+bool tud_msc_set_sense(uint8_t lun, uint8_t key, uint8_t asc, uint8_t ascq) {
+    return true;
+}
+
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+    int clusters;
+} _file_t;
+
+static uint8_t* _image;
+static uint32_t _image_size;
+
+static uint32_t _le(const uint8_t* in, int bytes) {
+    uint32_t value = 0;
+
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+
+    return value;
+}
+
+// Moisture of minute m, in 1/8 counts: 1000 counts and m/8 more
+static int16_t _moisture(int m) {
+    return 1000 * HISTORY_MOISTURE_SCALE + m;
+}
+
+static void _fill_history(void) {
+    history_init();
+
+    for (int m = 0; m < _MINUTES; m++) {
+        history_add_sample(HISTORY_MOISTURE, _moisture(m), m * 60);
+        history_add_sample(HISTORY_LUX, 100 * m, m * 60);
+        history_add_sample(HISTORY_TEMPERATURE, 20 + m / 60, m * 60);
+    }
+
+    stub_advance_to_us((uint64_t)_MINUTES * 60 * 1000000);
+    log_export_snapshot();
+}
+
+// Reads the whole volume the way a host does, several blocks at a time
+static void _read_image(void) {
+    uint32_t block_count;
+    uint16_t block_size;
+
+    tud_msc_capacity_cb(0, &block_count, &block_size);
+    CHECK_EQ(block_size, _BLOCK);
+
+    _image_size = block_count * _BLOCK;
+    _image = calloc(block_count, _BLOCK);
+
+    for (uint32_t lba = 0; lba < block_count; lba += 8) {
+        uint32_t bytes = MIN(8, block_count - lba) * _BLOCK;
+        CHECK_EQ(tud_msc_read10_cb(0, lba, 0, _image + lba * _BLOCK, bytes), bytes);
+    }
+}
+
+// Follows a file's cluster chain through the FAT and copies it out
+static _file_t _read_file(const char name[11]) {
+    const uint8_t* boot = _image;
+    _file_t file = {NULL, 0, 0};
+
+    uint32_t sector = _le(boot + 11, 2);
+    uint32_t per_cluster = boot[13] * sector;
+    uint32_t fat = _le(boot + 14, 2) * sector;
+    uint32_t root = fat + boot[16] * _le(boot + 22, 2) * sector;
+    uint32_t root_entries = _le(boot + 17, 2);
+    uint32_t data = root + root_entries * 32;
+
+    for (uint32_t e = 0; e < root_entries; e++) {
+        const uint8_t* entry = _image + root + e * 32;
+
+        if (memcmp(entry, name, 11) != 0) {
+            continue;
+        }
+
+        file.size = _le(entry + 28, 4);
+        file.data = calloc(1, file.size + 1);
+
+        uint32_t cluster = _le(entry + 26, 2);
+        uint32_t done = 0;
+
+        while (cluster >= 2 && cluster < 0xFF8 && done < file.size) {
+            uint32_t offset = data + (cluster - 2) * per_cluster;
+            uint32_t len = MIN(per_cluster, file.size - done);
+
+            CHECK(offset + len <= _image_size);
+            memcpy(file.data + done, _image + offset, len);
+            done += len;
+            file.clusters++;
+
+            // Two 12-bit entries are packed in three bytes
+            uint32_t packed = _le(_image + fat + cluster * 3 / 2, 2);
+            cluster = cluster & 1 ? packed >> 4 : packed & 0xFFF;
+        }
+
+        // The chain ends where the file does
+        CHECK(cluster >= 0xFF8);
+        CHECK_EQ(done, file.size);
+        break;
+    }
+
+    return file;
+}
+
+static void test_volume_is_fat12(void) {
+    _fill_history();
+    _read_image();
+
+    const uint8_t* boot = _image;
+
+    CHECK_EQ(boot[0], 0xEB);
+    CHECK_EQ(boot[510], 0x55);
+    CHECK_EQ(boot[511], 0xAA);
+    CHECK_EQ(_le(boot + 11, 2), _BLOCK);
+    CHECK_EQ(_le(boot + 19, 2) * _BLOCK, _image_size);
+    CHECK(memcmp(boot + 54, "FAT12   ", 8) == 0);
+
+    // The FAT starts with the media byte
+    uint32_t fat = _le(boot + 14, 2) * _BLOCK;
+    CHECK_EQ(_image[fat], boot[21]);
+
+    _file_t csv = _read_file("LOG     CSV");
+    _file_t bin = _read_file("LOG     BIN");
+
+    CHECK(csv.data != NULL);
+    CHECK(bin.data != NULL);
+    CHECK_EQ(csv.clusters, (csv.size + _BLOCK - 1) / _BLOCK);
+    CHECK_EQ(bin.clusters, (bin.size + _BLOCK - 1) / _BLOCK);
+
+    // Reads at an offset inside a block see the same bytes
+    static uint8_t part[_BLOCK + 100];
+    uint32_t lba = 5;
+
+    CHECK_EQ(tud_msc_read10_cb(0, lba, 300, part, sizeof(part)), sizeof(part));
+    CHECK(memcmp(part, _image + lba * _BLOCK + 300, sizeof(part)) == 0);
+
+    free(csv.data);
+    free(bin.data);
+    free(_image);
+}
+
+// Compares a CSV row with the history's bucket
+static void _check_csv_row(const char* row, const history_point_t points[HISTORY_SENSOR_COUNT],
+                           const bool valid[HISTORY_SENSOR_COUNT]) {
+    static const history_sensor_t columns[] = {HISTORY_MOISTURE, HISTORY_LUX, HISTORY_TEMPERATURE};
+    const char* field = strchr(strchr(row, ',') + 1, ',');
+
+    for (int s = 0; s < HISTORY_SENSOR_COUNT; s++) {
+        const history_point_t* point = &points[columns[s]];
+        int16_t values[3] = {point->min, point->avg, point->max};
+
+        for (int v = 0; v < 3; v++) {
+            char* end;
+            double value = strtod(field + 1, &end);
+
+            if (!valid[columns[s]]) {
+                CHECK(end == field + 1);
+            } else if (columns[s] == HISTORY_MOISTURE) {
+                CHECK_NEAR(value, (double)values[v] / HISTORY_MOISTURE_SCALE, 0.05);
+            } else {
+                CHECK_EQ(value, values[v]);
+            }
+
+            field = strchr(field + 1, ',');
+
+            if (!field) {
+                return;
+            }
+        }
+    }
+}
+
+static void test_files_hold_the_history(void) {
+    _fill_history();
+    _read_image();
+
+    _file_t csv = _read_file("LOG     CSV");
+    _file_t bin = _read_file("LOG     BIN");
+
+    CHECK(strncmp((char*)csv.data, "period_s,   start_s,moist_min", 29) == 0);
+
+    CHECK(memcmp(bin.data, "PHPLOG", 6) == 0);
+    CHECK_EQ(bin.data[6], 2);
+    CHECK_EQ(bin.data[7], HISTORY_SENSOR_COUNT);
+    CHECK_EQ(_le(bin.data + 10, 2), _BIN_ROW_LEN);
+    CHECK_EQ(_le(bin.data + 12, 4), _MINUTES * 60);
+
+    uint32_t rows = _le(bin.data + 8, 2);
+    CHECK_EQ(rows, HISTORY_RES_COUNT * HISTORY_BUCKETS);
+    CHECK_EQ(bin.size, _BIN_HEADER_LEN + rows * _BIN_ROW_LEN);
+
+    // Every CSV row is as long as the header
+    const char* line = (char*)csv.data;
+    size_t row_len = strchr(line, '\n') - line + 1;
+    CHECK_EQ(csv.size, (rows + 1) * row_len);
+
+    int filled_rows = 0;
+
+    for (uint32_t r = 0; r < rows; r++) {
+        const uint8_t* bin_row = bin.data + _BIN_HEADER_LEN + r * _BIN_ROW_LEN;
+        const char* csv_row = line + (r + 1) * row_len;
+
+        CHECK(csv_row[row_len - 2] == '\r' && csv_row[row_len - 1] == '\n');
+
+        uint32_t period_s = _le(bin_row, 4);
+        uint32_t start_s = _le(bin_row + 4, 4);
+
+        if (period_s == 0) {
+            // Older than the history: blank in both files
+            CHECK_EQ(bin_row[8], 0);
+            CHECK_EQ(strtol(csv_row, NULL, 10), 0);
+            continue;
+        }
+
+        CHECK_EQ(strtol(csv_row, NULL, 10), period_s);
+        CHECK_EQ(strtol(strchr(csv_row, ',') + 1, NULL, 10), start_s);
+
+        history_resolution_t resolution = r / HISTORY_BUCKETS;
+        CHECK_EQ(period_s, history_period_s(resolution));
+
+        history_point_t points[HISTORY_SENSOR_COUNT];
+        bool valid[HISTORY_SENSOR_COUNT];
+
+        for (int s = 0; s < HISTORY_SENSOR_COUNT; s++) {
+            valid[s] = history_get_bucket(s, resolution, start_s / period_s, &points[s]);
+            CHECK_EQ((bin_row[8] >> s) & 1, valid[s]);
+
+            if (valid[s]) {
+                const uint8_t* values = bin_row + 10 + s * 6;
+
+                CHECK_EQ((int16_t)_le(values, 2), points[s].min);
+                CHECK_EQ((int16_t)_le(values + 2, 2), points[s].avg);
+                CHECK_EQ((int16_t)_le(values + 4, 2), points[s].max);
+            }
+        }
+
+        _check_csv_row(csv_row, points, valid);
+        filled_rows += valid[HISTORY_MOISTURE];
+    }
+
+    // The last 84 minutes, 12 quarter hours and 3 hours
+    CHECK_EQ(filled_rows, HISTORY_BUCKETS + _MINUTES / 15 + _MINUTES / 60);
+
+    // The newest minute, as written: 1000 counts and 179/8
+    const char* newest = line + HISTORY_BUCKETS * row_len;
+    CHECK(strstr(newest, "   1022.4,   1022.4,   1022.4,    17900,") != NULL);
+
+    free(csv.data);
+    free(bin.data);
+    free(_image);
+}
+
+int main(void) {
+    RUN_TEST(test_volume_is_fat12);
+    RUN_TEST(test_files_hold_the_history);
+
+    return test_report();
+}
@@ -0,0 +1,184 @@
+/*
+
+Faults on the 1-wire bus. The DS18B20 driver runs its PIO program on
+the stub PIO against a simulated device which answers, is missing, or
+holds the line low. A missing device fails both the conversion and
+the read as soon as the reset in them finds no presence pulse; a line
+held low fails them by timing out and has the SM restarted, after
+which a device which answers again is read. The sampler faults the
+temperature sensor while it fails and reads it again once it answers.
+
+*/
+
+#include "test.h"
+#include "onewire_device.h"
+#include "ds18b20.h"
+#include "sensor.h"
+#include "hardware/clocks.h"
+
+#define _PIN 22
+
+// Reset, Skip ROM and Convert T
+#define _CONVERT_BITS 16
+
+static onewire_device_t _device;
+static ds18b20_sensor_t _sensor;
+static int _sensor_id;
+
+static uint64_t _now_us(void) {
+    return stub_now_ps() / 1000000;
+}
+
+// Sensors keep when they last started across tests, so each test
+// starts later than the last
+static void _start(void) {
+    static uint64_t start_us = 0;
+
+    start_us += 100000000;
+    stub_advance_to_us(start_us);
+}
+
+static void _setup(onewire_mode_t mode) {
+    _start();
+
+    _sensor = (ds18b20_sensor_t){pio0, _PIN, -1, false};
+    CHECK(ds18b20_sensor_driver.init(&_sensor));
+
+    // Attached once the pull-up is on, as the line only idles high from then
+    onewire_device_init(&_device, mode);
+    stub_gpio_attach(_PIN, &_device.gpio);
+}
+
+static bool _convert(void) {
+    return ds18b20_sensor_driver.start_conversion(&_sensor, NULL);
+}
+
+static bool _collect(uint8_t raw[SENSOR_RAW_MAX]) {
+    return ds18b20_sensor_driver.collect(&_sensor, NULL, raw);
+}
+
+static void test_conversion_waits_for_the_bus(void) {
+    _setup(ONEWIRE_PRESENT);
+
+    ds18b20_timing_t timing;
+    ds18b20_timing_for_clock(clock_get_hz(clk_sys), &timing);
+
+    uint64_t start_us = _now_us();
+
+    // Done once the device has taken the command, not once it is queued
+    CHECK(_convert());
+    CHECK_EQ(_device.conversions, 1);
+    CHECK(_now_us() - start_us >= (timing.reset_low_ns + _CONVERT_BITS * timing.slot_ns) / 1000);
+
+    uint8_t raw[SENSOR_RAW_MAX] = {0};
+
+    stub_advance_us(750000);
+    CHECK(_collect(raw));
+    CHECK_EQ(ds18b20_sensor_driver.decode(&_sensor, raw), 25);
+}
+
+static void test_missing_device_fails_conversion_and_read(void) {
+    _setup(ONEWIRE_ABSENT);
+
+    uint64_t start_us = _now_us();
+    uint8_t raw[SENSOR_RAW_MAX] = {0};
+
+    // Found by the reset, well before the transaction would time out
+    CHECK(!_convert());
+    CHECK(_now_us() - start_us < 5000);
+
+    CHECK(!_collect(raw));
+
+    // The SM carries on with the next transaction
+    _device.mode = ONEWIRE_PRESENT;
+
+    CHECK(_convert());
+    CHECK_EQ(_device.conversions, 1);
+}
+
+static void test_line_held_low_times_out_and_restarts(void) {
+    _setup(ONEWIRE_STUCK_LOW);
+
+    uint64_t start_us = _now_us();
+    uint8_t raw[SENSOR_RAW_MAX] = {0};
+
+    // Nothing to wait for but the deadline
+    CHECK(!_convert());
+    CHECK(_now_us() - start_us >= 4 * 2000);    // 4 words, 2 ms each
+
+    CHECK(!_collect(raw));
+
+    // The restarted SM starts the next transaction from the top
+    _device.mode = ONEWIRE_PRESENT;
+    onewire_device_set_temperature(&_device, 18 * 16);
+
+    CHECK(_convert());
+    stub_advance_us(750000);
+    CHECK(_collect(raw));
+    CHECK_EQ(ds18b20_sensor_driver.decode(&_sensor, raw), 18);
+    CHECK_EQ(_device.conversions, 1);
+    CHECK_EQ(_device.scratchpad_reads, 1);
+}
+
+// Waits for the sensor to be due and takes a sample
+static bool _sample(sensor_record_t* record) {
+    CHECK(sensor_wait_until_due(2 * SENSOR_FAULT_RETRY_MS));
+
+    sensor_sample_all(record, false);
+
+    return sensor_record_valid(record, _sensor_id);
+}
+
+static void test_missing_sensor_faults_and_recovers(void) {
+    _start();
+
+    // Set up by the sampler this time
+    _sensor = (ds18b20_sensor_t){pio0, _PIN, -1, false};
+    sensor_init_all();
+    CHECK_EQ(sensor_health(_sensor_id), SENSOR_HEALTH_OK);
+
+    onewire_device_init(&_device, ONEWIRE_PRESENT);
+    stub_gpio_attach(_PIN, &_device.gpio);
+
+    sensor_set_demand(_sensor_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_CONTINUOUS);
+
+    sensor_record_t record;
+
+    CHECK(_sample(&record));
+    CHECK_EQ(sensor_health(_sensor_id), SENSOR_HEALTH_OK);
+
+    _device.mode = ONEWIRE_ABSENT;
+
+    // Each failed conversion ends the sample, with no 750 ms wait
+    for (int i = 0; i < SENSOR_FAULT_AFTER; i++) {
+        uint64_t start_us = _now_us();
+
+        CHECK_EQ(sensor_health(_sensor_id), SENSOR_HEALTH_OK);
+        CHECK(!_sample(&record));
+        CHECK(record.conversion_ms[_sensor_id] == 0);
+        CHECK(_now_us() - start_us < SENSOR_FAULT_RETRY_MS * 1000 + 5000);
+    }
+
+    CHECK_EQ(sensor_health(_sensor_id), SENSOR_HEALTH_FAULT);
+    CHECK_EQ(sensor_fault_mask(), 1u << _sensor_id);
+
+    _device.mode = ONEWIRE_PRESENT;
+
+    CHECK(_sample(&record));
+    CHECK_EQ(record.values[_sensor_id], 25);
+    CHECK_EQ(sensor_health(_sensor_id), SENSOR_HEALTH_OK);
+
+    sensor_set_demand(_sensor_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_NONE);
+}
+
+int main(void) {
+    // The registry cannot be emptied, so the sensor is added once
+    _sensor_id = sensor_register(&ds18b20_sensor_driver, &_sensor);
+
+    RUN_TEST(test_conversion_waits_for_the_bus);
+    RUN_TEST(test_missing_device_fails_conversion_and_read);
+    RUN_TEST(test_line_held_low_times_out_and_restarts);
+    RUN_TEST(test_missing_sensor_faults_and_recovers);
+
+    return test_report();
+}
@@ -0,0 +1,179 @@
+/*
+
+View rendering against golden images. Each render case is drawn by
+the real view code and LCD driver, streamed through the stub PIO,
+and decoded from the pins by a simulated SPI receiver. An emulated
+PCD8544 is fed what came off the wire, and its image is compared
+with test/golden/<name>.pbm.
+
+The emulator lcd.c feeds from its stream words is checked against
+the same image, and the on-board self-test is run as well.
+
+To accept a rendering change, run with RENDER_UPDATE_GOLDENS=1 set
+and review the changed images.
+
+*/
+
+#include "test.h"
+#include <stdlib.h>
+#include "spi_device.h"
+#include "lcd.h"
+#include "graphics.h"
+#include "pcd8544_emu.h"
+#include "render_test.h"
+
+// Pins lcd.c uses
+#define _PIN_SCK 18
+#define _PIN_MOSI 19
+#define _PIN_DC 20
+
+typedef bool _image_t[PCD8544_HEIGHT][PCD8544_WIDTH];
+
+// clock_profile.c only needs these when low power mode is on
+bool power_low_power_enabled(void) {
+    return false;
+}
+
+void power_start_epoch(void) {
+}
+
+static void _golden_path(char* path, size_t size, const char* name) {
+    snprintf(path, size, "golden/%s.pbm", name);
+}
+
+// Reads a plain (P1) PBM image of the panel's size
+static bool _read_pbm(const char* name, _image_t image) {
+    char path[64];
+    _golden_path(path, sizeof(path), name);
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    int width, height;
+    bool ok = fscanf(file, "P1 %d %d", &width, &height) == 2 &&
+              width == PCD8544_WIDTH && height == PCD8544_HEIGHT;
+
+    for (int y = 0; ok && y < PCD8544_HEIGHT; y++) {
+        for (int x = 0; ok && x < PCD8544_WIDTH; x++) {
+            int pixel;
+            ok = fscanf(file, " %1d", &pixel) == 1;
+            image[y][x] = pixel;
+        }
+    }
+
+    fclose(file);
+    return ok;
+}
+
+static void _write_pbm(const char* name, const pcd8544_emu_t* emu) {
+    char path[64];
+    _golden_path(path, sizeof(path), name);
+
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return;
+    }
+
+    fprintf(file, "P1\n%d %d\n", PCD8544_WIDTH, PCD8544_HEIGHT);
+
+    for (int y = 0; y < PCD8544_HEIGHT; y++) {
+        for (int x = 0; x < PCD8544_WIDTH; x++) {
+            fputc(pcd8544_emu_pixel(emu, x, y) ? '1' : '0', file);
+        }
+        fputc('\n', file);
+    }
+
+    fclose(file);
+}
+
+static int _pixels_differing(const pcd8544_emu_t* emu, _image_t image) {
+    int differing = 0;
+
+    for (int y = 0; y < PCD8544_HEIGHT; y++) {
+        for (int x = 0; x < PCD8544_WIDTH; x++) {
+            differing += pcd8544_emu_pixel(emu, x, y) != image[y][x];
+        }
+    }
+
+    return differing;
+}
+
+static void _feed(pcd8544_emu_t* emu, spi_device_t* device) {
+    for (int i = 0; i < device->count; i++) {
+        if (device->is_data[i]) {
+            pcd8544_emu_data(emu, &device->bytes[i], 1);
+        } else {
+            pcd8544_emu_command(emu, device->bytes[i]);
+        }
+    }
+
+    device->count = 0;
+}
+
+static void test_views_match_goldens(void) {
+    static spi_device_t wire;
+    static pcd8544_emu_t wire_emu;
+    static pcd8544_emu_t tap_emu;
+
+    bool update = getenv("RENDER_UPDATE_GOLDENS") != NULL;
+
+    lcd_init();
+
+    // lcd_init() sets the panel up over SPI, before the stream takes
+    // over the pins. Attaching brings an emulator to that state; the
+    // wire emulator is only attached for that, then fed off the pins.
+    lcd_attach_emulator(&wire_emu);
+    lcd_attach_emulator(&tap_emu);
+
+    spi_device_attach(&wire, _PIN_SCK, _PIN_MOSI, _PIN_DC);
+
+    for (int i = 0; i < render_case_count; i++) {
+        const char* name = render_cases[i].name;
+
+        render_cases[i].draw();
+        graphics_wait_for_flush();
+
+        // Let the SM shift out what is still in its FIFO
+        stub_advance_us(100);
+
+        CHECK(wire.count < SPI_DEVICE_MAX_BYTES);
+        _feed(&wire_emu, &wire);
+
+        if (update) {
+            _write_pbm(name, &wire_emu);
+        }
+
+        static _image_t golden;
+
+        if (!_read_pbm(name, golden)) {
+            printf("  %s: no golden image\n", name);
+            _test_failures++;
+            continue;
+        }
+
+        int wire_diff = _pixels_differing(&wire_emu, golden);
+        int tap_diff = _pixels_differing(&tap_emu, golden);
+
+        if (wire_diff || tap_diff) {
+            printf("  %s: %d pixels differ on the wire, %d in the tap\n", name, wire_diff, tap_diff);
+            pcd8544_emu_print_pbm(&wire_emu, name);
+        }
+
+        CHECK_EQ(wire_diff, 0);
+        CHECK_EQ(tap_diff, 0);
+        CHECK(lcd_emulator_matches_buffer(&tap_emu));
+    }
+
+    lcd_attach_emulator(NULL);
+
+    // The on-board self-test passes on the same driver
+    CHECK(render_test_run());
+}
+
+int main(void) {
+    RUN_TEST(test_views_match_goldens);
+
+    return test_report();
+}
@@ -0,0 +1,71 @@
+/*
+
+Framed sample records. A known sample must give the exact line
+tools/test_collector.py parses, the checksum must be the standard
+CRC-16/CCITT-FALSE, and the longest possible frame must fit.
+
+*/
+
+#include "test.h"
+#include "sample_frame.h"
+
+// The same line is parsed in tools/test_collector.py
+#define _KNOWN_FRAME \
+    "(REC) 42,123456,05,a001000000000000,0000000000000000,05b900005b900200*a85a\n"
+
+static void test_crc_is_ccitt_false(void) {
+    // The standard check value
+    CHECK_EQ(sample_frame_crc("123456789", 9), 0x29B1);
+    CHECK_EQ(sample_frame_crc("", 0), 0xFFFF);
+}
+
+static void test_known_sample(void) {
+    sensor_record_t record = {0};
+
+    record.sequence = 42;
+    record.timestamp_ms = 123456;
+    record.count = 3;
+    record.valid_mask = 0x05;
+
+    // 26 C from the DS18B20, the lux sensor not read, and a burst of
+    // 16 moisture reads summing to 16 * 1465
+    static const uint8_t temperature[SENSOR_RAW_MAX] = {0xa0, 0x01};
+    static const uint8_t moisture[SENSOR_RAW_MAX] = {0x05, 0xb9, 0x00, 0x00, 0x5b, 0x90, 0x02};
+
+    memcpy(record.raw[0], temperature, SENSOR_RAW_MAX);
+    memcpy(record.raw[2], moisture, SENSOR_RAW_MAX);
+
+    char frame[SAMPLE_FRAME_MAX_LEN];
+    size_t len = sample_frame_format(&record, frame);
+
+    CHECK_STR(frame, _KNOWN_FRAME);
+    CHECK_EQ(len, strlen(_KNOWN_FRAME));
+}
+
+static void test_longest_frame_fits(void) {
+    sensor_record_t record;
+
+    memset(&record, 0xFF, sizeof(record));
+    record.count = SENSOR_MAX;
+
+    char frame[SAMPLE_FRAME_MAX_LEN + 1];
+    frame[SAMPLE_FRAME_MAX_LEN] = 'x';
+
+    size_t len = sample_frame_format(&record, frame);
+
+    CHECK_EQ(len, SAMPLE_FRAME_MAX_LEN - 1);
+    CHECK_EQ(strlen(frame), len);
+    CHECK_EQ(frame[len - 1], '\n');
+    CHECK_EQ(frame[SAMPLE_FRAME_MAX_LEN], 'x');
+
+    // One line: no line end before the last character
+    CHECK(strchr(frame, '\n') == frame + len - 1);
+}
+
+int main(void) {
+    RUN_TEST(test_crc_is_ccitt_false);
+    RUN_TEST(test_known_sample);
+    RUN_TEST(test_longest_frame_fits);
+
+    return test_report();
+}
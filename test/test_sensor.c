@@ -0,0 +1,182 @@
+/*
+
+The sampling engine with drivers that need no bus. A fake driver
+reads from a list of values, so bursts of an oversampled sensor can
+be checked for the value rounded to the driver's units and the fine
+value that keeps the burst's extra bits. Another fake fills every raw
+byte and cannot be oversampled.
+
+*/
+
+#include "test.h"
+#include "sensor.h"
+
+#define _CONVERSION_MS 5
+
+typedef struct {
+    const int32_t* reads;   // Values read in turn, repeating
+    int read_count;
+    int next;
+    bool burst;
+} _fake_t;
+
+static bool _fake_init(void* ctx) {
+    return true;
+}
+
+static bool _fake_start(void* ctx, i2c_job_t* job) {
+    return true;
+}
+
+static uint32_t _fake_conversion_time_ms(void* ctx) {
+    return _CONVERSION_MS;
+}
+
+static bool _fake_collect(void* ctx, i2c_job_t* job, uint8_t raw[SENSOR_RAW_MAX]) {
+    _fake_t* fake = ctx;
+    int32_t value = fake->reads[fake->next++ % fake->read_count];
+
+    raw[0] = (uint16_t)value >> 8;
+    raw[1] = (uint16_t)value;
+    return true;
+}
+
+static int32_t _fake_decode(void* ctx, const uint8_t raw[SENSOR_RAW_MAX]) {
+    return (int16_t)((raw[0] << 8) | raw[1]);
+}
+
+static bool _fake_set_burst_mode(void* ctx, bool burst) {
+    ((_fake_t*)ctx)->burst = burst;
+    return true;
+}
+
+static const sensor_driver_t _fake_driver = {
+    .name = "fake",
+    .init = _fake_init,
+    .start_conversion = _fake_start,
+    .conversion_time_ms = _fake_conversion_time_ms,
+    .collect = _fake_collect,
+    .decode = _fake_decode,
+    .set_burst_mode = _fake_set_burst_mode,
+};
+
+// Fills the rest of the raw bytes, where a burst would be kept
+static bool _padded_collect(void* ctx, i2c_job_t* job, uint8_t raw[SENSOR_RAW_MAX]) {
+    _fake_collect(ctx, job, raw);
+
+    for (int i = 2; i < SENSOR_RAW_MAX; i++) {
+        raw[i] = 0x5A;
+    }
+    return true;
+}
+
+static const sensor_driver_t _padded_driver = {
+    .name = "padded",
+    .init = _fake_init,
+    .start_conversion = _fake_start,
+    .conversion_time_ms = _fake_conversion_time_ms,
+    .collect = _padded_collect,
+    .decode = _fake_decode,
+};
+
+static const int32_t _HALF_STEP[] = {500, 501};
+static const int32_t _NEGATIVE[] = {-3};
+
+static _fake_t _soil = {_HALF_STEP, 2};
+static _fake_t _cold = {_NEGATIVE, 1};
+static _fake_t _padded = {_HALF_STEP, 2};
+
+static int _soil_id;
+static int _cold_id;
+static int _padded_id;
+
+static void _start(void) {
+    _soil.next = 0;
+    _cold.next = 0;
+    _padded.next = 0;
+
+    // The registry keeps when each sensor last started, which the
+    // clock reset put in the future, so each test starts later than
+    // the last one ended
+    static uint64_t start_us = 0;
+    start_us += 10000000;
+    stub_advance_to_us(start_us);
+
+    sensor_init_all();
+
+    sensor_set_demand(_soil_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_CONTINUOUS);
+    sensor_set_demand(_cold_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_CONTINUOUS);
+    sensor_set_demand(_padded_id, SENSOR_CONSUMER_VIEW, SENSOR_DEMAND_CONTINUOUS);
+}
+
+static void test_single_reads_have_no_fraction(void) {
+    _start();
+    CHECK(sensor_set_oversampling(_soil_id, 1));
+
+    sensor_record_t record;
+    CHECK(sensor_sample_all(&record, false));
+
+    CHECK_EQ(record.values[_soil_id], 500);
+    CHECK_EQ(record.fine_values[_soil_id], 500 << SENSOR_FRACTION_BITS);
+    CHECK_EQ(record.values[_cold_id], -3);
+    CHECK_EQ(record.fine_values[_cold_id], -3 * (1 << SENSOR_FRACTION_BITS));
+    CHECK(!_soil.burst);
+}
+
+static void test_burst_keeps_its_fraction(void) {
+    _start();
+    CHECK(sensor_set_oversampling(_soil_id, 16));
+    CHECK(_soil.burst);
+
+    sensor_record_t record;
+    CHECK(sensor_sample_all(&record, false));
+
+    // 500 and 501 alternating average 500.5: rounded up in the
+    // driver's units, exact in the fine value
+    CHECK_EQ(_soil.next, 16);
+    CHECK_EQ(record.values[_soil_id], 501);
+    CHECK_EQ(record.fine_values[_soil_id], 1001 << (SENSOR_FRACTION_BITS - 1));
+
+    // A replay of the raw bytes decodes the same
+    CHECK_EQ(sensor_decode(_soil_id, record.raw[_soil_id]), 501);
+    CHECK_EQ(sensor_decode_fine(_soil_id, record.raw[_soil_id]), record.fine_values[_soil_id]);
+
+    CHECK(sensor_set_oversampling(_soil_id, 1));
+}
+
+static void test_full_raw_bytes_are_not_a_burst(void) {
+    _start();
+    CHECK(!sensor_set_oversampling(_padded_id, 4));
+
+    sensor_record_t record;
+    CHECK(sensor_sample_all(&record, false));
+
+    // The driver's bytes where a burst's shift would be are left alone
+    CHECK_EQ(record.raw[_padded_id][6], 0x5A);
+    CHECK_EQ(record.values[_padded_id], 500);
+    CHECK_EQ(sensor_decode(_padded_id, record.raw[_padded_id]), 500);
+    CHECK_EQ(sensor_decode_fine(_padded_id, record.raw[_padded_id]), 500 << SENSOR_FRACTION_BITS);
+}
+
+static void test_burst_over_budget_is_refused(void) {
+    _start();
+
+    // 64 reads of 5 ms are over the 200 ms budget
+    CHECK(!sensor_set_oversampling(_soil_id, 64));
+    CHECK(!sensor_set_oversampling(_soil_id, 8));
+    CHECK(!_soil.burst);
+}
+
+int main(void) {
+    // The registry cannot be emptied, so the sensors are registered once
+    _soil_id = sensor_register(&_fake_driver, &_soil);
+    _cold_id = sensor_register(&_fake_driver, &_cold);
+    _padded_id = sensor_register(&_padded_driver, &_padded);
+
+    RUN_TEST(test_single_reads_have_no_fraction);
+    RUN_TEST(test_burst_keeps_its_fraction);
+    RUN_TEST(test_full_raw_bytes_are_not_a_burst);
+    RUN_TEST(test_burst_over_budget_is_refused);
+
+    return test_report();
+}
@@ -0,0 +1,181 @@
+/*
+
+Trace replay on the host. The built-in trace is played through the
+real driver decode, the view code and the LCD driver, against the
+SDK stubs instead of on the device. Stages are timed with the host's
+clock, so the real time factor printed is that of the host build.
+
+Publishing and the redraw rule stand in for main.c's: the shared
+sensor data is stored, the history fed, and a frame drawn whenever
+what is shown changes.
+
+*/
+
+#include "test.h"
+#include <time.h>
+#include "trace_replay.h"
+#include "sensor.h"
+#include "ds18b20.h"
+#include "bh1750_light_sensor.h"
+#include "soil_moisture_seesaw.h"
+#include "graphics.h"
+#include "history.h"
+#include "lcd.h"
+
+#define _MAX_FRAMES 32
+
+// clock_profile.c only needs these when low power mode is on
+bool power_low_power_enabled(void) {
+    return false;
+}
+
+void power_start_epoch(void) {
+}
+
+static ds18b20_sensor_t _temperature_sensor = {NULL, 22, -1, false};
+static bh1750_sensor_t _light_sensor;
+static seesaw_sensor_t _soil_sensor;
+
+static int _temperature_id;
+static int _lux_id;
+static int _moisture_id;
+
+// What main.c keeps in shared_sensor_data
+static bool _temperature_read;
+static int8_t _temperature;
+static uint16_t _lux;
+static uint16_t _moisture;    // In 1/HISTORY_MOISTURE_SCALE counts
+
+// What the last frame showed
+static bool _drawn;
+static bool _drawn_loading;
+static int8_t _drawn_temperature;
+static uint16_t _drawn_lux;
+static uint16_t _drawn_moisture;
+
+// Frames drawn during a replay
+static uint32_t _frame_sums[_MAX_FRAMES];
+static int _frame_count;
+
+static uint64_t _host_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void _publish(const sensor_record_t* record) {
+    uint32_t timestamp_s = record->timestamp_ms / 1000;
+
+    if (sensor_record_valid(record, _temperature_id)) {
+        _temperature_read = true;
+        _temperature = record->values[_temperature_id];
+        history_add_sample(HISTORY_TEMPERATURE, _temperature, timestamp_s);
+    }
+    if (sensor_record_valid(record, _lux_id)) {
+        _lux = MIN(record->values[_lux_id], UINT16_MAX - 1);
+        history_add_sample(HISTORY_LUX, MIN(_lux, INT16_MAX), timestamp_s);
+    }
+    if (sensor_record_valid(record, _moisture_id)) {
+        _moisture = MIN(record->fine_values[_moisture_id] * HISTORY_MOISTURE_SCALE >> SENSOR_FRACTION_BITS,
+                        UINT16_MAX - 1);
+        history_add_sample(HISTORY_MOISTURE, MIN(_moisture, INT16_MAX), timestamp_s);
+    }
+}
+
+static bool _render(void) {
+    bool loading = !_temperature_read;
+
+    if (_drawn && loading == _drawn_loading && _temperature == _drawn_temperature &&
+        _lux == _drawn_lux && _moisture == _drawn_moisture) {
+        return false;
+    }
+
+    if (loading) {
+        show_loading_view();
+    } else {
+        show_dual_view(_moisture, _lux, _temperature);
+    }
+
+    _drawn = true;
+    _drawn_loading = loading;
+    _drawn_temperature = _temperature;
+    _drawn_lux = _lux;
+    _drawn_moisture = _moisture;
+
+    graphics_wait_for_flush();
+
+    if (_frame_count < _MAX_FRAMES) {
+        _frame_sums[_frame_count] = lcd_panel_checksum();
+    }
+    _frame_count++;
+
+    return true;
+}
+
+static void _replay(void) {
+    _temperature_read = false;
+    _temperature = 0;
+    _lux = 0;
+    _moisture = 0;
+    _drawn = false;
+    _frame_count = 0;
+
+    history_init();
+    trace_replay_run(trace_builtin, trace_builtin_count, _publish, _render, _host_clock_us);
+}
+
+static void test_replay_decodes_and_draws(void) {
+    // The LCD driver keeps its stream set up, so it is only started
+    // once, with the stubs it was started on
+    graphics_init();
+
+    _replay();
+
+    // The last sample: 0x01a0 is 26 C, 0x0dec is 3564 counts or 2970 lx
+    CHECK_EQ(_temperature, 26);
+    CHECK_EQ(_lux, 2970);
+    CHECK_EQ(_moisture, 0x05b9 * HISTORY_MOISTURE_SCALE);
+
+    // LOADING until the third sample brings a temperature, then a
+    // frame for each sample that changed a value
+    CHECK(_frame_count > 2);
+    CHECK(_frame_count <= trace_builtin_count);
+    CHECK(_frame_sums[1] == _frame_sums[0]);
+    CHECK(_frame_sums[2] != _frame_sums[0]);
+
+    // Drawing the first and last views directly gives the same frames
+    uint32_t last = _frame_sums[MIN(_frame_count, _MAX_FRAMES) - 1];
+
+    show_loading_view();
+    graphics_wait_for_flush();
+    CHECK_EQ(_frame_sums[0], lcd_panel_checksum());
+
+    show_dual_view(_moisture, _lux, _temperature);
+    graphics_wait_for_flush();
+    CHECK_EQ(last, lcd_panel_checksum());
+
+    // A second replay draws the same frames
+    uint32_t first[_MAX_FRAMES];
+    int first_count = _frame_count;
+    memcpy(first, _frame_sums, sizeof(first));
+
+    _replay();
+
+    CHECK_EQ(_frame_count, first_count);
+
+    for (int i = 0; i < MIN(_frame_count, _MAX_FRAMES); i++) {
+        CHECK_EQ(_frame_sums[i], first[i]);
+    }
+}
+
+int main(void) {
+    // Registered once, in the same order as main.c, so the trace's
+    // sensor ids match
+    _temperature_id = sensor_register(&ds18b20_sensor_driver, &_temperature_sensor);
+    _lux_id = sensor_register(&bh1750_sensor_driver, &_light_sensor);
+    _moisture_id = sensor_register(&seesaw_sensor_driver, &_soil_sensor);
+
+    RUN_TEST(test_replay_decodes_and_draws);
+
+    return test_report();
+}
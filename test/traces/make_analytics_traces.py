@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Writes the reference traces for test_analytics.
+
+Each trace is a list of samples (time in s, lux, moisture; -1 where a
+sensor was not read) followed by the results a floating point
+reference gives for it. The reference follows the method described in
+src/analytics.c but shares no code with it:
+
+- DLI: trapezoid rule over PPFD = 0.0185 umol/m2/s per lux, not across
+  gaps over 10 minutes, days counted from boot.
+- Dry-down: least-squares line through the means of the last 48
+  complete 15-minute buckets of moisture, restarted at a missing
+  bucket.
+
+Run from this directory to regenerate the traces:
+
+    python3 make_analytics_traces.py
+"""
+
+import math
+
+DAY_S = 86400
+MAX_LIGHT_GAP_S = 600
+PPFD_PER_LUX = 0.0185
+DRY_BUCKET_S = 900
+DRY_WINDOW = 48
+DRY_MIN_POINTS = 4
+DRY_MOISTURE = 400
+MAX_HOURS_TO_DRY = 999
+
+
+class Noise:
+    """Small LCG, so the traces are the same on every run."""
+
+    def __init__(self, seed):
+        self.state = seed
+
+    def uniform(self, low, high):
+        self.state = (self.state * 1103515245 + 12345) % (1 << 31)
+        return low + (high - low) * self.state / (1 << 31)
+
+
+def reference_dli(samples):
+    """DLI of the last day and the day before, in mol/m2."""
+    today = 0.0
+    yesterday = None
+    last = None
+
+    for t, lux, _ in samples:
+        if lux < 0:
+            continue
+
+        day = t // DAY_S
+
+        if last and day != last[0] // DAY_S:
+            yesterday = today if day == last[0] // DAY_S + 1 else 0.0
+            today = 0.0
+
+        if last and 0 < t - last[0] <= MAX_LIGHT_GAP_S:
+            today += (lux + last[1]) / 2 * PPFD_PER_LUX * (t - last[0]) / 1e6
+
+        last = (t, lux)
+
+    return today, yesterday
+
+
+def reference_dry_down(samples):
+    """Points, rate in %/day and hours to dry, or None if not drying."""
+    buckets = {}
+
+    for t, _, moisture in samples:
+        if moisture >= 0:
+            buckets.setdefault(t // DRY_BUCKET_S, []).append(moisture)
+
+    # The newest bucket is still being filled
+    complete = sorted(buckets)[:-1]
+
+    window = []
+    for index in complete:
+        if window and index != window[-1][0] + 1:
+            window = []
+        window.append((index, sum(buckets[index]) / len(buckets[index])))
+
+    window = window[-DRY_WINDOW:]
+    n = len(window)
+
+    if n < DRY_MIN_POINTS:
+        return n, None
+
+    xs = range(n)
+    ys = [mean for _, mean in window]
+    x_mean = sum(xs) / n
+    y_mean = sum(ys) / n
+    slope = (sum((x - x_mean) * (y - y_mean) for x, y in zip(xs, ys))
+             / sum((x - x_mean) ** 2 for x in xs))
+
+    if slope >= 0:
+        return n, None
+
+    # Moisture is in 0.1% steps
+    rate = -slope * (DAY_S / DRY_BUCKET_S) / 10
+    fitted = y_mean + slope * (n - 1 - x_mean)
+
+    if fitted <= DRY_MOISTURE:
+        hours = 0
+    else:
+        hours = min((fitted - DRY_MOISTURE) / -slope * DRY_BUCKET_S / 3600, MAX_HOURS_TO_DRY)
+
+    return n, (rate, hours)
+
+
+def write_trace(name, description, samples):
+    today, yesterday = reference_dli(samples)
+    points, drying = reference_dry_down(samples)
+
+    with open(name + ".csv", "w") as out:
+        out.write("# " + description + "\n")
+        out.write("# Written by make_analytics_traces.py\n")
+
+        for t, lux, moisture in samples:
+            out.write("%d,%d,%d\n" % (t, lux, moisture))
+
+        out.write("expect dli_today_x100 %d\n" % round(today * 100))
+        if yesterday is not None:
+            out.write("expect dli_yesterday_x100 %d\n" % round(yesterday * 100))
+        out.write("expect dry_points %d\n" % points)
+        if drying:
+            out.write("expect dry_rate_x10 %d\n" % round(drying[0] * 10))
+            out.write("expect hours_to_dry %d\n" % round(drying[1]))
+        else:
+            out.write("expect not_drying\n")
+
+
+def daylight(t, noise):
+    hour = (t % DAY_S) / 3600
+    if not 6 <= hour <= 18:
+        return 0
+
+    clouds = noise.uniform(0.6, 1.0)
+    return min(round(30000 * math.sin(math.pi * (hour - 6) / 12) * clouds), 65534)
+
+
+def light_two_days():
+    noise = Noise(1)
+    samples = []
+
+    for t in range(0, 2 * DAY_S, 60):
+        # 20 minutes without readings at noon of the second day
+        if DAY_S + 12 * 3600 < t < DAY_S + 12 * 3600 + 1200:
+            continue
+        samples.append((t, daylight(t, noise), -1))
+
+    return samples
+
+
+def dry_down():
+    noise = Noise(2)
+    return [(t, -1, round(950 - 250 * t / DAY_S + noise.uniform(-4, 4)))
+            for t in range(0, 20 * 3600, 60)]
+
+
+def dry_down_after_gap():
+    noise = Noise(3)
+    samples = [(t, -1, round(800 - 100 * t / DAY_S + noise.uniform(-4, 4)))
+               for t in range(0, 10 * 3600, 60)]
+
+    # An hour without readings, then the soil dries faster
+    start = 11 * 3600
+    samples += [(t, -1, round(760 - 400 * (t - start) / DAY_S + noise.uniform(-4, 4)))
+                for t in range(start, start + 8 * 3600, 60)]
+
+    return samples
+
+
+def wet_soil():
+    noise = Noise(4)
+    return [(t, -1, round(1200 + 50 * t / DAY_S + noise.uniform(-4, 4)))
+            for t in range(0, 6 * 3600, 60)]
+
+
+if __name__ == "__main__":
+    write_trace("light_two_days",
+                "Two days of sun with passing clouds, a 20 minute gap at noon of day 2",
+                light_two_days())
+    write_trace("dry_down", "20 hours of soil drying 25 %/day from 95 %", dry_down())
+    write_trace("dry_down_after_gap",
+                "Slow drying, an hour without readings, then faster drying",
+                dry_down_after_gap())
+    write_trace("wet_soil", "Soil slowly getting wetter", wet_soil())
@@ -0,0 +1,739 @@
+#!/usr/bin/env python3
+"""Collects samples from many probes into memory-mapped columnar files.
+
+Each probe prints every sample over USB as one "(REC)" frame with a
+checksum (see src/sample_frame.c). Frames that were damaged or cut
+short are counted and dropped, and gaps in their sequence numbers are
+counted as lost samples. A stream can be a probe's USB serial device,
+a recorded log of one, or a synthetic probe used for testing:
+
+    python3 tools/collector.py collect data /dev/serial/by-id/usb-*
+    python3 tools/collector.py collect data probe-a.log
+    python3 tools/collector.py collect data synthetic:200 --seconds 60
+
+Every stream has its own reader thread, which decodes frames into
+samples. One event loop takes the samples from all readers, converts
+probe uptime to wall clock time and appends them to the store.
+
+The store has a directory per probe holding, for every channel
+(temperature, lux, moisture), one file of timestamps and one file of
+values. Both are arrays of 8-byte numbers behind a 16-byte header
+with the row count, mapped into memory and grown in chunks. A third
+file indexes each block of BLOCK_ROWS rows by its first and last
+timestamp and the min, max and sum of its values, so range queries
+find their rows with a binary search and downsampling reads whole
+blocks from the index instead of the columns:
+
+    python3 tools/collector.py query data probe-a lux --start 0 --step 60000
+
+The benchmark runs hundreds of synthetic probes unthrottled and checks
+that the collector stores samples faster than that many probes can
+produce them at the fastest sample rate of the firmware:
+
+    python3 tools/collector.py bench --probes 300 --seconds 10
+
+The frame parser and the store are tested by tools/test_collector.py.
+"""
+
+import argparse
+import array
+import binascii
+import bisect
+import math
+import mmap
+import os
+import queue
+import random
+import re
+import select
+import shutil
+import struct
+import sys
+import tempfile
+import termios
+import threading
+import time
+import tty
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+# Sensor ids in the order src/main.c registers them
+CHANNELS = ("temperature", "lux", "moisture")
+
+RAW_MAX = 8         # SENSOR_RAW_MAX
+RAW_SUM_BYTE = 2    # Sum of an oversampled burst, big-endian
+RAW_SHIFT_BYTE = 6  # n of the 4^n reads, 0 if not oversampled
+
+FRAME_TAG = "(REC) "   # SAMPLE_FRAME_TAG
+CRC_INIT = 0xFFFF       # CRC-16/CCITT-FALSE, as binascii.crc_hqx computes it
+
+COLUMN_MAGIC = b"PHPCOL1\0"
+COLUMN_HEADER = struct.Struct("<8sQ")
+COLUMN_CHUNK = 1 << 16  # Rows added each time a column grows
+
+BLOCK_ROWS = 4096
+BLOCK_ENTRY = struct.Struct("<qqdddQ")  # first_t, last_t, min, max, sum, count
+
+BATCH_LINES = 64        # Samples a reader hands over at once
+BATCH_SECONDS = 0.05    # Longest a reader holds on to a partial batch
+COMMIT_SECONDS = 1.0    # How often row counts are written to the headers
+REOPEN_SECONDS = 2.0    # Wait before reopening an unplugged serial device
+
+
+def max_sample_rate():
+    """Fastest rate a probe samples at, from the shortest burst budget
+    in include/sensor.h. Continuous demand samples back to back, and no
+    sample is shorter than one oversampling burst."""
+    with open(os.path.join(ROOT, "include", "sensor.h")) as f:
+        match = re.search(r"#define SENSOR_BURST_BUDGET_MS (\d+)", f.read())
+
+    return 1000.0 / int(match.group(1))
+
+
+# Decoding, following the sensor drivers in src/
+
+
+def decode_temperature(raw):
+    """Degrees fahrenheit. Unlike the firmware, which only keeps whole
+    degrees, the full 1/16 degree resolution of the scratchpad is kept."""
+    celsius = int.from_bytes(raw[0:2], "little", signed=True) / 16.0
+    return celsius * 9.0 / 5.0 + 32.0
+
+
+def decode_lux(raw):
+    return ((raw[0] << 8) | raw[1]) / 1.2
+
+
+def decode_moisture(raw):
+    return (raw[0] << 8) | raw[1]
+
+
+DECODERS = (decode_temperature, decode_lux, decode_moisture)
+
+
+def decode_value(sensor, raw):
+    shift = raw[RAW_SHIFT_BYTE]
+
+    # The burst sum is in decoded units; dividing by the read count keeps
+    # the extra resolution of oversampling
+    if shift:
+        total = int.from_bytes(raw[RAW_SUM_BYTE:RAW_SUM_BYTE + 4], "big", signed=True)
+        return total / (1 << (2 * shift))
+
+    return DECODERS[sensor](raw)
+
+
+class FrameError(ValueError):
+    """A frame that was damaged or cut short."""
+
+
+def parse_frame(line):
+    """Returns (sequence, uptime_ms, values) for a frame, where values
+    has one entry per sensor and None for sensors not read in the
+    sample, or None if the line holds no frame. Raises FrameError if
+    the frame fails its checksum or is malformed."""
+    start = line.find(FRAME_TAG)
+    if start < 0:
+        return None
+
+    body, star, crc = line[start + len(FRAME_TAG):].rstrip("\r\n").rpartition("*")
+
+    if not star or len(crc) != 4:
+        raise FrameError("no checksum")
+
+    try:
+        if binascii.crc_hqx(body.encode("ascii"), CRC_INIT) != int(crc, 16):
+            raise FrameError("checksum mismatch")
+
+        fields = body.split(",")
+        sequence, uptime_ms, mask = int(fields[0]), int(fields[1]), int(fields[2], 16)
+        raws = [bytes.fromhex(field) for field in fields[3:]]
+    except (UnicodeEncodeError, ValueError, IndexError) as error:
+        raise FrameError(str(error)) from None
+
+    if any(len(raw) != RAW_MAX for raw in raws):
+        raise FrameError("raw bytes of the wrong length")
+
+    values = []
+    for sensor, raw in enumerate(raws[:len(CHANNELS)]):
+        values.append(decode_value(sensor, raw) if mask & (1 << sensor) else None)
+
+    return sequence, uptime_ms, values
+
+
+def format_frame(sequence, uptime_ms, values):
+    """Encodes a sample the way sample_frame_print() prints it. Values
+    are in decoded units; lux and moisture are stored as 16-read bursts
+    like the board's default oversampling."""
+    mask = 0
+    sensors = []
+
+    for sensor, value in enumerate(values):
+        raw = bytearray(RAW_MAX)
+
+        if value is not None:
+            mask |= 1 << sensor
+
+            if sensor == 0:
+                celsius = round((value - 32.0) * 5.0 / 9.0 * 16)
+                raw[0:2] = (celsius & 0xffff).to_bytes(2, "little")
+            else:
+                reads = 16
+                single = round(value * 1.2) if sensor == 1 else round(value)
+                raw[0:2] = (min(single, 0xffff)).to_bytes(2, "big")
+                raw[RAW_SUM_BYTE:RAW_SUM_BYTE + 4] = round(value * reads).to_bytes(4, "big", signed=True)
+                raw[RAW_SHIFT_BYTE] = 2
+
+        sensors.append(raw.hex())
+
+    body = "%d,%d,%02x,%s" % (sequence, uptime_ms, mask, ",".join(sensors))
+
+    return "%s%s*%04x\n" % (FRAME_TAG, body, binascii.crc_hqx(body.encode("ascii"), CRC_INIT))
+
+
+# Storage
+
+
+class Column:
+    """An array of 8-byte numbers ('q' or 'd') in a memory-mapped file."""
+
+    def __init__(self, path, typecode):
+        self.typecode = typecode
+        self.file = open(path, "r+b" if os.path.exists(path) else "w+b")
+
+        if os.fstat(self.file.fileno()).st_size < COLUMN_HEADER.size:
+            self.file.write(COLUMN_HEADER.pack(COLUMN_MAGIC, 0))
+            self.file.truncate(COLUMN_HEADER.size + COLUMN_CHUNK * 8)
+
+        self._map()
+        magic, self.rows = COLUMN_HEADER.unpack_from(self.mm)
+
+        if magic != COLUMN_MAGIC:
+            raise ValueError("%s is not a column file" % path)
+
+        self.rows = min(self.rows, len(self.view))
+
+    def _map(self):
+        self.mm = mmap.mmap(self.file.fileno(), 0)
+        self.view = memoryview(self.mm)[COLUMN_HEADER.size:].cast(self.typecode)
+
+    def _unmap(self):
+        self.view.release()
+        self.mm.close()
+
+    def append(self, values):
+        end = self.rows + len(values)
+
+        if end > len(self.view):
+            capacity = max(end, len(self.view) * 2)
+            self._unmap()
+            self.file.truncate(COLUMN_HEADER.size + capacity * 8)
+            self._map()
+
+        self.view[self.rows:end] = memoryview(values)
+        self.rows = end
+
+    def commit(self):
+        COLUMN_HEADER.pack_into(self.mm, 0, COLUMN_MAGIC, self.rows)
+
+    def close(self):
+        self.commit()
+        self.mm.flush()
+        self._unmap()
+        self.file.close()
+
+
+class Channel:
+    """Timestamp and value columns of one channel, with a block index."""
+
+    def __init__(self, path):
+        self.times = Column(path + ".t", "q")
+        self.values = Column(path + ".v", "d")
+
+        # A crash between the two header writes leaves one column ahead
+        self.rows = self.times.rows = self.values.rows = min(self.times.rows, self.values.rows)
+
+        self.blocks = []
+        if os.path.exists(path + ".idx"):
+            with open(path + ".idx", "rb") as f:
+                data = f.read()
+            self.blocks = [BLOCK_ENTRY.unpack_from(data, offset)
+                           for offset in range(0, len(data) - BLOCK_ENTRY.size + 1, BLOCK_ENTRY.size)]
+            del self.blocks[self.rows // BLOCK_ROWS:]
+
+        self.block_starts = [block[0] for block in self.blocks]
+        self.index = open(path + ".idx", "r+b" if os.path.exists(path + ".idx") else "w+b")
+        self.index.truncate(len(self.blocks) * BLOCK_ENTRY.size)
+        self.index.seek(0, os.SEEK_END)
+
+    def last_time(self):
+        return self.times.view[self.rows - 1] if self.rows else None
+
+    def append(self, times, values):
+        """Appends rows. Times must not go back from the last row."""
+        self.times.append(times)
+        self.values.append(values)
+        self.rows += len(times)
+
+        while (len(self.blocks) + 1) * BLOCK_ROWS <= self.rows:
+            start = len(self.blocks) * BLOCK_ROWS
+            block = self.values.view[start:start + BLOCK_ROWS].tolist()
+            entry = (self.times.view[start], self.times.view[start + BLOCK_ROWS - 1],
+                     min(block), max(block), math.fsum(block), BLOCK_ROWS)
+
+            self.blocks.append(entry)
+            self.block_starts.append(entry[0])
+            self.index.write(BLOCK_ENTRY.pack(*entry))
+
+    def commit(self):
+        self.times.commit()
+        self.values.commit()
+        self.index.flush()
+
+    def close(self):
+        self.times.close()
+        self.values.close()
+        self.index.close()
+
+    def find(self, t):
+        """First row at or after time t."""
+        block = bisect.bisect_right(self.block_starts, t) - 1
+        lo = max(block, 0) * BLOCK_ROWS
+
+        if block + 1 < len(self.blocks):
+            hi = (block + 1) * BLOCK_ROWS
+        else:
+            hi = self.rows
+
+        return bisect.bisect_left(self.times.view, t, lo, hi)
+
+    def query(self, start, end):
+        """Rows with start <= time < end, as (time, value) pairs."""
+        first, last = self.find(start), self.find(end)
+
+        return list(zip(self.times.view[first:last].tolist(), self.values.view[first:last].tolist()))
+
+    def _aggregate(self, first, last):
+        """min, max, sum and count of rows first to last, using the block
+        index for every whole block in between."""
+        low, high, total, count = math.inf, -math.inf, 0.0, 0
+        row = first
+
+        while row < last:
+            block = row // BLOCK_ROWS
+
+            if row % BLOCK_ROWS == 0 and row + BLOCK_ROWS <= last and block < len(self.blocks):
+                entry = self.blocks[block]
+                low, high = min(low, entry[2]), max(high, entry[3])
+                total += entry[4]
+                count += entry[5]
+                row += BLOCK_ROWS
+                continue
+
+            stop = min(last, (block + 1) * BLOCK_ROWS)
+            part = self.values.view[row:stop].tolist()
+            low, high = min(low, min(part)), max(high, max(part))
+            total += math.fsum(part)
+            count += len(part)
+            row = stop
+
+        return low, high, total, count
+
+    def downsample(self, start, end, step):
+        """One (bucket start, min, max, mean, count) per step from start
+        to end, skipping buckets with no rows."""
+        buckets = []
+
+        for bucket in range(start, end, step):
+            first, last = self.find(bucket), self.find(min(bucket + step, end))
+
+            if first < last:
+                low, high, total, count = self._aggregate(first, last)
+                buckets.append((bucket, low, high, total / count, count))
+
+        return buckets
+
+
+class Store:
+    """A directory per probe with a Channel per sensor."""
+
+    def __init__(self, root):
+        self.root = root
+        self.channels = {}
+
+    def channel(self, probe, name):
+        key = (probe, name)
+
+        if key not in self.channels:
+            directory = os.path.join(self.root, probe)
+            os.makedirs(directory, exist_ok=True)
+            self.channels[key] = Channel(os.path.join(directory, name))
+
+        return self.channels[key]
+
+    def commit(self):
+        for channel in self.channels.values():
+            channel.commit()
+
+    def close(self):
+        for channel in self.channels.values():
+            channel.close()
+
+        self.channels.clear()
+
+
+# Readers. Each runs in its own thread and puts (probe, samples,
+# damaged) onto the event loop's queue, where samples is a list of
+# parse_frame() results and damaged the number of frames dropped since
+# the last batch. A reader puts (probe, None, 0) when its stream ends.
+
+
+def _read_lines(probe, lines, events, stop):
+    batch = []
+    damaged = 0
+    deadline = time.monotonic() + BATCH_SECONDS
+
+    for line in lines:
+        if stop.is_set():
+            break
+
+        try:
+            sample = parse_frame(line)
+        except FrameError:
+            damaged += 1
+            sample = None
+
+        if sample:
+            batch.append(sample)
+
+        if len(batch) >= BATCH_LINES or ((batch or damaged) and time.monotonic() >= deadline):
+            events.put((probe, batch, damaged))
+            batch = []
+            damaged = 0
+            deadline = time.monotonic() + BATCH_SECONDS
+
+    if batch or damaged:
+        events.put((probe, batch, damaged))
+
+
+def _serial_lines(path, stop):
+    """Lines from a serial device, reopening it if the probe is
+    unplugged or resets."""
+    pending = b""
+
+    while not stop.is_set():
+        try:
+            fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+        except OSError:
+            stop.wait(REOPEN_SECONDS)
+            continue
+
+        try:
+            # USB CDC ignores the baud rate; raw mode stops the tty layer
+            # from echoing or rewriting line endings
+            tty.setraw(fd, termios.TCSANOW)
+
+            while not stop.is_set():
+                ready, _, _ = select.select([fd], [], [], BATCH_SECONDS)
+                if not ready:
+                    yield ""
+                    continue
+
+                data = os.read(fd, 4096)
+                if not data:
+                    break
+
+                pending += data
+                *complete, pending = pending.split(b"\n")
+
+                for line in complete:
+                    yield line.decode("ascii", "replace")
+        except OSError:
+            pass
+        finally:
+            os.close(fd)
+
+        pending = b""
+        stop.wait(REOPEN_SECONDS)
+
+
+def read_serial(path, events, stop):
+    probe = os.path.basename(path)
+    _read_lines(probe, _serial_lines(path, stop), events, stop)
+    events.put((probe, None, 0))
+
+
+def read_recorded(path, events, stop):
+    probe = os.path.splitext(os.path.basename(path))[0]
+
+    with open(path, errors="replace") as f:
+        _read_lines(probe, f, events, stop)
+
+    events.put((probe, None, 0))
+
+
+def _synthetic_lines(seed, rate, stop):
+    """Frames of a probe in a pot by a window: temperature and
+    light follow the day, moisture dries down and is watered."""
+    rng = random.Random(seed)
+    period_ms = 1000.0 / rate if rate else 1000.0 / max_sample_rate()
+    uptime_ms = rng.randrange(1000, 5000)
+    moisture = rng.uniform(600, 900)
+    start = time.monotonic()
+    sample = 0
+
+    while not stop.is_set():
+        day = math.sin(2 * math.pi * uptime_ms / 86400000.0)
+        moisture = moisture - 0.001 if moisture > 350 else rng.uniform(800, 1000)
+
+        values = [70.0 + 8.0 * day + rng.gauss(0, 0.1),
+                  max(0.0, 4000.0 * day + rng.gauss(0, 20)),
+                  moisture + rng.gauss(0, 2)]
+
+        # The DS18B20 is slower than the other sensors, so it is left
+        # out of most samples
+        if sample % 4:
+            values[0] = None
+
+        yield format_frame(sample + 1, int(uptime_ms), values)
+
+        sample += 1
+        uptime_ms += period_ms
+
+        if rate:
+            delay = start + sample / rate - time.monotonic()
+            if delay > 0:
+                stop.wait(delay)
+
+
+def read_synthetic(index, rate, events, stop):
+    probe = "sim%03d" % index
+    _read_lines(probe, _synthetic_lines(index, rate, stop), events, stop)
+    events.put((probe, None, 0))
+
+
+# Event loop
+
+
+class Collector:
+    def __init__(self, store):
+        self.store = store
+        self.events = queue.Queue(maxsize=4096)
+        self.stop = threading.Event()
+        self.threads = []
+        self.clocks = {}    # probe -> (wall clock at uptime 0, last uptime)
+        self.sequences = {}     # probe -> last sequence number
+        self.samples = 0
+        self.rows = 0
+        self.damaged = 0    # Frames dropped for a bad checksum or format
+        self.lost = 0       # Gaps in sequence numbers, damaged frames included
+
+    def add_reader(self, target, *args):
+        thread = threading.Thread(target=target, args=args + (self.events, self.stop), daemon=True)
+        self.threads.append(thread)
+
+    def _wall_time(self, probe, uptime_ms):
+        """Converts probe uptime to wall clock milliseconds. The offset
+        is set by the first sample and again after the probe resets, so
+        time never goes back within a probe."""
+        offset, last_uptime = self.clocks.get(probe, (None, None))
+
+        if offset is None or uptime_ms < last_uptime:
+            now = int(time.time() * 1000)
+
+            if offset is not None:
+                now = max(now, offset + last_uptime + 1)
+
+            offset = now - uptime_ms
+
+        self.clocks[probe] = (offset, uptime_ms)
+
+        return offset + uptime_ms
+
+    def _store(self, probe, samples):
+        columns = [(array.array("q"), array.array("d")) for _ in CHANNELS]
+
+        for sequence, uptime_ms, values in samples:
+            t = self._wall_time(probe, uptime_ms)
+
+            # Sequence numbers start over when the probe resets
+            last = self.sequences.get(probe)
+            if last is not None and sequence > last + 1:
+                self.lost += sequence - last - 1
+            self.sequences[probe] = sequence
+
+            for sensor, value in enumerate(values):
+                if value is not None:
+                    columns[sensor][0].append(t)
+                    columns[sensor][1].append(value)
+
+        for sensor, (times, values) in enumerate(columns):
+            if times:
+                self.store.channel(probe, CHANNELS[sensor]).append(times, values)
+                self.rows += len(times)
+
+        self.samples += len(samples)
+
+    def run(self, seconds=None, report_seconds=None):
+        """Runs until every reader has finished, for the given time, or
+        until interrupted."""
+        running = len(self.threads)
+        start = time.monotonic()
+        next_commit = start + COMMIT_SECONDS
+        next_report = start + report_seconds if report_seconds else None
+
+        for thread in self.threads:
+            thread.start()
+
+        try:
+            while running:
+                now = time.monotonic()
+
+                if seconds is not None and now - start >= seconds and not self.stop.is_set():
+                    self.stop.set()
+
+                if now >= next_commit:
+                    self.store.commit()
+                    next_commit = now + COMMIT_SECONDS
+
+                if next_report and now >= next_report:
+                    print("(COLLECT) %d probes, %d samples, %d rows, %.0f samples/s, %d damaged, %d lost"
+                          % (len(self.clocks), self.samples, self.rows, self.samples / (now - start),
+                             self.damaged, self.lost))
+                    next_report = now + report_seconds
+
+                try:
+                    probe, samples, damaged = self.events.get(timeout=BATCH_SECONDS)
+                except queue.Empty:
+                    continue
+
+                self.damaged += damaged
+
+                if samples is None:
+                    running -= 1
+                else:
+                    self._store(probe, samples)
+        except KeyboardInterrupt:
+            self.stop.set()
+
+        self.stop.set()
+        self.store.commit()
+
+        return time.monotonic() - start
+
+
+def add_sources(collector, sources, rate):
+    for source in sources:
+        if source.startswith("synthetic:"):
+            for index in range(int(source.split(":", 1)[1])):
+                collector.add_reader(read_synthetic, index, rate)
+        elif os.path.isfile(source):
+            collector.add_reader(read_recorded, source)
+        else:
+            collector.add_reader(read_serial, source)
+
+
+def command_collect(args):
+    store = Store(args.store)
+    collector = Collector(store)
+    add_sources(collector, args.sources, args.rate)
+
+    elapsed = collector.run(args.seconds, report_seconds=10)
+    store.close()
+
+    print("(COLLECT) %d samples from %d probes in %.1f s, %d damaged, %d lost"
+          % (collector.samples, len(collector.clocks), elapsed, collector.damaged, collector.lost))
+
+
+def command_query(args):
+    store = Store(args.store)
+    channel = store.channel(args.probe, args.channel)
+    end = args.end if args.end is not None else (channel.last_time() or 0) + 1
+
+    if args.step:
+        print("time_ms,min,max,mean,count")
+        for bucket, low, high, mean, count in channel.downsample(args.start, end, args.step):
+            print("%d,%.3f,%.3f,%.3f,%d" % (bucket, low, high, mean, count))
+    else:
+        print("time_ms,value")
+        for t, value in channel.query(args.start, end):
+            print("%d,%.3f" % (t, value))
+
+    store.close()
+
+
+def command_bench(args):
+    required = args.probes * max_sample_rate()
+    directory = tempfile.mkdtemp(prefix="collector-bench-", dir=args.dir)
+
+    try:
+        store = Store(directory)
+        collector = Collector(store)
+        add_sources(collector, ["synthetic:%d" % args.probes], 0)
+
+        elapsed = collector.run(args.seconds)
+        rate = collector.samples / elapsed
+
+        print("(BENCH) %d probes, %d samples, %d rows in %.1f s"
+              % (args.probes, collector.samples, collector.rows, elapsed))
+        print("(BENCH) stored %.0f samples/s, %d probes at %.0f Hz need %.0f samples/s (%.1fx)"
+              % (rate, args.probes, max_sample_rate(), required, rate / required))
+
+        # Time queries over the busiest channel
+        channel = max(store.channels.values(), key=lambda c: c.rows)
+        first, last = channel.times.view[0], channel.times.view[channel.rows - 1] + 1
+        middle = (first + last) // 2
+
+        began = time.perf_counter()
+        rows = len(channel.query(middle, middle + (last - first) // 10))
+        query_ms = (time.perf_counter() - began) * 1000
+
+        began = time.perf_counter()
+        buckets = len(channel.downsample(first, last, max(1, (last - first) // 100)))
+        downsample_ms = (time.perf_counter() - began) * 1000
+
+        print("(BENCH) range query: %d of %d rows in %.2f ms" % (rows, channel.rows, query_ms))
+        print("(BENCH) downsample: %d buckets in %.2f ms" % (buckets, downsample_ms))
+
+        store.close()
+    finally:
+        shutil.rmtree(directory)
+
+    if rate < required:
+        sys.exit("(BENCH) collector cannot keep up")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    collect = commands.add_parser("collect", help="collect samples from probes")
+    collect.add_argument("store", help="store directory")
+    collect.add_argument("sources", nargs="+",
+                         help="serial device, recorded log or synthetic:<count>")
+    collect.add_argument("--seconds", type=float, help="stop after this long")
+    collect.add_argument("--rate", type=float, default=max_sample_rate(),
+                         help="samples/s of each synthetic probe, 0 for unthrottled")
+    collect.set_defaults(handler=command_collect)
+
+    query = commands.add_parser("query", help="print a channel as CSV")
+    query.add_argument("store", help="store directory")
+    query.add_argument("probe")
+    query.add_argument("channel", choices=CHANNELS)
+    query.add_argument("--start", type=int, default=0, help="first time, ms since the epoch")
+    query.add_argument("--end", type=int, help="time after the last row, ms since the epoch")
+    query.add_argument("--step", type=int, help="downsample to one row per step ms")
+    query.set_defaults(handler=command_query)
+
+    bench = commands.add_parser("bench", help="measure throughput with synthetic probes")
+    bench.add_argument("--probes", type=int, default=300)
+    bench.add_argument("--seconds", type=float, default=10)
+    bench.add_argument("--dir", help="where to create the temporary store")
+    bench.set_defaults(handler=command_bench)
+
+    args = parser.parse_args()
+    args.handler(args)
+
+
+if __name__ == "__main__":
+    main()
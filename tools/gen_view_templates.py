@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Generates src/view_templates.c, the static layer of each LCD view.
+
+Each template is a 504-byte frame buffer holding everything a view
+draws that never changes: labels, the header underline and the outline
+of percentage bars. Views copy their template and only draw the
+readings on top.
+
+The font is read from _FONT_TABLE in src/lcd.c, and drawing follows
+lcd.c: characters replace the 8 bytes under them, rectangles are OR'd
+in. Run this after changing the font or a view's static layout:
+
+    python3 tools/gen_view_templates.py
+"""
+
+import os
+import re
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+WIDTH = 84
+BANKS = 6
+
+FONT_ROW = re.compile(r"\{((?:\s*0x[0-9a-fA-F]{2},?){8})\s*\},\s*//\s*(\d+)")
+
+
+def load_font():
+    with open(os.path.join(ROOT, "src", "lcd.c")) as f:
+        source = f.read()
+
+    font = {}
+    for row, code in FONT_ROW.findall(source):
+        font[chr(int(code))] = [int(b, 16) for b in row.replace(",", " ").split()]
+
+    return font
+
+
+class Frame:
+    def __init__(self, font):
+        self.font = font
+        self.buf = [0] * (WIDTH * BANKS)
+
+    def text(self, col, row, string):
+        # Same wrapping as the text cursor: 10 columns, 6 rows
+        for c in string:
+            start = row * WIDTH + col * 8
+            self.buf[start:start + 8] = self.font[c]
+
+            col += 1
+            if col > 9:
+                col = 0
+                row = (row + 1) % BANKS
+
+    def pixel(self, x, y):
+        self.buf[(y // 8) * WIDTH + x] |= 1 << (y % 8)
+
+    def rect(self, x1, y1, x2, y2, fill):
+        for x in range(x1, x2 + 1):
+            if fill or x in (x1, x2):
+                for y in range(y1, y2 + 1):
+                    self.pixel(x, y)
+            else:
+                self.pixel(x, y1)
+                self.pixel(x, y2)
+
+
+def header(frame):
+    frame.rect(0, 9, 83, 9, True)
+
+
+# Static layers, kept in step with the views in src/graphics.c
+def loading(frame):
+    frame.text(0, 2, "LOADING...")
+
+
+def error(frame):
+    frame.text(0, 2, "  CRITICAL  ERROR!")
+
+
+def dual(frame):
+    header(frame)
+    frame.text(0, 2, "MOISTURE: ")
+    frame.rect(0, 24, 83, 31, False)
+    frame.text(0, 4, "LIGHT: ")
+    frame.rect(0, 40, 83, 47, False)
+
+
+def soil(frame):
+    header(frame)
+    frame.text(0, 2, "MOISTURE: ")
+    frame.rect(0, 32, 83, 39, False)
+
+
+def light(frame):
+    header(frame)
+    frame.text(0, 2, "QUALITY: ")
+    frame.rect(0, 32, 83, 39, False)
+
+
+def trend(frame):
+    header(frame)
+
+
+def dli(frame):
+    header(frame)
+    frame.text(0, 2, "TODAY:    ")
+    frame.text(0, 4, "YESTERDAY:")
+
+
+def dry_down(frame):
+    header(frame)
+    frame.text(0, 2, "DRYING:   ")
+    frame.text(0, 4, "DRY IN:   ")
+
+
+TEMPLATES = [
+    ("VIEW_TEMPLATE_LOADING", loading),
+    ("VIEW_TEMPLATE_ERROR", error),
+    ("VIEW_TEMPLATE_DUAL", dual),
+    ("VIEW_TEMPLATE_SOIL", soil),
+    ("VIEW_TEMPLATE_LIGHT", light),
+    ("VIEW_TEMPLATE_TREND", trend),
+    ("VIEW_TEMPLATE_DLI", dli),
+    ("VIEW_TEMPLATE_DRY_DOWN", dry_down),
+]
+
+
+def main():
+    font = load_font()
+
+    lines = [
+        "// Generated by tools/gen_view_templates.py. Do not edit.",
+        "",
+        '#include "view_templates.h"',
+        '#include "ram_placement.h"',
+        "",
+        "// Copied on every frame, so kept out of the XIP cache",
+        'const uint8_t HOT_DATA("view_templates") view_templates[VIEW_TEMPLATE_COUNT][LCD_BUF_SIZE] = {',
+    ]
+
+    for name, draw in TEMPLATES:
+        frame = Frame(font)
+        draw(frame)
+
+        lines.append("    [%s] = {" % name)
+        for i in range(0, len(frame.buf), 12):
+            lines.append("        " + ", ".join("0x%02x" % b for b in frame.buf[i:i + 12]) + ",")
+        lines.append("    },")
+
+    lines.append("};")
+
+    with open(os.path.join(ROOT, "src", "view_templates.c"), "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
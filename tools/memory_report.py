@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Breaks down static RAM and flash use per module from the linker map.
+
+Every input section in the map is assigned to the module (source file
+in src/) it came from, or to the SDK or library it belongs to. Sections
+at SRAM addresses count as RAM. Sections which also have a copy in
+flash (initialized data and code run from SRAM) count as both. Modules
+are checked against tools/memory_budget.txt, and the script exits with
+an error if any is over budget. Run after every build:
+
+    python3 tools/memory_report.py build/plant-health-probe.elf.map
+"""
+
+import os
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+FLASH = (0x10000000, 0x11000000)
+SRAM = (0x20000000, 0x20042000)
+
+# Sections which only reserve SRAM and have nothing in flash
+NO_LOAD = (".bss", ".noinit", ".heap", ".stack", "COMMON", ".scratch_x.bss", ".scratch_y.bss")
+
+# An input section, on one line or with the name on a line of its own
+SECTION = re.compile(r"^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+SECTION_NAME = re.compile(r"^ ([.\w]\S*)$")
+SECTION_REST = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+
+MODULE = re.compile(r"\.dir/src/(\w+)\.c\.obj$")
+LIBRARY = re.compile(r"lib(\w+)\.a\(")
+
+
+def load_budget():
+    budget = {}
+
+    with open(os.path.join(ROOT, "tools", "memory_budget.txt")) as f:
+        for line in f:
+            line = line.split("#")[0].split()
+            if line:
+                budget[line[0]] = (int(line[1]), int(line[2]))
+
+    return budget
+
+
+def module_of(obj):
+    match = MODULE.search(obj)
+    if match:
+        return match.group(1), True
+
+    match = LIBRARY.search(obj)
+    if match:
+        return "lib" + match.group(1), False
+
+    return "sdk", False
+
+
+def parse_map(path):
+    usage = {}
+    pending = None
+
+    with open(path) as f:
+        lines = iter(f.read().splitlines())
+
+    # Discarded sections are listed first and take no space
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            break
+
+    for line in lines:
+        if pending:
+            match = SECTION_REST.match(line)
+            name, pending = pending, None
+            if not match:
+                continue
+            addr, size, obj = match.groups()
+        else:
+            match = SECTION.match(line)
+            if not match:
+                match = SECTION_NAME.match(line)
+                if match:
+                    pending = match.group(1)
+                continue
+            name, addr, size, obj = match.groups()
+
+        if name == "*fill*" or obj.startswith("0x"):
+            continue
+
+        addr, size = int(addr, 16), int(size, 16)
+        if size == 0:
+            continue
+
+        module, ours = module_of(obj)
+        entry = usage.setdefault(module, [0, 0, ours])
+
+        if SRAM[0] <= addr < SRAM[1]:
+            entry[0] += size
+            if not name.startswith(NO_LOAD):
+                entry[1] += size
+        elif FLASH[0] <= addr < FLASH[1]:
+            entry[1] += size
+
+    return usage
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: memory_report.py <map file>")
+
+    budget = load_budget()
+    usage = parse_map(sys.argv[1])
+    over = []
+
+    print("(MEMORY) %-20s %8s %8s %8s %8s" % ("module", "ram", "budget", "flash", "budget"))
+
+    for module in sorted(usage, key=lambda m: (not usage[m][2], m)):
+        ram, flash, ours = usage[module]
+
+        if not ours:
+            print("(MEMORY) %-20s %8d %8s %8d %8s" % (module, ram, "-", flash, "-"))
+            continue
+
+        ram_budget, flash_budget = budget.get(module, budget["default"])
+        print("(MEMORY) %-20s %8d %8d %8d %8d" % (module, ram, ram_budget, flash, flash_budget))
+
+        if ram > ram_budget:
+            over.append("%s uses %d bytes of RAM, budget is %d" % (module, ram, ram_budget))
+        if flash > flash_budget:
+            over.append("%s uses %d bytes of flash, budget is %d" % (module, flash, flash_budget))
+
+    total_ram = sum(u[0] for u in usage.values())
+    total_flash = sum(u[1] for u in usage.values())
+    print("(MEMORY) %-20s %8d %8s %8d" % ("total", total_ram, "", total_flash))
+
+    for message in over:
+        print("(MEMORY) OVER BUDGET: " + message)
+
+    if over:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
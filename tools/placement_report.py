@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Reports where the hot-path functions and tables ended up.
+
+Every function marked HOT_FUNC(name) and every table marked
+HOT_DATA(group) in src/ is looked up in the linked ELF and listed as
+running from SRAM or from flash (through the XIP cache), followed by
+the total code size in each. Run after every build:
+
+    python3 tools/placement_report.py arm-none-eabi-nm build/plant-health-probe.elf
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+FLASH = (0x10000000, 0x11000000)
+SRAM = (0x20000000, 0x20042000)
+
+HOT_FUNC = re.compile(r"HOT_FUNC\((\w+)\)")
+HOT_DATA = re.compile(r"HOT_DATA\(\"[^\"]*\"\)\s+(\w+)")
+
+
+def region(addr):
+    if SRAM[0] <= addr < SRAM[1]:
+        return "SRAM"
+    if FLASH[0] <= addr < FLASH[1]:
+        return "flash"
+    return "?"
+
+
+def hot_symbols():
+    symbols = []
+    src = os.path.join(ROOT, "src")
+
+    for name in sorted(os.listdir(src)):
+        if not name.endswith(".c"):
+            continue
+        with open(os.path.join(src, name)) as f:
+            source = f.read()
+        for pattern in (HOT_FUNC, HOT_DATA):
+            symbols += [(match, name) for match in pattern.findall(source)]
+
+    return symbols
+
+
+def load_symbols(nm, elf):
+    out = subprocess.run([nm, "-S", "--defined-only", elf],
+                         check=True, capture_output=True, text=True).stdout
+    symbols = {}
+
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 4:
+            continue
+        addr, size, kind, name = parts
+        # Thumb function addresses have bit 0 set
+        symbols[name] = (int(addr, 16) & ~1, int(size, 16), kind)
+
+    return symbols
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: placement_report.py <nm> <elf>")
+
+    symbols = load_symbols(sys.argv[1], sys.argv[2])
+
+    print("(PLACEMENT) %-28s %-26s %6s  %s" % ("symbol", "file", "bytes", "runs from"))
+    for name, source in hot_symbols():
+        if name not in symbols:
+            print("(PLACEMENT) %-28s %-26s %6s  %s" % (name, source, "-", "not linked"))
+            continue
+        addr, size, _ = symbols[name]
+        print("(PLACEMENT) %-28s %-26s %6d  %s" % (name, source, size, region(addr)))
+
+    code = {"SRAM": 0, "flash": 0, "?": 0}
+    for addr, size, kind in symbols.values():
+        if kind in "tT":
+            code[region(addr)] += size
+
+    print("(PLACEMENT) code in SRAM: %d bytes, code in flash: %d bytes"
+          % (code["SRAM"], code["flash"]))
+
+
+if __name__ == "__main__":
+    main()
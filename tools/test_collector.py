@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Tests for collector.py: the frame parser, a recorded stream with
+damaged and missing frames, and queries on the store.
+
+    python3 tools/test_collector.py
+"""
+
+import os
+import shutil
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import collector  # noqa: E402
+
+# The line test/test_sample_frame.c formats: 26 C, lux not read and a
+# burst of 16 moisture reads of 1465
+KNOWN_FRAME = "(REC) 42,123456,05,a001000000000000,0000000000000000,05b900005b900200*a85a\n"
+
+
+class ParseFrameTest(unittest.TestCase):
+    def test_known_frame(self):
+        sequence, uptime_ms, values = collector.parse_frame(KNOWN_FRAME)
+
+        self.assertEqual(sequence, 42)
+        self.assertEqual(uptime_ms, 123456)
+        self.assertEqual(len(values), 3)
+        self.assertAlmostEqual(values[0], 26 * 9 / 5 + 32)
+        self.assertIsNone(values[1])
+        self.assertEqual(values[2], 1465.0)
+
+    def test_round_trip(self):
+        values = [71.5, 1234.5, 612.25]
+        line = collector.format_frame(7, 5000, values)
+        sequence, uptime_ms, parsed = collector.parse_frame(line)
+
+        self.assertEqual((sequence, uptime_ms), (7, 5000))
+        self.assertAlmostEqual(parsed[0], values[0], delta=0.1)
+        self.assertAlmostEqual(parsed[1], values[1], delta=1 / 16)
+        self.assertAlmostEqual(parsed[2], values[2], delta=1 / 16)
+
+    def test_frame_after_other_output(self):
+        # Output left without a line end runs into the next line
+        sample = collector.parse_frame("(SENSOR) noise" + KNOWN_FRAME)
+        self.assertEqual(sample[0], 42)
+
+    def test_other_lines_are_not_frames(self):
+        for line in ["", "\n", "(SENSOR) seesaw faulted after 2 failed samples.\n",
+                     "(TRACE) {1000, 0x07, {{0xa0}}},\n"]:
+            self.assertIsNone(collector.parse_frame(line))
+
+    def test_damaged_frames_are_rejected(self):
+        body_start = KNOWN_FRAME.index(" ") + 1
+        damaged = [
+            # Every single changed character in the body
+            KNOWN_FRAME[:i] + ("0" if KNOWN_FRAME[i] != "0" else "1") + KNOWN_FRAME[i + 1:]
+            for i in range(body_start, KNOWN_FRAME.index("*"))
+        ]
+        damaged += [
+            KNOWN_FRAME[:40] + "\n",                    # Cut short
+            KNOWN_FRAME.replace("*a85a", "*a8"),        # Short checksum
+            KNOWN_FRAME.replace("*a85a", "*zzzz"),      # Not hex
+            KNOWN_FRAME.replace("*a85a", ""),           # No checksum
+            KNOWN_FRAME.replace("05b9", "05\u00b9"),  # Not ASCII
+        ]
+
+        for line in damaged:
+            with self.assertRaises(collector.FrameError, msg=line):
+                collector.parse_frame(line)
+
+    def test_well_formed_checksum_over_bad_fields(self):
+        for body in ["42,123456", "x,1,05", "1,2,05,a001", "1,2,05,zz01000000000000"]:
+            line = "(REC) %s*%04x\n" % (body, collector.binascii.crc_hqx(body.encode(), collector.CRC_INIT))
+
+            with self.assertRaises(collector.FrameError, msg=line):
+                collector.parse_frame(line)
+
+
+class RecordedStreamTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp(prefix="collector-test-")
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def _collect(self, lines):
+        path = os.path.join(self.directory, "probe-a.log")
+
+        with open(path, "w") as f:
+            f.writelines(lines)
+
+        store = collector.Store(os.path.join(self.directory, "store"))
+        run = collector.Collector(store)
+        collector.add_sources(run, [path], 0)
+        run.run()
+
+        return store, run
+
+    def test_damaged_and_missing_frames_are_counted(self):
+        frames = [collector.format_frame(seq, seq * 200, [None, 100.0 * seq, 500.0])
+                  for seq in range(1, 11)]
+
+        # Frame 4 damaged, frame 7 missing, other output in between
+        frames[3] = frames[3].replace(",", ";", 1)
+        del frames[6]
+        frames.insert(2, "(SENSOR) bh1750 recovered after 1000 ms.\n")
+
+        store, run = self._collect(frames)
+
+        self.assertEqual(run.samples, 8)
+        self.assertEqual(run.damaged, 1)
+        self.assertEqual(run.lost, 2)
+        self.assertEqual(run.rows, 16)
+
+        lux = store.channel("probe-a", "lux")
+        self.assertEqual([value for _, value in lux.query(0, 2 ** 62)],
+                         [100.0 * seq for seq in (1, 2, 3, 5, 6, 8, 9, 10)])
+
+        store.close()
+
+    def test_probe_reset_is_not_a_loss(self):
+        frames = [collector.format_frame(seq, seq * 200, [None, None, 500.0]) for seq in (1, 2, 3)]
+        frames += [collector.format_frame(seq, seq * 200, [None, None, 510.0]) for seq in (1, 2)]
+
+        store, run = self._collect(frames)
+
+        self.assertEqual(run.samples, 5)
+        self.assertEqual(run.lost, 0)
+
+        # Time keeps going forward across the reset
+        times = [t for t, _ in store.channel("probe-a", "moisture").query(0, 2 ** 62)]
+        self.assertEqual(times, sorted(times))
+        self.assertEqual(len(set(times)), 5)
+
+        store.close()
+
+
+class StoreTest(unittest.TestCase):
+    def test_query_and_downsample_across_blocks(self):
+        directory = tempfile.mkdtemp(prefix="collector-test-")
+
+        try:
+            channel = collector.Channel(os.path.join(directory, "lux"))
+            rows = 3 * collector.BLOCK_ROWS + 100
+            times = collector.array.array("q", range(0, rows * 10, 10))
+            values = collector.array.array("d", (float(i % 97) for i in range(rows)))
+
+            channel.append(times, values)
+            self.assertEqual(len(channel.blocks), 3)
+
+            self.assertEqual(channel.query(995, 1035), [(1000, 3.0), (1010, 4.0), (1020, 5.0), (1030, 6.0)])
+
+            # Buckets straddling block edges agree with a plain scan
+            step = 12345
+            for start, low, high, mean, count in channel.downsample(0, rows * 10, step):
+                part = [values[i] for i in range(rows) if start <= times[i] < start + step]
+
+                self.assertEqual(count, len(part))
+                self.assertEqual((low, high), (min(part), max(part)))
+                self.assertAlmostEqual(mean, sum(part) / len(part))
+
+            channel.close()
+        finally:
+            shutil.rmtree(directory)
+
+
+if __name__ == "__main__":
+    unittest.main()